@@ -0,0 +1,1127 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Device memory sub-allocator. Memory is reserved in large blocks per memory
+// type and carved up with TLSF (two-level segregated fit): allocation and free
+// are O(1) bitmap scans plus neighbour merging. Buffers and optimal-tiling
+// images live in separate pools when bufferImageGranularity > 1, so they can
+// never share a granularity page. Not thread safe.
+//
+// Device memory is tracked per heap against the budget VK_EXT_memory_budget
+// reports (or a fixed share of the heap without it), and memory types whose
+// heap is close to its budget are passed over for another that fits.
+// Buffers registered as movable are copied out of sparse blocks a few per
+// frame, so the blocks empty out and are released.
+
+#define GPU_BLOCK_SIZE (64ull * 1024 * 1024)
+#define TLSF_GRANULARITY 256ull // every offset and size handed out is a multiple of this
+#define TLSF_SL_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 32
+#define GPU_BUDGET_PRESSURE 0.9 // a heap above this share of its budget is avoided
+#define GPU_BUDGET_ESTIMATE 0.8 // share of a heap we assume is ours without VK_EXT_memory_budget
+#define GPU_DEFRAG_BYTES_PER_FRAME (4ull * 1024 * 1024)
+#define GPU_DEFRAG_MOVES_PER_FRAME 16
+
+enum GpuResourceKind
+{
+    GPU_RESOURCE_LINEAR,  // buffers and linear images
+    GPU_RESOURCE_OPTIMAL, // optimal-tiling images
+};
+
+struct TlsfNode
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    int32_t prev_phys;
+    int32_t next_phys;
+    int32_t prev_free;
+    int32_t next_free;
+    bool free;
+};
+
+struct GpuMemoryBlock
+{
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void *mapped;
+    uint32_t memory_type;
+
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    int32_t free_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    ImVector<TlsfNode> nodes;
+    ImVector<int32_t> unused_nodes;
+
+    VkDeviceSize used;
+    uint32_t allocation_count;
+};
+
+struct GpuAllocation
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *mapped;
+    uint32_t memory_type;
+    GpuMemoryBlock *block; // nullptr for dedicated allocations
+    int32_t node;
+};
+
+struct GpuMemoryPool
+{
+    ImVector<GpuMemoryBlock *> blocks;
+};
+
+struct GpuAllocatorStats
+{
+    uint32_t block_count;
+    uint32_t dedicated_count;
+    uint32_t allocation_count;
+    VkDeviceSize reserved_bytes;
+    VkDeviceSize used_bytes;
+    VkDeviceSize largest_free;
+};
+
+struct GpuBuffer
+{
+    VkBuffer buffer;
+    GpuAllocation allocation;
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
+};
+
+// A buffer's old location after defragmentation moved it, kept until no
+// frame in flight can use it.
+struct GpuMovedBuffer
+{
+    GpuBuffer buffer;
+    uint64_t frame;
+};
+
+struct GpuAllocator
+{
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize buffer_image_granularity;
+    VkDeviceSize non_coherent_atom_size;
+    GpuMemoryPool pools[VK_MAX_MEMORY_TYPES][2];
+    uint32_t dedicated_count[VK_MAX_MEMORY_TYPES];
+    VkDeviceSize dedicated_bytes[VK_MAX_MEMORY_TYPES];
+    uint64_t alloc_calls;
+    uint64_t free_calls;
+    uint64_t device_alloc_calls;
+    VkDeviceSize device_bytes; // all live vkAllocateMemory allocations
+    VkDeviceSize peak_device_bytes;
+    VkDeviceSize heap_bytes[VK_MAX_MEMORY_HEAPS]; // device_bytes per heap
+    VkDeviceSize type_bytes[VK_MAX_MEMORY_TYPES]; // and per memory type
+
+    // Heap budgets, refreshed by gpu_allocator_begin_frame. heap_usage is the
+    // whole process as of the last query; without VK_EXT_memory_budget it
+    // stays 0 and only our own heap_bytes count.
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2; // nullptr without VK_EXT_memory_budget
+    VkDeviceSize heap_budget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heap_bytes_at_query[VK_MAX_MEMORY_HEAPS];
+    uint64_t budget_fallbacks; // allocations placed in another type because of the budget
+
+    // Defragmentation
+    bool defrag_enabled;
+    uint64_t frame;
+    uint32_t frames_in_flight;
+    ImVector<GpuBuffer *> movable;
+    ImVector<GpuMovedBuffer> moved;
+    uint64_t defrag_moves;
+    VkDeviceSize defrag_bytes;
+};
+
+struct GpuImage
+{
+    VkImage image;
+    GpuAllocation allocation;
+};
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline uint32_t bit_scan_reverse(uint64_t x)
+{
+    return 63 - __builtin_clzll(x);
+}
+
+//
+// TLSF within one block
+//
+
+static void tlsf_mapping(VkDeviceSize size, uint32_t *fl, uint32_t *sl)
+{
+    uint64_t units = size / TLSF_GRANULARITY;
+    if (units < TLSF_SL_COUNT)
+    {
+        *fl = 0;
+        *sl = (uint32_t)units;
+        return;
+    }
+    uint32_t msb = bit_scan_reverse(units);
+    *fl = msb - TLSF_SL_LOG2 + 1;
+    *sl = (uint32_t)(units >> (msb - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+}
+
+// Rounds the request up to the next size class so any block in that class fits.
+static void tlsf_mapping_search(VkDeviceSize size, uint32_t *fl, uint32_t *sl)
+{
+    uint64_t units = size / TLSF_GRANULARITY;
+    if (units >= TLSF_SL_COUNT)
+    {
+        units += (1ull << (bit_scan_reverse(units) - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping(units * TLSF_GRANULARITY, fl, sl);
+}
+
+static int32_t tlsf_new_node(GpuMemoryBlock *block)
+{
+    if (block->unused_nodes.Size > 0)
+    {
+        int32_t index = block->unused_nodes.back();
+        block->unused_nodes.pop_back();
+        return index;
+    }
+    block->nodes.push_back(TlsfNode());
+    return block->nodes.Size - 1;
+}
+
+static void tlsf_insert_free(GpuMemoryBlock *block, int32_t index)
+{
+    TlsfNode *node = &block->nodes[index];
+    uint32_t fl, sl;
+    tlsf_mapping(node->size, &fl, &sl);
+
+    int32_t head = block->free_heads[fl][sl];
+    node->free = true;
+    node->prev_free = -1;
+    node->next_free = head;
+    if (head >= 0)
+        block->nodes[head].prev_free = index;
+    block->free_heads[fl][sl] = index;
+    block->fl_bitmap |= 1u << fl;
+    block->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void tlsf_remove_free(GpuMemoryBlock *block, int32_t index)
+{
+    TlsfNode *node = &block->nodes[index];
+    uint32_t fl, sl;
+    tlsf_mapping(node->size, &fl, &sl);
+
+    if (node->prev_free >= 0)
+        block->nodes[node->prev_free].next_free = node->next_free;
+    else
+        block->free_heads[fl][sl] = node->next_free;
+    if (node->next_free >= 0)
+        block->nodes[node->next_free].prev_free = node->prev_free;
+
+    if (block->free_heads[fl][sl] < 0)
+    {
+        block->sl_bitmap[fl] &= ~(1u << sl);
+        if (block->sl_bitmap[fl] == 0)
+            block->fl_bitmap &= ~(1u << fl);
+    }
+    node->free = false;
+}
+
+static int32_t tlsf_find_free(GpuMemoryBlock *block, VkDeviceSize size)
+{
+    uint32_t fl, sl;
+    tlsf_mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT)
+        return -1;
+
+    uint32_t sl_map = block->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0)
+    {
+        uint32_t fl_map = (fl + 1 < TLSF_FL_COUNT) ? block->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_map == 0)
+            return -1;
+        fl = __builtin_ctz(fl_map);
+        sl_map = block->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return block->free_heads[fl][sl];
+}
+
+// Splits `size` bytes off the front (front == true) or back of a used node;
+// the split-off part becomes a new free node.
+static void tlsf_split(GpuMemoryBlock *block, int32_t index, VkDeviceSize size, bool front)
+{
+    int32_t rest = tlsf_new_node(block);
+    TlsfNode *node = &block->nodes[index];
+    TlsfNode *split = &block->nodes[rest];
+    if (front)
+    {
+        split->offset = node->offset;
+        split->size = size;
+        split->prev_phys = node->prev_phys;
+        split->next_phys = index;
+        if (node->prev_phys >= 0)
+            block->nodes[node->prev_phys].next_phys = rest;
+        node->prev_phys = rest;
+        node->offset += size;
+        node->size -= size;
+    }
+    else
+    {
+        split->offset = node->offset + size;
+        split->size = node->size - size;
+        split->prev_phys = index;
+        split->next_phys = node->next_phys;
+        if (node->next_phys >= 0)
+            block->nodes[node->next_phys].prev_phys = rest;
+        node->next_phys = rest;
+        node->size = size;
+    }
+    tlsf_insert_free(block, rest);
+}
+
+static int32_t tlsf_alloc(GpuMemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize padded = size + (alignment > TLSF_GRANULARITY ? alignment - TLSF_GRANULARITY : 0);
+    int32_t index = tlsf_find_free(block, padded);
+    if (index < 0)
+        return -1;
+    tlsf_remove_free(block, index);
+
+    VkDeviceSize offset = block->nodes[index].offset;
+    VkDeviceSize padding = align_up(offset, alignment) - offset;
+    if (padding > 0)
+        tlsf_split(block, index, padding, true);
+    if (block->nodes[index].size - size >= TLSF_GRANULARITY)
+        tlsf_split(block, index, size, false);
+    return index;
+}
+
+static void tlsf_merge(GpuMemoryBlock *block, int32_t into, int32_t from)
+{
+    TlsfNode *a = &block->nodes[into];
+    TlsfNode *b = &block->nodes[from];
+    a->size += b->size;
+    a->next_phys = b->next_phys;
+    if (b->next_phys >= 0)
+        block->nodes[b->next_phys].prev_phys = into;
+    block->unused_nodes.push_back(from);
+}
+
+static void tlsf_free(GpuMemoryBlock *block, int32_t index)
+{
+    int32_t prev = block->nodes[index].prev_phys;
+    if (prev >= 0 && block->nodes[prev].free)
+    {
+        tlsf_remove_free(block, prev);
+        tlsf_merge(block, prev, index);
+        index = prev;
+    }
+    int32_t next = block->nodes[index].next_phys;
+    if (next >= 0 && block->nodes[next].free)
+    {
+        tlsf_remove_free(block, next);
+        tlsf_merge(block, index, next);
+    }
+    tlsf_insert_free(block, index);
+}
+
+static VkDeviceSize tlsf_largest_free(GpuMemoryBlock *block)
+{
+    if (block->fl_bitmap == 0)
+        return 0;
+    uint32_t fl = bit_scan_reverse(block->fl_bitmap);
+    uint32_t sl = bit_scan_reverse(block->sl_bitmap[fl]);
+    VkDeviceSize largest = 0;
+    for (int32_t i = block->free_heads[fl][sl]; i >= 0; i = block->nodes[i].next_free)
+    {
+        largest = block->nodes[i].size > largest ? block->nodes[i].size : largest;
+    }
+    return largest;
+}
+
+//
+// Blocks and pools
+//
+
+static bool is_host_visible(GpuAllocator *allocator, uint32_t memory_type)
+{
+    return allocator->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+static bool is_non_coherent(GpuAllocator *allocator, uint32_t memory_type)
+{
+    VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+    return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+static VkDeviceMemory allocate_device_memory(GpuAllocator *allocator, uint32_t memory_type, VkDeviceSize size, void **mapped)
+{
+    VkMemoryAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = size;
+    info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory;
+    VkResult err = vkAllocateMemory(allocator->device, &info, nullptr, &memory);
+    if (err != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    allocator->device_alloc_calls++;
+    allocator->device_bytes += size;
+    if (allocator->device_bytes > allocator->peak_device_bytes)
+        allocator->peak_device_bytes = allocator->device_bytes;
+    allocator->heap_bytes[allocator->memory_properties.memoryTypes[memory_type].heapIndex] += size;
+    allocator->type_bytes[memory_type] += size;
+
+    *mapped = nullptr;
+    if (is_host_visible(allocator, memory_type))
+    {
+        err = vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        check_vk_result(err);
+    }
+    return memory;
+}
+
+static void free_device_memory(GpuAllocator *allocator, VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size, void *mapped)
+{
+    if (mapped)
+        vkUnmapMemory(allocator->device, memory);
+    vkFreeMemory(allocator->device, memory, nullptr);
+    allocator->device_bytes -= size;
+    allocator->heap_bytes[allocator->memory_properties.memoryTypes[memory_type].heapIndex] -= size;
+    allocator->type_bytes[memory_type] -= size;
+}
+
+static GpuMemoryBlock *create_memory_block(GpuAllocator *allocator, uint32_t memory_type, VkDeviceSize size)
+{
+    void *mapped;
+    VkDeviceMemory memory = allocate_device_memory(allocator, memory_type, size, &mapped);
+    if (memory == VK_NULL_HANDLE)
+        return nullptr;
+
+    GpuMemoryBlock *block = IM_NEW(GpuMemoryBlock)();
+    block->memory = memory;
+    block->size = size;
+    block->mapped = mapped;
+    block->memory_type = memory_type;
+    block->fl_bitmap = 0;
+    memset(block->sl_bitmap, 0, sizeof(block->sl_bitmap));
+    memset(block->free_heads, 0xff, sizeof(block->free_heads));
+    block->used = 0;
+    block->allocation_count = 0;
+
+    int32_t index = tlsf_new_node(block);
+    TlsfNode *node = &block->nodes[index];
+    node->offset = 0;
+    node->size = size;
+    node->prev_phys = -1;
+    node->next_phys = -1;
+    tlsf_insert_free(block, index);
+    return block;
+}
+
+static void destroy_memory_block(GpuAllocator *allocator, GpuMemoryBlock *block)
+{
+    free_device_memory(allocator, block->memory, block->memory_type, block->size, block->mapped);
+    IM_DELETE(block);
+}
+
+static GpuMemoryPool *get_memory_pool(GpuAllocator *allocator, uint32_t memory_type, GpuResourceKind kind)
+{
+    // With a granularity of 1 linear and optimal resources may share pages
+    int pool = allocator->buffer_image_granularity > 1 ? (int)kind : 0;
+    return &allocator->pools[memory_type][pool];
+}
+
+static VkDeviceSize get_block_size(GpuAllocator *allocator, uint32_t memory_type)
+{
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+    VkDeviceSize heap_size = allocator->memory_properties.memoryHeaps[heap].size;
+    VkDeviceSize block_size = GPU_BLOCK_SIZE;
+    if (heap_size <= 1024ull * 1024 * 1024)
+        block_size = align_up(heap_size / 8, TLSF_GRANULARITY);
+    return block_size;
+}
+
+static VkDeviceSize get_heap_usage(GpuAllocator *allocator, uint32_t heap)
+{
+    // The driver's figure is as of the last query; add what we allocated since
+    VkDeviceSize usage = allocator->heap_usage[heap] + allocator->heap_bytes[heap];
+    VkDeviceSize at_query = allocator->heap_bytes_at_query[heap];
+    return usage > at_query ? usage - at_query : 0;
+}
+
+static void update_budget(GpuAllocator *allocator)
+{
+    if (!allocator->get_memory_properties2)
+        return;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    properties.pNext = &budget;
+    allocator->get_memory_properties2(allocator->physical_device, &properties);
+    for (uint32_t heap = 0; heap < allocator->memory_properties.memoryHeapCount; heap++)
+    {
+        allocator->heap_budget[heap] = budget.heapBudget[heap];
+        allocator->heap_usage[heap] = budget.heapUsage[heap];
+        allocator->heap_bytes_at_query[heap] = allocator->heap_bytes[heap];
+    }
+}
+
+// Bytes of new device memory an allocation of size would take from the type's heap.
+static VkDeviceSize get_new_device_bytes(GpuAllocator *allocator, uint32_t memory_type, GpuResourceKind kind, VkDeviceSize size)
+{
+    VkDeviceSize block_size = get_block_size(allocator, memory_type);
+    if (size > block_size / 2)
+        return size;
+    for (GpuMemoryBlock *block : get_memory_pool(allocator, memory_type, kind)->blocks)
+    {
+        if (tlsf_find_free(block, size) >= 0)
+            return 0;
+    }
+    return block_size;
+}
+
+// Picks a memory type allowed by type_filter with all of props. A type whose
+// heap would go over GPU_BUDGET_PRESSURE of its budget is passed over for
+// another match, then for one without DEVICE_LOCAL, which is slower but works
+// for anything. If every candidate is under pressure the first match is used
+// and vkAllocateMemory has the final say.
+static uint32_t find_memory_type(GpuAllocator *allocator, uint32_t type_filter, VkMemoryPropertyFlags props, GpuResourceKind kind, VkDeviceSize size)
+{
+    const VkPhysicalDeviceMemoryProperties& mem_props = allocator->memory_properties;
+    const VkMemoryPropertyFlags candidates[] = { props, props & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+    uint32_t first = UINT32_MAX;
+    for (VkMemoryPropertyFlags wanted : candidates)
+    {
+        for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++)
+        {
+            if (!(type_filter & (1u << i)) || (mem_props.memoryTypes[i].propertyFlags & wanted) != wanted)
+                continue;
+            if (first == UINT32_MAX)
+                first = i;
+            uint32_t heap = mem_props.memoryTypes[i].heapIndex;
+            VkDeviceSize usage = get_heap_usage(allocator, heap) + get_new_device_bytes(allocator, i, kind, size);
+            if (usage <= (VkDeviceSize)(allocator->heap_budget[heap] * GPU_BUDGET_PRESSURE))
+            {
+                if (i != first)
+                    allocator->budget_fallbacks++;
+                return i;
+            }
+        }
+    }
+    if (first == UINT32_MAX)
+        fatal("Failed to find suitable memory type");
+    return first;
+}
+
+// memory_budget: VK_EXT_memory_budget is enabled on the device.
+void gpu_allocator_init(GpuAllocator *allocator, VkInstance instance, VkDevice device, VkPhysicalDevice physical_device, bool memory_budget)
+{
+    allocator->device = device;
+    allocator->physical_device = physical_device;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->memory_properties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    allocator->buffer_image_granularity = properties.limits.bufferImageGranularity;
+    allocator->non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+
+    memset(allocator->dedicated_count, 0, sizeof(allocator->dedicated_count));
+    memset(allocator->dedicated_bytes, 0, sizeof(allocator->dedicated_bytes));
+    allocator->alloc_calls = 0;
+    allocator->free_calls = 0;
+    allocator->device_alloc_calls = 0;
+    allocator->device_bytes = 0;
+    allocator->peak_device_bytes = 0;
+    memset(allocator->heap_bytes, 0, sizeof(allocator->heap_bytes));
+    memset(allocator->type_bytes, 0, sizeof(allocator->type_bytes));
+
+    memset(allocator->heap_usage, 0, sizeof(allocator->heap_usage));
+    memset(allocator->heap_bytes_at_query, 0, sizeof(allocator->heap_bytes_at_query));
+    for (uint32_t heap = 0; heap < allocator->memory_properties.memoryHeapCount; heap++)
+        allocator->heap_budget[heap] = (VkDeviceSize)(allocator->memory_properties.memoryHeaps[heap].size * GPU_BUDGET_ESTIMATE);
+    allocator->get_memory_properties2 = nullptr;
+    if (memory_budget)
+        allocator->get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    allocator->budget_fallbacks = 0;
+    update_budget(allocator);
+
+    allocator->defrag_enabled = true;
+    allocator->frame = 0;
+    allocator->frames_in_flight = 1;
+    allocator->defrag_moves = 0;
+    allocator->defrag_bytes = 0;
+}
+
+static void get_allocation_size(GpuAllocator *allocator, uint32_t memory_type, const VkMemoryRequirements& reqs, VkDeviceSize *size, VkDeviceSize *alignment)
+{
+    *alignment = reqs.alignment > TLSF_GRANULARITY ? reqs.alignment : TLSF_GRANULARITY;
+    *size = align_up(reqs.size, TLSF_GRANULARITY);
+    if (is_non_coherent(allocator, memory_type))
+    {
+        // Keep flush/invalidate ranges of neighbours from overlapping
+        VkDeviceSize atom = allocator->non_coherent_atom_size;
+        *alignment = atom > *alignment ? atom : *alignment;
+        *size = align_up(*size, atom);
+    }
+}
+
+static bool alloc_from_block(GpuMemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, GpuAllocation *out)
+{
+    int32_t node = tlsf_alloc(block, size, alignment);
+    if (node < 0)
+        return false;
+
+    const TlsfNode& n = block->nodes[node];
+    block->used += n.size;
+    block->allocation_count++;
+
+    memset(out, 0, sizeof(*out));
+    out->memory = block->memory;
+    out->offset = n.offset;
+    out->size = n.size;
+    out->mapped = block->mapped ? (char *)block->mapped + n.offset : nullptr;
+    out->memory_type = block->memory_type;
+    out->block = block;
+    out->node = node;
+    return true;
+}
+
+bool gpu_alloc(GpuAllocator *allocator, const VkMemoryRequirements& reqs, VkMemoryPropertyFlags props, GpuResourceKind kind, GpuAllocation *out)
+{
+    uint32_t memory_type = find_memory_type(allocator, reqs.memoryTypeBits, props, kind, align_up(reqs.size, TLSF_GRANULARITY));
+    VkDeviceSize size, alignment;
+    get_allocation_size(allocator, memory_type, reqs, &size, &alignment);
+
+    memset(out, 0, sizeof(*out));
+    out->memory_type = memory_type;
+    out->node = -1;
+    allocator->alloc_calls++;
+
+    VkDeviceSize block_size = get_block_size(allocator, memory_type);
+    if (size > block_size / 2)
+    {
+        out->memory = allocate_device_memory(allocator, memory_type, size, &out->mapped);
+        if (out->memory == VK_NULL_HANDLE)
+            return false;
+        out->size = size;
+        allocator->dedicated_count[memory_type]++;
+        allocator->dedicated_bytes[memory_type] += size;
+        return true;
+    }
+
+    GpuMemoryPool *pool = get_memory_pool(allocator, memory_type, kind);
+    for (GpuMemoryBlock *block : pool->blocks)
+    {
+        if (alloc_from_block(block, size, alignment, out))
+            return true;
+    }
+    GpuMemoryBlock *block = create_memory_block(allocator, memory_type, block_size);
+    if (!block)
+        return false;
+    pool->blocks.push_back(block);
+    bool ok = alloc_from_block(block, size, alignment, out);
+    IM_ASSERT(ok);
+    return ok;
+}
+
+void gpu_free(GpuAllocator *allocator, GpuAllocation *allocation)
+{
+    if (allocation->memory == VK_NULL_HANDLE)
+        return;
+    allocator->free_calls++;
+
+    if (!allocation->block)
+    {
+        free_device_memory(allocator, allocation->memory, allocation->memory_type, allocation->size, allocation->mapped);
+        allocator->dedicated_count[allocation->memory_type]--;
+        allocator->dedicated_bytes[allocation->memory_type] -= allocation->size;
+        memset(allocation, 0, sizeof(*allocation));
+        return;
+    }
+
+    GpuMemoryBlock *block = allocation->block;
+    block->used -= block->nodes[allocation->node].size;
+    block->allocation_count--;
+    tlsf_free(block, allocation->node);
+
+    // Keep one empty block per pool around so alloc/free cycles don't thrash vkAllocateMemory
+    if (block->allocation_count == 0)
+    {
+        for (GpuMemoryPool& pool : allocator->pools[block->memory_type])
+        {
+            for (int i = 0; i < pool.blocks.Size; i++)
+            {
+                if (pool.blocks[i] == block && pool.blocks.Size > 1)
+                {
+                    pool.blocks.erase(&pool.blocks[i]);
+                    destroy_memory_block(allocator, block);
+                    break;
+                }
+            }
+        }
+    }
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+void gpu_allocator_destroy(GpuAllocator *allocator)
+{
+    for (GpuMovedBuffer& moved : allocator->moved)
+    {
+        vkDestroyBuffer(allocator->device, moved.buffer.buffer, nullptr);
+        gpu_free(allocator, &moved.buffer.allocation);
+    }
+    allocator->moved.clear();
+    allocator->movable.clear();
+
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+    {
+        for (GpuMemoryPool& pool : allocator->pools[type])
+        {
+            for (GpuMemoryBlock *block : pool.blocks)
+            {
+                if (block->allocation_count > 0)
+                    fprintf(stderr, "[allocator] Leaked %u allocations in memory type %u\n", block->allocation_count, type);
+                destroy_memory_block(allocator, block);
+            }
+            pool.blocks.clear();
+        }
+    }
+}
+
+// Flushes host writes for non-coherent memory; a no-op for coherent types.
+void gpu_flush(GpuAllocator *allocator, const GpuAllocation *allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!is_non_coherent(allocator, allocation->memory_type))
+        return;
+    VkDeviceSize atom = allocator->non_coherent_atom_size;
+    VkDeviceSize begin = (allocation->offset + offset) & ~(atom - 1);
+    VkDeviceSize end = align_up(allocation->offset + offset + size, atom);
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation->memory;
+    range.offset = begin;
+    range.size = end - begin;
+    VkResult err = vkFlushMappedMemoryRanges(allocator->device, 1, &range);
+    check_vk_result(err);
+}
+
+void gpu_allocator_get_stats(GpuAllocator *allocator, uint32_t memory_type, GpuAllocatorStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (GpuMemoryPool& pool : allocator->pools[memory_type])
+    {
+        for (GpuMemoryBlock *block : pool.blocks)
+        {
+            VkDeviceSize largest = tlsf_largest_free(block);
+            stats->block_count++;
+            stats->allocation_count += block->allocation_count;
+            stats->reserved_bytes += block->size;
+            stats->used_bytes += block->used;
+            stats->largest_free = largest > stats->largest_free ? largest : stats->largest_free;
+        }
+    }
+    stats->dedicated_count = allocator->dedicated_count[memory_type];
+    stats->allocation_count += allocator->dedicated_count[memory_type];
+    stats->reserved_bytes += allocator->dedicated_bytes[memory_type];
+    stats->used_bytes += allocator->dedicated_bytes[memory_type];
+}
+
+// One row per block: allocations in green over the free space.
+static void draw_block_map(GpuMemoryBlock *block)
+{
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImVec2 size(ImGui::GetContentRegionAvail().x, ImGui::GetTextLineHeight());
+    float scale = size.x / (float)block->size;
+    draw_list->AddRectFilled(pos, ImVec2(pos.x + size.x, pos.y + size.y), IM_COL32(50, 50, 50, 255));
+
+    // Walk the physical chain from the front; merged-away nodes never start at 0
+    int32_t index = -1;
+    for (int32_t i = 0; i < block->nodes.Size && index < 0; i++)
+    {
+        if (block->nodes[i].offset == 0)
+            index = i;
+    }
+    for (; index >= 0; index = block->nodes[index].next_phys)
+    {
+        const TlsfNode& node = block->nodes[index];
+        if (node.free)
+            continue;
+        float x0 = pos.x + node.offset * scale;
+        float x1 = pos.x + (node.offset + node.size) * scale;
+        x1 = x1 - x0 < 1.0f ? x0 + 1.0f : x1;
+        draw_list->AddRectFilled(ImVec2(x0, pos.y), ImVec2(x1, pos.y + size.y), IM_COL32(90, 170, 90, 255));
+    }
+    ImGui::Dummy(size);
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::SetTooltip("type %u: %u allocations, %.2f / %.2f MiB used, largest free %.2f MiB", block->memory_type, block->allocation_count,
+                          block->used / (1024.0 * 1024.0), block->size / (1024.0 * 1024.0), tlsf_largest_free(block) / (1024.0 * 1024.0));
+    }
+}
+
+void gpu_allocator_draw_ui(GpuAllocator *allocator)
+{
+    ImGui::BulletText("alloc calls: %llu, free calls: %llu, vkAllocateMemory calls: %llu",
+                      (unsigned long long)allocator->alloc_calls, (unsigned long long)allocator->free_calls, (unsigned long long)allocator->device_alloc_calls);
+
+    if (allocator->get_memory_properties2)
+        ImGui::BulletText("Heap budgets from VK_EXT_memory_budget, usage is the whole process");
+    else
+        ImGui::BulletText("Heap budgets estimated at %.0f%% of each heap, usage is ours only", GPU_BUDGET_ESTIMATE * 100.0);
+    for (uint32_t heap = 0; heap < allocator->memory_properties.memoryHeapCount; heap++)
+    {
+        const VkMemoryHeap& info = allocator->memory_properties.memoryHeaps[heap];
+        VkDeviceSize usage = get_heap_usage(allocator, heap);
+        VkDeviceSize budget = allocator->heap_budget[heap];
+        ImGui::Text("heap %u (%s, %.0f MiB): ours %.2f MiB", heap, (info.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device local" : "host",
+                    info.size / (1024.0 * 1024.0), allocator->heap_bytes[heap] / (1024.0 * 1024.0));
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", usage / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+        ImGui::ProgressBar(budget > 0 ? (float)((double)usage / budget) : 0.0f, ImVec2(-1.0f, 0.0f), overlay);
+    }
+    ImGui::BulletText("placed off their first choice by the budget: %llu", (unsigned long long)allocator->budget_fallbacks);
+
+    for (uint32_t type = 0; type < allocator->memory_properties.memoryTypeCount; type++)
+    {
+        GpuAllocatorStats stats;
+        gpu_allocator_get_stats(allocator, type, &stats);
+        if (stats.block_count == 0 && stats.dedicated_count == 0)
+            continue;
+        ImGui::BulletText("type %u (heap %u): %u allocs in %u blocks + %u dedicated, %.2f / %.2f MiB used, largest free %.2f MiB",
+                          type, allocator->memory_properties.memoryTypes[type].heapIndex,
+                          stats.allocation_count, stats.block_count, stats.dedicated_count,
+                          stats.used_bytes / (1024.0 * 1024.0), stats.reserved_bytes / (1024.0 * 1024.0),
+                          stats.largest_free / (1024.0 * 1024.0));
+    }
+
+    if (ImGui::TreeNode("Blocks"))
+    {
+        for (uint32_t type = 0; type < allocator->memory_properties.memoryTypeCount; type++)
+        {
+            for (GpuMemoryPool& pool : allocator->pools[type])
+            {
+                for (GpuMemoryBlock *block : pool.blocks)
+                    draw_block_map(block);
+            }
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::Checkbox("Defragment", &allocator->defrag_enabled);
+    ImGui::BulletText("%d movable buffers, %llu moves, %.2f MiB moved, %d awaiting retire", allocator->movable.Size,
+                      (unsigned long long)allocator->defrag_moves, allocator->defrag_bytes / (1024.0 * 1024.0), allocator->moved.Size);
+}
+
+//
+// Resources
+//
+
+void gpu_create_buffer(GpuAllocator *allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, GpuBuffer *out)
+{
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult err = vkCreateBuffer(allocator->device, &buffer_info, nullptr, &out->buffer);
+    check_vk_result(err);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(allocator->device, out->buffer, &mem_reqs);
+    if (!gpu_alloc(allocator, mem_reqs, props, GPU_RESOURCE_LINEAR, &out->allocation))
+        fatal("Out of device memory allocating a %llu byte buffer", (unsigned long long)size);
+
+    err = vkBindBufferMemory(allocator->device, out->buffer, out->allocation.memory, out->allocation.offset);
+    check_vk_result(err);
+    out->size = size;
+    out->usage = usage;
+}
+
+void gpu_destroy_buffer(GpuAllocator *allocator, GpuBuffer *buffer)
+{
+    for (int i = 0; i < allocator->movable.Size; i++)
+    {
+        if (allocator->movable[i] == buffer)
+        {
+            allocator->movable.erase_unsorted(&allocator->movable[i]);
+            break;
+        }
+    }
+    vkDestroyBuffer(allocator->device, buffer->buffer, nullptr);
+    gpu_free(allocator, &buffer->allocation);
+    buffer->buffer = VK_NULL_HANDLE;
+}
+
+void gpu_create_image(GpuAllocator *allocator, const VkImageCreateInfo *info, VkMemoryPropertyFlags props, GpuImage *out)
+{
+    VkResult err = vkCreateImage(allocator->device, info, nullptr, &out->image);
+    check_vk_result(err);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(allocator->device, out->image, &mem_reqs);
+    GpuResourceKind kind = info->tiling == VK_IMAGE_TILING_OPTIMAL ? GPU_RESOURCE_OPTIMAL : GPU_RESOURCE_LINEAR;
+    if (!gpu_alloc(allocator, mem_reqs, props, kind, &out->allocation))
+        fatal("Out of device memory allocating a %ux%u image", info->extent.width, info->extent.height);
+
+    err = vkBindImageMemory(allocator->device, out->image, out->allocation.memory, out->allocation.offset);
+    check_vk_result(err);
+}
+
+void gpu_destroy_image(GpuAllocator *allocator, GpuImage *image)
+{
+    vkDestroyImage(allocator->device, image->image, nullptr);
+    gpu_free(allocator, &image->allocation);
+    image->image = VK_NULL_HANDLE;
+}
+
+//
+// Defragmentation. Registered buffers are moved out of the sparsest block of
+// a pool into fuller blocks of the same pool with GPU copies, a few per frame.
+// Once the old copies retire the block is empty and gpu_free releases it.
+// Images and unregistered buffers stay put.
+//
+
+// The buffer may be moved by gpu_allocator_defrag: the GpuBuffer is updated in
+// place, so users must take buffer->buffer when recording rather than keep a
+// copy, and must not reference it from descriptor sets. Needs transfer src and
+// dst usage. gpu_destroy_buffer unregisters it.
+void gpu_allocator_register_movable(GpuAllocator *allocator, GpuBuffer *buffer)
+{
+    const VkBufferUsageFlags transfer = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    IM_ASSERT((buffer->usage & transfer) == transfer);
+    allocator->movable.push_back(buffer);
+}
+
+// Call once per frame, before recording: refreshes the heap budgets and
+// destroys moved-from buffers no frame in flight can still use.
+void gpu_allocator_begin_frame(GpuAllocator *allocator, uint32_t frames_in_flight)
+{
+    allocator->frame++;
+    allocator->frames_in_flight = frames_in_flight;
+    update_budget(allocator);
+    for (int i = 0; i < allocator->moved.Size;)
+    {
+        GpuMovedBuffer *moved = &allocator->moved[i];
+        if (allocator->frame - moved->frame >= frames_in_flight)
+        {
+            vkDestroyBuffer(allocator->device, moved->buffer.buffer, nullptr);
+            gpu_free(allocator, &moved->buffer.allocation);
+            allocator->moved.erase_unsorted(moved);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static bool holds_movable(GpuAllocator *allocator, GpuMemoryBlock *block)
+{
+    for (GpuBuffer *buffer : allocator->movable)
+    {
+        if (buffer->allocation.block == block)
+            return true;
+    }
+    return false;
+}
+
+static bool holds_moved(GpuAllocator *allocator, GpuMemoryBlock *block)
+{
+    for (const GpuMovedBuffer& moved : allocator->moved)
+    {
+        if (moved.buffer.allocation.block == block)
+            return true;
+    }
+    return false;
+}
+
+// The least used block, among pools with more than one, that holds something
+// movable and whose contents would fit in the rest of its pool.
+static GpuMemoryBlock *find_defrag_source(GpuAllocator *allocator, GpuMemoryPool **out_pool)
+{
+    GpuMemoryBlock *source = nullptr;
+    for (uint32_t type = 0; type < allocator->memory_properties.memoryTypeCount; type++)
+    {
+        for (GpuMemoryPool& pool : allocator->pools[type])
+        {
+            if (pool.blocks.Size < 2)
+                continue;
+            VkDeviceSize free_bytes = 0;
+            for (GpuMemoryBlock *block : pool.blocks)
+                free_bytes += block->size - block->used;
+            for (GpuMemoryBlock *block : pool.blocks)
+            {
+                if (block->allocation_count == 0 || block->used > free_bytes - (block->size - block->used))
+                    continue;
+                if (source && block->used >= source->used)
+                    continue;
+                if (!holds_movable(allocator, block))
+                    continue;
+                source = block;
+                *out_pool = &pool;
+            }
+        }
+    }
+    return source;
+}
+
+// Records copies for up to GPU_DEFRAG_BYTES_PER_FRAME of moves into
+// command_buffer, ahead of anything this frame that uses the buffers, and
+// points the registered buffers at their new location right away.
+void gpu_allocator_defrag(GpuAllocator *allocator, VkCommandBuffer command_buffer)
+{
+    if (!allocator->defrag_enabled)
+        return;
+    GpuMemoryPool *pool = nullptr;
+    GpuMemoryBlock *source = find_defrag_source(allocator, &pool);
+    if (!source)
+        return;
+
+    // Moved buffers can be used anywhere, so the barriers are coarse; they are
+    // only recorded on frames that move something.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    VkDeviceSize bytes = 0;
+    int moves = 0;
+    for (GpuBuffer *buffer : allocator->movable)
+    {
+        if (buffer->allocation.block != source)
+            continue;
+        if (moves == GPU_DEFRAG_MOVES_PER_FRAME || (moves > 0 && bytes + buffer->size > GPU_DEFRAG_BYTES_PER_FRAME))
+            break;
+
+        GpuBuffer moved = *buffer;
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = buffer->size;
+        buffer_info.usage = buffer->usage;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkResult err = vkCreateBuffer(allocator->device, &buffer_info, nullptr, &moved.buffer);
+        check_vk_result(err);
+
+        // Only into fuller blocks that aren't being emptied themselves, so
+        // buffers never move back and forth
+        VkMemoryRequirements mem_reqs;
+        vkGetBufferMemoryRequirements(allocator->device, moved.buffer, &mem_reqs);
+        VkDeviceSize size, alignment;
+        get_allocation_size(allocator, source->memory_type, mem_reqs, &size, &alignment);
+        bool placed = false;
+        for (GpuMemoryBlock *block : pool->blocks)
+        {
+            if (block != source && block->used >= source->used && !holds_moved(allocator, block) &&
+                alloc_from_block(block, size, alignment, &moved.allocation))
+            {
+                placed = true;
+                break;
+            }
+        }
+        if (!placed)
+        {
+            vkDestroyBuffer(allocator->device, moved.buffer, nullptr);
+            break;
+        }
+        allocator->alloc_calls++;
+        err = vkBindBufferMemory(allocator->device, moved.buffer, moved.allocation.memory, moved.allocation.offset);
+        check_vk_result(err);
+
+        if (moves == 0)
+        {
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        VkBufferCopy region = {};
+        region.size = buffer->size;
+        vkCmdCopyBuffer(command_buffer, buffer->buffer, moved.buffer, 1, &region);
+
+        GpuMovedBuffer retired = { *buffer, allocator->frame };
+        allocator->moved.push_back(retired);
+        *buffer = moved;
+        bytes += buffer->size;
+        moves++;
+    }
+    if (moves == 0)
+        return;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+    allocator->defrag_moves += moves;
+    allocator->defrag_bytes += bytes;
+}
+
+//
+// Linear pools: one persistently mapped buffer split into per-frame regions.
+// Allocation is a pointer bump, a frame's region is reset wholesale once its
+// fence has been waited on.
+//
+
+struct GpuLinearPool
+{
+    GpuBuffer buffer;
+    VkDeviceSize frame_size;
+    uint32_t frame_count;
+    uint32_t frame_index;
+    VkDeviceSize head;
+    VkDeviceSize peak;
+};
+
+struct GpuLinearSlice
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void *mapped;
+};
+
+void gpu_linear_pool_init(GpuAllocator *allocator, GpuLinearPool *pool, VkDeviceSize frame_size, uint32_t frame_count, VkBufferUsageFlags usage)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->frame_size = align_up(frame_size, TLSF_GRANULARITY);
+    pool->frame_count = frame_count;
+    gpu_create_buffer(allocator, pool->frame_size * frame_count, usage,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pool->buffer);
+}
+
+void gpu_linear_pool_destroy(GpuAllocator *allocator, GpuLinearPool *pool)
+{
+    gpu_destroy_buffer(allocator, &pool->buffer);
+}
+
+void gpu_linear_pool_begin_frame(GpuLinearPool *pool, uint32_t frame_index)
+{
+    pool->frame_index = frame_index % pool->frame_count;
+    pool->head = 0;
+}
+
+bool gpu_linear_alloc(GpuLinearPool *pool, VkDeviceSize size, VkDeviceSize alignment, GpuLinearSlice *out)
+{
+    VkDeviceSize offset = align_up(pool->head, alignment);
+    if (offset + size > pool->frame_size)
+        return false;
+    pool->head = offset + size;
+    pool->peak = pool->head > pool->peak ? pool->head : pool->peak;
+
+    VkDeviceSize base = pool->frame_size * pool->frame_index;
+    out->buffer = pool->buffer.buffer;
+    out->offset = base + offset;
+    out->mapped = (char *)pool->buffer.allocation.mapped + base + offset;
+    return true;
+}
@@ -0,0 +1,694 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Compute work on its own queue, overlapping the graphics frame.
+//
+// The demo generates instance data with a deliberately heavy compute pass and
+// draws it with the batch pipeline. Output is double buffered: in frame N
+// compute fills slot N % 2 while graphics draws the other slot, filled in
+// frame N - 1, so the two submissions have no dependency on each other and can
+// run side by side. Per slot, compute signals compute_done for the graphics
+// submit that draws it, and that submit signals graphics_done for the compute
+// pass that overwrites it next.
+//
+// Buffers are VK_SHARING_MODE_EXCLUSIVE. With separate families each handoff
+// is a release barrier on one queue and a matching acquire barrier on the
+// other, chained through the semaphore. Without a compute-only family the
+// graphics queue is used and the semaphores alone order the work.
+//
+// Overlap is measured, not inferred: both queues write begin/end timestamps
+// and the intervals are intersected. Timestamps from different queues are
+// only comparable in a shared time domain, which VK_EXT_calibrated_timestamps
+// guarantees for VK_TIME_DOMAIN_DEVICE_EXT. Without it overlap isn't measured.
+
+#define ASYNC_SLOTS 2
+#define ASYNC_MAX_INSTANCES (1 << 20)
+#define ASYNC_HISTORY 16 // frames of queue intervals kept for the overlap measurement
+
+// Matches the push constants in async.comp
+struct AsyncPushConstants
+{
+    float time;
+    uint32_t instance_count;
+    uint32_t iterations;
+};
+
+struct AsyncSlot
+{
+    GpuBuffer instances;
+    VkDescriptorSet set;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    VkQueryPool query_pool;
+    VkSemaphore compute_done;
+    VkSemaphore graphics_done;
+    bool submitted;        // fence will signal
+    bool compute_pending;  // compute_done signaled, not yet waited on
+    bool graphics_pending; // graphics_done signaled, not yet waited on
+    uint32_t instance_count;
+    uint64_t frame; // submitted in
+};
+
+// One queue's busy interval in a frame, in device timestamp ticks
+struct AsyncInterval
+{
+    uint64_t frame;
+    uint64_t begin;
+    uint64_t end;
+    bool valid;
+    bool pending; // graphics: written, results not read yet
+};
+
+struct AsyncCompute
+{
+    VkDevice device;
+    uint32_t compute_family;
+    uint32_t graphics_family;
+    VkQueue compute_queue;
+    bool dedicated; // compute_queue is not the graphics queue
+    bool timestamps;
+    float timestamp_period;
+    uint64_t timestamp_mask;
+    bool shared_timestamps; // both queues' timestamps are in one domain, overlap is measured
+    uint64_t shared_mask;    // bits valid on both families
+
+    VkQueryPool graphics_query_pool; // begin/end per frame in ASYNC_HISTORY
+    bool graphics_timed;             // this frame's begin was written
+    AsyncInterval compute_intervals[ASYNC_HISTORY];
+    AsyncInterval graphics_intervals[ASYNC_HISTORY];
+
+    VkCommandPool command_pool;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    AsyncSlot slots[ASYNC_SLOTS];
+
+    uint64_t frame;
+    int draw_slot; // slot graphics draws this frame, -1 if none
+
+    bool enabled;
+    int instance_count;
+    int iterations;
+    double time;
+
+    float compute_ms;     // GPU time of the last compute pass
+    double compute_total_ms;
+    uint64_t compute_samples;
+
+    float overlap_ms; // compute time running alongside graphics, last measured frame
+    double overlap_total_ms;
+    double overlap_compute_ms; // compute time of the frames overlap was measured for
+    uint64_t overlap_samples;
+};
+
+// Whether the device can put both queues' timestamps in one domain. The
+// device must then enable VK_EXT_calibrated_timestamps.
+bool async_compute_query_shared_timestamps(VkInstance instance, VkPhysicalDevice physical_device)
+{
+    auto f_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT =
+        (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+    if (!f_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+        return false;
+    uint32_t count = 0;
+    VkResult err = f_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &count, nullptr);
+    check_vk_result(err);
+    ImVector<VkTimeDomainEXT> domains;
+    domains.resize((int)count);
+    err = f_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &count, domains.Data);
+    check_vk_result(err);
+    for (VkTimeDomainEXT domain : domains)
+    {
+        if (domain == VK_TIME_DOMAIN_DEVICE_EXT)
+            return true;
+    }
+    return false;
+}
+
+// Prefers a compute family without graphics; falls back to the graphics family.
+uint32_t find_compute_queue_family(VkPhysicalDevice physical_device, uint32_t graphics_family)
+{
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    ImVector<VkQueueFamilyProperties> families;
+    families.resize(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, families.Data);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && families[i].queueCount > 0)
+            return i;
+    }
+    return graphics_family;
+}
+
+static VkPipeline create_async_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkPipelineLayout layout)
+{
+    VkShaderModule shader = create_shader_module("async.comp", device);
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = shader;
+    info.stage.pName = "main";
+    info.layout = layout;
+
+    VkPipeline pipeline;
+    VkResult err = vkCreateComputePipelines(device, pipeline_cache, 1, &info, nullptr, &pipeline);
+    check_vk_result(err);
+    vkDestroyShaderModule(device, shader, nullptr);
+    return pipeline;
+}
+
+static void create_async_descriptors(AsyncCompute *ac)
+{
+    VkDevice device = ac->device;
+    VkResult err;
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+    err = vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &ac->set_layout);
+    check_vk_result(err);
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ASYNC_SLOTS };
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = ASYNC_SLOTS;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    err = vkCreateDescriptorPool(device, &pool_info, nullptr, &ac->descriptor_pool);
+    check_vk_result(err);
+
+    for (AsyncSlot& slot : ac->slots)
+    {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = ac->descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &ac->set_layout;
+        err = vkAllocateDescriptorSets(device, &alloc_info, &slot.set);
+        check_vk_result(err);
+
+        VkDescriptorBufferInfo buffer_info = { slot.instances.buffer, 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = slot.set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &buffer_info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(AsyncPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &ac->set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &range;
+    err = vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &ac->pipeline_layout);
+    check_vk_result(err);
+}
+
+// compute_queue may be the graphics queue, in which case compute_family must
+// be the graphics family. shared_timestamps is from
+// async_compute_query_shared_timestamps.
+void async_compute_init(AsyncCompute *ac, GpuAllocator *allocator, VkPipelineCache pipeline_cache,
+                        uint32_t graphics_family, VkQueue graphics_queue, uint32_t compute_family, VkQueue compute_queue,
+                        bool shared_timestamps)
+{
+    VkDevice device = allocator->device;
+    VkResult err;
+    ac->device = device;
+    ac->compute_family = compute_family;
+    ac->graphics_family = graphics_family;
+    ac->compute_queue = compute_queue;
+    ac->dedicated = compute_queue != graphics_queue;
+
+    uint32_t family_count;
+    vkGetPhysicalDeviceQueueFamilyProperties(allocator->physical_device, &family_count, nullptr);
+    ImVector<VkQueueFamilyProperties> families;
+    families.resize(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(allocator->physical_device, &family_count, families.Data);
+    uint32_t valid_bits = families[compute_family].timestampValidBits;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+    ac->timestamps = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
+    ac->timestamp_period = properties.limits.timestampPeriod;
+    ac->timestamp_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+    uint32_t graphics_bits = families[graphics_family].timestampValidBits;
+    uint32_t shared_bits = graphics_bits < valid_bits ? graphics_bits : valid_bits;
+    ac->shared_timestamps = shared_timestamps && ac->timestamps && graphics_bits > 0;
+    ac->shared_mask = shared_bits >= 64 ? ~0ull : ((1ull << shared_bits) - 1);
+    ac->graphics_query_pool = VK_NULL_HANDLE;
+    ac->graphics_timed = false;
+    memset(ac->compute_intervals, 0, sizeof(ac->compute_intervals));
+    memset(ac->graphics_intervals, 0, sizeof(ac->graphics_intervals));
+    if (ac->shared_timestamps)
+    {
+        VkQueryPoolCreateInfo query_info = {};
+        query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_info.queryCount = 2 * ASYNC_HISTORY;
+        err = vkCreateQueryPool(device, &query_info, nullptr, &ac->graphics_query_pool);
+        check_vk_result(err);
+    }
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = compute_family;
+    err = vkCreateCommandPool(device, &pool_info, nullptr, &ac->command_pool);
+    check_vk_result(err);
+
+    for (AsyncSlot& slot : ac->slots)
+    {
+        gpu_create_buffer(allocator, sizeof(BatchInstance) * ASYNC_MAX_INSTANCES,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &slot.instances);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = ac->command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(device, &alloc_info, &slot.command_buffer);
+        check_vk_result(err);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        err = vkCreateFence(device, &fence_info, nullptr, &slot.fence);
+        check_vk_result(err);
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        err = vkCreateSemaphore(device, &semaphore_info, nullptr, &slot.compute_done);
+        check_vk_result(err);
+        err = vkCreateSemaphore(device, &semaphore_info, nullptr, &slot.graphics_done);
+        check_vk_result(err);
+
+        slot.query_pool = VK_NULL_HANDLE;
+        if (ac->timestamps)
+        {
+            VkQueryPoolCreateInfo query_info = {};
+            query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_info.queryCount = 2;
+            err = vkCreateQueryPool(device, &query_info, nullptr, &slot.query_pool);
+            check_vk_result(err);
+        }
+
+        slot.submitted = false;
+        slot.compute_pending = false;
+        slot.graphics_pending = false;
+        slot.instance_count = 0;
+        slot.frame = 0;
+    }
+
+    create_async_descriptors(ac);
+    ac->pipeline = create_async_pipeline(device, pipeline_cache, ac->pipeline_layout);
+
+    ac->frame = 0;
+    ac->draw_slot = -1;
+    ac->enabled = false;
+    ac->instance_count = 256 * 1024;
+    ac->iterations = 64;
+    ac->time = 0.0;
+    ac->compute_ms = 0.0f;
+    ac->compute_total_ms = 0.0;
+    ac->compute_samples = 0;
+    ac->overlap_ms = 0.0f;
+    ac->overlap_total_ms = 0.0;
+    ac->overlap_compute_ms = 0.0;
+    ac->overlap_samples = 0;
+
+    printf("[async compute] family %u (graphics %u), %s queue, overlap %s\n", compute_family, graphics_family,
+           ac->dedicated ? "dedicated" : "graphics", ac->shared_timestamps ? "measured" : "not measured");
+}
+
+// The device must be idle.
+void async_compute_destroy(AsyncCompute *ac, GpuAllocator *allocator)
+{
+    if (ac->graphics_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(ac->device, ac->graphics_query_pool, nullptr);
+    for (AsyncSlot& slot : ac->slots)
+    {
+        if (slot.query_pool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(ac->device, slot.query_pool, nullptr);
+        vkDestroySemaphore(ac->device, slot.graphics_done, nullptr);
+        vkDestroySemaphore(ac->device, slot.compute_done, nullptr);
+        vkDestroyFence(ac->device, slot.fence, nullptr);
+        gpu_destroy_buffer(allocator, &slot.instances);
+    }
+    vkDestroyPipeline(ac->device, ac->pipeline, nullptr);
+    vkDestroyPipelineLayout(ac->device, ac->pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(ac->device, ac->descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(ac->device, ac->set_layout, nullptr);
+    vkDestroyCommandPool(ac->device, ac->command_pool, nullptr);
+}
+
+static bool async_compute_transfers_ownership(const AsyncCompute *ac)
+{
+    return ac->compute_family != ac->graphics_family;
+}
+
+static VkBufferMemoryBarrier async_ownership_barrier(const AsyncSlot *slot, uint32_t src_family, uint32_t dst_family,
+                                                      VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.buffer = slot->instances.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    return barrier;
+}
+
+static void async_compute_collect(AsyncCompute *ac, AsyncSlot *slot)
+{
+    if (!ac->timestamps)
+        return;
+    uint64_t results[2][2];
+    VkResult err = vkGetQueryPoolResults(ac->device, slot->query_pool, 0, 2, sizeof(results), results, sizeof(results[0]),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (err != VK_SUCCESS && err != VK_NOT_READY)
+        check_vk_result(err);
+    if (!results[0][1] || !results[1][1])
+        return;
+    uint64_t ticks = (results[1][0] - results[0][0]) & ac->timestamp_mask;
+    ac->compute_ms = (float)((double)ticks * ac->timestamp_period / 1000000.0);
+    ac->compute_total_ms += ac->compute_ms;
+    ac->compute_samples++;
+
+    AsyncInterval *interval = &ac->compute_intervals[slot->frame % ASYNC_HISTORY];
+    interval->frame = slot->frame;
+    interval->begin = results[0][0] & ac->shared_mask;
+    interval->end = results[1][0] & ac->shared_mask;
+    interval->valid = interval->end >= interval->begin; // a wrap isn't worth untangling
+}
+
+// Reads a graphics interval if its command buffer has finished. Never blocks.
+static void async_compute_collect_graphics(AsyncCompute *ac, AsyncInterval *interval)
+{
+    if (!interval->pending)
+        return;
+    uint32_t first = (uint32_t)(interval - ac->graphics_intervals) * 2;
+    uint64_t results[2][2];
+    VkResult err = vkGetQueryPoolResults(ac->device, ac->graphics_query_pool, first, 2, sizeof(results), results, sizeof(results[0]),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (err != VK_SUCCESS && err != VK_NOT_READY)
+        check_vk_result(err);
+    if (!results[0][1] || !results[1][1])
+        return;
+    interval->begin = results[0][0] & ac->shared_mask;
+    interval->end = results[1][0] & ac->shared_mask;
+    interval->valid = interval->end >= interval->begin;
+    interval->pending = false;
+}
+
+static uint64_t async_intersect(const AsyncInterval& a, const AsyncInterval& b)
+{
+    uint64_t begin = a.begin > b.begin ? a.begin : b.begin;
+    uint64_t end = a.end < b.end ? a.end : b.end;
+    return end > begin ? end - begin : 0;
+}
+
+// Intersects frame's compute interval with the graphics intervals it could
+// have run alongside: its own frame's and the neighbours'. Each queue runs
+// its own work in order, so the intersections never count a tick twice.
+static void async_compute_measure_overlap(AsyncCompute *ac, uint64_t frame)
+{
+    const AsyncInterval& compute = ac->compute_intervals[frame % ASYNC_HISTORY];
+    if (!compute.valid || compute.frame != frame)
+        return;
+    uint64_t ticks = 0;
+    bool any = false;
+    for (uint64_t f = frame - 1; f <= frame + 1; f++)
+    {
+        AsyncInterval *graphics = &ac->graphics_intervals[f % ASYNC_HISTORY];
+        async_compute_collect_graphics(ac, graphics);
+        if (!graphics->valid || graphics->frame != f)
+            continue;
+        ticks += async_intersect(compute, *graphics);
+        any = true;
+    }
+    if (!any)
+        return;
+    ac->overlap_ms = (float)((double)ticks * ac->timestamp_period / 1000000.0);
+    ac->overlap_total_ms += ac->overlap_ms;
+    ac->overlap_compute_ms += (double)(compute.end - compute.begin) * ac->timestamp_period / 1000000.0;
+    ac->overlap_samples++;
+}
+
+// Submits this frame's compute pass and picks the slot graphics draws. Call
+// once per frame before the graphics submit that async_compute_graphics_sync
+// feeds.
+void async_compute_begin_frame(AsyncCompute *ac, float dt)
+{
+    uint64_t frame = ac->frame;
+    uint32_t write_index = (uint32_t)(frame % ASYNC_SLOTS);
+    uint32_t read_index = write_index ^ 1;
+    ac->frame++;
+
+    // Far enough back that both queues are done with it and its neighbours
+    if (ac->shared_timestamps && frame > ASYNC_HISTORY / 2)
+        async_compute_measure_overlap(ac, frame - ASYNC_HISTORY / 2);
+
+    // A pending result is always consumed, even with the demo switched off,
+    // so no semaphore is left signaled
+    ac->draw_slot = ac->slots[read_index].compute_pending ? (int)read_index : -1;
+
+    if (!ac->enabled)
+        return;
+    CPU_SCOPE("async_compute_submit");
+
+    AsyncSlot *slot = &ac->slots[write_index];
+    VkResult err;
+    if (slot->submitted)
+    {
+        err = vkWaitForFences(ac->device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+        check_vk_result(err);
+        err = vkResetFences(ac->device, 1, &slot->fence);
+        check_vk_result(err);
+        async_compute_collect(ac, slot);
+        slot->submitted = false;
+    }
+    IM_ASSERT(!slot->compute_pending);
+
+    ac->time += dt;
+    if (ac->instance_count > ASYNC_MAX_INSTANCES)
+        ac->instance_count = ASYNC_MAX_INSTANCES;
+    slot->instance_count = (uint32_t)ac->instance_count;
+    slot->frame = frame;
+
+    VkCommandBuffer command_buffer = slot->command_buffer;
+    err = vkResetCommandBuffer(command_buffer, 0);
+    check_vk_result(err);
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    err = vkBeginCommandBuffer(command_buffer, &begin_info);
+    check_vk_result(err);
+
+    // Acquire from graphics, matching its release after the draw
+    if (slot->graphics_pending && async_compute_transfers_ownership(ac))
+    {
+        VkBufferMemoryBarrier barrier = async_ownership_barrier(slot, ac->graphics_family, ac->compute_family, 0, VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    if (ac->timestamps)
+    {
+        // At the semaphore's wait stage, so the interval doesn't start while
+        // the submit still waits for graphics
+        vkCmdResetQueryPool(command_buffer, slot->query_pool, 0, 2);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, slot->query_pool, 0);
+    }
+
+    AsyncPushConstants constants = { (float)ac->time, slot->instance_count, (uint32_t)ac->iterations };
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ac->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ac->pipeline_layout, 0, 1, &slot->set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, ac->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (slot->instance_count + 63) / 64, 1, 1);
+
+    if (ac->timestamps)
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot->query_pool, 1);
+
+    // Release to graphics; the semaphore makes the writes visible
+    if (async_compute_transfers_ownership(ac))
+    {
+        VkBufferMemoryBarrier barrier = async_ownership_barrier(slot, ac->compute_family, ac->graphics_family, VK_ACCESS_SHADER_WRITE_BIT, 0);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    err = vkEndCommandBuffer(command_buffer);
+    check_vk_result(err);
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.waitSemaphoreCount = slot->graphics_pending ? 1 : 0;
+    info.pWaitSemaphores = &slot->graphics_done;
+    info.pWaitDstStageMask = &wait_stage;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &command_buffer;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = &slot->compute_done;
+    err = vkQueueSubmit(ac->compute_queue, 1, &info, slot->fence);
+    check_vk_result(err);
+
+    slot->submitted = true;
+    slot->graphics_pending = false;
+    slot->compute_pending = true;
+}
+
+// Graphics side acquire; record outside the render pass, before the draw.
+// Also starts the graphics interval the overlap is measured against.
+void async_compute_record_acquire(AsyncCompute *ac, VkCommandBuffer command_buffer)
+{
+    ac->graphics_timed = ac->shared_timestamps && ac->enabled;
+    if (ac->graphics_timed)
+    {
+        uint64_t frame = ac->frame - 1;
+        AsyncInterval *interval = &ac->graphics_intervals[frame % ASYNC_HISTORY];
+        // Finished long ago: at most a few frames are in flight
+        async_compute_collect_graphics(ac, interval);
+        uint32_t first = (uint32_t)(frame % ASYNC_HISTORY) * 2;
+        vkCmdResetQueryPool(command_buffer, ac->graphics_query_pool, first, 2);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ac->graphics_query_pool, first);
+        interval->frame = frame;
+        interval->valid = false;
+        interval->pending = true;
+    }
+
+    if (ac->draw_slot < 0 || !async_compute_transfers_ownership(ac))
+        return;
+    AsyncSlot *slot = &ac->slots[ac->draw_slot];
+    VkBufferMemoryBarrier barrier = async_ownership_barrier(slot, ac->compute_family, ac->graphics_family, 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Draws the slot compute filled last frame. Expects viewport and scissor to be
+// set already.
+void async_compute_record_draw(const AsyncCompute *ac, VkCommandBuffer command_buffer, BatchRenderer *batch, PipelineRegistry *registry)
+{
+    if (ac->draw_slot < 0 || !ac->enabled)
+        return;
+    const AsyncSlot *slot = &ac->slots[ac->draw_slot];
+
+    VkBuffer buffers[2] = { batch->vertices.buffer, slot->instances.buffer };
+    VkDeviceSize offsets[2] = { 0, 0 };
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, batch->indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_registry_get(registry, batch->triangle_pipeline));
+
+    BatchPushConstants constants = { { 0.0f, 0.0f, 1.0f, 1.0f } };
+    vkCmdPushConstants(command_buffer, g_BatchPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    const BatchShapeInfo& shape = batch->shapes[BATCH_SHAPE_TRIANGLE];
+    vkCmdDrawIndexed(command_buffer, shape.index_count, slot->instance_count, shape.first_index, shape.vertex_offset, 0);
+}
+
+// Graphics side release back to compute; record after the render pass.
+void async_compute_record_release(AsyncCompute *ac, VkCommandBuffer command_buffer)
+{
+    if (ac->graphics_timed)
+    {
+        uint32_t first = (uint32_t)((ac->frame - 1) % ASYNC_HISTORY) * 2;
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, ac->graphics_query_pool, first + 1);
+        ac->graphics_timed = false;
+    }
+
+    if (ac->draw_slot < 0 || !async_compute_transfers_ownership(ac))
+        return;
+    AsyncSlot *slot = &ac->slots[ac->draw_slot];
+    VkBufferMemoryBarrier barrier = async_ownership_barrier(slot, ac->graphics_family, ac->compute_family, 0, 0);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Adds this frame's semaphores to the graphics submit. The submit must follow.
+void async_compute_graphics_sync(AsyncCompute *ac, SubmitSync *sync)
+{
+    if (ac->draw_slot < 0)
+        return;
+    IM_ASSERT(sync->wait_count < SUBMIT_SYNC_MAX && sync->signal_count < SUBMIT_SYNC_MAX);
+    AsyncSlot *slot = &ac->slots[ac->draw_slot];
+    sync->wait_semaphores[sync->wait_count] = slot->compute_done;
+    sync->wait_stages[sync->wait_count] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    sync->wait_count++;
+    sync->signal_semaphores[sync->signal_count++] = slot->graphics_done;
+    slot->compute_pending = false;
+    slot->graphics_pending = true;
+}
+
+void async_compute_reset_stats(AsyncCompute *ac)
+{
+    ac->compute_total_ms = 0.0;
+    ac->compute_samples = 0;
+    ac->overlap_total_ms = 0.0;
+    ac->overlap_compute_ms = 0.0;
+    ac->overlap_samples = 0;
+}
+
+double async_compute_get_avg_ms(const AsyncCompute *ac)
+{
+    return ac->compute_samples > 0 ? ac->compute_total_ms / ac->compute_samples : 0.0;
+}
+
+// Average measured overlap per frame and the share of compute time it is.
+// False if overlap wasn't measured.
+bool async_compute_get_overlap(const AsyncCompute *ac, double *avg_ms, double *fraction)
+{
+    if (!ac->shared_timestamps || ac->overlap_samples == 0)
+        return false;
+    *avg_ms = ac->overlap_total_ms / ac->overlap_samples;
+    *fraction = ac->overlap_compute_ms > 0.0 ? ac->overlap_total_ms / ac->overlap_compute_ms : 0.0;
+    return true;
+}
+
+// gpu_graphics_ms is the graphics queue's GPU frame time.
+void async_compute_draw_ui(AsyncCompute *ac, float gpu_graphics_ms)
+{
+    ImGui::Checkbox("Enabled##async", &ac->enabled);
+    ImGui::Text("Queue family %u, %s", ac->compute_family, ac->dedicated ? "dedicated compute queue" : "no compute-only family, graphics queue");
+    ImGui::SliderInt("Instances##async", &ac->instance_count, 1024, ASYNC_MAX_INSTANCES, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderInt("Iterations", &ac->iterations, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+    if (!ac->enabled)
+        return;
+
+    ImGui::Text("GPU compute: %.3f ms, GPU graphics: %.3f ms", ac->compute_ms, gpu_graphics_ms);
+    if (!ac->timestamps)
+        ImGui::TextDisabled("No timestamps on the compute family");
+    else if (!ac->shared_timestamps)
+        ImGui::TextDisabled("Overlap not measured: no timestamp domain shared by both queues");
+    else
+        ImGui::Text("Measured overlap: %.3f ms of compute ran alongside graphics", ac->overlap_ms);
+}
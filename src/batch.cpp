@@ -0,0 +1,376 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+#include "vertex_layout.hpp"
+
+// Instanced 2D primitives. Each shape is a tiny indexed mesh drawn once per
+// shape with one instance per primitive, so the whole batch is three draws no
+// matter how many primitives there are. Instance data for the maximum count is
+// generated and uploaded once; the slider only changes the instance count.
+// It is stored as BatchInstancePacked, which cuts vertex fetch by 40% over the
+// float BatchInstance that the culling and async compute paths write.
+
+#define BATCH_MAX_INSTANCES (1 << 21) // per shape
+
+enum BatchShape
+{
+    BATCH_SHAPE_TRIANGLE,
+    BATCH_SHAPE_QUAD,
+    BATCH_SHAPE_LINE,
+    BATCH_SHAPE_COUNT,
+};
+
+struct BatchInstance
+{
+    float offset[2];
+    float scale_rotation[2];
+    uint32_t color; // RGBA8
+};
+
+struct BatchInstancePacked
+{
+    Half2 offset;
+    Half2 scale_rotation;
+    uint32_t color; // RGBA8
+};
+
+using BatchInstanceLayout = VertexBinding<BatchInstance, VK_VERTEX_INPUT_RATE_INSTANCE,
+                                          VERTEX_ATTR(BatchInstance, offset),
+                                          VERTEX_ATTR(BatchInstance, scale_rotation),
+                                          VERTEX_ATTR_AS(BatchInstance, color, VK_FORMAT_R8G8B8A8_UNORM)>;
+
+using BatchInstancePackedLayout = VertexBinding<BatchInstancePacked, VK_VERTEX_INPUT_RATE_INSTANCE,
+                                                VERTEX_ATTR(BatchInstancePacked, offset),
+                                                VERTEX_ATTR(BatchInstancePacked, scale_rotation),
+                                                VERTEX_ATTR_AS(BatchInstancePacked, color, VK_FORMAT_R8G8B8A8_UNORM)>;
+
+struct BatchShapeInfo
+{
+    const char *name;
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset;
+    uint32_t primitives; // per instance
+};
+
+struct BatchRenderer
+{
+    GpuBuffer vertices;
+    GpuBuffer indices;
+    GpuBuffer instances;
+    BatchShapeInfo shapes[BATCH_SHAPE_COUNT];
+    int triangle_pipeline; // BatchInstance, for the culling and async compute paths
+    int packed_triangle_pipeline;
+    int packed_line_pipeline;
+
+    int instance_count; // per shape
+    bool shape_enabled[BATCH_SHAPE_COUNT];
+    uint64_t primitives_per_frame;
+    uint64_t instances_per_frame;
+};
+
+static VkPipelineLayout g_BatchPipelineLayout = VK_NULL_HANDLE;
+
+// Matches the push constants in batch.vert
+struct BatchPushConstants
+{
+    float view[4]; // center xy, 1 / half extents zw
+};
+
+static VkPipelineLayout create_batch_pipeline_layout(VkDevice device)
+{
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    range.offset = 0;
+    range.size = sizeof(BatchPushConstants);
+
+    VkPipelineLayoutCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.pushConstantRangeCount = 1;
+    info.pPushConstantRanges = &range;
+    VkPipelineLayout pipeline_layout;
+    VkResult err = vkCreatePipelineLayout(device, &info, nullptr, &pipeline_layout);
+    check_vk_result(err);
+    return pipeline_layout;
+}
+
+static VkPipeline create_batch_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkPrimitiveTopology topology,
+                                        const VkPipelineVertexInputStateCreateInfo *vertex_input, const char *name)
+{
+    VkShaderModule vert_shader = create_shader_module("batch.vert", device);
+    VkShaderModule frag_shader = create_shader_module("tri.frag", device);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_shader;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_shader;
+    stages[1].pName = "main";
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = topology;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = (uint32_t)IM_ARRAYSIZE(dynamic_states);
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask = (VK_COLOR_COMPONENT_R_BIT |
+                                             VK_COLOR_COMPONENT_G_BIT |
+                                             VK_COLOR_COMPONENT_B_BIT |
+                                             VK_COLOR_COMPONENT_A_BIT);
+    color_blend_attachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    if (g_BatchPipelineLayout == VK_NULL_HANDLE)
+        g_BatchPipelineLayout = create_batch_pipeline_layout(device);
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_BatchPipelineLayout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipeline pipeline = create_graphics_pipeline_timed(device, pipeline_cache, &pipeline_info, name);
+    vkDestroyShaderModule(device, vert_shader, nullptr);
+    vkDestroyShaderModule(device, frag_shader, nullptr);
+    return pipeline;
+}
+
+static VkPipeline create_batch_triangle_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+    VkPipelineVertexInputStateCreateInfo vertex_input = VertexInput<VertexLayout, BatchInstanceLayout>::state();
+    return create_batch_pipeline(device, pipeline_cache, render_pass, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &vertex_input, "batch_triangles");
+}
+
+static VkPipeline create_batch_packed_triangle_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+    VkPipelineVertexInputStateCreateInfo vertex_input = VertexInput<VertexLayout, BatchInstancePackedLayout>::state();
+    return create_batch_pipeline(device, pipeline_cache, render_pass, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &vertex_input, "batch_triangles_packed");
+}
+
+static VkPipeline create_batch_packed_line_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+    VkPipelineVertexInputStateCreateInfo vertex_input = VertexInput<VertexLayout, BatchInstancePackedLayout>::state();
+    return create_batch_pipeline(device, pipeline_cache, render_pass, VK_PRIMITIVE_TOPOLOGY_LINE_LIST, &vertex_input, "batch_lines_packed");
+}
+
+static uint32_t batch_random(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static float batch_random_float(uint32_t *state, float min, float max)
+{
+    return min + (max - min) * (batch_random(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+void batch_init(BatchRenderer *batch, GpuAllocator *allocator, UploadContext *upload, PipelineRegistry *registry)
+{
+    // Unit shapes, all centered on the origin
+    const VertexSource source[] = {
+        // Triangle
+        { {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+        { {  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f } },
+        { { -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } },
+        // Quad
+        { { -0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f } },
+        { {  0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f } },
+        { {  0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f } },
+        { { -0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f } },
+        // Line
+        { { -0.5f,  0.0f }, { 1.0f, 1.0f, 1.0f } },
+        { {  0.5f,  0.0f }, { 1.0f, 1.0f, 1.0f } },
+    };
+    Vertex verts[IM_ARRAYSIZE(source)];
+    pack_vertices(source, verts, IM_ARRAYSIZE(source));
+    const uint16_t indices[] = {
+        0, 1, 2,
+        0, 1, 2, 2, 3, 0,
+        0, 1,
+    };
+    batch->shapes[BATCH_SHAPE_TRIANGLE] = { "Triangles", 0, 3, 0, 1 };
+    batch->shapes[BATCH_SHAPE_QUAD] = { "Quads", 3, 6, 3, 2 };
+    batch->shapes[BATCH_SHAPE_LINE] = { "Lines", 9, 2, 7, 1 };
+
+    gpu_create_buffer(allocator, sizeof(verts), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &batch->vertices);
+    upload_buffer(upload, batch->vertices.buffer, 0, verts, sizeof(verts),
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+    gpu_create_buffer(allocator, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &batch->indices);
+    upload_buffer(upload, batch->indices.buffer, 0, indices, sizeof(indices),
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    // One range of BATCH_MAX_INSTANCES per shape
+    const int total = BATCH_MAX_INSTANCES * BATCH_SHAPE_COUNT;
+    VkDeviceSize instances_size = sizeof(BatchInstancePacked) * total;
+    gpu_create_buffer(allocator, instances_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &batch->instances);
+
+    // Generated as floats a chunk at a time, converted to half in one pass per chunk
+    BatchInstancePacked *instances = (BatchInstancePacked *)xmalloc(instances_size);
+    const int chunk = 4096;
+    float *params = (float *)xmalloc(sizeof(float) * 4 * chunk);
+    uint16_t *halves = (uint16_t *)xmalloc(sizeof(uint16_t) * 4 * chunk);
+    uint32_t seed = 0x9e3779b9;
+    for (int first = 0; first < total; first += chunk)
+    {
+        int n = total - first < chunk ? total - first : chunk;
+        for (int i = 0; i < n; i++)
+        {
+            float *p = &params[4 * i];
+            p[0] = batch_random_float(&seed, -1.0f, 1.0f);
+            p[1] = batch_random_float(&seed, -1.0f, 1.0f);
+            p[2] = batch_random_float(&seed, 0.005f, 0.03f);
+            p[3] = batch_random_float(&seed, 0.0f, 6.2831853f);
+            instances[first + i].color = batch_random(&seed) | 0xff000000;
+        }
+        pack_half(params, halves, 4 * (size_t)n);
+        for (int i = 0; i < n; i++)
+        {
+            const uint16_t *h = &halves[4 * i];
+            instances[first + i].offset = { h[0], h[1] };
+            instances[first + i].scale_rotation = { h[2], h[3] };
+        }
+    }
+    free(params);
+    free(halves);
+    upload_buffer(upload, batch->instances.buffer, 0, instances, instances_size,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    free(instances);
+
+    batch->triangle_pipeline = pipeline_registry_add(registry, "batch_triangles", create_batch_triangle_pipeline);
+    batch->packed_triangle_pipeline = pipeline_registry_add(registry, "batch_triangles_packed", create_batch_packed_triangle_pipeline);
+    batch->packed_line_pipeline = pipeline_registry_add(registry, "batch_lines_packed", create_batch_packed_line_pipeline);
+    for (int handle : { batch->triangle_pipeline, batch->packed_triangle_pipeline, batch->packed_line_pipeline })
+    {
+        pipeline_registry_add_shader(registry, handle, "batch.vert");
+        pipeline_registry_add_shader(registry, handle, "tri.frag");
+    }
+
+    batch->instance_count = 10000;
+    for (bool& enabled : batch->shape_enabled)
+        enabled = true;
+    batch->primitives_per_frame = 0;
+    batch->instances_per_frame = 0;
+}
+
+void batch_destroy(BatchRenderer *batch, GpuAllocator *allocator)
+{
+    gpu_destroy_buffer(allocator, &batch->vertices);
+    gpu_destroy_buffer(allocator, &batch->indices);
+    gpu_destroy_buffer(allocator, &batch->instances);
+    if (g_BatchPipelineLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(allocator->device, g_BatchPipelineLayout, nullptr);
+        g_BatchPipelineLayout = VK_NULL_HANDLE;
+    }
+}
+
+// Expects viewport and scissor to be set already.
+void batch_record(BatchRenderer *batch, VkCommandBuffer command_buffer, PipelineRegistry *registry)
+{
+    batch->primitives_per_frame = 0;
+    batch->instances_per_frame = 0;
+    if (batch->instance_count <= 0)
+        return;
+
+    VkBuffer buffers[2] = { batch->vertices.buffer, batch->instances.buffer };
+    VkDeviceSize offsets[2] = { 0, 0 };
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, batch->indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+    BatchPushConstants constants = { { 0.0f, 0.0f, 1.0f, 1.0f } };
+    vkCmdPushConstants(command_buffer, g_BatchPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    VkPipeline bound = VK_NULL_HANDLE;
+    for (int shape = 0; shape < BATCH_SHAPE_COUNT; shape++)
+    {
+        if (!batch->shape_enabled[shape])
+            continue;
+
+        int handle = shape == BATCH_SHAPE_LINE ? batch->packed_line_pipeline : batch->packed_triangle_pipeline;
+        VkPipeline pipeline = pipeline_registry_get(registry, handle);
+        if (pipeline != bound)
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound = pipeline;
+        }
+
+        const BatchShapeInfo& info = batch->shapes[shape];
+        vkCmdDrawIndexed(command_buffer, info.index_count, (uint32_t)batch->instance_count,
+                         info.first_index, info.vertex_offset, (uint32_t)(shape * BATCH_MAX_INSTANCES));
+        batch->primitives_per_frame += (uint64_t)info.primitives * batch->instance_count;
+        batch->instances_per_frame += (uint64_t)batch->instance_count;
+    }
+}
+
+// gpu_ms is the GPU time of the batch pass, 0 if unknown.
+void batch_draw_ui(BatchRenderer *batch, float gpu_ms)
+{
+    ImGui::SliderInt("Instances per shape", &batch->instance_count, 0, BATCH_MAX_INSTANCES, "%d", ImGuiSliderFlags_Logarithmic);
+    for (int shape = 0; shape < BATCH_SHAPE_COUNT; shape++)
+    {
+        if (shape > 0)
+            ImGui::SameLine();
+        ImGui::Checkbox(batch->shapes[shape].name, &batch->shape_enabled[shape]);
+    }
+
+    double primitives = (double)batch->primitives_per_frame;
+    ImGui::Text("%.3f M primitives/frame", primitives / 1e6);
+    ImGui::Text("%.1f M primitives/s at %.1f frames/s", primitives * ImGui::GetIO().Framerate / 1e6, ImGui::GetIO().Framerate);
+    if (gpu_ms > 0.0f)
+        ImGui::Text("%.1f M primitives/s of GPU time (%.3f ms)", primitives / gpu_ms / 1e3, gpu_ms);
+    ImGui::Text("Instance fetch: %.1f MB/frame at %d bytes/instance (%d unpacked)",
+                batch->instances_per_frame * sizeof(BatchInstancePacked) / (1024.0 * 1024.0),
+                (int)sizeof(BatchInstancePacked), (int)sizeof(BatchInstance));
+}
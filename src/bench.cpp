@@ -0,0 +1,344 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+
+#include "helpers.hpp"
+
+// Benchmark suite results. Each scenario runs a fixed number of headless
+// frames between bench_scenario_begin and bench_scenario_end, which collect
+// wall time, GPU frame time, CPU time per profiler phase, allocator calls and
+// peak device memory. bench_write_json writes one object per scenario, and
+// bench_compare flattens a stored baseline and the new results to
+// "scenarios.<name>.<metric>" keys and flags metrics that got worse by more
+// than a threshold.
+//
+// Keys ending in _ms, _bytes and _allocations are lower-is-better; keys
+// ending in _per_s are throughputs, higher-is-better.
+
+#define BENCH_MAX_PHASES 32
+#define BENCH_MIN_MS 0.05 // differences below this are noise on any machine
+
+struct BenchScenario
+{
+    char name[64];
+    int frames;
+    double frame_ms; // wall time per frame, including waiting on the GPU
+    double gpu_ms;   // "Frame" scope per frame, 0 without timestamps
+    int phase_count;
+    const char *phase_names[BENCH_MAX_PHASES];
+    double phase_ms[BENCH_MAX_PHASES]; // CPU ms per frame, summed over threads
+    uint64_t gpu_allocations;          // gpu_alloc calls
+    uint64_t device_allocations;       // vkAllocateMemory calls
+    VkDeviceSize peak_device_bytes;
+    const char *throughput_name; // optional, must end in _per_s
+    double throughput;
+
+    double start_ms;
+    uint64_t start_alloc_calls;
+    uint64_t start_device_alloc_calls;
+};
+
+struct BenchSuite
+{
+    char device[256];
+    uint32_t width;
+    uint32_t height;
+    ImVector<BenchScenario> scenarios;
+};
+
+struct BenchValue
+{
+    char key[160];
+    double number;
+    char text[256]; // set for strings, number is 0
+};
+
+// Call with the device idle; warm-up frames should already have run.
+void bench_scenario_begin(BenchScenario *scenario, const char *name, GpuAllocator *allocator, GpuProfiler *profiler)
+{
+    memset(scenario, 0, sizeof(*scenario));
+    snprintf(scenario->name, sizeof(scenario->name), "%s", name);
+    gpu_profiler_flush(profiler);
+    gpu_profiler_reset(profiler);
+    cpu_profiler_reset_totals();
+    allocator->peak_device_bytes = allocator->device_bytes;
+    scenario->start_alloc_calls = allocator->alloc_calls;
+    scenario->start_device_alloc_calls = allocator->device_alloc_calls;
+    scenario->start_ms = get_time_ms();
+}
+
+// Call with the device idle, after frames frames.
+void bench_scenario_end(BenchScenario *scenario, int frames, GpuAllocator *allocator, GpuProfiler *profiler)
+{
+    scenario->frames = frames;
+    scenario->frame_ms = (get_time_ms() - scenario->start_ms) / frames;
+    gpu_profiler_flush(profiler);
+    scenario->gpu_ms = gpu_profiler_get_avg_ms(profiler, "Frame");
+    scenario->phase_count = cpu_profiler_get_totals(scenario->phase_names, scenario->phase_ms, BENCH_MAX_PHASES);
+    for (int i = 0; i < scenario->phase_count; i++)
+        scenario->phase_ms[i] /= frames;
+    scenario->gpu_allocations = allocator->alloc_calls - scenario->start_alloc_calls;
+    scenario->device_allocations = allocator->device_alloc_calls - scenario->start_device_alloc_calls;
+    scenario->peak_device_bytes = allocator->peak_device_bytes;
+
+    printf("[bench] %-22s %8.3f ms/frame  gpu %8.3f ms  %6llu allocs  peak %7.1f MiB", scenario->name, scenario->frame_ms, scenario->gpu_ms,
+           (unsigned long long)scenario->gpu_allocations, scenario->peak_device_bytes / (1024.0 * 1024.0));
+    if (scenario->throughput_name)
+        printf("  %s %.1f", scenario->throughput_name, scenario->throughput);
+    printf("\n");
+}
+
+bool bench_write_json(const BenchSuite *suite, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "[bench] Can't write %s\n", path);
+        return false;
+    }
+    fprintf(f, "{\n  \"device\": ");
+    write_json_string(f, suite->device);
+    fprintf(f, ",\n  \"width\": %u,\n  \"height\": %u,\n  \"scenarios\": {", suite->width, suite->height);
+    for (int i = 0; i < suite->scenarios.Size; i++)
+    {
+        const BenchScenario& s = suite->scenarios[i];
+        fprintf(f, "%s\n    ", i > 0 ? "," : "");
+        write_json_string(f, s.name);
+        fprintf(f, ": {\n");
+        fprintf(f, "      \"frames\": %d,\n", s.frames);
+        fprintf(f, "      \"frame_ms\": %.4f,\n", s.frame_ms);
+        fprintf(f, "      \"gpu_ms\": %.4f,\n", s.gpu_ms);
+        fprintf(f, "      \"cpu_ms\": {");
+        for (int p = 0; p < s.phase_count; p++)
+        {
+            fprintf(f, "%s\n        ", p > 0 ? "," : "");
+            write_json_string(f, s.phase_names[p]);
+            fprintf(f, ": %.4f", s.phase_ms[p]);
+        }
+        fprintf(f, "\n      },\n");
+        fprintf(f, "      \"gpu_allocations\": %llu,\n", (unsigned long long)s.gpu_allocations);
+        fprintf(f, "      \"device_allocations\": %llu,\n", (unsigned long long)s.device_allocations);
+        if (s.throughput_name)
+            fprintf(f, "      \"%s\": %.2f,\n", s.throughput_name, s.throughput);
+        fprintf(f, "      \"peak_device_bytes\": %llu\n    }", (unsigned long long)s.peak_device_bytes);
+    }
+    fprintf(f, "\n  }\n}\n");
+    fclose(f);
+    printf("[bench] Wrote %s\n", path);
+    return true;
+}
+
+//
+// Baseline comparison. Just enough JSON to read back what bench_write_json
+// writes: objects, arrays, strings, numbers and literals, flattened into
+// dotted keys.
+//
+
+struct BenchJsonReader
+{
+    const char *p;
+    const char *end;
+    bool ok;
+};
+
+static void bench_json_skip_space(BenchJsonReader *r)
+{
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r'))
+        r->p++;
+}
+
+static bool bench_json_expect(BenchJsonReader *r, char c)
+{
+    bench_json_skip_space(r);
+    if (r->p < r->end && *r->p == c)
+    {
+        r->p++;
+        return true;
+    }
+    r->ok = false;
+    return false;
+}
+
+static void bench_json_parse_string(BenchJsonReader *r, char *out, size_t size)
+{
+    size_t length = 0;
+    if (!bench_json_expect(r, '"'))
+        return;
+    while (r->p < r->end && *r->p != '"')
+    {
+        char c = *r->p++;
+        if (c == '\\' && r->p < r->end)
+            c = *r->p++; // escapes other than \" and \\ aren't written
+        if (length + 1 < size)
+            out[length++] = c;
+    }
+    out[length] = '\0';
+    bench_json_expect(r, '"');
+}
+
+static void bench_json_parse_value(BenchJsonReader *r, const char *key, ImVector<BenchValue> *out)
+{
+    bench_json_skip_space(r);
+    if (!r->ok || r->p >= r->end)
+    {
+        r->ok = false;
+        return;
+    }
+
+    char child[160];
+    if (*r->p == '{' || *r->p == '[')
+    {
+        bool object = *r->p == '{';
+        char close = object ? '}' : ']';
+        r->p++;
+        bench_json_skip_space(r);
+        for (int index = 0; r->ok && r->p < r->end && *r->p != close; index++)
+        {
+            if (index > 0 && !bench_json_expect(r, ','))
+                return;
+            char name[128];
+            if (object)
+            {
+                bench_json_parse_string(r, name, sizeof(name));
+                bench_json_expect(r, ':');
+            }
+            else
+            {
+                snprintf(name, sizeof(name), "%d", index);
+            }
+            snprintf(child, sizeof(child), "%s%s%s", key, key[0] ? "." : "", name);
+            bench_json_parse_value(r, child, out);
+            bench_json_skip_space(r);
+        }
+        bench_json_expect(r, close);
+        return;
+    }
+
+    BenchValue value = {};
+    snprintf(value.key, sizeof(value.key), "%s", key);
+    if (*r->p == '"')
+    {
+        bench_json_parse_string(r, value.text, sizeof(value.text));
+    }
+    else if (*r->p == 't' || *r->p == 'f' || *r->p == 'n')
+    {
+        while (r->p < r->end && *r->p >= 'a' && *r->p <= 'z')
+            r->p++;
+        return;
+    }
+    else
+    {
+        char *number_end;
+        value.number = strtod(r->p, &number_end);
+        if (number_end == r->p)
+        {
+            r->ok = false;
+            return;
+        }
+        r->p = number_end;
+    }
+    out->push_back(value);
+}
+
+static bool bench_read_json(const char *path, ImVector<BenchValue> *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *text = (char *)xmalloc(size > 0 ? (size_t)size : 1);
+    size_t read = fread(text, 1, size > 0 ? (size_t)size : 0, f);
+    fclose(f);
+
+    BenchJsonReader reader = { text, text + read, true };
+    bench_json_parse_value(&reader, "", out);
+    free(text);
+    if (!reader.ok)
+        fprintf(stderr, "[bench] %s is not valid JSON\n", path);
+    return reader.ok;
+}
+
+static const BenchValue *bench_find_value(const ImVector<BenchValue>& values, const char *key)
+{
+    for (const BenchValue& value : values)
+    {
+        if (strcmp(value.key, key) == 0)
+            return &value;
+    }
+    return nullptr;
+}
+
+static bool bench_ends_with(const char *s, const char *suffix)
+{
+    size_t length = strlen(s);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(s + length - suffix_length, suffix) == 0;
+}
+
+// Compares every scenario metric in results against baseline. threshold is a
+// fraction, e.g. 0.1 flags anything more than 10% worse. Returns the number of
+// regressions, or -1 if nothing was compared: either file can't be read or
+// they have no metric in common. That is a failure, never a pass.
+int bench_compare(const char *baseline_path, const char *results_path, double threshold)
+{
+    ImVector<BenchValue> baseline;
+    ImVector<BenchValue> results;
+    if (!bench_read_json(baseline_path, &baseline))
+    {
+        fprintf(stderr, "[bench] NOT COMPARED: no baseline at %s; run make bench-baseline to record one\n", baseline_path);
+        return -1;
+    }
+    if (!bench_read_json(results_path, &results))
+    {
+        fprintf(stderr, "[bench] NOT COMPARED: can't read the results in %s\n", results_path);
+        return -1;
+    }
+
+    const BenchValue *baseline_device = bench_find_value(baseline, "device");
+    const BenchValue *results_device = bench_find_value(results, "device");
+    if (baseline_device && results_device && strcmp(baseline_device->text, results_device->text) != 0)
+        printf("[bench] Warning: baseline is from %s, this run is on %s\n", baseline_device->text, results_device->text);
+
+    int regressions = 0;
+    int compared = 0;
+    printf("[bench] Against %s, threshold %.0f%%\n", baseline_path, threshold * 100.0);
+    for (const BenchValue& value : results)
+    {
+        if (strncmp(value.key, "scenarios.", 10) != 0 || bench_ends_with(value.key, ".frames"))
+            continue;
+        const BenchValue *base = bench_find_value(baseline, value.key);
+        if (!base)
+        {
+            printf("[bench]   new      %-48s %12.3f\n", value.key, value.number);
+            continue;
+        }
+        compared++;
+
+        bool higher_is_better = bench_ends_with(value.key, "_per_s");
+        double worse_by = higher_is_better ? base->number - value.number : value.number - base->number;
+        // Small absolute changes don't count, whatever the ratio
+        double floor = bench_ends_with(value.key, "_ms") || strstr(value.key, ".cpu_ms.") ? BENCH_MIN_MS :
+                       bench_ends_with(value.key, "_bytes") ? 1024.0 * 1024.0 : 0.5;
+        if (higher_is_better)
+            floor = 0.0;
+        if (worse_by > floor && worse_by > fabs(base->number) * threshold)
+        {
+            double percent = base->number != 0.0 ? worse_by / fabs(base->number) * 100.0 : INFINITY;
+            printf("[bench]   REGRESSED %-47s %12.3f -> %12.3f (%+.1f%%)\n", value.key, base->number, value.number, higher_is_better ? -percent : percent);
+            regressions++;
+        }
+    }
+    printf("[bench] %d metrics compared, %d regressed\n", compared, regressions);
+    if (compared == 0)
+    {
+        fprintf(stderr, "[bench] NOT COMPARED: %s shares no metric with this run; record it again\n", baseline_path);
+        return -1;
+    }
+    return regressions;
+}
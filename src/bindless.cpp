@@ -0,0 +1,674 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+#include "vertex_layout.hpp"
+
+// Bindless textures on VK_EXT_descriptor_indexing.
+//
+// One descriptor set holds a large, partially bound array of sampled images
+// plus a small array of immutable samplers. It is bound once per command
+// buffer and shaders pick a texture by index, so textured draws never bind
+// descriptors. Slots come from a free list. Writes are queued and go out in
+// one vkUpdateDescriptorSets per frame; the binding is update-after-bind and
+// update-unused-while-pending, so filling a free slot doesn't disturb frames
+// in flight. A removed slot is only reused once those frames have retired.
+
+#define BINDLESS_MAX_TEXTURES 4096
+#define BINDLESS_SAMPLER_COUNT 2   // matches samplers[] in sprite.frag
+#define BINDLESS_PUSH_CONSTANT_SIZE 128 // the guaranteed minimum
+#define BINDLESS_INVALID_SLOT UINT32_MAX
+
+enum BindlessSampler
+{
+    BINDLESS_SAMPLER_LINEAR,
+    BINDLESS_SAMPLER_NEAREST,
+};
+
+static const char *g_BindlessSamplerNames[] = { "linear", "nearest" };
+
+struct BindlessRetiredSlot
+{
+    uint32_t slot;
+    uint64_t frame;
+};
+
+struct BindlessTable
+{
+    VkDevice device;
+    bool supported;
+    uint32_t capacity;
+
+    VkSampler samplers[BINDLESS_SAMPLER_COUNT];
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    VkPipelineLayout pipeline_layout; // the set plus BINDLESS_PUSH_CONSTANT_SIZE for all stages
+
+    ImVector<uint32_t> free_slots;
+    ImVector<BindlessRetiredSlot> retired;
+    ImVector<uint32_t> pending_slots;
+    ImVector<VkDescriptorImageInfo> pending_images;
+    uint32_t next_slot; // slots below this have been handed out at least once
+    uint64_t frame;
+
+    // Stats
+    uint32_t live;
+    uint32_t writes_last_flush;
+    uint64_t writes_total;
+    uint64_t flushes;
+};
+
+// Checks for the descriptor indexing features bindless needs and fills in the
+// ones to enable. Needs VK_KHR_get_physical_device_properties2 on the instance
+// and VK_EXT_descriptor_indexing on the device.
+bool bindless_query_support(VkInstance instance, VkPhysicalDevice physical_device, VkPhysicalDeviceDescriptorIndexingFeaturesEXT *enable, uint32_t *max_textures)
+{
+    auto f_vkGetPhysicalDeviceFeatures2KHR = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto f_vkGetPhysicalDeviceProperties2KHR = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+    if (!f_vkGetPhysicalDeviceFeatures2KHR || !f_vkGetPhysicalDeviceProperties2KHR)
+        return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features.pNext = &supported;
+    f_vkGetPhysicalDeviceFeatures2KHR(physical_device, &features);
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+    limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    properties.pNext = &limits;
+    f_vkGetPhysicalDeviceProperties2KHR(physical_device, &properties);
+
+    if (!supported.shaderSampledImageArrayNonUniformIndexing || !supported.descriptorBindingSampledImageUpdateAfterBind ||
+        !supported.descriptorBindingUpdateUnusedWhilePending || !supported.descriptorBindingPartiallyBound || !supported.runtimeDescriptorArray)
+        return false;
+
+    memset(enable, 0, sizeof(*enable));
+    enable->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    enable->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    enable->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enable->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    enable->descriptorBindingPartiallyBound = VK_TRUE;
+    enable->runtimeDescriptorArray = VK_TRUE;
+
+    uint32_t max = limits.maxPerStageDescriptorUpdateAfterBindSampledImages;
+    if (limits.maxDescriptorSetUpdateAfterBindSampledImages < max)
+        max = limits.maxDescriptorSetUpdateAfterBindSampledImages;
+    *max_textures = max < BINDLESS_MAX_TEXTURES ? max : BINDLESS_MAX_TEXTURES;
+    return *max_textures > 0;
+}
+
+static VkSampler create_bindless_sampler(VkDevice device, VkFilter filter)
+{
+    VkSamplerCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    info.magFilter = filter;
+    info.minFilter = filter;
+    info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.maxLod = VK_LOD_CLAMP_NONE;
+    VkSampler sampler;
+    VkResult err = vkCreateSampler(device, &info, nullptr, &sampler);
+    check_vk_result(err);
+    return sampler;
+}
+
+// capacity is from bindless_query_support; 0 if descriptor indexing isn't
+// available, in which case the table stays empty and bindless_supported is false.
+void bindless_init(BindlessTable *table, VkDevice device, uint32_t capacity)
+{
+    table->device = device;
+    table->supported = capacity > 0;
+    table->capacity = capacity;
+    table->set_layout = VK_NULL_HANDLE;
+    table->pool = VK_NULL_HANDLE;
+    table->set = VK_NULL_HANDLE;
+    table->pipeline_layout = VK_NULL_HANDLE;
+    table->free_slots.clear();
+    table->retired.clear();
+    table->pending_slots.clear();
+    table->pending_images.clear();
+    table->next_slot = 0;
+    table->frame = 0;
+    table->live = 0;
+    table->writes_last_flush = 0;
+    table->writes_total = 0;
+    table->flushes = 0;
+    for (VkSampler& sampler : table->samplers)
+        sampler = VK_NULL_HANDLE;
+    if (!table->supported)
+    {
+        printf("[bindless] descriptor indexing not available\n");
+        return;
+    }
+
+    VkResult err;
+    table->samplers[BINDLESS_SAMPLER_LINEAR] = create_bindless_sampler(device, VK_FILTER_LINEAR);
+    table->samplers[BINDLESS_SAMPLER_NEAREST] = create_bindless_sampler(device, VK_FILTER_NEAREST);
+
+    // Set layout: binding 0 is the texture array, binding 1 the immutable samplers
+    {
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[0].descriptorCount = capacity;
+        bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        bindings[1].descriptorCount = BINDLESS_SAMPLER_COUNT;
+        bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[1].pImmutableSamplers = table->samplers;
+
+        VkDescriptorBindingFlagsEXT binding_flags[2] = {};
+        binding_flags[0] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {};
+        flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_info.bindingCount = 2;
+        flags_info.pBindingFlags = binding_flags;
+
+        VkDescriptorSetLayoutCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.pNext = &flags_info;
+        info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        info.bindingCount = 2;
+        info.pBindings = bindings;
+        err = vkCreateDescriptorSetLayout(device, &info, nullptr, &table->set_layout);
+        check_vk_result(err);
+    }
+
+    // Its own pool: update-after-bind sets can't come from ImGui's
+    {
+        VkDescriptorPoolSize pool_sizes[] =
+        {
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, capacity },
+            { VK_DESCRIPTOR_TYPE_SAMPLER, BINDLESS_SAMPLER_COUNT },
+        };
+        VkDescriptorPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        info.maxSets = 1;
+        info.poolSizeCount = (uint32_t)IM_ARRAYSIZE(pool_sizes);
+        info.pPoolSizes = pool_sizes;
+        err = vkCreateDescriptorPool(device, &info, nullptr, &table->pool);
+        check_vk_result(err);
+
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = table->pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &table->set_layout;
+        err = vkAllocateDescriptorSets(device, &alloc_info, &table->set);
+        check_vk_result(err);
+    }
+
+    // One layout for everything drawn bindless, so binding the set once
+    // covers every pipeline in the command buffer
+    {
+        VkPushConstantRange range = {};
+        range.stageFlags = VK_SHADER_STAGE_ALL;
+        range.offset = 0;
+        range.size = BINDLESS_PUSH_CONSTANT_SIZE;
+
+        VkPipelineLayoutCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        info.setLayoutCount = 1;
+        info.pSetLayouts = &table->set_layout;
+        info.pushConstantRangeCount = 1;
+        info.pPushConstantRanges = &range;
+        err = vkCreatePipelineLayout(device, &info, nullptr, &table->pipeline_layout);
+        check_vk_result(err);
+    }
+
+    printf("[bindless] %u texture slots\n", capacity);
+}
+
+// The device must be idle.
+void bindless_destroy(BindlessTable *table)
+{
+    if (!table->supported)
+        return;
+    vkDestroyPipelineLayout(table->device, table->pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(table->device, table->pool, nullptr);
+    vkDestroyDescriptorSetLayout(table->device, table->set_layout, nullptr);
+    for (VkSampler& sampler : table->samplers)
+        vkDestroySampler(table->device, sampler, nullptr);
+    table->supported = false;
+}
+
+// Returns the slot shaders index view by, or BINDLESS_INVALID_SLOT if the
+// table is full. The descriptor is written with the next bindless_begin_frame.
+// view must be in SHADER_READ_ONLY_OPTIMAL when it's sampled.
+uint32_t bindless_add_texture(BindlessTable *table, VkImageView view)
+{
+    if (!table->supported)
+        return BINDLESS_INVALID_SLOT;
+    uint32_t slot;
+    if (table->free_slots.Size > 0)
+    {
+        slot = table->free_slots.back();
+        table->free_slots.pop_back();
+    }
+    else if (table->next_slot < table->capacity)
+    {
+        slot = table->next_slot++;
+    }
+    else
+    {
+        return BINDLESS_INVALID_SLOT;
+    }
+
+    VkDescriptorImageInfo image = {};
+    image.imageView = view;
+    image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    table->pending_slots.push_back(slot);
+    table->pending_images.push_back(image);
+    table->live++;
+    return slot;
+}
+
+// Frees slot once the frames in flight that may sample it have retired. The
+// caller keeps the view alive at least as long.
+void bindless_remove_texture(BindlessTable *table, uint32_t slot)
+{
+    if (slot == BINDLESS_INVALID_SLOT)
+        return;
+    BindlessRetiredSlot retired = { slot, table->frame };
+    table->retired.push_back(retired);
+    table->live--;
+}
+
+// Recycles retired slots and writes everything added since the last frame in
+// one call. Call once per frame after its fence wait and before recording.
+void bindless_begin_frame(BindlessTable *table, uint32_t frames_in_flight)
+{
+    if (!table->supported)
+        return;
+    table->frame++;
+    for (int i = 0; i < table->retired.Size;)
+    {
+        if (table->frame - table->retired[i].frame >= frames_in_flight)
+        {
+            table->free_slots.push_back(table->retired[i].slot);
+            table->retired.erase_unsorted(&table->retired[i]);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    table->writes_last_flush = (uint32_t)table->pending_slots.Size;
+    if (table->pending_slots.Size == 0)
+        return;
+
+    CPU_SCOPE("bindless_flush");
+    ImVector<VkWriteDescriptorSet> writes;
+    writes.resize(table->pending_slots.Size);
+    for (int i = 0; i < writes.Size; i++)
+    {
+        VkWriteDescriptorSet& write = writes[i];
+        write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = table->set;
+        write.dstBinding = 0;
+        write.dstArrayElement = table->pending_slots[i];
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.pImageInfo = &table->pending_images[i];
+    }
+    vkUpdateDescriptorSets(table->device, (uint32_t)writes.Size, writes.Data, 0, nullptr);
+    table->pending_slots.clear();
+    table->pending_images.clear();
+    table->writes_total += table->writes_last_flush;
+    table->flushes++;
+}
+
+// Once per command buffer; every pipeline using table->pipeline_layout then
+// sees all textures.
+void bindless_bind(BindlessTable *table, VkCommandBuffer command_buffer)
+{
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, table->pipeline_layout, 0, 1, &table->set, 0, nullptr);
+}
+
+void bindless_draw_ui(BindlessTable *table)
+{
+    if (!table->supported)
+    {
+        ImGui::TextDisabled("VK_EXT_descriptor_indexing not supported");
+        return;
+    }
+    ImGui::Text("Slots: %u live, %u free, %d retiring, %u of %u touched", table->live, (uint32_t)table->free_slots.Size,
+                table->retired.Size, table->next_slot, table->capacity);
+    ImGui::Text("Writes: %u last frame, %llu in %llu batched updates", table->writes_last_flush,
+                (unsigned long long)table->writes_total, (unsigned long long)table->flushes);
+}
+
+//
+// Sprites: textured quads drawn with one draw and one descriptor bind,
+// picking from SPRITE_TEXTURE_COUNT textures per instance. Streaming swaps a
+// texture for a freshly uploaded one every frame to keep slots cycling.
+//
+
+#define SPRITE_MAX_INSTANCES (1 << 16)
+#define SPRITE_TEXTURE_COUNT 16 // matches textures[] in sprite.vert
+#define SPRITE_TEXTURE_SIZE 64
+
+struct SpriteInstance
+{
+    float offset[2];
+    float scale_rotation[2];
+    uint32_t texture; // 0..SPRITE_TEXTURE_COUNT-1
+};
+
+using SpriteInstanceLayout = VertexBinding<SpriteInstance, VK_VERTEX_INPUT_RATE_INSTANCE,
+                                           VERTEX_ATTR(SpriteInstance, offset),
+                                           VERTEX_ATTR(SpriteInstance, scale_rotation),
+                                           VERTEX_ATTR(SpriteInstance, texture)>;
+
+// Matches the push constants in sprite.vert and sprite.frag
+struct SpritePushConstants
+{
+    float view[4];
+    uint32_t sampler_index;
+    uint32_t textures[SPRITE_TEXTURE_COUNT];
+};
+
+static_assert(sizeof(SpritePushConstants) <= BINDLESS_PUSH_CONSTANT_SIZE, "sprite push constants don't fit");
+
+struct SpriteTexture
+{
+    GpuImage image;
+    VkImageView view;
+    uint32_t slot;
+    uint64_t retire_frame;
+};
+
+struct SpriteRenderer
+{
+    bool supported;
+    GpuBuffer instances;
+    int pipeline;
+    SpriteTexture textures[SPRITE_TEXTURE_COUNT];
+    ImVector<SpriteTexture> retired;
+    uint64_t frame;
+    uint32_t seed;
+    int next_stream;
+
+    bool enabled;
+    bool stream;
+    int instance_count;
+    int sampler_index;
+    uint64_t textures_streamed;
+};
+
+static VkPipelineLayout g_SpritePipelineLayout = VK_NULL_HANDLE;
+
+static VkPipeline create_sprite_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+    VkShaderModule vert_shader = create_shader_module("sprite.vert", device);
+    VkShaderModule frag_shader = create_shader_module("sprite.frag", device);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_shader;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_shader;
+    stages[1].pName = "main";
+
+    // Locations 2-4 follow the batch Vertex; sprite.vert doesn't read its color
+    VkPipelineVertexInputStateCreateInfo vertex_input = VertexInput<VertexLayout, SpriteInstanceLayout>::state();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = (uint32_t)IM_ARRAYSIZE(dynamic_states);
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask = (VK_COLOR_COMPONENT_R_BIT |
+                                             VK_COLOR_COMPONENT_G_BIT |
+                                             VK_COLOR_COMPONENT_B_BIT |
+                                             VK_COLOR_COMPONENT_A_BIT);
+    color_blend_attachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_SpritePipelineLayout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipeline pipeline = create_graphics_pipeline_timed(device, pipeline_cache, &pipeline_info, "sprites");
+    vkDestroyShaderModule(device, vert_shader, nullptr);
+    vkDestroyShaderModule(device, frag_shader, nullptr);
+    return pipeline;
+}
+
+// A random two-color checkerboard, uploaded and registered with the table.
+static SpriteTexture create_sprite_texture(SpriteRenderer *sprites, GpuAllocator *allocator, UploadContext *upload, BindlessTable *table)
+{
+    SpriteTexture texture = {};
+    {
+        VkImageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = { SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 1 };
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        gpu_create_image(allocator, &info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.image);
+    }
+    {
+        VkImageViewCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.image = texture.image.image;
+        info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        VkResult err = vkCreateImageView(allocator->device, &info, nullptr, &texture.view);
+        check_vk_result(err);
+    }
+
+    uint32_t colors[2] = { batch_random(&sprites->seed) | 0xff000000, batch_random(&sprites->seed) | 0xff000000 };
+    int cell = 4 << (batch_random(&sprites->seed) % 3);
+    uint32_t texels[SPRITE_TEXTURE_SIZE * SPRITE_TEXTURE_SIZE];
+    for (int y = 0; y < SPRITE_TEXTURE_SIZE; y++)
+    {
+        for (int x = 0; x < SPRITE_TEXTURE_SIZE; x++)
+            texels[y * SPRITE_TEXTURE_SIZE + x] = colors[(x / cell + y / cell) & 1];
+    }
+    upload_image(upload, texture.image.image, SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 4, texels,
+                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    texture.slot = bindless_add_texture(table, texture.view);
+    return texture;
+}
+
+static void destroy_sprite_texture(GpuAllocator *allocator, SpriteTexture *texture)
+{
+    vkDestroyImageView(allocator->device, texture->view, nullptr);
+    gpu_destroy_image(allocator, &texture->image);
+}
+
+void sprites_init(SpriteRenderer *sprites, GpuAllocator *allocator, UploadContext *upload, BindlessTable *table, PipelineRegistry *registry)
+{
+    sprites->supported = table->supported;
+    sprites->retired.clear();
+    sprites->frame = 0;
+    sprites->seed = 0x2545f491;
+    sprites->next_stream = 0;
+    sprites->enabled = false;
+    sprites->stream = false;
+    sprites->instance_count = 4096;
+    sprites->sampler_index = BINDLESS_SAMPLER_NEAREST;
+    sprites->textures_streamed = 0;
+    sprites->pipeline = -1;
+    if (!sprites->supported)
+        return;
+
+    for (SpriteTexture& texture : sprites->textures)
+        texture = create_sprite_texture(sprites, allocator, upload, table);
+
+    VkDeviceSize instances_size = sizeof(SpriteInstance) * SPRITE_MAX_INSTANCES;
+    gpu_create_buffer(allocator, instances_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &sprites->instances);
+    SpriteInstance *instances = (SpriteInstance *)xmalloc(instances_size);
+    for (int i = 0; i < SPRITE_MAX_INSTANCES; i++)
+    {
+        SpriteInstance *instance = &instances[i];
+        instance->offset[0] = batch_random_float(&sprites->seed, -1.0f, 1.0f);
+        instance->offset[1] = batch_random_float(&sprites->seed, -1.0f, 1.0f);
+        instance->scale_rotation[0] = batch_random_float(&sprites->seed, 0.02f, 0.08f);
+        instance->scale_rotation[1] = batch_random_float(&sprites->seed, 0.0f, 6.2831853f);
+        instance->texture = batch_random(&sprites->seed) % SPRITE_TEXTURE_COUNT;
+    }
+    upload_buffer(upload, sprites->instances.buffer, 0, instances, instances_size,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    free(instances);
+
+    g_SpritePipelineLayout = table->pipeline_layout;
+    sprites->pipeline = pipeline_registry_add(registry, "sprites", create_sprite_pipeline);
+    pipeline_registry_add_shader(registry, sprites->pipeline, "sprite.vert");
+    pipeline_registry_add_shader(registry, sprites->pipeline, "sprite.frag");
+}
+
+// The device must be idle.
+void sprites_destroy(SpriteRenderer *sprites, GpuAllocator *allocator)
+{
+    if (!sprites->supported)
+        return;
+    for (SpriteTexture& texture : sprites->textures)
+        destroy_sprite_texture(allocator, &texture);
+    for (SpriteTexture& texture : sprites->retired)
+        destroy_sprite_texture(allocator, &texture);
+    sprites->retired.clear();
+    gpu_destroy_buffer(allocator, &sprites->instances);
+    g_SpritePipelineLayout = VK_NULL_HANDLE;
+}
+
+// Frees textures no frame in flight can sample any more and, when streaming,
+// replaces one. Call before bindless_begin_frame so the new slot is written
+// with this frame's batch.
+void sprites_begin_frame(SpriteRenderer *sprites, GpuAllocator *allocator, UploadContext *upload, BindlessTable *table, uint32_t frames_in_flight)
+{
+    if (!sprites->supported)
+        return;
+    sprites->frame++;
+    for (int i = 0; i < sprites->retired.Size;)
+    {
+        if (sprites->frame - sprites->retired[i].retire_frame >= frames_in_flight)
+        {
+            destroy_sprite_texture(allocator, &sprites->retired[i]);
+            sprites->retired.erase_unsorted(&sprites->retired[i]);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (!sprites->enabled || !sprites->stream)
+        return;
+    SpriteTexture *texture = &sprites->textures[sprites->next_stream];
+    sprites->next_stream = (sprites->next_stream + 1) % SPRITE_TEXTURE_COUNT;
+    bindless_remove_texture(table, texture->slot);
+    texture->retire_frame = sprites->frame;
+    sprites->retired.push_back(*texture);
+    *texture = create_sprite_texture(sprites, allocator, upload, table);
+    sprites->textures_streamed++;
+}
+
+// Expects viewport and scissor to be set already. Takes the quad mesh from batch.
+void sprites_record(SpriteRenderer *sprites, VkCommandBuffer command_buffer, BindlessTable *table, BatchRenderer *batch, PipelineRegistry *registry)
+{
+    if (!sprites->supported || !sprites->enabled || sprites->instance_count <= 0)
+        return;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_registry_get(registry, sprites->pipeline));
+    bindless_bind(table, command_buffer);
+
+    SpritePushConstants constants = {};
+    constants.view[0] = 0.0f;
+    constants.view[1] = 0.0f;
+    constants.view[2] = 1.0f;
+    constants.view[3] = 1.0f;
+    constants.sampler_index = (uint32_t)sprites->sampler_index;
+    for (int i = 0; i < SPRITE_TEXTURE_COUNT; i++)
+        constants.textures[i] = sprites->textures[i].slot;
+    vkCmdPushConstants(command_buffer, table->pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+
+    VkBuffer buffers[2] = { batch->vertices.buffer, sprites->instances.buffer };
+    VkDeviceSize offsets[2] = { 0, 0 };
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, batch->indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+    const BatchShapeInfo& quad = batch->shapes[BATCH_SHAPE_QUAD];
+    vkCmdDrawIndexed(command_buffer, quad.index_count, (uint32_t)sprites->instance_count, quad.first_index, quad.vertex_offset, 0);
+}
+
+void sprites_draw_ui(SpriteRenderer *sprites, BindlessTable *table, float gpu_ms)
+{
+    bindless_draw_ui(table);
+    if (!sprites->supported)
+        return;
+    ImGui::Checkbox("Draw sprites", &sprites->enabled);
+    ImGui::SliderInt("Sprites", &sprites->instance_count, 0, SPRITE_MAX_INSTANCES, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::Combo("Sampler", &sprites->sampler_index, g_BindlessSamplerNames, BINDLESS_SAMPLER_COUNT);
+    ImGui::Checkbox("Stream a texture per frame", &sprites->stream);
+    ImGui::Text("%d textures, 1 draw, 1 descriptor bind; %llu streamed, %d awaiting retirement", SPRITE_TEXTURE_COUNT,
+                (unsigned long long)sprites->textures_streamed, sprites->retired.Size);
+    if (gpu_ms > 0.0f)
+        ImGui::Text("GPU: %.3f ms", gpu_ms);
+}
@@ -0,0 +1,363 @@
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Frame capture for offline replay. A frame is recorded as what it is built
+// from: the scene settings and clocks going into record_frame, and the full
+// ImGui draw data, vertices and indices included. Replay runs the current
+// build's recording code on that state, so it reproduces the workload, not
+// the exact commands of the captured run. Only what record_frame reads from
+// the CPU is captured: state that lives on the GPU across frames, like the
+// particle buffers, starts over from its initial contents and differs from
+// what was on screen. Static resources are recreated from the same code.
+//
+// Nothing in the file depends on addresses, handles or the time of capture.
+// Capturing a replay reproduces the input byte for byte, and the checksum in
+// the header tells two captures apart at a glance. Little endian only.
+
+#define CAPTURE_MAGIC 0x50414356 // "VCAP"
+#define CAPTURE_FILE_VERSION 1
+#define CAPTURE_TEXTURE_FONT 0
+#define CAPTURE_TEXTURE_OTHER 1 // replayed with the font atlas
+
+struct CaptureFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_count;
+    uint32_t index_size; // sizeof(ImDrawIdx)
+    uint64_t checksum;   // FNV-1a over everything after the header
+};
+
+// Everything record_frame reads besides the draw data. Clocks are restored
+// every frame, so each captured frame replays the same way in any order.
+struct CaptureSceneState
+{
+    double scene_time;
+    double cull_time;
+    double async_time;
+    double particles_time;
+    float geometry_time;
+    float delta_time;
+    float clear_color[4];
+
+    int32_t tri_copies;
+    float tri_spin;
+    uint32_t tri_keep_aspect;
+    int32_t tri_blend;
+    int32_t tri_topology;
+    int32_t tri_color;
+    int32_t batch_instance_count;
+    uint32_t batch_shape_mask;
+    uint32_t sprites_enabled;
+    uint32_t sprites_stream;
+    int32_t sprites_instance_count;
+    int32_t sprites_sampler;
+    uint32_t sprites_seed;
+    int32_t sprites_next_stream;
+    uint32_t cull_enabled;
+    int32_t cull_mode;
+    int32_t cull_object_count;
+    float cull_view_half_extent;
+    uint32_t cull_animate_view;
+    uint32_t async_enabled;
+    int32_t async_instance_count;
+    int32_t async_iterations;
+    uint32_t particles_enabled;
+    int32_t particles_count;
+    uint32_t geometry_enabled;
+    int32_t geometry_shape;
+    int32_t geometry_kernel;
+    int32_t geometry_lines;
+    int32_t geometry_segments_per_line;
+    uint32_t recorder_enabled;
+    int32_t recorder_slice_count;
+    uint32_t reserved;
+};
+
+static_assert(offsetof(CaptureSceneState, reserved) + sizeof(uint32_t) == sizeof(CaptureSceneState), "CaptureSceneState must have no padding");
+
+// Captured fields index arrays and size buffers once replayed, and the
+// checksum only catches accidents, so each one is held to the range the UI
+// allows before it reaches the renderer.
+static int capture_check_range(int32_t value, int min, int max, const char *field)
+{
+    if (value < min || value > max)
+        fatal("Corrupt capture, %s is %d, outside %d..%d", field, value, min, max);
+    return value;
+}
+
+// Per draw command, after the draw list's counts, vertices and indices
+struct CaptureDrawCmd
+{
+    float clip_rect[4];
+    uint32_t texture;
+    uint32_t vtx_offset;
+    uint32_t idx_offset;
+    uint32_t elem_count;
+};
+
+struct FrameCapture
+{
+    FILE *file;
+    char path[256];
+    CaptureFileHeader header;
+    int frames_left;
+    uint64_t bytes;
+    uint32_t skipped_callbacks;
+};
+
+static uint64_t capture_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void capture_write(FrameCapture *capture, const void *data, size_t size)
+{
+    if (size == 0)
+        return;
+    if (fwrite(data, 1, size, capture->file) != size)
+        fatal("Short write on %s", capture->path);
+    capture->header.checksum = capture_hash(capture->header.checksum, data, size);
+    capture->bytes += size;
+}
+
+// Records the next frame_count frames to path, starting with the next
+// capture_write_frame. width and height are the render target's.
+void capture_begin(FrameCapture *capture, const char *path, int frame_count, uint32_t width, uint32_t height)
+{
+    memset(capture, 0, sizeof(*capture));
+    snprintf(capture->path, sizeof(capture->path), "%s", path);
+    capture->file = xfopen(path, "wb");
+    capture->header.magic = CAPTURE_MAGIC;
+    capture->header.version = CAPTURE_FILE_VERSION;
+    capture->header.width = width;
+    capture->header.height = height;
+    capture->header.index_size = sizeof(ImDrawIdx);
+    capture->header.checksum = 0xcbf29ce484222325ull;
+    capture->frames_left = frame_count;
+
+    // Rewritten with the frame count and checksum once done
+    if (fwrite(&capture->header, sizeof(capture->header), 1, capture->file) != 1)
+        fatal("Short write on %s", path);
+}
+
+bool capture_active(const FrameCapture *capture)
+{
+    return capture->file != nullptr;
+}
+
+static void capture_end(FrameCapture *capture)
+{
+    fseek(capture->file, 0, SEEK_SET);
+    if (fwrite(&capture->header, sizeof(capture->header), 1, capture->file) != 1)
+        fatal("Short write on %s", capture->path);
+    fclose(capture->file);
+    capture->file = nullptr;
+    printf("[capture] %u frames, %.1f KiB to %s, checksum %016llx\n", capture->header.frame_count, capture->bytes / 1024.0, capture->path,
+           (unsigned long long)capture->header.checksum);
+    if (capture->skipped_callbacks > 0)
+        printf("[capture] %u ImGui draw callbacks left out\n", capture->skipped_callbacks);
+}
+
+void capture_write_frame(FrameCapture *capture, const CaptureSceneState *state, const ImDrawData *draw_data)
+{
+    if (!capture_active(capture))
+        return;
+    capture_write(capture, state, sizeof(*state));
+
+    float display[6] = { draw_data->DisplayPos.x, draw_data->DisplayPos.y, draw_data->DisplaySize.x, draw_data->DisplaySize.y,
+                         draw_data->FramebufferScale.x, draw_data->FramebufferScale.y };
+    capture_write(capture, display, sizeof(display));
+    uint32_t list_count = (uint32_t)draw_data->CmdListsCount;
+    capture_write(capture, &list_count, sizeof(list_count));
+
+    ImTextureID font = ImGui::GetIO().Fonts->TexID;
+    for (const ImDrawList *list : draw_data->CmdLists)
+    {
+        // Callbacks point into this process, so they can't be replayed
+        uint32_t cmd_count = 0;
+        for (const ImDrawCmd& cmd : list->CmdBuffer)
+            cmd_count += cmd.UserCallback == nullptr;
+        capture->skipped_callbacks += (uint32_t)list->CmdBuffer.Size - cmd_count;
+
+        uint32_t counts[3] = { (uint32_t)list->VtxBuffer.Size, (uint32_t)list->IdxBuffer.Size, cmd_count };
+        capture_write(capture, counts, sizeof(counts));
+        capture_write(capture, list->VtxBuffer.Data, list->VtxBuffer.Size * sizeof(ImDrawVert));
+        capture_write(capture, list->IdxBuffer.Data, list->IdxBuffer.Size * sizeof(ImDrawIdx));
+        for (const ImDrawCmd& cmd : list->CmdBuffer)
+        {
+            if (cmd.UserCallback)
+                continue;
+            CaptureDrawCmd out = {};
+            memcpy(out.clip_rect, &cmd.ClipRect, sizeof(out.clip_rect));
+            out.texture = cmd.TextureId == font ? CAPTURE_TEXTURE_FONT : CAPTURE_TEXTURE_OTHER;
+            out.vtx_offset = cmd.VtxOffset;
+            out.idx_offset = cmd.IdxOffset;
+            out.elem_count = cmd.ElemCount;
+            capture_write(capture, &out, sizeof(out));
+        }
+    }
+
+    capture->header.frame_count++;
+    if (--capture->frames_left <= 0)
+        capture_end(capture);
+}
+
+// Stops early; what was captured so far stays valid.
+void capture_stop(FrameCapture *capture)
+{
+    if (capture_active(capture))
+        capture_end(capture);
+}
+
+//
+// Replay side: a capture loaded back into draw lists ImGui_ImplVulkan_RenderDrawData takes.
+//
+
+struct CapturedFrame
+{
+    CaptureSceneState state;
+    ImDrawData draw_data;
+    ImVector<ImDrawList *> lists;
+};
+
+struct CaptureReplay
+{
+    CaptureFileHeader header;
+    ImVector<CapturedFrame *> frames;
+};
+
+struct CaptureReader
+{
+    FILE *file;
+    const char *path;
+    uint64_t checksum;
+    uint64_t remaining; // bytes left in the file
+};
+
+// Counts come from the file, so anything sized by them is checked against
+// what is left to read before it is allocated.
+static void capture_require(CaptureReader *reader, uint64_t count, uint64_t item_size)
+{
+    if (item_size != 0 && count > reader->remaining / item_size)
+        fatal("Corrupt capture %s, it claims more data than it holds", reader->path);
+}
+
+static void capture_read(CaptureReader *reader, void *data, size_t size)
+{
+    capture_require(reader, size, 1);
+    if (size > 0 && fread(data, 1, size, reader->file) != size)
+        fatal("Truncated capture %s", reader->path);
+    reader->remaining -= size;
+    reader->checksum = capture_hash(reader->checksum, data, size);
+}
+
+// Needs a current ImGui context for the draw lists and the font atlas.
+void capture_load(CaptureReplay *replay, const char *path)
+{
+    CaptureReader reader = { xfopen(path, "rb"), path, 0xcbf29ce484222325ull, 0 };
+    fseek(reader.file, 0, SEEK_END);
+    long file_size = ftell(reader.file);
+    fseek(reader.file, 0, SEEK_SET);
+    if (file_size < (long)sizeof(replay->header) || fread(&replay->header, sizeof(replay->header), 1, reader.file) != 1)
+        fatal("Truncated capture %s", path);
+    reader.remaining = (uint64_t)file_size - sizeof(replay->header);
+    const CaptureFileHeader& header = replay->header;
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_FILE_VERSION)
+        fatal("%s is not a version %d capture", path, CAPTURE_FILE_VERSION);
+    if (header.index_size != sizeof(ImDrawIdx))
+        fatal("%s has %u byte ImGui indices, this build uses %d", path, header.index_size, (int)sizeof(ImDrawIdx));
+
+    // Smallest frame: the state, the display rectangle and an empty list count
+    capture_require(&reader, header.frame_count, sizeof(CaptureSceneState) + sizeof(float) * 6 + sizeof(uint32_t));
+    ImTextureID font = ImGui::GetIO().Fonts->TexID;
+    for (uint32_t i = 0; i < header.frame_count; i++)
+    {
+        CapturedFrame *frame = IM_NEW(CapturedFrame)();
+        replay->frames.push_back(frame);
+        capture_read(&reader, &frame->state, sizeof(frame->state));
+
+        float display[6];
+        capture_read(&reader, display, sizeof(display));
+        uint32_t list_count;
+        capture_read(&reader, &list_count, sizeof(list_count));
+        capture_require(&reader, list_count, sizeof(uint32_t) * 3);
+
+        ImDrawData& draw_data = frame->draw_data;
+        draw_data.Valid = true;
+        draw_data.DisplayPos = ImVec2(display[0], display[1]);
+        draw_data.DisplaySize = ImVec2(display[2], display[3]);
+        draw_data.FramebufferScale = ImVec2(display[4], display[5]);
+        for (uint32_t l = 0; l < list_count; l++)
+        {
+            ImDrawList *list = IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData());
+            frame->lists.push_back(list);
+            uint32_t counts[3];
+            capture_read(&reader, counts, sizeof(counts));
+            uint64_t list_size = (uint64_t)counts[0] * sizeof(ImDrawVert) + (uint64_t)counts[1] * sizeof(ImDrawIdx) +
+                                 (uint64_t)counts[2] * sizeof(CaptureDrawCmd);
+            capture_require(&reader, list_size, 1);
+            if (counts[0] > INT_MAX || counts[1] > INT_MAX || counts[2] > INT_MAX)
+                fatal("Corrupt capture %s, it claims more data than it holds", path);
+            list->VtxBuffer.resize((int)counts[0]);
+            list->IdxBuffer.resize((int)counts[1]);
+            list->CmdBuffer.resize((int)counts[2]);
+            capture_read(&reader, list->VtxBuffer.Data, counts[0] * sizeof(ImDrawVert));
+            capture_read(&reader, list->IdxBuffer.Data, counts[1] * sizeof(ImDrawIdx));
+            for (ImDrawCmd& cmd : list->CmdBuffer)
+            {
+                CaptureDrawCmd in;
+                capture_read(&reader, &in, sizeof(in));
+                cmd = ImDrawCmd();
+                memcpy(&cmd.ClipRect, in.clip_rect, sizeof(in.clip_rect));
+                // The indexed draw must stay inside this list's indices and vertices
+                if (in.idx_offset > counts[1] || in.elem_count > counts[1] - in.idx_offset ||
+                    (in.elem_count > 0 && in.vtx_offset >= counts[0]))
+                    fatal("Corrupt capture %s, a draw command reads past its draw list", path);
+                for (uint32_t e = 0; e < in.elem_count; e++)
+                    if (list->IdxBuffer[(int)(in.idx_offset + e)] >= counts[0] - in.vtx_offset)
+                        fatal("Corrupt capture %s, an index points past its draw list", path);
+                cmd.TextureId = font;
+                cmd.VtxOffset = in.vtx_offset;
+                cmd.IdxOffset = in.idx_offset;
+                cmd.ElemCount = in.elem_count;
+            }
+            draw_data.TotalVtxCount += (int)counts[0];
+            draw_data.TotalIdxCount += (int)counts[1];
+        }
+        // Owned by the frame; the draw data only borrows the pointers
+        draw_data.CmdLists = frame->lists;
+        draw_data.CmdListsCount = frame->lists.Size;
+    }
+    fclose(reader.file);
+    if (reader.checksum != header.checksum)
+        fatal("Checksum mismatch in %s, the capture is corrupt or was not finished", path);
+    printf("[replay] %s: %u frames at %ux%u, checksum %016llx\n", path, header.frame_count, header.width, header.height,
+           (unsigned long long)header.checksum);
+}
+
+void capture_unload(CaptureReplay *replay)
+{
+    for (CapturedFrame *frame : replay->frames)
+    {
+        for (ImDrawList *list : frame->lists)
+            IM_DELETE(list);
+        IM_DELETE(frame);
+    }
+    replay->frames.clear();
+}
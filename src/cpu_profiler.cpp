@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+
+#include "helpers.hpp"
+
+// Scoped CPU timers for the frame loop and the worker threads.
+//
+// Each thread that records a scope gets its own single-producer ring, so the
+// hot path is two clock reads and a store with no locks or shared cache lines.
+// The main thread drains every ring once per frame (cpu_profiler_collect) into
+// per-phase rolling histories for the UI and into a bounded trace history that
+// cpu_profiler_dump_trace writes out as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev). A full ring drops events and counts them.
+//
+// Scope names must be string literals or otherwise outlive the profiler.
+
+#define CPU_PROFILER_MAX_THREADS 64
+#define CPU_PROFILER_RING_SIZE 4096 // events per thread, power of two
+#define CPU_PROFILER_HISTORY 512    // samples per phase for the histogram
+#define CPU_PROFILER_TRACE_EVENTS (1 << 18)
+#define CPU_PROFILER_HISTOGRAM_BINS 32
+
+struct CpuEvent
+{
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+struct CpuThreadRing
+{
+    char name[32];
+    uint32_t tid;
+    alignas(64) std::atomic<uint64_t> head; // written by the owning thread
+    alignas(64) std::atomic<uint64_t> tail; // written by the collector
+    std::atomic<uint64_t> dropped;
+    CpuEvent events[CPU_PROFILER_RING_SIZE];
+};
+
+struct CpuTraceEvent
+{
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t tid;
+};
+
+struct CpuPhase
+{
+    const char *name;
+    float samples[CPU_PROFILER_HISTORY]; // ms
+    int count;
+    int offset;
+    float last_ms;
+    double total_ms; // since the last cpu_profiler_reset_totals
+};
+
+struct CpuProfiler
+{
+    std::atomic<CpuThreadRing *> rings[CPU_PROFILER_MAX_THREADS];
+    std::atomic<int> ring_count;
+    uint64_t start_ns;
+
+    std::atomic<bool> enabled; // read by every recording thread
+    ImVector<CpuPhase> phases;
+    ImVector<CpuTraceEvent> trace; // ring of the most recent events
+    int trace_offset;
+    uint64_t dropped;
+    char last_dump[256];
+};
+
+static CpuProfiler g_CpuProfiler;
+static thread_local CpuThreadRing *t_CpuRing = nullptr;
+
+static uint64_t cpu_profiler_now_ns()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void cpu_profiler_init()
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    for (std::atomic<CpuThreadRing *>& ring : profiler->rings)
+        ring = nullptr;
+    profiler->ring_count = 0;
+    profiler->start_ns = cpu_profiler_now_ns();
+    profiler->enabled = true;
+    profiler->phases.clear();
+    profiler->trace.clear();
+    profiler->trace_offset = 0;
+    profiler->dropped = 0;
+    profiler->last_dump[0] = '\0';
+}
+
+// Call with every other thread that recorded scopes joined.
+void cpu_profiler_destroy()
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    int count = profiler->ring_count.load();
+    for (int i = 0; i < count && i < CPU_PROFILER_MAX_THREADS; i++)
+    {
+        free(profiler->rings[i].load());
+        profiler->rings[i] = nullptr;
+    }
+    profiler->ring_count = 0;
+    profiler->phases.clear();
+    profiler->trace.clear();
+    t_CpuRing = nullptr;
+}
+
+// Names the calling thread in traces. Registers it if it has no ring yet.
+static CpuThreadRing *cpu_profiler_thread_ring(const char *name)
+{
+    if (t_CpuRing)
+        return t_CpuRing;
+
+    CpuProfiler *profiler = &g_CpuProfiler;
+    int index = profiler->ring_count.fetch_add(1);
+    if (index >= CPU_PROFILER_MAX_THREADS)
+        return nullptr;
+
+    CpuThreadRing *ring = (CpuThreadRing *)xcalloc(sizeof(CpuThreadRing));
+    ring->tid = (uint32_t)index;
+    ring->head = 0;
+    ring->tail = 0;
+    if (name)
+        snprintf(ring->name, sizeof(ring->name), "%s", name);
+    else
+        snprintf(ring->name, sizeof(ring->name), "thread %d", index);
+    profiler->rings[index].store(ring, std::memory_order_release);
+    t_CpuRing = ring;
+    return ring;
+}
+
+// Call before the thread records its first scope.
+void cpu_profiler_set_thread_name(const char *name)
+{
+    if (t_CpuRing)
+        snprintf(t_CpuRing->name, sizeof(t_CpuRing->name), "%s", name);
+    else
+        cpu_profiler_thread_ring(name);
+}
+
+static void cpu_profiler_record(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+    CpuThreadRing *ring = t_CpuRing ? t_CpuRing : cpu_profiler_thread_ring(nullptr);
+    if (!ring)
+        return;
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= CPU_PROFILER_RING_SIZE)
+    {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    CpuEvent *event = &ring->events[head & (CPU_PROFILER_RING_SIZE - 1)];
+    event->name = name;
+    event->start_ns = start_ns;
+    event->end_ns = end_ns;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+struct CpuScope
+{
+    const char *name;
+    uint64_t start_ns;
+
+    CpuScope(const char *name) : name(name)
+    {
+        start_ns = g_CpuProfiler.enabled.load(std::memory_order_relaxed) ? cpu_profiler_now_ns() : 0;
+    }
+
+    ~CpuScope()
+    {
+        if (start_ns)
+            cpu_profiler_record(name, start_ns, cpu_profiler_now_ns());
+    }
+};
+
+#define CPU_SCOPE_CONCAT2(a, b) a##b
+#define CPU_SCOPE_CONCAT(a, b) CPU_SCOPE_CONCAT2(a, b)
+#define CPU_SCOPE(name) CpuScope CPU_SCOPE_CONCAT(cpu_scope_, __LINE__)(name)
+
+static CpuPhase *cpu_profiler_find_phase(CpuProfiler *profiler, const char *name)
+{
+    // Names are usually the same literal, so compare pointers first
+    for (CpuPhase& phase : profiler->phases)
+    {
+        if (phase.name == name)
+            return &phase;
+    }
+    for (CpuPhase& phase : profiler->phases)
+    {
+        if (strcmp(phase.name, name) == 0)
+            return &phase;
+    }
+    CpuPhase phase = {};
+    phase.name = name;
+    profiler->phases.push_back(phase);
+    return &profiler->phases.back();
+}
+
+// Drains every thread's ring. Call once per frame from the main thread.
+void cpu_profiler_collect()
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    int count = profiler->ring_count.load();
+    if (count > CPU_PROFILER_MAX_THREADS)
+        count = CPU_PROFILER_MAX_THREADS;
+
+    for (int i = 0; i < count; i++)
+    {
+        CpuThreadRing *ring = profiler->rings[i].load(std::memory_order_acquire);
+        if (!ring)
+            continue; // registered, not published yet
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+        {
+            const CpuEvent& event = ring->events[tail & (CPU_PROFILER_RING_SIZE - 1)];
+            float ms = (float)((event.end_ns - event.start_ns) / 1e6);
+
+            CpuPhase *phase = cpu_profiler_find_phase(profiler, event.name);
+            phase->last_ms = ms;
+            phase->total_ms += ms;
+            phase->samples[phase->offset] = ms;
+            phase->offset = (phase->offset + 1) % CPU_PROFILER_HISTORY;
+            if (phase->count < CPU_PROFILER_HISTORY)
+                phase->count++;
+
+            CpuTraceEvent trace_event = { event.name, event.start_ns, event.end_ns, ring->tid };
+            if (profiler->trace.Size < CPU_PROFILER_TRACE_EVENTS)
+            {
+                profiler->trace.push_back(trace_event);
+            }
+            else
+            {
+                profiler->trace[profiler->trace_offset] = trace_event;
+                profiler->trace_offset = (profiler->trace_offset + 1) % CPU_PROFILER_TRACE_EVENTS;
+            }
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    uint64_t dropped = 0;
+    for (int i = 0; i < count; i++)
+    {
+        CpuThreadRing *ring = profiler->rings[i].load(std::memory_order_acquire);
+        if (ring)
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    profiler->dropped = dropped;
+}
+
+static void cpu_profiler_write_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Writes the retained trace history as Chrome trace JSON. Returns false if the
+// file could not be written.
+bool cpu_profiler_dump_trace(const char *path)
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    cpu_profiler_collect();
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "[cpu profiler] Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int count = profiler->ring_count.load();
+    for (int i = 0; i < count && i < CPU_PROFILER_MAX_THREADS; i++)
+    {
+        CpuThreadRing *ring = profiler->rings[i].load(std::memory_order_acquire);
+        if (!ring)
+            continue;
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", ring->tid);
+        cpu_profiler_write_json_string(f, ring->name);
+        fprintf(f, "}}");
+        first = false;
+    }
+
+    // Oldest first
+    int trace_count = profiler->trace.Size;
+    for (int i = 0; i < trace_count; i++)
+    {
+        const CpuTraceEvent& event = profiler->trace[(profiler->trace_offset + i) % trace_count];
+        double ts_us = (double)(event.start_ns - profiler->start_ns) / 1e3;
+        double dur_us = (double)(event.end_ns - event.start_ns) / 1e3;
+        fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+        cpu_profiler_write_json_string(f, event.name);
+        fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.tid, ts_us, dur_us);
+        first = false;
+    }
+    fprintf(f, "\n]}\n");
+    bool ok = ferror(f) == 0;
+    fclose(f);
+
+    snprintf(profiler->last_dump, sizeof(profiler->last_dump), "%s (%d events)", path, trace_count);
+    printf("[cpu profiler] Wrote %s\n", profiler->last_dump);
+    return ok;
+}
+
+static float cpu_profiler_percentile(const float *sorted, int count, float p)
+{
+    if (count == 0)
+        return 0.0f;
+    int index = (int)(p * (count - 1) + 0.5f);
+    return sorted[index];
+}
+
+void cpu_profiler_draw_ui()
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    bool enabled = profiler->enabled;
+    if (ImGui::Checkbox("Enabled##cpu_profiler", &enabled))
+        profiler->enabled = enabled;
+    ImGui::SameLine();
+    if (ImGui::Button("Dump Chrome trace"))
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "cpu_trace_%llu.json", (unsigned long long)(cpu_profiler_now_ns() / 1000000));
+        cpu_profiler_dump_trace(path);
+    }
+    ImGui::Text("%d threads, %d events retained, %llu dropped", profiler->ring_count.load(), profiler->trace.Size, (unsigned long long)profiler->dropped);
+    if (profiler->last_dump[0])
+        ImGui::TextDisabled("Last dump: %s", profiler->last_dump);
+
+    float sorted[CPU_PROFILER_HISTORY];
+    for (CpuPhase& phase : profiler->phases)
+    {
+        if (phase.count == 0)
+            continue;
+        memcpy(sorted, phase.samples, sizeof(float) * phase.count);
+        std::sort(sorted, sorted + phase.count);
+        float p50 = cpu_profiler_percentile(sorted, phase.count, 0.50f);
+        float p99 = cpu_profiler_percentile(sorted, phase.count, 0.99f);
+        float max_ms = sorted[phase.count - 1];
+
+        // Histogram over [0, max]
+        float bins[CPU_PROFILER_HISTOGRAM_BINS] = {};
+        float bin_ms = max_ms > 0.0f ? max_ms / CPU_PROFILER_HISTOGRAM_BINS : 1.0f;
+        for (int i = 0; i < phase.count; i++)
+        {
+            int bin = (int)(sorted[i] / bin_ms);
+            bins[bin < CPU_PROFILER_HISTOGRAM_BINS ? bin : CPU_PROFILER_HISTOGRAM_BINS - 1] += 1.0f;
+        }
+
+        char overlay[96];
+        snprintf(overlay, sizeof(overlay), "p50 %.3f  p99 %.3f  max %.3f ms", p50, p99, max_ms);
+        ImGui::PlotHistogram(phase.name, bins, CPU_PROFILER_HISTOGRAM_BINS, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 40));
+    }
+}
+
+// Starts a measurement window for cpu_profiler_get_totals. Drains pending
+// events first so they aren't counted.
+void cpu_profiler_reset_totals()
+{
+    cpu_profiler_collect();
+    for (CpuPhase& phase : g_CpuProfiler.phases)
+        phase.total_ms = 0.0;
+}
+
+// Milliseconds spent in every phase since cpu_profiler_reset_totals, summed
+// over all threads. Returns the number of phases, up to max_count.
+int cpu_profiler_get_totals(const char **names, double *total_ms, int max_count)
+{
+    cpu_profiler_collect();
+    int count = 0;
+    for (CpuPhase& phase : g_CpuProfiler.phases)
+    {
+        if (phase.total_ms <= 0.0 || count == max_count)
+            continue;
+        names[count] = phase.name;
+        total_ms[count] = phase.total_ms;
+        count++;
+    }
+    return count;
+}
+
+// One line per phase for headless runs.
+void cpu_profiler_print()
+{
+    CpuProfiler *profiler = &g_CpuProfiler;
+    cpu_profiler_collect();
+    float sorted[CPU_PROFILER_HISTORY];
+    for (CpuPhase& phase : profiler->phases)
+    {
+        if (phase.count == 0)
+            continue;
+        memcpy(sorted, phase.samples, sizeof(float) * phase.count);
+        std::sort(sorted, sorted + phase.count);
+        printf("[cpu profiler] %-18s p50 %8.3f ms  p99 %8.3f ms  (last %d samples)\n", phase.name,
+               cpu_profiler_percentile(sorted, phase.count, 0.50f), cpu_profiler_percentile(sorted, phase.count, 0.99f), phase.count);
+    }
+}
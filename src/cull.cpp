@@ -0,0 +1,456 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// GPU-driven view culling. Every object gets its own indexed draw command;
+// a compute pass tests object bounds against the view and appends the
+// survivors to an indirect buffer, which a single vkCmdDrawIndexedIndirectCount
+// consumes. The CPU paths produce the same compacted commands on the host
+// (CULL_MODE_CPU) or issue one vkCmdDrawIndexed per survivor
+// (CULL_MODE_CPU_DRAWS), the baseline this is meant to replace.
+//
+// Needs the multiDrawIndirect and drawIndirectFirstInstance features for the
+// indirect modes. Without VK_KHR_draw_indirect_count the GPU path zeroes the
+// command buffer and draws the maximum count; culled slots are empty draws.
+
+#define CULL_MAX_OBJECTS (1 << 20)
+#define CULL_MAX_FRAMES 8
+#define CULL_WORLD_EXTENT 4.0f
+
+enum CullMode
+{
+    CULL_MODE_GPU,
+    CULL_MODE_CPU,
+    CULL_MODE_CPU_DRAWS,
+    CULL_MODE_COUNT,
+};
+
+static const char *g_CullModeNames[CULL_MODE_COUNT] = { "GPU compute", "CPU, indirect", "CPU, draw per object" };
+
+// Matches the push constants in cull.comp
+struct CullPushConstants
+{
+    float view[4]; // center xy, half extents zw
+    uint32_t object_count;
+    uint32_t count_slot;
+};
+
+struct CullStats
+{
+    uint32_t visible;
+    double cpu_ms; // culling and recording on the CPU, last frame
+};
+
+struct CullRenderer
+{
+    VkDevice device;
+    bool indirect_supported;
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count;
+
+    BatchInstance *objects_cpu;
+    GpuBuffer objects;
+    GpuBuffer commands;
+    GpuBuffer counts;       // one uint per frame slot, host visible for the stats readout
+    GpuLinearPool cpu_commands; // per-frame host-written commands for CULL_MODE_CPU
+
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet set;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+
+    bool enabled;
+    CullMode mode;
+    int object_count;
+    float view_half_extent;
+    bool animate_view;
+    float view_center[2];
+    double time;
+
+    uint32_t frame_slot;
+    CullStats stats;
+};
+
+static VkPipeline create_cull_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkPipelineLayout layout)
+{
+    VkShaderModule shader = create_shader_module("cull.comp", device);
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = shader;
+    info.stage.pName = "main";
+    info.layout = layout;
+
+    VkPipeline pipeline;
+    VkResult err = vkCreateComputePipelines(device, pipeline_cache, 1, &info, nullptr, &pipeline);
+    check_vk_result(err);
+    vkDestroyShaderModule(device, shader, nullptr);
+    return pipeline;
+}
+
+static void create_cull_descriptors(CullRenderer *cull)
+{
+    VkDevice device = cull->device;
+    VkResult err;
+
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 3;
+    layout_info.pBindings = bindings;
+    err = vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &cull->set_layout);
+    check_vk_result(err);
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 };
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    err = vkCreateDescriptorPool(device, &pool_info, nullptr, &cull->descriptor_pool);
+    check_vk_result(err);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = cull->descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &cull->set_layout;
+    err = vkAllocateDescriptorSets(device, &alloc_info, &cull->set);
+    check_vk_result(err);
+
+    VkDescriptorBufferInfo buffer_infos[3] = {
+        { cull->objects.buffer, 0, VK_WHOLE_SIZE },
+        { cull->commands.buffer, 0, VK_WHOLE_SIZE },
+        { cull->counts.buffer, 0, VK_WHOLE_SIZE },
+    };
+    VkWriteDescriptorSet writes[3] = {};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = cull->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &cull->set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &range;
+    err = vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &cull->pipeline_layout);
+    check_vk_result(err);
+}
+
+// features are the ones enabled on the device; draw_indirect_count tells
+// whether VK_KHR_draw_indirect_count was enabled.
+void cull_init(CullRenderer *cull, GpuAllocator *allocator, UploadContext *upload, VkPipelineCache pipeline_cache,
+               const VkPhysicalDeviceFeatures& features, bool draw_indirect_count, uint32_t frame_count)
+{
+    VkDevice device = allocator->device;
+    cull->device = device;
+    cull->indirect_supported = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    cull->draw_indexed_indirect_count = nullptr;
+    if (draw_indirect_count)
+        cull->draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+
+    // Objects spread over a world larger than the view, so most get culled
+    cull->objects_cpu = (BatchInstance *)xmalloc(sizeof(BatchInstance) * CULL_MAX_OBJECTS);
+    uint32_t seed = 0x2545f491;
+    for (int i = 0; i < CULL_MAX_OBJECTS; i++)
+    {
+        BatchInstance *object = &cull->objects_cpu[i];
+        object->offset[0] = batch_random_float(&seed, -CULL_WORLD_EXTENT, CULL_WORLD_EXTENT);
+        object->offset[1] = batch_random_float(&seed, -CULL_WORLD_EXTENT, CULL_WORLD_EXTENT);
+        object->scale_rotation[0] = batch_random_float(&seed, 0.005f, 0.03f);
+        object->scale_rotation[1] = batch_random_float(&seed, 0.0f, 6.2831853f);
+        object->color = batch_random(&seed) | 0xff000000;
+    }
+
+    VkDeviceSize objects_size = sizeof(BatchInstance) * CULL_MAX_OBJECTS;
+    gpu_create_buffer(allocator, objects_size,
+                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull->objects);
+    upload_buffer(upload, cull->objects.buffer, 0, cull->objects_cpu, objects_size,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    VkDeviceSize commands_size = sizeof(VkDrawIndexedIndirectCommand) * CULL_MAX_OBJECTS;
+    gpu_create_buffer(allocator, commands_size,
+                      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cull->commands);
+    gpu_create_buffer(allocator, sizeof(uint32_t) * CULL_MAX_FRAMES,
+                      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &cull->counts);
+    memset(cull->counts.allocation.mapped, 0, sizeof(uint32_t) * CULL_MAX_FRAMES);
+
+    // Commands plus the count, per frame in flight
+    if (frame_count > CULL_MAX_FRAMES)
+        frame_count = CULL_MAX_FRAMES;
+    gpu_linear_pool_init(allocator, &cull->cpu_commands, commands_size + 256, frame_count, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    create_cull_descriptors(cull);
+    cull->pipeline = create_cull_pipeline(device, pipeline_cache, cull->pipeline_layout);
+
+    cull->enabled = false;
+    cull->mode = cull->indirect_supported ? CULL_MODE_GPU : CULL_MODE_CPU_DRAWS;
+    cull->object_count = 100000;
+    cull->view_half_extent = 1.0f;
+    cull->animate_view = true;
+    cull->view_center[0] = 0.0f;
+    cull->view_center[1] = 0.0f;
+    cull->time = 0.0;
+    cull->frame_slot = 0;
+    memset(&cull->stats, 0, sizeof(cull->stats));
+
+    printf("[cull] indirect draws: %s, draw indirect count: %s\n",
+           cull->indirect_supported ? "yes" : "no", cull->draw_indexed_indirect_count ? "yes" : "no");
+}
+
+void cull_destroy(CullRenderer *cull, GpuAllocator *allocator)
+{
+    vkDestroyPipeline(cull->device, cull->pipeline, nullptr);
+    vkDestroyPipelineLayout(cull->device, cull->pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(cull->device, cull->descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(cull->device, cull->set_layout, nullptr);
+    gpu_linear_pool_destroy(allocator, &cull->cpu_commands);
+    gpu_destroy_buffer(allocator, &cull->counts);
+    gpu_destroy_buffer(allocator, &cull->commands);
+    gpu_destroy_buffer(allocator, &cull->objects);
+    free(cull->objects_cpu);
+}
+
+static bool cull_is_visible(const CullRenderer *cull, const BatchInstance& object)
+{
+    // Same test as cull.comp
+    float radius = object.scale_rotation[0] * 0.70710678f;
+    float dx = fabsf(object.offset[0] - cull->view_center[0]) - radius;
+    float dy = fabsf(object.offset[1] - cull->view_center[1]) - radius;
+    return dx <= cull->view_half_extent && dy <= cull->view_half_extent;
+}
+
+static VkDrawIndexedIndirectCommand cull_make_command(uint32_t i)
+{
+    bool quad = (i & 1) != 0;
+    VkDrawIndexedIndirectCommand command;
+    command.indexCount = quad ? 6 : 3;
+    command.instanceCount = 1;
+    command.firstIndex = quad ? 3 : 0;
+    command.vertexOffset = quad ? 3 : 0;
+    command.firstInstance = i;
+    return command;
+}
+
+// Moves the view and picks this frame's count slot. frame_index must identify
+// a frame whose fence has been waited on.
+void cull_update(CullRenderer *cull, uint32_t frame_index, float dt)
+{
+    if (!cull->enabled)
+        return;
+    double start = get_time_ms();
+
+    if (cull->animate_view)
+        cull->time += dt;
+    float radius = CULL_WORLD_EXTENT - cull->view_half_extent;
+    cull->view_center[0] = radius * 0.5f * cosf((float)cull->time * 0.2f);
+    cull->view_center[1] = radius * 0.5f * sinf((float)cull->time * 0.3f);
+
+    // The previous result in this slot is complete once its frame's fence signaled
+    cull->frame_slot = frame_index % CULL_MAX_FRAMES;
+    uint32_t *counts = (uint32_t *)cull->counts.allocation.mapped;
+    if (cull->mode == CULL_MODE_GPU)
+        cull->stats.visible = counts[cull->frame_slot];
+
+    cull->stats.cpu_ms = get_time_ms() - start;
+}
+
+bool cull_uses_compute(const CullRenderer *cull)
+{
+    return cull->enabled && cull->mode == CULL_MODE_GPU && cull->indirect_supported;
+}
+
+// Runs the culling for this frame, outside the render pass, after cull_update.
+// The caller orders it against earlier indirect draws from the same buffers
+// and the indirect draw that consumes it.
+void cull_record_compute(CullRenderer *cull, VkCommandBuffer command_buffer)
+{
+    if (!cull_uses_compute(cull))
+        return;
+    double start = get_time_ms();
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    vkCmdFillBuffer(command_buffer, cull->counts.buffer, sizeof(uint32_t) * cull->frame_slot, sizeof(uint32_t), 0);
+    if (!cull->draw_indexed_indirect_count)
+        vkCmdFillBuffer(command_buffer, cull->commands.buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * cull->object_count, 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    CullPushConstants constants = {};
+    constants.view[0] = cull->view_center[0];
+    constants.view[1] = cull->view_center[1];
+    constants.view[2] = cull->view_half_extent;
+    constants.view[3] = cull->view_half_extent;
+    constants.object_count = (uint32_t)cull->object_count;
+    constants.count_slot = cull->frame_slot;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline_layout, 0, 1, &cull->set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, cull->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, ((uint32_t)cull->object_count + 63) / 64, 1, 1);
+
+    // cull_update reads this frame's count once the fence signals
+    VkBufferMemoryBarrier host_barrier = {};
+    host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    host_barrier.buffer = cull->counts.buffer;
+    host_barrier.offset = sizeof(uint32_t) * cull->frame_slot;
+    host_barrier.size = sizeof(uint32_t);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &host_barrier, 0, nullptr);
+
+    cull->stats.cpu_ms += get_time_ms() - start;
+}
+
+static void cull_bind_draw_state(const CullRenderer *cull, VkCommandBuffer command_buffer, BatchRenderer *batch, PipelineRegistry *registry)
+{
+    VkBuffer buffers[2] = { batch->vertices.buffer, cull->objects.buffer };
+    VkDeviceSize offsets[2] = { 0, 0 };
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, batch->indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_registry_get(registry, batch->triangle_pipeline));
+
+    BatchPushConstants constants = { { cull->view_center[0], cull->view_center[1], 1.0f / cull->view_half_extent, 1.0f / cull->view_half_extent } };
+    vkCmdPushConstants(command_buffer, g_BatchPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+}
+
+// CULL_MODE_CPU_DRAWS for objects [first, first + count), with its own state
+// binds. Only reads the renderer, so disjoint ranges can be recorded into
+// different command buffers concurrently. Returns the number of draws.
+uint32_t cull_record_draw_range(const CullRenderer *cull, VkCommandBuffer command_buffer, uint32_t first, uint32_t count,
+                                BatchRenderer *batch, PipelineRegistry *registry)
+{
+    if (count == 0)
+        return 0;
+    cull_bind_draw_state(cull, command_buffer, batch, registry);
+
+    uint32_t visible = 0;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        if (!cull_is_visible(cull, cull->objects_cpu[i]))
+            continue;
+        VkDrawIndexedIndirectCommand c = cull_make_command(i);
+        vkCmdDrawIndexed(command_buffer, c.indexCount, 1, c.firstIndex, c.vertexOffset, c.firstInstance);
+        visible++;
+    }
+    return visible;
+}
+
+// Draws the survivors with the batch triangle pipeline. Expects viewport and
+// scissor to be set already.
+void cull_record_draw(CullRenderer *cull, VkCommandBuffer command_buffer, uint32_t frame_index, BatchRenderer *batch, PipelineRegistry *registry)
+{
+    if (!cull->enabled)
+        return;
+    double start = get_time_ms();
+
+    if (cull->mode == CULL_MODE_CPU_DRAWS)
+    {
+        cull->stats.visible = cull_record_draw_range(cull, command_buffer, 0, (uint32_t)cull->object_count, batch, registry);
+        cull->stats.cpu_ms += get_time_ms() - start;
+        return;
+    }
+    cull_bind_draw_state(cull, command_buffer, batch, registry);
+
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    const uint32_t object_count = (uint32_t)cull->object_count;
+    switch (cull->mode)
+    {
+        case CULL_MODE_GPU:
+        {
+            if (cull->draw_indexed_indirect_count)
+                cull->draw_indexed_indirect_count(command_buffer, cull->commands.buffer, 0,
+                                                  cull->counts.buffer, sizeof(uint32_t) * cull->frame_slot, object_count, stride);
+            else
+                vkCmdDrawIndexedIndirect(command_buffer, cull->commands.buffer, 0, object_count, stride);
+            break;
+        }
+        case CULL_MODE_CPU:
+        {
+            gpu_linear_pool_begin_frame(&cull->cpu_commands, frame_index);
+            GpuLinearSlice count_slice, commands_slice;
+            if (!gpu_linear_alloc(&cull->cpu_commands, sizeof(uint32_t), 4, &count_slice) ||
+                !gpu_linear_alloc(&cull->cpu_commands, (VkDeviceSize)stride * object_count, 4, &commands_slice))
+                fatal("Culled commands don't fit their frame region");
+
+            VkDrawIndexedIndirectCommand *commands = (VkDrawIndexedIndirectCommand *)commands_slice.mapped;
+            uint32_t visible = 0;
+            for (uint32_t i = 0; i < object_count; i++)
+            {
+                if (cull_is_visible(cull, cull->objects_cpu[i]))
+                    commands[visible++] = cull_make_command(i);
+            }
+            *(uint32_t *)count_slice.mapped = visible;
+            cull->stats.visible = visible;
+
+            if (cull->draw_indexed_indirect_count)
+                cull->draw_indexed_indirect_count(command_buffer, commands_slice.buffer, commands_slice.offset,
+                                                  count_slice.buffer, count_slice.offset, object_count, stride);
+            else if (visible > 0)
+                vkCmdDrawIndexedIndirect(command_buffer, commands_slice.buffer, commands_slice.offset, visible, stride);
+            break;
+        }
+        default:
+            break;
+    }
+
+    cull->stats.cpu_ms += get_time_ms() - start;
+}
+
+void cull_draw_ui(CullRenderer *cull, float gpu_cull_ms, float gpu_draw_ms)
+{
+    ImGui::Checkbox("Enabled##cull", &cull->enabled);
+    if (!cull->indirect_supported)
+    {
+        ImGui::TextDisabled("multiDrawIndirect/drawIndirectFirstInstance not supported, CPU draws only");
+        cull->mode = CULL_MODE_CPU_DRAWS;
+    }
+    else
+    {
+        ImGui::Combo("Mode", (int *)&cull->mode, g_CullModeNames, CULL_MODE_COUNT);
+    }
+    ImGui::SliderInt("Objects", &cull->object_count, 1000, CULL_MAX_OBJECTS, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderFloat("View half extent", &cull->view_half_extent, 0.1f, CULL_WORLD_EXTENT, "%.2f", ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Animate view", &cull->animate_view);
+
+    ImGui::Text("Visible: %u / %d", cull->stats.visible, cull->object_count);
+    ImGui::Text("CPU: %.3f ms, GPU cull: %.3f ms, GPU draw: %.3f ms", cull->stats.cpu_ms, gpu_cull_ms, gpu_draw_ms);
+}
@@ -0,0 +1,363 @@
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Everything the Info window shows about a physical device, queried once.
+// The rows are formatted when the snapshot is taken, so drawing a section is
+// one clipped TextUnformatted per visible row. The raw structs are kept for
+// the JSON export.
+//
+// Limits, sparse properties and features are walked through DeviceField
+// tables generated from vulkan_core.h by tools/gen_device_fields.py.
+
+enum DeviceFieldType
+{
+    DEVICE_FIELD_U32,
+    DEVICE_FIELD_I32,
+    DEVICE_FIELD_U64,
+    DEVICE_FIELD_SIZE,
+    DEVICE_FIELD_FLOAT,
+    DEVICE_FIELD_BOOL,
+    DEVICE_FIELD_SAMPLE_COUNTS,
+};
+
+struct DeviceField
+{
+    const char *name;
+    size_t offset;
+    DeviceFieldType type;
+    int count; // array length, 1 for scalars
+};
+
+#include "device_fields.hpp"
+
+#define DEVICE_INFO_MAX_DEVICES 8
+#define DEVICE_INFO_JSON_PATH "bin/device_info.json"
+
+enum DeviceInfoSection
+{
+    DEVICE_INFO_PROPERTIES,
+    DEVICE_INFO_LIMITS,
+    DEVICE_INFO_SPARSE,
+    DEVICE_INFO_FEATURES,
+    DEVICE_INFO_MEMORY,
+    DEVICE_INFO_QUEUES,
+    DEVICE_INFO_EXTENSIONS,
+    DEVICE_INFO_SECTION_COUNT,
+};
+
+static const char *g_DeviceInfoSectionNames[] = { "Properties", "Limits", "Sparse properties", "Features", "Memory", "Queue families", "Extensions" };
+
+struct DeviceSnapshot
+{
+    VkPhysicalDevice device;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memory;
+    ImVector<VkQueueFamilyProperties> queue_families;
+    ImVector<VkExtensionProperties> extensions;
+
+    // Pre-formatted rows, null-terminated in text
+    ImVector<char> text;
+    ImVector<int> rows[DEVICE_INFO_SECTION_COUNT]; // offsets into text
+};
+
+static const char *get_vk_device_type_str(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+            return "VK_PHYSICAL_DEVICE_TYPE_OTHER";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return "VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return "VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return "VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return "VK_PHYSICAL_DEVICE_TYPE_CPU";
+        default:
+            return "Unknown device type";
+    }
+}
+
+// Appends "NAME | NAME" for the set bits, or "none".
+static void append_flag_names(char *buf, size_t size, uint32_t flags, const char *const *names, int name_count)
+{
+    size_t len = strlen(buf);
+    bool first = true;
+    for (int bit = 0; bit < name_count && len < size; bit++)
+    {
+        if (!(flags & (1u << bit)) || !names[bit])
+            continue;
+        len += snprintf(buf + len, size - len, "%s%s", first ? "" : " | ", names[bit]);
+        first = false;
+    }
+    if (first && len < size)
+        snprintf(buf + len, size - len, "none");
+}
+
+static const char *g_SampleCountNames[] = {
+    "VK_SAMPLE_COUNT_1_BIT", "VK_SAMPLE_COUNT_2_BIT", "VK_SAMPLE_COUNT_4_BIT", "VK_SAMPLE_COUNT_8_BIT",
+    "VK_SAMPLE_COUNT_16_BIT", "VK_SAMPLE_COUNT_32_BIT", "VK_SAMPLE_COUNT_64_BIT",
+};
+static const char *g_QueueFlagNames[] = { "graphics", "compute", "transfer", "sparse binding", "protected" };
+static const char *g_MemoryPropertyNames[] = { "device local", "host visible", "host coherent", "host cached", "lazily allocated", "protected" };
+static const char *g_MemoryHeapFlagNames[] = { "device local", "multi instance" };
+
+static void device_snapshot_add_row(DeviceSnapshot *snapshot, DeviceInfoSection section, const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0)
+        return;
+    if (len >= (int)sizeof(buf))
+        len = (int)sizeof(buf) - 1;
+
+    snapshot->rows[section].push_back(snapshot->text.Size);
+    int offset = snapshot->text.Size;
+    snapshot->text.resize(offset + len + 1);
+    memcpy(snapshot->text.Data + offset, buf, (size_t)len + 1);
+}
+
+// Formats element i of a field into buf.
+static void format_device_field_value(const DeviceField& field, const void *base, int i, char *buf, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)base + field.offset;
+    buf[0] = '\0';
+    switch (field.type)
+    {
+        case DEVICE_FIELD_U32: snprintf(buf, size, "%u", ((const uint32_t *)p)[i]); break;
+        case DEVICE_FIELD_I32: snprintf(buf, size, "%d", ((const int32_t *)p)[i]); break;
+        case DEVICE_FIELD_U64: snprintf(buf, size, "%llu", (unsigned long long)((const VkDeviceSize *)p)[i]); break;
+        case DEVICE_FIELD_SIZE: snprintf(buf, size, "%zu", ((const size_t *)p)[i]); break;
+        case DEVICE_FIELD_FLOAT: snprintf(buf, size, "%0.3f", ((const float *)p)[i]); break;
+        case DEVICE_FIELD_BOOL: snprintf(buf, size, "%s", ((const VkBool32 *)p)[i] ? "true" : "false"); break;
+        case DEVICE_FIELD_SAMPLE_COUNTS:
+            append_flag_names(buf, size, ((const VkSampleCountFlags *)p)[i], g_SampleCountNames, IM_ARRAYSIZE(g_SampleCountNames));
+            break;
+    }
+}
+
+static void device_snapshot_add_fields(DeviceSnapshot *snapshot, DeviceInfoSection section, const DeviceField *fields, int field_count, const void *base)
+{
+    for (int f = 0; f < field_count; f++)
+    {
+        const DeviceField& field = fields[f];
+        char value[256];
+        value[0] = '\0';
+        size_t len = 0;
+        for (int i = 0; i < field.count && len < sizeof(value); i++)
+        {
+            if (field.count > 1)
+                len += snprintf(value + len, sizeof(value) - len, "%s", i == 0 ? "[" : ", ");
+            if (len < sizeof(value))
+                format_device_field_value(field, base, i, value + len, sizeof(value) - len);
+            len = strlen(value);
+        }
+        if (field.count > 1 && len < sizeof(value))
+            snprintf(value + len, sizeof(value) - len, "]");
+        device_snapshot_add_row(snapshot, section, "%s = %s", field.name, value);
+    }
+}
+
+void device_snapshot_take(DeviceSnapshot *snapshot, VkPhysicalDevice device)
+{
+    snapshot->device = device;
+    vkGetPhysicalDeviceProperties(device, &snapshot->properties);
+    vkGetPhysicalDeviceFeatures(device, &snapshot->features);
+    vkGetPhysicalDeviceMemoryProperties(device, &snapshot->memory);
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+    snapshot->queue_families.resize((int)count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, snapshot->queue_families.Data);
+
+    count = 0;
+    VkResult err = vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+    check_vk_result(err);
+    snapshot->extensions.resize((int)count);
+    err = vkEnumerateDeviceExtensionProperties(device, nullptr, &count, snapshot->extensions.Data);
+    check_vk_result(err);
+
+    snapshot->text.resize(0);
+    for (ImVector<int>& rows : snapshot->rows)
+        rows.resize(0);
+
+    const VkPhysicalDeviceProperties& p = snapshot->properties;
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Device Name: %s", p.deviceName);
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "API version: %u.%u.%u", VK_API_VERSION_MAJOR(p.apiVersion),
+                            VK_API_VERSION_MINOR(p.apiVersion), VK_API_VERSION_PATCH(p.apiVersion));
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Driver version: %u", p.driverVersion);
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Vendor ID: %u", p.vendorID);
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Device ID: %u", p.deviceID);
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Type: %s", get_vk_device_type_str(p.deviceType));
+    char uuid[VK_UUID_SIZE * 2 + 1];
+    for (int i = 0; i < VK_UUID_SIZE; i++)
+        snprintf(uuid + i * 2, 3, "%02x", p.pipelineCacheUUID[i]);
+    device_snapshot_add_row(snapshot, DEVICE_INFO_PROPERTIES, "Pipeline cache UUID: %s", uuid);
+
+    device_snapshot_add_fields(snapshot, DEVICE_INFO_LIMITS, g_DeviceLimitFields, IM_ARRAYSIZE(g_DeviceLimitFields), &p.limits);
+    device_snapshot_add_fields(snapshot, DEVICE_INFO_SPARSE, g_DeviceSparseFields, IM_ARRAYSIZE(g_DeviceSparseFields), &p.sparseProperties);
+    device_snapshot_add_fields(snapshot, DEVICE_INFO_FEATURES, g_DeviceFeatureFields, IM_ARRAYSIZE(g_DeviceFeatureFields), &snapshot->features);
+
+    const VkPhysicalDeviceMemoryProperties& m = snapshot->memory;
+    for (uint32_t i = 0; i < m.memoryHeapCount; i++)
+    {
+        char flags[128] = "";
+        append_flag_names(flags, sizeof(flags), m.memoryHeaps[i].flags, g_MemoryHeapFlagNames, IM_ARRAYSIZE(g_MemoryHeapFlagNames));
+        device_snapshot_add_row(snapshot, DEVICE_INFO_MEMORY, "Heap %u: %.1f MiB, %s", i, m.memoryHeaps[i].size / (1024.0 * 1024.0), flags);
+    }
+    for (uint32_t i = 0; i < m.memoryTypeCount; i++)
+    {
+        char flags[256] = "";
+        append_flag_names(flags, sizeof(flags), m.memoryTypes[i].propertyFlags, g_MemoryPropertyNames, IM_ARRAYSIZE(g_MemoryPropertyNames));
+        device_snapshot_add_row(snapshot, DEVICE_INFO_MEMORY, "Type %u: heap %u, %s", i, m.memoryTypes[i].heapIndex, flags);
+    }
+
+    for (int i = 0; i < snapshot->queue_families.Size; i++)
+    {
+        const VkQueueFamilyProperties& q = snapshot->queue_families[i];
+        char flags[128] = "";
+        append_flag_names(flags, sizeof(flags), q.queueFlags, g_QueueFlagNames, IM_ARRAYSIZE(g_QueueFlagNames));
+        device_snapshot_add_row(snapshot, DEVICE_INFO_QUEUES, "%d: %s; %u queues, %u timestamp bits, granularity %ux%ux%u", i, flags, q.queueCount,
+                                q.timestampValidBits, q.minImageTransferGranularity.width, q.minImageTransferGranularity.height,
+                                q.minImageTransferGranularity.depth);
+    }
+
+    for (const VkExtensionProperties& e : snapshot->extensions)
+        device_snapshot_add_row(snapshot, DEVICE_INFO_EXTENSIONS, "%s (spec %u)", e.extensionName, e.specVersion);
+}
+
+static void device_info_draw_rows(const DeviceSnapshot *snapshot, DeviceInfoSection section)
+{
+    const ImVector<int>& rows = snapshot->rows[section];
+    ImGuiListClipper clipper;
+    clipper.Begin(rows.Size);
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+            ImGui::Bullet();
+            ImGui::TextUnformatted(snapshot->text.Data + rows[i]);
+        }
+    }
+}
+
+// selected marks the device in use.
+void device_info_draw_ui(const DeviceSnapshot *snapshot, int device_index, bool selected)
+{
+    const char *name = snapshot->properties.deviceName;
+    if (!ImGui::TreeNode(snapshot, "%d: %s%s", device_index, name, selected ? " <-" : ""))
+        return;
+    for (int section = 0; section < DEVICE_INFO_SECTION_COUNT; section++)
+    {
+        const ImVector<int>& rows = snapshot->rows[section];
+        if (ImGui::TreeNode(g_DeviceInfoSectionNames[section], "%s (%d)", g_DeviceInfoSectionNames[section], rows.Size))
+        {
+            device_info_draw_rows(snapshot, (DeviceInfoSection)section);
+            ImGui::TreePop();
+        }
+    }
+    ImGui::TreePop();
+}
+
+//
+// JSON export
+//
+
+static void device_info_write_fields(FILE *f, const char *key, const DeviceField *fields, int field_count, const void *base)
+{
+    fprintf(f, ",\n      \"%s\": {", key);
+    for (int i = 0; i < field_count; i++)
+    {
+        const DeviceField& field = fields[i];
+        const uint8_t *p = (const uint8_t *)base + field.offset;
+        fprintf(f, "%s\n        \"%s\": %s", i > 0 ? "," : "", field.name, field.count > 1 ? "[" : "");
+        for (int e = 0; e < field.count; e++)
+        {
+            if (e > 0)
+                fprintf(f, ", ");
+            switch (field.type)
+            {
+                case DEVICE_FIELD_U32: fprintf(f, "%u", ((const uint32_t *)p)[e]); break;
+                case DEVICE_FIELD_I32: fprintf(f, "%d", ((const int32_t *)p)[e]); break;
+                case DEVICE_FIELD_U64: fprintf(f, "%llu", (unsigned long long)((const VkDeviceSize *)p)[e]); break;
+                case DEVICE_FIELD_SIZE: fprintf(f, "%zu", ((const size_t *)p)[e]); break;
+                case DEVICE_FIELD_FLOAT: fprintf(f, "%.9g", ((const float *)p)[e]); break;
+                case DEVICE_FIELD_BOOL: fprintf(f, "%s", ((const VkBool32 *)p)[e] ? "true" : "false"); break;
+                case DEVICE_FIELD_SAMPLE_COUNTS: fprintf(f, "%u", ((const VkSampleCountFlags *)p)[e]); break;
+            }
+        }
+        fprintf(f, "%s", field.count > 1 ? "]" : "");
+    }
+    fprintf(f, "\n      }");
+}
+
+// Flags are written as the raw Vulkan bitmasks.
+bool device_info_write_json(const DeviceSnapshot *snapshots, int snapshot_count, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "[device info] Can't write %s\n", path);
+        return false;
+    }
+    fprintf(f, "{\n  \"devices\": [");
+    for (int d = 0; d < snapshot_count; d++)
+    {
+        const DeviceSnapshot& s = snapshots[d];
+        const VkPhysicalDeviceProperties& p = s.properties;
+        fprintf(f, "%s\n    {\n      \"name\": ", d > 0 ? "," : "");
+        write_json_string(f, p.deviceName);
+        fprintf(f, ",\n      \"api_version\": \"%u.%u.%u\"", VK_API_VERSION_MAJOR(p.apiVersion), VK_API_VERSION_MINOR(p.apiVersion), VK_API_VERSION_PATCH(p.apiVersion));
+        fprintf(f, ",\n      \"driver_version\": %u,\n      \"vendor_id\": %u,\n      \"device_id\": %u", p.driverVersion, p.vendorID, p.deviceID);
+        fprintf(f, ",\n      \"type\": \"%s\",\n      \"pipeline_cache_uuid\": \"", get_vk_device_type_str(p.deviceType));
+        for (int i = 0; i < VK_UUID_SIZE; i++)
+            fprintf(f, "%02x", p.pipelineCacheUUID[i]);
+        fprintf(f, "\"");
+
+        device_info_write_fields(f, "limits", g_DeviceLimitFields, IM_ARRAYSIZE(g_DeviceLimitFields), &p.limits);
+        device_info_write_fields(f, "sparse_properties", g_DeviceSparseFields, IM_ARRAYSIZE(g_DeviceSparseFields), &p.sparseProperties);
+        device_info_write_fields(f, "features", g_DeviceFeatureFields, IM_ARRAYSIZE(g_DeviceFeatureFields), &s.features);
+
+        fprintf(f, ",\n      \"memory_heaps\": [");
+        for (uint32_t i = 0; i < s.memory.memoryHeapCount; i++)
+            fprintf(f, "%s\n        { \"size\": %llu, \"flags\": %u }", i > 0 ? "," : "",
+                    (unsigned long long)s.memory.memoryHeaps[i].size, s.memory.memoryHeaps[i].flags);
+        fprintf(f, "\n      ],\n      \"memory_types\": [");
+        for (uint32_t i = 0; i < s.memory.memoryTypeCount; i++)
+            fprintf(f, "%s\n        { \"heap\": %u, \"flags\": %u }", i > 0 ? "," : "",
+                    s.memory.memoryTypes[i].heapIndex, s.memory.memoryTypes[i].propertyFlags);
+        fprintf(f, "\n      ],\n      \"queue_families\": [");
+        for (int i = 0; i < s.queue_families.Size; i++)
+        {
+            const VkQueueFamilyProperties& q = s.queue_families[i];
+            fprintf(f, "%s\n        { \"flags\": %u, \"count\": %u, \"timestamp_valid_bits\": %u, \"min_image_transfer_granularity\": [%u, %u, %u] }",
+                    i > 0 ? "," : "", q.queueFlags, q.queueCount, q.timestampValidBits,
+                    q.minImageTransferGranularity.width, q.minImageTransferGranularity.height, q.minImageTransferGranularity.depth);
+        }
+        fprintf(f, "\n      ],\n      \"extensions\": [");
+        for (int i = 0; i < s.extensions.Size; i++)
+        {
+            fprintf(f, "%s\n        { \"name\": ", i > 0 ? "," : "");
+            write_json_string(f, s.extensions[i].extensionName);
+            fprintf(f, ", \"spec_version\": %u }", s.extensions[i].specVersion);
+        }
+        fprintf(f, "\n      ]\n    }");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    printf("[device info] Wrote %s\n", path);
+    return true;
+}
@@ -0,0 +1,346 @@
+#include <cfloat>
+#include <cstdio>
+#include <thread>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Frames in flight that don't depend on the swapchain image count, and a
+// frame limiter for low latency.
+//
+// FrameQueue owns a command buffer, fence and acquire semaphore per frame in
+// flight, plus a render-complete semaphore per swapchain image (a present may
+// still be waiting on it when the frame slot comes around again). If there are
+// more frames in flight than images, an acquired image can still be in use by
+// an older frame, so the fence of the last frame that rendered to each image is
+// tracked and waited on as well.
+//
+// FrameLimiter moves the blocking waits before input sampling and then sleeps
+// until just late enough to finish the frame by the next present slot,
+// estimated from how long the recent frames took from input to present.
+
+#define FRAMES_MAX_IN_FLIGHT 4
+#define FRAMES_MAX_IMAGES 8
+#define FRAME_LATENCY_HISTORY 120
+#define SUBMIT_SYNC_MAX 4
+
+// Extra semaphores for a frame's submit, on top of the swapchain's own
+struct SubmitSync
+{
+    VkSemaphore wait_semaphores[SUBMIT_SYNC_MAX];
+    VkPipelineStageFlags wait_stages[SUBMIT_SYNC_MAX];
+    uint32_t wait_count;
+    VkSemaphore signal_semaphores[SUBMIT_SYNC_MAX];
+    uint32_t signal_count;
+};
+
+struct FrameInFlight
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    VkSemaphore image_acquired;
+};
+
+struct FrameQueue
+{
+    VkDevice device;
+    FrameInFlight frames[FRAMES_MAX_IN_FLIGHT];
+    int frames_in_flight;
+    int requested_frames_in_flight; // applied at the next frame_queue_acquire
+    uint32_t frame_index;
+
+    uint32_t image_count;
+    uint32_t image_index;
+    VkSemaphore render_complete[FRAMES_MAX_IMAGES];
+    VkFence image_fences[FRAMES_MAX_IMAGES]; // not owned
+
+    double acquire_wait_ms; // fence and acquire waits, last frame
+};
+
+void frame_queue_init(FrameQueue *queue, VkDevice device, uint32_t queue_family, int frames_in_flight)
+{
+    queue->device = device;
+    queue->frames_in_flight = frames_in_flight;
+    queue->requested_frames_in_flight = frames_in_flight;
+    queue->frame_index = 0;
+    queue->image_count = 0;
+    queue->image_index = 0;
+    queue->acquire_wait_ms = 0.0;
+
+    for (FrameInFlight& frame : queue->frames)
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family;
+        VkResult err = vkCreateCommandPool(device, &pool_info, nullptr, &frame.command_pool);
+        check_vk_result(err);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = frame.command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(device, &alloc_info, &frame.command_buffer);
+        check_vk_result(err);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        err = vkCreateFence(device, &fence_info, nullptr, &frame.fence);
+        check_vk_result(err);
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        err = vkCreateSemaphore(device, &semaphore_info, nullptr, &frame.image_acquired);
+        check_vk_result(err);
+    }
+}
+
+static void frame_queue_destroy_image_semaphores(FrameQueue *queue)
+{
+    for (uint32_t i = 0; i < queue->image_count; i++)
+    {
+        vkDestroySemaphore(queue->device, queue->render_complete[i], nullptr);
+    }
+    queue->image_count = 0;
+}
+
+// Call after the swapchain was (re)created, with the device idle.
+void frame_queue_set_images(FrameQueue *queue, uint32_t image_count)
+{
+    if (image_count > FRAMES_MAX_IMAGES)
+        fatal("Swapchain has %u images, at most %d supported", image_count, FRAMES_MAX_IMAGES);
+
+    frame_queue_destroy_image_semaphores(queue);
+    for (uint32_t i = 0; i < image_count; i++)
+    {
+        VkSemaphoreCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkResult err = vkCreateSemaphore(queue->device, &info, nullptr, &queue->render_complete[i]);
+        check_vk_result(err);
+        queue->image_fences[i] = VK_NULL_HANDLE;
+    }
+    queue->image_count = image_count;
+}
+
+void frame_queue_destroy(FrameQueue *queue)
+{
+    frame_queue_destroy_image_semaphores(queue);
+    for (FrameInFlight& frame : queue->frames)
+    {
+        vkDestroySemaphore(queue->device, frame.image_acquired, nullptr);
+        vkDestroyFence(queue->device, frame.fence, nullptr);
+        vkDestroyCommandPool(queue->device, frame.command_pool, nullptr);
+    }
+}
+
+FrameInFlight *frame_queue_current(FrameQueue *queue)
+{
+    return &queue->frames[queue->frame_index];
+}
+
+// Waits until the current frame slot is free, then acquires the next image and
+// waits until no older frame renders to it. Returns the vkAcquireNextImageKHR
+// result; on VK_ERROR_OUT_OF_DATE_KHR nothing was acquired.
+VkResult frame_queue_acquire(FrameQueue *queue, VkSwapchainKHR swapchain)
+{
+    double start = get_time_ms();
+    if (queue->requested_frames_in_flight != queue->frames_in_flight)
+    {
+        VkResult err = vkDeviceWaitIdle(queue->device);
+        check_vk_result(err);
+        queue->frames_in_flight = queue->requested_frames_in_flight;
+        queue->frame_index = 0;
+    }
+
+    FrameInFlight *frame = frame_queue_current(queue);
+    VkResult err;
+    {
+        CPU_SCOPE("fence_wait");
+        err = vkWaitForFences(queue->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+        check_vk_result(err);
+    }
+
+    VkResult result;
+    {
+        CPU_SCOPE("acquire");
+        result = vkAcquireNextImageKHR(queue->device, swapchain, UINT64_MAX, frame->image_acquired, VK_NULL_HANDLE, &queue->image_index);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        return result;
+    if (result != VK_SUBOPTIMAL_KHR)
+        check_vk_result(result);
+
+    VkFence *image_fence = &queue->image_fences[queue->image_index];
+    if (*image_fence != VK_NULL_HANDLE && *image_fence != frame->fence)
+    {
+        CPU_SCOPE("image_fence_wait");
+        err = vkWaitForFences(queue->device, 1, image_fence, VK_TRUE, UINT64_MAX);
+        check_vk_result(err);
+    }
+    *image_fence = frame->fence;
+
+    queue->acquire_wait_ms = get_time_ms() - start;
+    return result;
+}
+
+// Submits the current frame's command buffer against the acquired image. sync
+// may be null.
+void frame_queue_submit(FrameQueue *queue, VkQueue vk_queue, const SubmitSync *sync)
+{
+    FrameInFlight *frame = frame_queue_current(queue);
+    VkResult err = vkResetFences(queue->device, 1, &frame->fence);
+    check_vk_result(err);
+
+    VkSemaphore wait_semaphores[SUBMIT_SYNC_MAX + 1] = { frame->image_acquired };
+    VkPipelineStageFlags wait_stages[SUBMIT_SYNC_MAX + 1] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    VkSemaphore signal_semaphores[SUBMIT_SYNC_MAX + 1] = { queue->render_complete[queue->image_index] };
+    uint32_t wait_count = 1;
+    uint32_t signal_count = 1;
+    if (sync)
+    {
+        for (uint32_t i = 0; i < sync->wait_count; i++, wait_count++)
+        {
+            wait_semaphores[wait_count] = sync->wait_semaphores[i];
+            wait_stages[wait_count] = sync->wait_stages[i];
+        }
+        for (uint32_t i = 0; i < sync->signal_count; i++)
+            signal_semaphores[signal_count++] = sync->signal_semaphores[i];
+    }
+
+    VkSubmitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.waitSemaphoreCount = wait_count;
+    info.pWaitSemaphores = wait_semaphores;
+    info.pWaitDstStageMask = wait_stages;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &frame->command_buffer;
+    info.signalSemaphoreCount = signal_count;
+    info.pSignalSemaphores = signal_semaphores;
+    CPU_SCOPE("queue_submit");
+    err = vkQueueSubmit(vk_queue, 1, &info, frame->fence);
+    check_vk_result(err);
+}
+
+// Presents the acquired image and moves on to the next frame slot.
+VkResult frame_queue_present(FrameQueue *queue, VkQueue vk_queue, VkSwapchainKHR swapchain)
+{
+    VkPresentInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    info.waitSemaphoreCount = 1;
+    info.pWaitSemaphores = &queue->render_complete[queue->image_index];
+    info.swapchainCount = 1;
+    info.pSwapchains = &swapchain;
+    info.pImageIndices = &queue->image_index;
+    VkResult result;
+    {
+        CPU_SCOPE("queue_present");
+        result = vkQueuePresentKHR(vk_queue, &info);
+    }
+    queue->frame_index = (queue->frame_index + 1) % (uint32_t)queue->frames_in_flight;
+    return result;
+}
+
+struct FrameLimiter
+{
+    bool low_latency;
+    int fps_cap;     // without vsync
+    float margin_ms; // slack left before the present slot
+    double refresh_hz;
+
+    double next_present_ms;
+    double work_ms_avg; // input sampling to present call
+    double sleep_ms;
+    double input_ms;
+
+    double latency_ms;
+    double latency_ms_avg;
+    float latency_history[FRAME_LATENCY_HISTORY];
+    int history_index;
+};
+
+void frame_limiter_init(FrameLimiter *limiter, double refresh_hz)
+{
+    *limiter = {};
+    limiter->low_latency = false;
+    limiter->refresh_hz = refresh_hz > 0.0 ? refresh_hz : 60.0;
+    limiter->fps_cap = (int)limiter->refresh_hz;
+    limiter->margin_ms = 1.0f;
+}
+
+static void frame_limiter_sleep_until(double target_ms)
+{
+    // The OS sleep is coarse, so sleep short and spin the last stretch
+    const double spin_ms = 1.0;
+    double remaining = target_ms - get_time_ms();
+    if (remaining > spin_ms)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining - spin_ms));
+    while (get_time_ms() < target_ms)
+        std::this_thread::yield();
+}
+
+// Low latency mode only: call after the frame slot and image are acquired,
+// right before sampling input.
+void frame_limiter_wait(FrameLimiter *limiter, bool vsync)
+{
+    limiter->sleep_ms = 0.0;
+    if (!limiter->low_latency)
+        return;
+
+    double fps = vsync ? limiter->refresh_hz : (double)limiter->fps_cap;
+    double interval = 1000.0 / (fps > 1.0 ? fps : 1.0);
+    double now = get_time_ms();
+    limiter->next_present_ms += interval;
+    if (limiter->next_present_ms < now || limiter->next_present_ms > now + 2.0 * interval)
+        limiter->next_present_ms = now + interval; // fell behind or first frame, resync
+
+    double wake = limiter->next_present_ms - limiter->work_ms_avg - limiter->margin_ms;
+    if (wake > now)
+    {
+        CPU_SCOPE("limiter_sleep");
+        frame_limiter_sleep_until(wake);
+        limiter->sleep_ms = get_time_ms() - now;
+    }
+}
+
+void frame_limiter_input_sampled(FrameLimiter *limiter)
+{
+    limiter->input_ms = get_time_ms();
+}
+
+void frame_limiter_presented(FrameLimiter *limiter)
+{
+    double latency = get_time_ms() - limiter->input_ms;
+    limiter->latency_ms = latency;
+    limiter->latency_ms_avg += (latency - limiter->latency_ms_avg) * 0.05;
+    // Track the upper side of the work estimate so spikes don't miss the slot
+    double k = latency > limiter->work_ms_avg ? 0.2 : 0.02;
+    limiter->work_ms_avg += (latency - limiter->work_ms_avg) * k;
+    limiter->latency_history[limiter->history_index] = (float)latency;
+    limiter->history_index = (limiter->history_index + 1) % FRAME_LATENCY_HISTORY;
+}
+
+void frame_pacing_draw_ui(FrameQueue *queue, FrameLimiter *limiter, bool vsync, float gpu_frame_ms)
+{
+    ImGui::SliderInt("Frames in flight", &queue->requested_frames_in_flight, 1, FRAMES_MAX_IN_FLIGHT);
+    ImGui::Text("%u swapchain images", queue->image_count);
+    ImGui::Checkbox("Low latency", &limiter->low_latency);
+    if (limiter->low_latency)
+    {
+        if (vsync)
+            ImGui::Text("Pacing to %.1f Hz refresh", limiter->refresh_hz);
+        else
+            ImGui::SliderInt("FPS cap", &limiter->fps_cap, 10, 1000);
+        ImGui::SliderFloat("Margin (ms)", &limiter->margin_ms, 0.0f, 10.0f, "%.1f");
+        ImGui::Text("Sleep: %.2f ms, predicted work: %.2f ms", limiter->sleep_ms, limiter->work_ms_avg);
+    }
+    ImGui::Text("Fence/acquire wait: %.2f ms", queue->acquire_wait_ms);
+    ImGui::Text("Input to present: %.2f ms (avg %.2f), + %.2f ms GPU", limiter->latency_ms, limiter->latency_ms_avg, gpu_frame_ms);
+    ImGui::PlotLines("##latency", limiter->latency_history, FRAME_LATENCY_HISTORY, limiter->history_index,
+                     "input to present (ms)", 0.0f, FLT_MAX, ImVec2(0, 60));
+}
@@ -0,0 +1,501 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+#include "vertex_layout.hpp"
+
+// Procedural geometry regenerated on the CPU every frame: bundles of lines
+// (waveforms, rings, Lissajous graphs) tessellated into ribbons of two
+// triangles per segment. The segments are split into fixed-size jobs on the
+// job system, and each job writes its own range of this frame's region of a
+// persistently mapped vertex buffer. Nothing is staged or copied in between.
+//
+// Kernels are written once against a lane type and built for the widest
+// vector unit the compiler targets (AVX2 with make AVX2=1, otherwise SSE2 or
+// NEON) and for plain floats. The scalar kernel stays selectable to measure
+// against. Lanes are computed in blocks of GEOMETRY_BLOCK segments on the
+// stack, then packed to Vertex with pack_half and pack_unorm8 and written
+// straight to the mapped buffer.
+
+#define GEOMETRY_MAX_SEGMENTS (1 << 20) // 6 vertices each
+#define GEOMETRY_JOB_SEGMENTS 8192
+#define GEOMETRY_BLOCK 64 // segments per block, a multiple of every lane width
+#define GEOMETRY_MIN_FRAME_BYTES (1ull << 20)
+
+enum GeometryShape
+{
+    GEOMETRY_SHAPE_WAVES,
+    GEOMETRY_SHAPE_RINGS,
+    GEOMETRY_SHAPE_LISSAJOUS,
+    GEOMETRY_SHAPE_COUNT,
+};
+
+static const char *g_GeometryShapeNames[GEOMETRY_SHAPE_COUNT] = { "Waveforms", "Rings", "Lissajous" };
+
+enum GeometryKernel
+{
+    GEOMETRY_KERNEL_SCALAR,
+    GEOMETRY_KERNEL_SIMD,
+    GEOMETRY_KERNEL_COUNT,
+};
+
+//
+// Lane types. Each has splat, ramp, the arithmetic operators, sqrt, min, max,
+// round (to nearest even, in every path) and store.
+//
+
+struct GeoF32x1
+{
+    float v;
+    static constexpr int width = 1;
+    static GeoF32x1 splat(float x) { return { x }; }
+    static GeoF32x1 ramp(float first, float step) { return { first }; }
+    static GeoF32x1 sqrt(GeoF32x1 a) { return { sqrtf(a.v) }; }
+    static GeoF32x1 min(GeoF32x1 a, GeoF32x1 b) { return { a.v < b.v ? a.v : b.v }; }
+    static GeoF32x1 max(GeoF32x1 a, GeoF32x1 b) { return { a.v > b.v ? a.v : b.v }; }
+    static GeoF32x1 round(GeoF32x1 a) { return { nearbyintf(a.v) }; }
+    void store(float *dst) const { *dst = v; }
+};
+
+static inline GeoF32x1 operator+(GeoF32x1 a, GeoF32x1 b) { return { a.v + b.v }; }
+static inline GeoF32x1 operator-(GeoF32x1 a, GeoF32x1 b) { return { a.v - b.v }; }
+static inline GeoF32x1 operator*(GeoF32x1 a, GeoF32x1 b) { return { a.v * b.v }; }
+static inline GeoF32x1 operator/(GeoF32x1 a, GeoF32x1 b) { return { a.v / b.v }; }
+
+#if defined(__AVX2__)
+#define GEOMETRY_SIMD_NAME "AVX2"
+struct GeoSimd
+{
+    __m256 v;
+    static constexpr int width = 8;
+    static GeoSimd splat(float x) { return { _mm256_set1_ps(x) }; }
+    static GeoSimd ramp(float first, float step)
+    {
+        __m256 lane = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+        return { _mm256_add_ps(_mm256_set1_ps(first), _mm256_mul_ps(lane, _mm256_set1_ps(step))) };
+    }
+    static GeoSimd sqrt(GeoSimd a) { return { _mm256_sqrt_ps(a.v) }; }
+    static GeoSimd min(GeoSimd a, GeoSimd b) { return { _mm256_min_ps(a.v, b.v) }; }
+    static GeoSimd max(GeoSimd a, GeoSimd b) { return { _mm256_max_ps(a.v, b.v) }; }
+    static GeoSimd round(GeoSimd a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+    void store(float *dst) const { _mm256_storeu_ps(dst, v); }
+};
+
+static inline GeoSimd operator+(GeoSimd a, GeoSimd b) { return { _mm256_add_ps(a.v, b.v) }; }
+static inline GeoSimd operator-(GeoSimd a, GeoSimd b) { return { _mm256_sub_ps(a.v, b.v) }; }
+static inline GeoSimd operator*(GeoSimd a, GeoSimd b) { return { _mm256_mul_ps(a.v, b.v) }; }
+static inline GeoSimd operator/(GeoSimd a, GeoSimd b) { return { _mm256_div_ps(a.v, b.v) }; }
+#elif defined(__SSE2__)
+#define GEOMETRY_SIMD_NAME "SSE2"
+struct GeoSimd
+{
+    __m128 v;
+    static constexpr int width = 4;
+    static GeoSimd splat(float x) { return { _mm_set1_ps(x) }; }
+    static GeoSimd ramp(float first, float step)
+    {
+        __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        return { _mm_add_ps(_mm_set1_ps(first), _mm_mul_ps(lane, _mm_set1_ps(step))) };
+    }
+    static GeoSimd sqrt(GeoSimd a) { return { _mm_sqrt_ps(a.v) }; }
+    static GeoSimd min(GeoSimd a, GeoSimd b) { return { _mm_min_ps(a.v, b.v) }; }
+    static GeoSimd max(GeoSimd a, GeoSimd b) { return { _mm_max_ps(a.v, b.v) }; }
+    // Inputs stay well inside int32 range; MXCSR rounds to nearest even
+    static GeoSimd round(GeoSimd a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+    void store(float *dst) const { _mm_storeu_ps(dst, v); }
+};
+
+static inline GeoSimd operator+(GeoSimd a, GeoSimd b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline GeoSimd operator-(GeoSimd a, GeoSimd b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline GeoSimd operator*(GeoSimd a, GeoSimd b) { return { _mm_mul_ps(a.v, b.v) }; }
+static inline GeoSimd operator/(GeoSimd a, GeoSimd b) { return { _mm_div_ps(a.v, b.v) }; }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define GEOMETRY_SIMD_NAME "NEON"
+struct GeoSimd
+{
+    float32x4_t v;
+    static constexpr int width = 4;
+    static GeoSimd splat(float x) { return { vdupq_n_f32(x) }; }
+    static GeoSimd ramp(float first, float step)
+    {
+        const float lane[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        return { vmlaq_n_f32(vdupq_n_f32(first), vld1q_f32(lane), step) };
+    }
+    static GeoSimd sqrt(GeoSimd a) { return { vsqrtq_f32(a.v) }; }
+    static GeoSimd min(GeoSimd a, GeoSimd b) { return { vminq_f32(a.v, b.v) }; }
+    static GeoSimd max(GeoSimd a, GeoSimd b) { return { vmaxq_f32(a.v, b.v) }; }
+    static GeoSimd round(GeoSimd a) { return { vrndnq_f32(a.v) }; }
+    void store(float *dst) const { vst1q_f32(dst, v); }
+};
+
+static inline GeoSimd operator+(GeoSimd a, GeoSimd b) { return { vaddq_f32(a.v, b.v) }; }
+static inline GeoSimd operator-(GeoSimd a, GeoSimd b) { return { vsubq_f32(a.v, b.v) }; }
+static inline GeoSimd operator*(GeoSimd a, GeoSimd b) { return { vmulq_f32(a.v, b.v) }; }
+static inline GeoSimd operator/(GeoSimd a, GeoSimd b) { return { vdivq_f32(a.v, b.v) }; }
+#else
+typedef GeoF32x1 GeoSimd; // no vector unit targeted, GEOMETRY_SIMD_NAME stays undefined
+#endif
+
+static_assert(GEOMETRY_BLOCK % GeoSimd::width == 0, "GEOMETRY_BLOCK must be a multiple of the lane width");
+
+// sin to about 1e-5: reduced to [-pi, pi], folded onto [-pi/2, pi/2], then
+// the Taylor series to x^9.
+template <typename L>
+static inline L geometry_sin(L x)
+{
+    const float pi = 3.14159265f;
+    x = x - L::round(x * L::splat(0.5f / pi)) * L::splat(2.0f * pi);
+    x = L::min(x, L::splat(pi) - x);
+    x = L::max(x, L::splat(-pi) - x);
+    L x2 = x * x;
+    L p = L::splat(1.0f / 362880.0f);
+    p = p * x2 + L::splat(-1.0f / 5040.0f);
+    p = p * x2 + L::splat(1.0f / 120.0f);
+    p = p * x2 + L::splat(-1.0f / 6.0f);
+    p = p * x2 + L::splat(1.0f);
+    return x * p;
+}
+
+template <typename L>
+static inline L geometry_cos(L x)
+{
+    return geometry_sin(x + L::splat(1.57079633f));
+}
+
+struct GeometryLine
+{
+    GeometryShape shape;
+    float line_t;     // 0..1 across the bundle
+    float spacing;    // between neighbouring lines
+    float time;
+};
+
+// Point t (0..1) along a line of the bundle.
+template <typename L>
+static inline void geometry_point(const GeometryLine& line, L t, L *x, L *y)
+{
+    const float two_pi = 6.28318531f;
+    switch (line.shape)
+    {
+        case GEOMETRY_SHAPE_WAVES:
+        {
+            L px = L::splat(-0.95f) + t * L::splat(1.9f);
+            L wave = geometry_sin(px * L::splat(7.0f) + L::splat(2.0f * line.time + 6.0f * line.line_t)) * L::splat(0.6f) +
+                     geometry_sin(px * L::splat(23.0f) - L::splat(3.1f * line.time)) * L::splat(0.4f);
+            *x = px;
+            *y = L::splat(-0.9f + 1.8f * line.line_t) + wave * L::splat(0.8f * line.spacing);
+            break;
+        }
+        case GEOMETRY_SHAPE_RINGS:
+        {
+            L angle = t * L::splat(two_pi);
+            L r = L::splat(0.1f + 0.8f * line.line_t) +
+                  geometry_sin(angle * L::splat(8.0f) + L::splat(3.0f * line.time + 10.0f * line.line_t)) * L::splat(0.8f * line.spacing);
+            *x = r * geometry_cos(angle);
+            *y = r * geometry_sin(angle);
+            break;
+        }
+        default:
+        {
+            L angle = t * L::splat(two_pi);
+            L scale = L::splat(0.2f + 0.75f * line.line_t);
+            *x = scale * geometry_sin(angle * L::splat(3.0f) + L::splat(0.7f * line.time + line.line_t));
+            *y = scale * geometry_sin(angle * L::splat(4.0f) + L::splat(2.0f * line.line_t));
+            break;
+        }
+    }
+}
+
+// Per segment, SoA: the four ribbon corners (x, y each) and the color.
+struct GeometryBlock
+{
+    float corners[8][GEOMETRY_BLOCK];
+    float color[3][GEOMETRY_BLOCK];
+};
+
+// Segments first..first+GEOMETRY_BLOCK-1 of a line with segment_count segments;
+// lanes past the end are computed and ignored.
+template <typename L>
+static void geometry_block(const GeometryLine& line, int first, int segment_count, float half_width, GeometryBlock *block)
+{
+    float dt = 1.0f / segment_count;
+    for (int i = 0; i < GEOMETRY_BLOCK; i += L::width)
+    {
+        L t0 = L::ramp((first + i) * dt, dt);
+        L t1 = t0 + L::splat(dt);
+        L x0, y0, x1, y1;
+        geometry_point(line, t0, &x0, &y0);
+        geometry_point(line, t1, &x1, &y1);
+
+        // Offset both ends along the segment's normal
+        L dx = x1 - x0;
+        L dy = y1 - y0;
+        L scale = L::splat(half_width) / (L::sqrt(dx * dx + dy * dy) + L::splat(1e-12f));
+        L nx = L::splat(0.0f) - dy * scale;
+        L ny = dx * scale;
+        (x0 + nx).store(&block->corners[0][i]);
+        (y0 + ny).store(&block->corners[1][i]);
+        (x0 - nx).store(&block->corners[2][i]);
+        (y0 - ny).store(&block->corners[3][i]);
+        (x1 + nx).store(&block->corners[4][i]);
+        (y1 + ny).store(&block->corners[5][i]);
+        (x1 - nx).store(&block->corners[6][i]);
+        (y1 - ny).store(&block->corners[7][i]);
+
+        L hue = L::splat(6.2831853f * line.line_t + line.time) + t0 * L::splat(3.0f);
+        for (int c = 0; c < 3; c++)
+            (L::splat(0.55f) + geometry_sin(hue + L::splat(2.0943951f * c)) * L::splat(0.45f)).store(&block->color[c][i]);
+    }
+}
+
+// Packs the first count segments of a block and writes their six vertices
+// each to dst, in order.
+static void geometry_emit(const GeometryBlock *block, int count, Vertex *dst)
+{
+    float pos[GEOMETRY_BLOCK * 8];
+    float color[GEOMETRY_BLOCK * 4];
+    uint16_t pos_half[GEOMETRY_BLOCK * 8];
+    uint8_t color_unorm[GEOMETRY_BLOCK * 4];
+    for (int i = 0; i < count; i++)
+    {
+        for (int c = 0; c < 8; c++)
+            pos[8 * i + c] = block->corners[c][i];
+        color[4 * i] = block->color[0][i];
+        color[4 * i + 1] = block->color[1][i];
+        color[4 * i + 2] = block->color[2][i];
+        color[4 * i + 3] = 1.0f;
+    }
+    pack_half(pos, pos_half, (size_t)count * 8);
+    pack_unorm8(color, color_unorm, (size_t)count * 4);
+
+    // Two triangles per segment: (a0, b0, a1) and (a1, b0, b1)
+    static const int corner_order[6] = { 0, 1, 2, 2, 1, 3 };
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *rgba = &color_unorm[4 * i];
+        Unorm8x4 packed_color = { rgba[0], rgba[1], rgba[2], rgba[3] };
+        for (int k = 0; k < 6; k++)
+        {
+            const uint16_t *corner = &pos_half[8 * i + 2 * corner_order[k]];
+            Vertex& v = dst[6 * i + k];
+            v.pos = { corner[0], corner[1] };
+            v.color = packed_color;
+        }
+    }
+}
+
+template <typename L>
+static void geometry_run(const GeometryLine& line, int first, int count, int segment_count, float half_width, Vertex *dst)
+{
+    GeometryBlock block;
+    for (int done = 0; done < count; done += GEOMETRY_BLOCK)
+    {
+        int n = count - done < GEOMETRY_BLOCK ? count - done : GEOMETRY_BLOCK;
+        geometry_block<L>(line, first + done, segment_count, half_width, &block);
+        geometry_emit(&block, n, dst + 6 * done);
+    }
+}
+
+struct GeometryStats
+{
+    uint32_t vertices;
+    double wall_ms; // generation, last frame
+    double cpu_ms;  // summed over the threads, last frame
+    int threads;    // that took part, last frame
+};
+
+struct GeometryGenerator
+{
+    GpuLinearPool pool; // one region per frame in flight, allocated when first enabled
+    uint32_t frame_count;
+    bool allocated;
+
+    bool enabled;
+    GeometryShape shape;
+    GeometryKernel kernel;
+    int lines;
+    int segments_per_line;
+    float time;
+
+    // This frame's vertices, valid after geometry_update
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    uint32_t vertex_count;
+
+    GeometryStats stats;
+    double thread_ms[JOB_MAX_THREADS + 1]; // per job system thread, reset every frame
+    // Totals since geometry_reset_stats, for the benchmarks
+    uint64_t total_vertices;
+    double total_wall_ms;
+    double total_cpu_ms;
+};
+
+struct GeometryJobs
+{
+    GeometryGenerator *gen;
+    Vertex *dst;
+};
+
+void geometry_init(GeometryGenerator *gen, uint32_t frame_count)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->frame_count = frame_count;
+    gen->enabled = false;
+    gen->shape = GEOMETRY_SHAPE_WAVES;
+#if defined(GEOMETRY_SIMD_NAME)
+    gen->kernel = GEOMETRY_KERNEL_SIMD;
+#else
+    gen->kernel = GEOMETRY_KERNEL_SCALAR;
+#endif
+    gen->lines = 128;
+    gen->segments_per_line = 1024;
+}
+
+void geometry_destroy(GeometryGenerator *gen, GpuAllocator *allocator)
+{
+    if (gen->allocated)
+        gpu_linear_pool_destroy(allocator, &gen->pool);
+    gen->allocated = false;
+}
+
+void geometry_reset_stats(GeometryGenerator *gen)
+{
+    gen->total_vertices = 0;
+    gen->total_wall_ms = 0.0;
+    gen->total_cpu_ms = 0.0;
+}
+
+static void geometry_job(void *user, int job, int thread_index)
+{
+    GeometryJobs *jobs = (GeometryJobs *)user;
+    const GeometryGenerator *gen = jobs->gen;
+    double start = get_time_ms();
+
+    int per_line = gen->segments_per_line;
+    int total = gen->lines * per_line;
+    int begin = job * GEOMETRY_JOB_SEGMENTS;
+    int end = begin + GEOMETRY_JOB_SEGMENTS < total ? begin + GEOMETRY_JOB_SEGMENTS : total;
+
+    GeometryLine line = {};
+    line.shape = gen->shape;
+    line.spacing = 1.0f / gen->lines;
+    line.time = gen->time;
+    // About a pixel at 1000 pixels across, wider when there are few lines
+    float half_width = 0.3f * line.spacing > 0.001f ? 0.3f * line.spacing : 0.001f;
+
+    // A job may span the end of one line and the start of the next
+    for (int s = begin; s < end;)
+    {
+        int index = s / per_line;
+        int first = s % per_line;
+        int count = per_line - first < end - s ? per_line - first : end - s;
+        line.line_t = gen->lines > 1 ? (float)index / (gen->lines - 1) : 0.5f;
+        if (gen->kernel == GEOMETRY_KERNEL_SIMD)
+            geometry_run<GeoSimd>(line, first, count, per_line, half_width, jobs->dst + 6 * (size_t)s);
+        else
+            geometry_run<GeoF32x1>(line, first, count, per_line, half_width, jobs->dst + 6 * (size_t)s);
+        s += count;
+    }
+
+    jobs->gen->thread_ms[thread_index] += get_time_ms() - start;
+}
+
+// Regenerates this frame's vertices. Call before recording, once the frame
+// slot's fence has been waited on; the job system must be idle.
+void geometry_update(GeometryGenerator *gen, GpuAllocator *allocator, JobSystem *jobs, uint32_t frame_index, float dt)
+{
+    gen->vertex_count = 0;
+    if (!gen->enabled)
+        return;
+
+    if (gen->lines < 1)
+        gen->lines = 1;
+    if (gen->segments_per_line < 1)
+        gen->segments_per_line = 1;
+    if (gen->lines * gen->segments_per_line > GEOMETRY_MAX_SEGMENTS)
+        gen->segments_per_line = GEOMETRY_MAX_SEGMENTS / gen->lines;
+    int segments = gen->lines * gen->segments_per_line;
+    VkDeviceSize bytes = (VkDeviceSize)segments * 6 * sizeof(Vertex);
+
+    if (!gen->allocated || bytes > gen->pool.frame_size)
+    {
+        // Every frame in flight may still be reading the old regions
+        VkResult err = vkDeviceWaitIdle(allocator->device);
+        check_vk_result(err);
+        geometry_destroy(gen, allocator);
+        VkDeviceSize frame_size = GEOMETRY_MIN_FRAME_BYTES;
+        while (frame_size < bytes)
+            frame_size *= 2;
+        gpu_linear_pool_init(allocator, &gen->pool, frame_size, gen->frame_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        gen->allocated = true;
+        printf("[geometry] %.1f MiB per frame, %u frames\n", frame_size / (1024.0 * 1024.0), gen->frame_count);
+    }
+
+    gpu_linear_pool_begin_frame(&gen->pool, frame_index);
+    GpuLinearSlice slice;
+    if (!gpu_linear_alloc(&gen->pool, bytes, sizeof(Vertex), &slice))
+        fatal("Geometry doesn't fit its frame region");
+    gen->time += dt;
+
+    GeometryJobs jobs_data = { gen, (Vertex *)slice.mapped };
+    memset(gen->thread_ms, 0, sizeof(gen->thread_ms));
+    double start = get_time_ms();
+    job_system_run(jobs, (segments + GEOMETRY_JOB_SEGMENTS - 1) / GEOMETRY_JOB_SEGMENTS, geometry_job, &jobs_data);
+    gen->stats.wall_ms = get_time_ms() - start;
+
+    gen->stats.cpu_ms = 0.0;
+    gen->stats.threads = 0;
+    for (double ms : gen->thread_ms)
+    {
+        gen->stats.cpu_ms += ms;
+        gen->stats.threads += ms > 0.0;
+    }
+    gen->stats.vertices = (uint32_t)segments * 6;
+    gen->total_vertices += gen->stats.vertices;
+    gen->total_wall_ms += gen->stats.wall_ms;
+    gen->total_cpu_ms += gen->stats.cpu_ms;
+
+    gen->buffer = slice.buffer;
+    gen->offset = slice.offset;
+    gen->vertex_count = gen->stats.vertices;
+}
+
+// Draws this frame's vertices with the triangle pipeline, which the caller has
+// bound along with the frame constants.
+void geometry_record_draw(const GeometryGenerator *gen, VkCommandBuffer command_buffer)
+{
+    if (gen->vertex_count == 0)
+        return;
+    TriPushConstants constants = {};
+    constants.scale = 1.0f;
+    vkCmdPushConstants(command_buffer, g_TriPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &gen->buffer, &gen->offset);
+    vkCmdDraw(command_buffer, gen->vertex_count, 1, 0, 0);
+}
+
+void geometry_draw_ui(GeometryGenerator *gen)
+{
+    ImGui::Checkbox("Enabled##geometry", &gen->enabled);
+    ImGui::Combo("Shape", (int *)&gen->shape, g_GeometryShapeNames, GEOMETRY_SHAPE_COUNT);
+#if defined(GEOMETRY_SIMD_NAME)
+    const char *kernel_names[GEOMETRY_KERNEL_COUNT] = { "Scalar", GEOMETRY_SIMD_NAME };
+    ImGui::Combo("Kernel", (int *)&gen->kernel, kernel_names, GEOMETRY_KERNEL_COUNT);
+#else
+    ImGui::TextUnformatted("Kernel: scalar only, no SIMD target");
+#endif
+    ImGui::SliderInt("Lines", &gen->lines, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderInt("Segments per line", &gen->segments_per_line, 16, 65536, "%d", ImGuiSliderFlags_Logarithmic);
+    if (gen->vertex_count == 0)
+        return;
+
+    const GeometryStats& stats = gen->stats;
+    ImGui::Text("%u vertices, %.1f MiB written", stats.vertices, stats.vertices * sizeof(Vertex) / (1024.0 * 1024.0));
+    ImGui::Text("%.3f ms, %.3f ms CPU over %d threads", stats.wall_ms, stats.cpu_ms, stats.threads);
+    if (stats.cpu_ms > 0.0)
+        ImGui::Text("%.1f M vertices/s per core", stats.vertices / (stats.cpu_ms * 1000.0));
+}
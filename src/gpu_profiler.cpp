@@ -0,0 +1,272 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+#define GPU_PROFILER_MAX_FRAMES 8
+#define GPU_PROFILER_MAX_SCOPES 32
+#define GPU_PROFILER_HISTORY 120
+
+// One query pool per frame in flight. A pool is only read back after the
+// fence of its frame has been waited on, so vkGetQueryPoolResults never
+// blocks; results show up a few frames late instead.
+struct GpuProfilerFrame
+{
+    VkQueryPool query_pool;
+    uint32_t scope_count;
+    int scope_passes[GPU_PROFILER_MAX_SCOPES];
+    bool pending;
+};
+
+struct GpuProfilerPass
+{
+    const char *name;
+    float history[GPU_PROFILER_HISTORY];
+    int history_offset;
+    float last_ms;
+    double total_ms;
+    uint64_t sample_count;
+};
+
+struct GpuProfiler
+{
+    VkDevice device;
+    bool supported;
+    float timestamp_period;
+    uint64_t timestamp_mask;
+    GpuProfilerFrame frames[GPU_PROFILER_MAX_FRAMES];
+    GpuProfilerFrame *current;
+    ImVector<GpuProfilerPass> passes;
+};
+
+void gpu_profiler_init(GpuProfiler *profiler, VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    uint32_t family_count;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    ImVector<VkQueueFamilyProperties> families;
+    families.resize(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.Data);
+    uint32_t valid_bits = families[queue_family].timestampValidBits;
+
+    profiler->device = device;
+    profiler->supported = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
+    profiler->timestamp_period = properties.limits.timestampPeriod;
+    profiler->timestamp_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+    profiler->current = nullptr;
+    if (!profiler->supported)
+    {
+        fprintf(stderr, "[gpu profiler] Timestamps not supported on queue family %u\n", queue_family);
+        return;
+    }
+
+    for (GpuProfilerFrame& frame : profiler->frames)
+    {
+        VkQueryPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = GPU_PROFILER_MAX_SCOPES * 2;
+        VkResult err = vkCreateQueryPool(device, &info, nullptr, &frame.query_pool);
+        check_vk_result(err);
+        frame.scope_count = 0;
+        frame.pending = false;
+    }
+}
+
+void gpu_profiler_destroy(GpuProfiler *profiler)
+{
+    if (profiler->supported)
+    {
+        for (GpuProfilerFrame& frame : profiler->frames)
+        {
+            vkDestroyQueryPool(profiler->device, frame.query_pool, nullptr);
+        }
+    }
+    profiler->passes.clear();
+    profiler->supported = false;
+}
+
+static int gpu_profiler_find_pass(GpuProfiler *profiler, const char *name)
+{
+    for (int i = 0; i < profiler->passes.Size; i++)
+    {
+        if (strcmp(profiler->passes[i].name, name) == 0)
+            return i;
+    }
+    GpuProfilerPass pass = {};
+    pass.name = name;
+    profiler->passes.push_back(pass);
+    return profiler->passes.Size - 1;
+}
+
+static void gpu_profiler_collect(GpuProfiler *profiler, GpuProfilerFrame *frame)
+{
+    if (!frame->pending || frame->scope_count == 0)
+        return;
+
+    // Pairs of (timestamp, availability)
+    uint64_t results[GPU_PROFILER_MAX_SCOPES * 2][2];
+    VkResult err = vkGetQueryPoolResults(profiler->device, frame->query_pool, 0, frame->scope_count * 2,
+                                         sizeof(results), results, sizeof(results[0]),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (err != VK_SUCCESS && err != VK_NOT_READY)
+        check_vk_result(err);
+
+    for (uint32_t i = 0; i < frame->scope_count; i++)
+    {
+        const uint64_t *begin = results[i * 2];
+        const uint64_t *end = results[i * 2 + 1];
+        if (!begin[1] || !end[1])
+            continue;
+        uint64_t ticks = (end[0] - begin[0]) & profiler->timestamp_mask;
+        float ms = (float)((double)ticks * profiler->timestamp_period / 1000000.0);
+
+        GpuProfilerPass *pass = &profiler->passes[frame->scope_passes[i]];
+        pass->last_ms = ms;
+        pass->total_ms += ms;
+        pass->sample_count++;
+        pass->history[pass->history_offset] = ms;
+        pass->history_offset = (pass->history_offset + 1) % GPU_PROFILER_HISTORY;
+    }
+    frame->pending = false;
+}
+
+// Call right after vkBeginCommandBuffer, once the fence of frame_index has been
+// waited on. Collects that frame's previous results and resets its pool.
+void gpu_profiler_begin_frame(GpuProfiler *profiler, VkCommandBuffer command_buffer, uint32_t frame_index)
+{
+    if (!profiler->supported)
+        return;
+
+    GpuProfilerFrame *frame = &profiler->frames[frame_index % GPU_PROFILER_MAX_FRAMES];
+    gpu_profiler_collect(profiler, frame);
+
+    vkCmdResetQueryPool(command_buffer, frame->query_pool, 0, GPU_PROFILER_MAX_SCOPES * 2);
+    frame->scope_count = 0;
+    frame->pending = true;
+    profiler->current = frame;
+}
+
+int gpu_profiler_begin_scope(GpuProfiler *profiler, VkCommandBuffer command_buffer, const char *name)
+{
+    GpuProfilerFrame *frame = profiler->current;
+    if (!profiler->supported || !frame || frame->scope_count == GPU_PROFILER_MAX_SCOPES)
+        return -1;
+
+    int scope = (int)frame->scope_count++;
+    frame->scope_passes[scope] = gpu_profiler_find_pass(profiler, name);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->query_pool, scope * 2);
+    return scope;
+}
+
+void gpu_profiler_end_scope(GpuProfiler *profiler, VkCommandBuffer command_buffer, int scope)
+{
+    if (scope < 0)
+        return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->current->query_pool, scope * 2 + 1);
+}
+
+struct GpuScope
+{
+    GpuProfiler *profiler;
+    VkCommandBuffer command_buffer;
+    int scope;
+
+    GpuScope(GpuProfiler *profiler, VkCommandBuffer command_buffer, const char *name)
+        : profiler(profiler), command_buffer(command_buffer)
+    {
+        scope = gpu_profiler_begin_scope(profiler, command_buffer, name);
+    }
+
+    ~GpuScope()
+    {
+        gpu_profiler_end_scope(profiler, command_buffer, scope);
+    }
+};
+
+// Latest GPU time of a pass in ms, 0 if it has not been measured yet.
+float gpu_profiler_get_ms(GpuProfiler *profiler, const char *name)
+{
+    for (GpuProfilerPass& pass : profiler->passes)
+    {
+        if (strcmp(pass.name, name) == 0)
+            return pass.last_ms;
+    }
+    return 0.0f;
+}
+
+void gpu_profiler_draw_ui(GpuProfiler *profiler)
+{
+    if (!profiler->supported)
+    {
+        ImGui::TextDisabled("GPU timestamps not supported");
+        return;
+    }
+
+    for (GpuProfilerPass& pass : profiler->passes)
+    {
+        float max_ms = 0.0f;
+        float avg_ms = 0.0f;
+        for (float ms : pass.history)
+        {
+            max_ms = ms > max_ms ? ms : max_ms;
+            avg_ms += ms;
+        }
+        avg_ms /= GPU_PROFILER_HISTORY;
+
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%0.3f ms (avg %0.3f)", pass.last_ms, avg_ms);
+        ImGui::PlotLines(pass.name, pass.history, GPU_PROFILER_HISTORY, pass.history_offset, overlay, 0.0f, max_ms * 1.2f, ImVec2(0, 40));
+    }
+}
+
+// Call once the device is idle; picks up the frames still in flight.
+void gpu_profiler_flush(GpuProfiler *profiler)
+{
+    if (!profiler->supported)
+        return;
+    for (GpuProfilerFrame& frame : profiler->frames)
+    {
+        gpu_profiler_collect(profiler, &frame);
+    }
+}
+
+// Clears the running averages, e.g. between benchmark runs. Flush first.
+void gpu_profiler_reset(GpuProfiler *profiler)
+{
+    for (GpuProfilerPass& pass : profiler->passes)
+    {
+        pass.total_ms = 0.0;
+        pass.sample_count = 0;
+    }
+}
+
+// Average GPU time of a pass since the last reset, 0 if never measured.
+double gpu_profiler_get_avg_ms(GpuProfiler *profiler, const char *name)
+{
+    for (GpuProfilerPass& pass : profiler->passes)
+    {
+        if (strcmp(pass.name, name) == 0 && pass.sample_count > 0)
+            return pass.total_ms / pass.sample_count;
+    }
+    return 0.0;
+}
+
+// Call once the device is idle.
+void gpu_profiler_print(GpuProfiler *profiler)
+{
+    if (!profiler->supported)
+        return;
+    gpu_profiler_flush(profiler);
+    for (GpuProfilerPass& pass : profiler->passes)
+    {
+        if (pass.sample_count > 0)
+            printf("[gpu profiler] %s: avg %.3f ms over %llu frames\n", pass.name, pass.total_ms / pass.sample_count, (unsigned long long)pass.sample_count);
+    }
+}
@@ -0,0 +1,177 @@
+#include <cstdio>
+#include <cstring>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+#define HEADLESS_FRAMES_IN_FLIGHT 2
+
+// Offscreen stand-in for ImGui_ImplVulkanH_Window: one color image per frame
+// in flight, no surface, no swapchain, no present.
+struct HeadlessFrame
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    GpuImage image;
+    VkImageView view; // framebuffers are made by the render graph
+};
+
+struct HeadlessTarget
+{
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    VkRenderPass render_pass;
+    VkClearValue clear_value;
+    uint32_t frame_index;
+    HeadlessFrame frames[HEADLESS_FRAMES_IN_FLIGHT];
+};
+
+static VkRenderPass create_headless_render_pass(VkDevice device, VkFormat format)
+{
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference color_attachment = {};
+    color_attachment.attachment = 0;
+    color_attachment.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment;
+
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = 1;
+    info.pAttachments = &attachment;
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+    info.dependencyCount = 1;
+    info.pDependencies = &dependency;
+
+    VkRenderPass render_pass;
+    VkResult err = vkCreateRenderPass(device, &info, nullptr, &render_pass);
+    check_vk_result(err);
+    return render_pass;
+}
+
+static void create_headless_frame(GpuAllocator *allocator, uint32_t queue_family, HeadlessTarget *target, HeadlessFrame *fd)
+{
+    VkDevice device = allocator->device;
+    VkResult err;
+
+    // Color image
+    {
+        VkImageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = target->format;
+        info.extent = { target->width, target->height, 1 };
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        gpu_create_image(allocator, &info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &fd->image);
+    }
+
+    // View
+    {
+        VkImageViewCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.image = fd->image.image;
+        info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        info.format = target->format;
+        info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        err = vkCreateImageView(device, &info, nullptr, &fd->view);
+        check_vk_result(err);
+    }
+
+    // Command pool, command buffer and fence
+    {
+        VkCommandPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        info.queueFamilyIndex = queue_family;
+        err = vkCreateCommandPool(device, &info, nullptr, &fd->command_pool);
+        check_vk_result(err);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = fd->command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(device, &alloc_info, &fd->command_buffer);
+        check_vk_result(err);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        err = vkCreateFence(device, &fence_info, nullptr, &fd->fence);
+        check_vk_result(err);
+    }
+}
+
+void create_headless_target(VkDevice device, GpuAllocator *allocator, uint32_t queue_family, HeadlessTarget *target, uint32_t width, uint32_t height)
+{
+    target->width = width;
+    target->height = height;
+    target->format = VK_FORMAT_R8G8B8A8_UNORM;
+    target->frame_index = 0;
+    target->render_pass = create_headless_render_pass(device, target->format);
+    for (HeadlessFrame& fd : target->frames)
+    {
+        create_headless_frame(allocator, queue_family, target, &fd);
+    }
+}
+
+static void destroy_headless_frame(GpuAllocator *allocator, HeadlessFrame *fd)
+{
+    VkDevice device = allocator->device;
+    vkDestroyFence(device, fd->fence, nullptr);
+    vkDestroyCommandPool(device, fd->command_pool, nullptr);
+    vkDestroyImageView(device, fd->view, nullptr);
+    gpu_destroy_image(allocator, &fd->image);
+}
+
+// Offscreen counterpart of a swapchain rebuild: new images, same render pass,
+// so pipelines stay valid. The device must be idle.
+void resize_headless_target(GpuAllocator *allocator, uint32_t queue_family, HeadlessTarget *target, uint32_t width, uint32_t height)
+{
+    for (HeadlessFrame& fd : target->frames)
+        destroy_headless_frame(allocator, &fd);
+    target->width = width;
+    target->height = height;
+    target->frame_index = 0;
+    for (HeadlessFrame& fd : target->frames)
+        create_headless_frame(allocator, queue_family, target, &fd);
+}
+
+void destroy_headless_target(GpuAllocator *allocator, HeadlessTarget *target)
+{
+    for (HeadlessFrame& fd : target->frames)
+        destroy_headless_frame(allocator, &fd);
+    vkDestroyRenderPass(allocator->device, target->render_pass, nullptr);
+    memset(target, 0, sizeof(*target));
+}
@@ -0,0 +1,155 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "helpers.hpp"
+
+// Minimal fork/join thread pool. job_system_run hands out job indices to the
+// workers and the calling thread and returns once every job has finished, so
+// callers never deal with futures or queues. Not reentrant.
+
+#define JOB_MAX_THREADS 32
+
+// thread_index is 0 for the calling thread and 1..worker_count for workers,
+// handy for per-thread scratch data.
+typedef void (*JobFn)(void *user, int job, int thread_index);
+
+struct JobSystem
+{
+    std::thread workers[JOB_MAX_THREADS];
+    int worker_count;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    uint64_t generation;
+    int active; // workers inside job_system_work
+    bool quit;
+
+    JobFn fn;
+    void *user;
+    int job_count;
+    std::atomic<int> next_job;
+    std::atomic<int> remaining;
+};
+
+static void job_system_work(JobSystem *js, JobFn fn, void *user, int job_count, int thread_index)
+{
+    for (;;)
+    {
+        int job = js->next_job.fetch_add(1);
+        if (job >= job_count)
+            break;
+        fn(user, job, thread_index);
+        if (js->remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(js->mutex);
+            js->done_cv.notify_all();
+        }
+    }
+}
+
+static void job_system_worker(JobSystem *js, int thread_index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", thread_index);
+    cpu_profiler_set_thread_name(name);
+
+    uint64_t seen = 0;
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(js->mutex);
+        js->work_cv.wait(lock, [&] { return js->quit || js->generation != seen; });
+        if (js->quit)
+            return;
+        seen = js->generation;
+        JobFn fn = js->fn;
+        void *user = js->user;
+        int job_count = js->job_count;
+        js->active++;
+        lock.unlock();
+
+        job_system_work(js, fn, user, job_count, thread_index);
+
+        lock.lock();
+        js->active--;
+        js->done_cv.notify_all();
+    }
+}
+
+// thread_count includes the calling thread; 0 picks one per hardware thread.
+void job_system_init(JobSystem *js, int thread_count)
+{
+    if (thread_count <= 0)
+        thread_count = (int)std::thread::hardware_concurrency();
+    if (thread_count <= 0)
+        thread_count = 1;
+    if (thread_count > JOB_MAX_THREADS)
+        thread_count = JOB_MAX_THREADS;
+
+    js->worker_count = thread_count - 1;
+    js->generation = 0;
+    js->active = 0;
+    js->quit = false;
+    js->fn = nullptr;
+    js->user = nullptr;
+    js->job_count = 0;
+    js->next_job = 0;
+    js->remaining = 0;
+    for (int i = 0; i < js->worker_count; i++)
+    {
+        js->workers[i] = std::thread(job_system_worker, js, i + 1);
+    }
+}
+
+void job_system_destroy(JobSystem *js)
+{
+    {
+        std::lock_guard<std::mutex> lock(js->mutex);
+        js->quit = true;
+    }
+    js->work_cv.notify_all();
+    for (int i = 0; i < js->worker_count; i++)
+    {
+        js->workers[i].join();
+    }
+    js->worker_count = 0;
+}
+
+int job_system_thread_count(JobSystem *js)
+{
+    return js->worker_count + 1;
+}
+
+// Runs fn for jobs 0..job_count-1 across all threads and waits for them.
+void job_system_run(JobSystem *js, int job_count, JobFn fn, void *user)
+{
+    if (job_count <= 0)
+        return;
+    if (js->worker_count == 0 || job_count == 1)
+    {
+        for (int i = 0; i < job_count; i++)
+            fn(user, i, 0);
+        return;
+    }
+
+    {
+        // Stragglers from the previous run must be out before the job state changes
+        std::unique_lock<std::mutex> lock(js->mutex);
+        js->done_cv.wait(lock, [&] { return js->active == 0; });
+        js->fn = fn;
+        js->user = user;
+        js->job_count = job_count;
+        js->next_job = 0;
+        js->remaining = job_count;
+        js->generation++;
+    }
+    js->work_cv.notify_all();
+
+    job_system_work(js, fn, user, job_count, 0);
+
+    std::unique_lock<std::mutex> lock(js->mutex);
+    js->done_cv.wait(lock, [&] { return js->remaining == 0; });
+}
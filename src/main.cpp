@@ -1,5 +1,7 @@
+#include <climits>
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 #include <imgui.h>
@@ -11,7 +13,31 @@
 
 #include "helpers.hpp"
 
+#include "cpu_profiler.cpp"
+#include "device_info.cpp"
+#include "shader_pack.cpp"
+#include "pipeline_cache.cpp"
+#include "pipeline_registry.cpp"
+#include "allocator.cpp"
+#include "upload.cpp"
+#include "uniforms.cpp"
 #include "tri.cpp"
+#include "batch.cpp"
+#include "bindless.cpp"
+#include "cull.cpp"
+#include "jobs.cpp"
+#include "parallel_record.cpp"
+#include "pipeline_variants.cpp"
+#include "shader_reload.cpp"
+#include "headless.cpp"
+#include "gpu_profiler.cpp"
+#include "frame_pacing.cpp"
+#include "async_compute.cpp"
+#include "particles.cpp"
+#include "geometry.cpp"
+#include "capture.cpp"
+#include "render_graph.cpp"
+#include "bench.cpp"
 
 static VkDebugReportCallbackEXT g_DebugReport = VK_NULL_HANDLE;
 
@@ -21,6 +47,16 @@ static VkPhysicalDevice g_PhysicalDevice = VK_NULL_HANDLE;
 static uint32_t g_QueueFamily = (uint32_t)-1;
 static VkDevice g_Device = VK_NULL_HANDLE;
 static VkQueue g_Queue = VK_NULL_HANDLE;
+static VkPhysicalDeviceFeatures g_EnabledFeatures;
+static bool g_PhysicalDeviceProperties2 = false;
+static uint32_t g_BindlessCapacity = 0; // 0 without descriptor indexing
+static bool g_DrawIndirectCount = false;
+static bool g_MemoryBudget = false;
+static bool g_SharedTimestamps = false; // VK_EXT_calibrated_timestamps with the device domain
+static uint32_t g_TransferQueueFamily = (uint32_t)-1;
+static VkQueue g_TransferQueue = VK_NULL_HANDLE;
+static uint32_t g_ComputeQueueFamily = (uint32_t)-1;
+static VkQueue g_ComputeQueue = VK_NULL_HANDLE;
 static VkDescriptorPool g_DescriptorPool = VK_NULL_HANDLE;
 static VkPipelineCache g_PipelineCache = VK_NULL_HANDLE;
 
@@ -28,12 +64,57 @@ static ImGui_ImplVulkanH_Window g_MainWindowData;
 static uint32_t g_MinImageCount = 2;
 static bool g_SwapChainRebuild = false;
 static bool g_VSyncEnabled = true;
+static bool g_Headless = false;
+static bool g_EnableValidation = true;
+static HeadlessTarget g_HeadlessTarget;
+static GpuProfiler g_GpuProfiler;
+static FrameQueue g_Frames;
+static FrameLimiter g_Limiter;
+static GpuAllocator g_GpuAllocator;
+static UploadContext g_Upload;
+static UniformRing g_Uniforms;
+static uint32_t g_FrameConstantsOffset = 0; // this frame's FrameConstants in g_Uniforms
 
 static ImVector<VkPhysicalDevice> g_Gpus;
+static DeviceSnapshot g_DeviceSnapshots[DEVICE_INFO_MAX_DEVICES];
+static int g_DeviceSnapshotCount = 0;
+static const char *g_DeviceInfoPath = nullptr; // --device-info
 static int g_SelectedGpuIndex;
 
-static VkPipeline g_TriPipeline = VK_NULL_HANDLE;
-static VkBuffer g_TriVertexBuffer = VK_NULL_HANDLE;
+static PipelineRegistry g_Pipelines;
+static int g_TriPipeline = -1;
+static PipelineVariantSet g_TriVariants;
+static TriVariant g_TriVariant = {};
+static int g_TriCopies = 1;
+static float g_TriSpin = 0.0f;
+static bool g_TriKeepAspect = false;
+static int g_TriStartupVariants[TRI_VARIANT_COUNT];
+static int g_TriStartupVariantCount = 0;
+static GpuBuffer g_TriVertexBuffer;
+static BatchRenderer g_Batch;
+static BindlessTable g_Bindless;
+static SpriteRenderer g_Sprites;
+static CullRenderer g_Cull;
+static JobSystem g_Jobs;
+static ParallelRecorder g_Recorder;
+static ShaderReloader g_ShaderReload;
+static AsyncCompute g_AsyncCompute;
+static ParticleSystem g_Particles;
+static GeometryGenerator g_Geometry;
+static FrameCapture g_Capture;
+static RenderGraph g_RenderGraph;
+
+static bool g_ShowDemoWindow = true;
+static bool g_ShowOptionsWindow = true;
+static int g_BenchUiRows = 0; // rows of widgets in the ImGui-heavy bench scenario
+static bool g_ShowInfoWindow = true;
+static int g_JobThreadCount = 0; // 0: one per hardware thread
+static double g_StartupMs = 0.0;
+static bool g_FirstFrameReported = false;
+static double g_SceneTime = 0.0; // FrameConstants::time, advanced by DeltaTime so captures can restore it
+static const char *g_CapturePath = nullptr; // --capture, started once the renderer is up
+static int g_CaptureFrames = 1;
+static ImVec4 g_ClearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
 
 static bool is_extension_available(const ImVector<VkExtensionProperties>& properties, const char *extension)
@@ -48,6 +129,23 @@ static bool is_extension_available(const ImVector<VkExtensionProperties>& proper
     return false;
 }
 
+static bool is_layer_available(const char *layer)
+{
+    uint32_t layer_count;
+    ImVector<VkLayerProperties> layers;
+    vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+    layers.resize(layer_count);
+    vkEnumerateInstanceLayerProperties(&layer_count, layers.Data);
+    for (const VkLayerProperties& l: layers)
+    {
+        if (strcmp(l.layerName, layer) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectType, uint64_t object, size_t location, int32_t messageCode, const char* pLayerPrefix, const char* pMessage, void* pUserData)
 {
     (void)flags; (void)object; (void)location; (void)messageCode; (void)pUserData; (void)pLayerPrefix; // Unused arguments
@@ -76,17 +174,21 @@ VkPhysicalDevice select_physical_device(VkInstance instance)
     err = vkEnumeratePhysicalDevices(instance, &gpu_count, g_Gpus.Data);
     check_vk_result(err);
 
-    int i = 0;
+    // Taken once; the Info window and the JSON export only read these
+    g_DeviceSnapshotCount = 0;
     for (VkPhysicalDevice& device : g_Gpus)
     {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(device, &properties);
-        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+        if (g_DeviceSnapshotCount < DEVICE_INFO_MAX_DEVICES)
+            device_snapshot_take(&g_DeviceSnapshots[g_DeviceSnapshotCount++], device);
+    }
+
+    for (int i = 0; i < g_DeviceSnapshotCount; i++)
+    {
+        if (g_DeviceSnapshots[i].properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
         {
             g_SelectedGpuIndex = i;
-            return device;
+            return g_Gpus[i];
         }
-        i++;
     }
 
     if (gpu_count > 0)
@@ -98,40 +200,14 @@ VkPhysicalDevice select_physical_device(VkInstance instance)
     return VK_NULL_HANDLE;
 }
 
-static const char *get_vk_device_type_str(VkPhysicalDeviceType type)
+static int render_graph_gpu_scope_begin(void *user, VkCommandBuffer command_buffer, const char *name)
 {
-    switch (type)
-    {
-        case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-            return "VK_PHYSICAL_DEVICE_TYPE_OTHER";
-        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-            return "VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU";
-        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-            return "VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU";
-        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-            return "VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU";
-        case VK_PHYSICAL_DEVICE_TYPE_CPU:
-            return "VK_PHYSICAL_DEVICE_TYPE_CPU";
-        default:
-            return "Unknown device type";
-    }
+    return gpu_profiler_begin_scope((GpuProfiler *)user, command_buffer, name);
 }
 
-static const char *get_vk_sample_count_flag_names(VkSampleCountFlags f)
+static void render_graph_gpu_scope_end(void *user, VkCommandBuffer command_buffer, int scope)
 {
-    static char buf[1024];
-    buf[0] = '\0';
-    bool added_one = false;
-    if (f & VK_SAMPLE_COUNT_1_BIT) strcat(buf, "VK_SAMPLE_COUNT_1_BIT | ");
-    if (f & VK_SAMPLE_COUNT_2_BIT) strcat(buf, "VK_SAMPLE_COUNT_2_BIT | ");
-    if (f & VK_SAMPLE_COUNT_4_BIT) strcat(buf, "VK_SAMPLE_COUNT_4_BIT | ");
-    if (f & VK_SAMPLE_COUNT_8_BIT) strcat(buf, "VK_SAMPLE_COUNT_8_BIT | ");
-    if (f & VK_SAMPLE_COUNT_16_BIT) strcat(buf, "VK_SAMPLE_COUNT_16_BIT | ");
-    if (f & VK_SAMPLE_COUNT_32_BIT) strcat(buf, "VK_SAMPLE_COUNT_32_BIT | ");
-    if (f & VK_SAMPLE_COUNT_64_BIT) strcat(buf, "VK_SAMPLE_COUNT_64_BIT | ");
-    size_t len = strlen(buf);
-    if (len > 0) buf[len - 3] = '\0';
-    return buf;
+    gpu_profiler_end_scope((GpuProfiler *)user, command_buffer, scope);
 }
 
 static void setup_vulkan(ImVector<const char *> instance_extensions)
@@ -155,6 +231,7 @@ static void setup_vulkan(ImVector<const char *> instance_extensions)
         if (is_extension_available(properties, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
         {
             instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            g_PhysicalDeviceProperties2 = true;
         }
 
         if (is_extension_available(properties, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
@@ -163,11 +240,15 @@ static void setup_vulkan(ImVector<const char *> instance_extensions)
             create_info.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
         }
 
-        // Enable validation layers
+        // Enable validation layers (optional: headless boxes often don't have them installed)
         const char *layers[] = {"VK_LAYER_KHRONOS_validation"};
-        create_info.enabledLayerCount = 1;
-        create_info.ppEnabledLayerNames = layers;
-        instance_extensions.push_back("VK_EXT_debug_report");
+        bool enable_validation = g_EnableValidation && is_layer_available(layers[0]);
+        if (enable_validation)
+        {
+            create_info.enabledLayerCount = 1;
+            create_info.ppEnabledLayerNames = layers;
+            instance_extensions.push_back("VK_EXT_debug_report");
+        }
 
         // Create vulkan instance
         create_info.enabledExtensionCount = (uint32_t)instance_extensions.Size;
@@ -176,57 +257,135 @@ static void setup_vulkan(ImVector<const char *> instance_extensions)
         check_vk_result(err);
 
         // Set up the debug report callback
-        auto f_vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkCreateDebugReportCallbackEXT");
-        IM_ASSERT(f_vkCreateDebugReportCallbackEXT != nullptr);
-        VkDebugReportCallbackCreateInfoEXT debug_report_ci = {};
-        debug_report_ci.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-        // debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
-        debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
-        debug_report_ci.pfnCallback = debug_report;
-        debug_report_ci.pUserData = nullptr;
-        err = f_vkCreateDebugReportCallbackEXT(g_Instance, &debug_report_ci, g_Allocator, &g_DebugReport);
-        check_vk_result(err);
+        if (enable_validation)
+        {
+            auto f_vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkCreateDebugReportCallbackEXT");
+            IM_ASSERT(f_vkCreateDebugReportCallbackEXT != nullptr);
+            VkDebugReportCallbackCreateInfoEXT debug_report_ci = {};
+            debug_report_ci.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
+            // debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
+            debug_report_ci.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
+            debug_report_ci.pfnCallback = debug_report;
+            debug_report_ci.pUserData = nullptr;
+            err = f_vkCreateDebugReportCallbackEXT(g_Instance, &debug_report_ci, g_Allocator, &g_DebugReport);
+            check_vk_result(err);
+        }
     }
 
     // Select GPU
     g_PhysicalDevice = select_physical_device(g_Instance);
     IM_ASSERT(g_PhysicalDevice != VK_NULL_HANDLE);
+    if (g_DeviceInfoPath && !device_info_write_json(g_DeviceSnapshots, g_DeviceSnapshotCount, g_DeviceInfoPath))
+        fatal("Can't write %s", g_DeviceInfoPath);
 
-    // Select graphics queue family
+    // Select graphics, transfer and compute queue families
     g_QueueFamily = ImGui_ImplVulkanH_SelectQueueFamilyIndex(g_PhysicalDevice);
+    g_TransferQueueFamily = find_transfer_queue_family(g_PhysicalDevice, g_QueueFamily);
+    g_ComputeQueueFamily = find_compute_queue_family(g_PhysicalDevice, g_QueueFamily);
 
-    // Create logical device (with 1 queue)
+    // Create logical device (with a graphics queue and, if available, transfer and compute queues)
     {
         ImVector<const char *> device_extensions;
-        device_extensions.push_back("VK_KHR_swapchain");
-        device_extensions.push_back("VK_KHR_portability_subset");
+        if (!g_Headless)
+        {
+            device_extensions.push_back("VK_KHR_swapchain");
+        }
 
         uint32_t properties_count;
         ImVector<VkExtensionProperties> properties;
         vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &properties_count, nullptr);
         properties.resize(properties_count);
         vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &properties_count, properties.Data);
+        if (is_extension_available(properties, VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME))
+        {
+            device_extensions.push_back(VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME);
+        }
         if (is_extension_available(properties, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
         {
             device_extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
         }
+        if (is_extension_available(properties, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME))
+        {
+            device_extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+            g_PipelineCreationFeedback = true;
+        }
+        if (is_extension_available(properties, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+        {
+            device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            g_DrawIndirectCount = true;
+        }
+        if (g_PhysicalDeviceProperties2 && is_extension_available(properties, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        {
+            device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            g_MemoryBudget = true;
+        }
+        if (is_extension_available(properties, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) &&
+            async_compute_query_shared_timestamps(g_Instance, g_PhysicalDevice))
+        {
+            device_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            g_SharedTimestamps = true;
+        }
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing = {};
+        if (g_PhysicalDeviceProperties2 && is_extension_available(properties, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+            is_extension_available(properties, VK_KHR_MAINTENANCE3_EXTENSION_NAME) &&
+            bindless_query_support(g_Instance, g_PhysicalDevice, &descriptor_indexing, &g_BindlessCapacity))
+        {
+            device_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+
+        // Only what we use, and only if supported
+        VkPhysicalDeviceFeatures supported_features;
+        vkGetPhysicalDeviceFeatures(g_PhysicalDevice, &supported_features);
+        memset(&g_EnabledFeatures, 0, sizeof(g_EnabledFeatures));
+        g_EnabledFeatures.multiDrawIndirect = supported_features.multiDrawIndirect;
+        g_EnabledFeatures.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+
+        // Compute gets its own queue when it shares a family with transfer
+        // and the family has a second one
+        uint32_t compute_queue_index = 0;
+        if (g_ComputeQueueFamily == g_TransferQueueFamily && g_ComputeQueueFamily != g_QueueFamily)
+        {
+            uint32_t family_count;
+            vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &family_count, nullptr);
+            ImVector<VkQueueFamilyProperties> families;
+            families.resize(family_count);
+            vkGetPhysicalDeviceQueueFamilyProperties(g_PhysicalDevice, &family_count, families.Data);
+            if (families[g_ComputeQueueFamily].queueCount >= 2)
+                compute_queue_index = 1;
+        }
 
-        const float queue_priority[] = { 1.0f };
-        VkDeviceQueueCreateInfo queue_info[1] = {};
-        queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_info[0].queueFamilyIndex = g_QueueFamily;
-        queue_info[0].queueCount = 1;
-        queue_info[0].pQueuePriorities = queue_priority;
+        const float queue_priority[] = { 1.0f, 1.0f };
+        VkDeviceQueueCreateInfo queue_info[3] = {};
+        uint32_t queue_info_count = 0;
+        uint32_t families[3] = { g_QueueFamily, g_TransferQueueFamily, g_ComputeQueueFamily };
+        for (uint32_t family : families)
+        {
+            bool seen = false;
+            for (uint32_t i = 0; i < queue_info_count; i++)
+                seen |= queue_info[i].queueFamilyIndex == family;
+            if (seen)
+                continue;
+            VkDeviceQueueCreateInfo *info = &queue_info[queue_info_count++];
+            info->sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            info->queueFamilyIndex = family;
+            info->queueCount = family == g_ComputeQueueFamily ? compute_queue_index + 1 : 1;
+            info->pQueuePriorities = queue_priority;
+        }
 
         VkDeviceCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
+        create_info.pNext = g_BindlessCapacity > 0 ? &descriptor_indexing : nullptr;
+        create_info.queueCreateInfoCount = queue_info_count;
         create_info.pQueueCreateInfos = queue_info;
         create_info.enabledExtensionCount = (uint32_t)device_extensions.Size;
         create_info.ppEnabledExtensionNames = device_extensions.Data;
+        create_info.pEnabledFeatures = &g_EnabledFeatures;
         err = vkCreateDevice(g_PhysicalDevice, &create_info, g_Allocator, &g_Device);
         check_vk_result(err);
         vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
+        vkGetDeviceQueue(g_Device, g_TransferQueueFamily, 0, &g_TransferQueue);
+        vkGetDeviceQueue(g_Device, g_ComputeQueueFamily, compute_queue_index, &g_ComputeQueue);
     }
 
     // Create descriptor set
@@ -242,13 +401,28 @@ static void setup_vulkan(ImVector<const char *> instance_extensions)
         pool_info.maxSets = 0;
         for (VkDescriptorPoolSize& pool_size: pool_sizes)
         {
-            pool_info.maxSets = pool_size.descriptorCount;
+            pool_info.maxSets += pool_size.descriptorCount;
         }
         pool_info.poolSizeCount = (uint32_t)IM_ARRAYSIZE(pool_sizes);
         pool_info.pPoolSizes = pool_sizes;
         err = vkCreateDescriptorPool(g_Device, &pool_info, g_Allocator, &g_DescriptorPool);
         check_vk_result(err);
     }
+
+    // Create pipeline cache (shared by our pipelines and ImGui's)
+    g_PipelineCache = load_pipeline_cache(g_Device, g_PhysicalDevice, PIPELINE_CACHE_PATH);
+    pipeline_registry_init(&g_Pipelines, g_Device, g_PipelineCache);
+
+    gpu_profiler_init(&g_GpuProfiler, g_Device, g_PhysicalDevice, g_QueueFamily);
+    gpu_allocator_init(&g_GpuAllocator, g_Instance, g_Device, g_PhysicalDevice, g_MemoryBudget);
+    upload_init(&g_Upload, &g_GpuAllocator, g_QueueFamily, g_Queue, g_TransferQueueFamily, g_TransferQueue);
+    uniform_ring_init(&g_Uniforms, &g_GpuAllocator, FRAMES_MAX_IN_FLIGHT);
+    g_TriPipelineLayout = create_pipeline_layout(g_Device, g_Uniforms.set_layout);
+    job_system_init(&g_Jobs, g_JobThreadCount);
+    parallel_recorder_init(&g_Recorder, g_Device, g_QueueFamily, &g_Jobs);
+    render_graph_init(&g_RenderGraph, g_Device);
+    render_graph_set_scope_fns(&g_RenderGraph, render_graph_gpu_scope_begin, render_graph_gpu_scope_end, &g_GpuProfiler);
+    bindless_init(&g_Bindless, g_Device, g_BindlessCapacity);
 }
 
 static void setup_vulkan_window(ImGui_ImplVulkanH_Window *wd, VkSurfaceKHR surface, int width, int height)
@@ -281,10 +455,25 @@ static void setup_vulkan_window(ImGui_ImplVulkanH_Window *wd, VkSurfaceKHR surfa
 
 static void cleanup_vulkan()
 {
+    bindless_destroy(&g_Bindless);
+    render_graph_destroy(&g_RenderGraph);
+    parallel_recorder_destroy(&g_Recorder);
+    job_system_destroy(&g_Jobs);
+    gpu_profiler_destroy(&g_GpuProfiler);
+    pipeline_registry_destroy(&g_Pipelines);
+    vkDestroyPipelineLayout(g_Device, g_TriPipelineLayout, g_Allocator);
+    uniform_ring_destroy(&g_Uniforms, &g_GpuAllocator);
+    upload_destroy(&g_Upload, &g_GpuAllocator);
+    gpu_allocator_destroy(&g_GpuAllocator);
+    save_pipeline_cache(g_Device, g_PipelineCache, PIPELINE_CACHE_PATH);
+    vkDestroyPipelineCache(g_Device, g_PipelineCache, g_Allocator);
     vkDestroyDescriptorPool(g_Device, g_DescriptorPool, g_Allocator);
 
-    auto f_vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkDestroyDebugReportCallbackEXT");
-    f_vkDestroyDebugReportCallbackEXT(g_Instance, g_DebugReport, g_Allocator);
+    if (g_DebugReport != VK_NULL_HANDLE)
+    {
+        auto f_vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(g_Instance, "vkDestroyDebugReportCallbackEXT");
+        f_vkDestroyDebugReportCallbackEXT(g_Instance, g_DebugReport, g_Allocator);
+    }
 
     vkDestroyDevice(g_Device, g_Allocator);
     vkDestroyInstance(g_Instance, g_Allocator);
@@ -295,110 +484,448 @@ static void cleanup_vulkan_window()
     ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
 }
 
-static void frame_render(ImGui_ImplVulkanH_Window *wd, ImDrawData *draw_data)
+// The selected variant, or the plain registry pipeline while it compiles.
+static void record_tri(VkCommandBuffer command_buffer)
 {
-    VkSemaphore image_acquired_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].ImageAcquiredSemaphore;
-    VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
-    VkResult err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, UINT64_MAX, image_acquired_semaphore, VK_NULL_HANDLE, &wd->FrameIndex);
-    if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
+    VkPipeline fallback = pipeline_registry_get(&g_Pipelines, g_TriPipeline);
+    VkPipeline pipeline = pipeline_variants_get(&g_TriVariants, tri_variant_index(g_TriVariant), fallback);
+    VkDeviceSize offsets = 0;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &g_TriVertexBuffer.buffer, &offsets);
+    uniform_ring_bind(&g_Uniforms, command_buffer, g_TriPipelineLayout, 0, g_FrameConstantsOffset);
+
+    // One draw per copy, laid out in a row; only the push constants change
+    for (int i = 0; i < g_TriCopies; i++)
     {
-        g_SwapChainRebuild = true;
+        TriPushConstants constants = {};
+        constants.scale = 1.0f / g_TriCopies;
+        constants.offset[0] = (2.0f * i + 1.0f) / g_TriCopies - 1.0f;
+        constants.offset[1] = 0.0f;
+        constants.rotation = 0.0f;
+        constants.spin = g_TriSpin * (i % 2 == 0 ? 1.0f : -1.0f);
+        vkCmdPushConstants(command_buffer, g_TriPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+        vkCmdDraw(command_buffer, 3, 1, 0, 0);
     }
-    if (err == VK_ERROR_OUT_OF_DATE_KHR)
-    {
+}
+
+// This frame's procedural geometry, with the plain triangle pipeline.
+static void record_geometry(VkCommandBuffer command_buffer)
+{
+    if (g_Geometry.vertex_count == 0)
         return;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_registry_get(&g_Pipelines, g_TriPipeline));
+    uniform_ring_bind(&g_Uniforms, command_buffer, g_TriPipelineLayout, 0, g_FrameConstantsOffset);
+    geometry_record_draw(&g_Geometry, command_buffer);
+}
+
+// Fills this frame's FrameConstants in the uniform ring.
+static void push_frame_constants(uint32_t frame_index, uint32_t width, uint32_t height)
+{
+    uniform_ring_begin_frame(&g_Uniforms, frame_index);
+
+    FrameConstants constants = {};
+    float sx = 1.0f, sy = 1.0f;
+    if (g_TriKeepAspect && width > 0 && height > 0)
+    {
+        if (width > height)
+            sx = (float)height / width;
+        else
+            sy = (float)width / height;
     }
-    if (err != VK_SUBOPTIMAL_KHR)
+    constants.transform[0] = sx;
+    constants.transform[5] = sy;
+    constants.transform[10] = 1.0f;
+    constants.transform[15] = 1.0f;
+    constants.resolution[0] = (float)width;
+    constants.resolution[1] = (float)height;
+    constants.time = (float)g_SceneTime;
+    constants.delta_time = ImGui::GetIO().DeltaTime;
+    g_FrameConstantsOffset = uniform_ring_push(&g_Uniforms, &constants, sizeof(constants));
+}
+
+struct SceneRecordArgs
+{
+    uint32_t frame_index;
+    ImDrawData *draw_data;
+    uint32_t visible[RECORD_MAX_SLICES]; // CULL_MODE_CPU_DRAWS survivors per slice
+};
+
+// Slice 0 takes the fixed-size draws; per-object culled draws, the part that
+// grows with the scene, are split evenly over all slices.
+static void record_scene_slice(void *user, VkCommandBuffer command_buffer, int slice, int slice_count)
+{
+    SceneRecordArgs *args = (SceneRecordArgs *)user;
+    bool split_cull = g_Cull.enabled && g_Cull.mode == CULL_MODE_CPU_DRAWS;
+    if (slice == 0)
     {
-        check_vk_result(err);
+        record_tri(command_buffer);
+
+        batch_record(&g_Batch, command_buffer, &g_Pipelines);
+
+        sprites_record(&g_Sprites, command_buffer, &g_Bindless, &g_Batch, &g_Pipelines);
+
+        if (g_Cull.enabled && !split_cull)
+            cull_record_draw(&g_Cull, command_buffer, args->frame_index, &g_Batch, &g_Pipelines);
+
+        async_compute_record_draw(&g_AsyncCompute, command_buffer, &g_Batch, &g_Pipelines);
+
+        particles_record_draw(&g_Particles, command_buffer, &g_Pipelines);
+
+        record_geometry(command_buffer);
+    }
+    if (split_cull)
+    {
+        uint64_t object_count = (uint64_t)g_Cull.object_count;
+        uint32_t first = (uint32_t)(object_count * slice / slice_count);
+        uint32_t end = (uint32_t)(object_count * (slice + 1) / slice_count);
+        args->visible[slice] = cull_record_draw_range(&g_Cull, command_buffer, first, end - first, &g_Batch, &g_Pipelines);
+    }
+}
+
+static void record_imgui_slice(void *user, VkCommandBuffer command_buffer, int slice, int slice_count)
+{
+    SceneRecordArgs *args = (SceneRecordArgs *)user;
+    ImGui_ImplVulkan_RenderDrawData(args->draw_data, command_buffer);
+}
+
+// The scene, recorded straight into the primary.
+static void record_frame_inline(uint32_t frame_index, VkCommandBuffer command_buffer)
+{
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Triangle");
+        record_tri(command_buffer);
     }
 
-    ImGui_ImplVulkanH_Frame *fd = &wd->Frames[wd->FrameIndex];
     {
-        err = vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX); // Wait indefinitely instead of periodically checking
-        check_vk_result(err);
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Batch");
+        batch_record(&g_Batch, command_buffer, &g_Pipelines);
+    }
 
-        err = vkResetFences(g_Device, 1, &fd->Fence);
-        check_vk_result(err);
+    if (g_Sprites.enabled)
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Sprites");
+        sprites_record(&g_Sprites, command_buffer, &g_Bindless, &g_Batch, &g_Pipelines);
+    }
+
+    if (g_Cull.enabled)
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Cull draw");
+        cull_record_draw(&g_Cull, command_buffer, frame_index, &g_Batch, &g_Pipelines);
+    }
+
+    if (g_AsyncCompute.enabled)
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Async draw");
+        async_compute_record_draw(&g_AsyncCompute, command_buffer, &g_Batch, &g_Pipelines);
+    }
+
+    if (particles_active(&g_Particles))
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Particles draw");
+        particles_record_draw(&g_Particles, command_buffer, &g_Pipelines);
+    }
+
+    if (g_Geometry.vertex_count > 0)
+    {
+        GpuScope scope(&g_GpuProfiler, command_buffer, "Geometry");
+        record_geometry(command_buffer);
+    }
+}
+
+static void record_cull_pass(const RenderGraphContext *ctx, void *user)
+{
+    GpuScope scope(&g_GpuProfiler, ctx->command_buffer, "Cull");
+    cull_record_compute(&g_Cull, ctx->command_buffer);
+}
+
+static void record_particles_pass(const RenderGraphContext *ctx, void *user)
+{
+    GpuScope scope(&g_GpuProfiler, ctx->command_buffer, "Particles");
+    particles_record_compute(&g_Particles, ctx->command_buffer);
+}
+
+// Scene and ImGui together, recorded into secondaries on the job threads.
+static void record_parallel_pass(const RenderGraphContext *ctx, void *user)
+{
+    // Timed as "Scene" by the render graph, outside the render pass
+    SceneRecordArgs *args = (SceneRecordArgs *)user;
+    double start = get_time_ms();
+    parallel_record(&g_Recorder, ctx->command_buffer, args->frame_index, ctx->render_pass, ctx->framebuffer, ctx->width, ctx->height,
+                    record_scene_slice, args, record_imgui_slice, args);
+    if (g_Cull.enabled && g_Cull.mode == CULL_MODE_CPU_DRAWS)
+    {
+        g_Cull.stats.visible = 0;
+        for (int i = 0; i < g_Recorder.slice_count; i++)
+            g_Cull.stats.visible += args->visible[i];
+        g_Cull.stats.cpu_ms += get_time_ms() - start;
+    }
+}
+
+static void record_scene_pass(const RenderGraphContext *ctx, void *user)
+{
+    SceneRecordArgs *args = (SceneRecordArgs *)user;
+    VkViewport viewport = { 0.0f, 0.0f, (float)ctx->width, (float)ctx->height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { ctx->width, ctx->height } };
+    vkCmdSetViewport(ctx->command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(ctx->command_buffer, 0, 1, &scissor);
+    record_frame_inline(args->frame_index, ctx->command_buffer);
+}
+
+static void record_imgui_pass(const RenderGraphContext *ctx, void *user)
+{
+    SceneRecordArgs *args = (SceneRecordArgs *)user;
+    GpuScope scope(&g_GpuProfiler, ctx->command_buffer, "ImGui");
+    ImGui_ImplVulkan_RenderDrawData(args->draw_data, ctx->command_buffer);
+}
+
+// Declares the frame's passes to the render graph, which culls what isn't
+// needed, merges the rest into as few render passes as it can and places the
+// barriers. Shared by the swapchain and headless paths, so it knows nothing
+// about surfaces or presentation: the target image is left in final_layout.
+static void record_frame(uint32_t frame_index, VkCommandPool command_pool, VkCommandBuffer command_buffer, VkImage image, VkImageView view, VkFormat format,
+                         VkImageLayout final_layout, uint32_t width, uint32_t height, const VkClearValue *clear_value, ImDrawData *draw_data)
+{
+    CPU_SCOPE("record");
+    // Compute for the next frame goes out first so it overlaps this one
+    async_compute_begin_frame(&g_AsyncCompute, ImGui::GetIO().DeltaTime);
+    g_SceneTime += ImGui::GetIO().DeltaTime;
+    push_frame_constants(frame_index, width, height);
+    cull_update(&g_Cull, frame_index, ImGui::GetIO().DeltaTime);
+    particles_update(&g_Particles, &g_GpuAllocator, ImGui::GetIO().DeltaTime);
+    geometry_update(&g_Geometry, &g_GpuAllocator, &g_Jobs, frame_index, ImGui::GetIO().DeltaTime);
+
+    SceneRecordArgs args = {};
+    args.frame_index = frame_index;
+    args.draw_data = draw_data;
+
+    RenderGraph *graph = &g_RenderGraph;
+    render_graph_begin(graph);
+    int target = render_graph_import_image(graph, "target", image, view, format, width, height,
+                                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, final_layout, true);
+    int commands = -1, counts = -1;
+    if (g_Cull.enabled)
+    {
+        // Earlier frames may still be drawing from them
+        commands = render_graph_import_buffer(graph, "cull_commands", g_Cull.commands.buffer,
+                                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        counts = render_graph_import_buffer(graph, "cull_counts", g_Cull.counts.buffer,
+                                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        int cull = render_graph_add_pass(graph, "Cull", RENDER_GRAPH_COMPUTE, 0, record_cull_pass, nullptr);
+        for (int buffer : { commands, counts })
+            render_graph_write_buffer(graph, cull, buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    int particle_streams[PARTICLE_STREAM_COUNT];
+    if (particles_active(&g_Particles))
+    {
+        // Last frame's draw reads them, this frame's simulation updates them in place
+        int particles = render_graph_add_pass(graph, "Particles", RENDER_GRAPH_COMPUTE, 0, record_particles_pass, nullptr);
+        for (int i = 0; i < PARTICLE_STREAM_COUNT; i++)
+        {
+            particle_streams[i] = render_graph_import_buffer(graph, g_ParticleStreamNames[i], particles_get_stream(&g_Particles, (ParticleStream)i),
+                                                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+            render_graph_write_buffer(graph, particles, particle_streams[i], VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+    }
+
+    int scene = render_graph_add_pass(graph, "Scene", RENDER_GRAPH_GRAPHICS, g_Recorder.enabled ? RENDER_GRAPH_SECONDARY : 0,
+                                      g_Recorder.enabled ? record_parallel_pass : record_scene_pass, &args);
+    render_graph_color_attachment(graph, scene, target, VK_ATTACHMENT_LOAD_OP_CLEAR, clear_value);
+    // Only the GPU mode draws from the cull buffers; in the others the cull pass is culled
+    if (cull_uses_compute(&g_Cull))
+    {
+        for (int buffer : { commands, counts })
+            render_graph_read_buffer(graph, scene, buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+    if (particles_active(&g_Particles))
+    {
+        for (int buffer : particle_streams)
+            render_graph_read_buffer(graph, scene, buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    if (!g_Recorder.enabled)
+    {
+        int imgui = render_graph_add_pass(graph, "ImGui", RENDER_GRAPH_GRAPHICS, 0, record_imgui_pass, &args);
+        render_graph_color_attachment(graph, imgui, target, VK_ATTACHMENT_LOAD_OP_LOAD, nullptr);
     }
+
     {
-        err = vkResetCommandPool(g_Device, fd->CommandPool, 0);
+        VkResult err = vkResetCommandPool(g_Device, command_pool, 0);
         check_vk_result(err);
         VkCommandBufferBeginInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
+        err = vkBeginCommandBuffer(command_buffer, &info);
         check_vk_result(err);
     }
+    gpu_profiler_begin_frame(&g_GpuProfiler, command_buffer, frame_index);
+    int frame_scope = gpu_profiler_begin_scope(&g_GpuProfiler, command_buffer, "Frame");
+    async_compute_record_acquire(&g_AsyncCompute, command_buffer);
+    gpu_allocator_defrag(&g_GpuAllocator, command_buffer);
+    render_graph_execute(graph, command_buffer);
+    async_compute_record_release(&g_AsyncCompute, command_buffer);
+    gpu_profiler_end_scope(&g_GpuProfiler, command_buffer, frame_scope);
+
+    VkResult err = vkEndCommandBuffer(command_buffer);
+    check_vk_result(err);
+}
+
+// What record_frame and the per-frame begin calls read besides the draw data.
+static void save_scene_state(CaptureSceneState *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->scene_time = g_SceneTime;
+    state->cull_time = g_Cull.time;
+    state->async_time = g_AsyncCompute.time;
+    state->particles_time = g_Particles.time;
+    state->geometry_time = g_Geometry.time;
+    state->delta_time = ImGui::GetIO().DeltaTime;
+    memcpy(state->clear_color, &g_ClearColor, sizeof(state->clear_color));
+
+    state->tri_copies = g_TriCopies;
+    state->tri_spin = g_TriSpin;
+    state->tri_keep_aspect = g_TriKeepAspect;
+    state->tri_blend = g_TriVariant.blend;
+    state->tri_topology = g_TriVariant.topology;
+    state->tri_color = g_TriVariant.color;
+    state->batch_instance_count = g_Batch.instance_count;
+    for (int i = 0; i < BATCH_SHAPE_COUNT; i++)
+        state->batch_shape_mask |= (uint32_t)g_Batch.shape_enabled[i] << i;
+    state->sprites_enabled = g_Sprites.enabled;
+    state->sprites_stream = g_Sprites.stream;
+    state->sprites_instance_count = g_Sprites.instance_count;
+    state->sprites_sampler = g_Sprites.sampler_index;
+    state->sprites_seed = g_Sprites.seed;
+    state->sprites_next_stream = g_Sprites.next_stream;
+    state->cull_enabled = g_Cull.enabled;
+    state->cull_mode = g_Cull.mode;
+    state->cull_object_count = g_Cull.object_count;
+    state->cull_view_half_extent = g_Cull.view_half_extent;
+    state->cull_animate_view = g_Cull.animate_view;
+    state->async_enabled = g_AsyncCompute.enabled;
+    state->async_instance_count = g_AsyncCompute.instance_count;
+    state->async_iterations = g_AsyncCompute.iterations;
+    state->particles_enabled = g_Particles.enabled;
+    state->particles_count = g_Particles.count;
+    state->geometry_enabled = g_Geometry.enabled;
+    state->geometry_shape = g_Geometry.shape;
+    state->geometry_kernel = g_Geometry.kernel;
+    state->geometry_lines = g_Geometry.lines;
+    state->geometry_segments_per_line = g_Geometry.segments_per_line;
+    state->recorder_enabled = g_Recorder.enabled;
+    state->recorder_slice_count = g_Recorder.slice_count;
+}
+
+// Called by both render paths before anything of the frame is touched.
+static void capture_frame(ImDrawData *draw_data)
+{
+    if (!capture_active(&g_Capture))
+        return;
+    CPU_SCOPE("capture");
+    CaptureSceneState state;
+    save_scene_state(&state);
+    capture_write_frame(&g_Capture, &state, draw_data);
+}
+
+// Startup cost as the user sees it: process start to the first frame handed
+// to the GPU.
+static void report_first_frame()
+{
+    if (g_FirstFrameReported)
+        return;
+    g_FirstFrameReported = true;
+    printf("[startup] first frame after %.1f ms, %d threads\n", get_time_ms() - g_StartupMs, job_system_thread_count(&g_Jobs));
+}
+
+// Waits for a free frame slot and swapchain image. Returns false if the
+// swapchain is out of date and nothing was acquired.
+static bool frame_acquire(ImGui_ImplVulkanH_Window *wd)
+{
+    VkResult err = frame_queue_acquire(&g_Frames, wd->Swapchain);
+    if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
     {
-        VkRenderPassBeginInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        info.renderPass = wd->RenderPass;
-        info.framebuffer = fd->Framebuffer;
-        info.renderArea.extent.width = wd->Width;
-        info.renderArea.extent.height = wd->Height;
-        info.clearValueCount = 1;
-        info.pClearValues = &wd->ClearValue;
-        vkCmdBeginRenderPass(fd->CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+        g_SwapChainRebuild = true;
     }
+    return err != VK_ERROR_OUT_OF_DATE_KHR;
+}
 
-    VkDeviceSize offsets = 0;
-    vkCmdBindPipeline(fd->CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_TriPipeline);
-    vkCmdBindVertexBuffers(fd->CommandBuffer, 0, 1, &g_TriVertexBuffer, &offsets);
-    vkCmdDraw(fd->CommandBuffer, 3, 1, 0, 0);
+static void frame_render(ImGui_ImplVulkanH_Window *wd, ImDrawData *draw_data)
+{
+    capture_frame(draw_data);
+    FrameInFlight *frame = frame_queue_current(&g_Frames);
+    pipeline_registry_begin_frame(&g_Pipelines, FRAMES_MAX_IN_FLIGHT);
+    gpu_allocator_begin_frame(&g_GpuAllocator, FRAMES_MAX_IN_FLIGHT);
+    shader_reload_update(&g_ShaderReload, &g_Pipelines);
+    sprites_begin_frame(&g_Sprites, &g_GpuAllocator, &g_Upload, &g_Bindless, FRAMES_MAX_IN_FLIGHT);
+    bindless_begin_frame(&g_Bindless, FRAMES_MAX_IN_FLIGHT);
+    ImGui_ImplVulkanH_Frame *fd = &wd->Frames[g_Frames.image_index];
+    record_frame(g_Frames.frame_index, frame->command_pool, frame->command_buffer, fd->Backbuffer, fd->BackbufferView, wd->SurfaceFormat.format,
+                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, wd->Width, wd->Height, &wd->ClearValue, draw_data);
+
+    // Pending uploads are submitted ahead of the frame so it sees them
+    upload_flush(&g_Upload);
+    SubmitSync sync = {};
+    async_compute_graphics_sync(&g_AsyncCompute, &sync);
+    frame_queue_submit(&g_Frames, g_Queue, &sync);
+}
+
+// Offscreen counterpart of frame_render: no acquire, no swapchain semaphores, no present.
+static void headless_frame_render(HeadlessTarget *target, ImDrawData *draw_data)
+{
+    HeadlessFrame *fd = &target->frames[target->frame_index];
+    {
+        CPU_SCOPE("fence_wait");
+        VkResult err = vkWaitForFences(g_Device, 1, &fd->fence, VK_TRUE, UINT64_MAX);
+        check_vk_result(err);
 
-    // Record dear imgui primitives into command buffer
-    ImGui_ImplVulkan_RenderDrawData(draw_data, fd->CommandBuffer);
+        err = vkResetFences(g_Device, 1, &fd->fence);
+        check_vk_result(err);
+    }
 
-    vkCmdEndRenderPass(fd->CommandBuffer);
+    capture_frame(draw_data);
+    gpu_allocator_begin_frame(&g_GpuAllocator, HEADLESS_FRAMES_IN_FLIGHT);
+    sprites_begin_frame(&g_Sprites, &g_GpuAllocator, &g_Upload, &g_Bindless, HEADLESS_FRAMES_IN_FLIGHT);
+    bindless_begin_frame(&g_Bindless, HEADLESS_FRAMES_IN_FLIGHT);
+    record_frame(target->frame_index, fd->command_pool, fd->command_buffer, fd->image.image, fd->view, target->format,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target->width, target->height, &target->clear_value, draw_data);
+
+    upload_flush(&g_Upload);
     {
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        SubmitSync sync = {};
+        async_compute_graphics_sync(&g_AsyncCompute, &sync);
         VkSubmitInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        info.waitSemaphoreCount = 1;
-        info.pWaitSemaphores = &image_acquired_semaphore;
-        info.pWaitDstStageMask = &wait_stage;
+        info.waitSemaphoreCount = sync.wait_count;
+        info.pWaitSemaphores = sync.wait_semaphores;
+        info.pWaitDstStageMask = sync.wait_stages;
         info.commandBufferCount = 1;
-        info.pCommandBuffers = &fd->CommandBuffer;
-        info.signalSemaphoreCount = 1;
-        info.pSignalSemaphores = &render_complete_semaphore;
+        info.pCommandBuffers = &fd->command_buffer;
+        info.signalSemaphoreCount = sync.signal_count;
+        info.pSignalSemaphores = sync.signal_semaphores;
 
-        err = vkEndCommandBuffer(fd->CommandBuffer);
-        check_vk_result(err);
-        err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
+        CPU_SCOPE("queue_submit");
+        VkResult err = vkQueueSubmit(g_Queue, 1, &info, fd->fence);
         check_vk_result(err);
     }
+    target->frame_index = (target->frame_index + 1) % HEADLESS_FRAMES_IN_FLIGHT;
+    report_first_frame();
 }
 
+// Always presents once an image was acquired and submitted, even if a
+// rebuild is pending, so its semaphores are consumed.
 static void frame_present(ImGui_ImplVulkanH_Window *wd)
 {
-    if (g_SwapChainRebuild)
-    {
-        return;
-    }
-
-    VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
-    VkPresentInfoKHR info = {};
-    info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    info.waitSemaphoreCount = 1;
-    info.pWaitSemaphores = &render_complete_semaphore;
-    info.swapchainCount = 1;
-    info.pSwapchains = &wd->Swapchain;
-    info.pImageIndices = &wd->FrameIndex;
-    VkResult err = vkQueuePresentKHR(g_Queue, &info);
+    VkResult err = frame_queue_present(&g_Frames, g_Queue, wd->Swapchain);
     if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
     {
         g_SwapChainRebuild = true;
     }
-    if (err == VK_ERROR_OUT_OF_DATE_KHR)
-    {
-        return;
-    }
-    if (err != VK_SUBOPTIMAL_KHR)
+    else
     {
         check_vk_result(err);
     }
-    wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->SemaphoreCount; // Now we can use the next set of semaphores
+    frame_limiter_presented(&g_Limiter);
+    report_first_frame();
 }
 
 static void rebuild_swapchain_if_needed(ImGui_ImplVulkanH_Window *wd, GLFWwindow *window)
@@ -411,220 +938,75 @@ static void rebuild_swapchain_if_needed(ImGui_ImplVulkanH_Window *wd, GLFWwindow
 
         ImGui_ImplVulkan_SetMinImageCount(g_MinImageCount);
         ImGui_ImplVulkanH_CreateOrResizeWindow(g_Instance, g_PhysicalDevice, g_Device, &g_MainWindowData, g_QueueFamily, g_Allocator, fb_width, fb_height, g_MinImageCount);
-        g_MainWindowData.FrameIndex = 0;
+        frame_queue_set_images(&g_Frames, wd->ImageCount);
+        render_graph_reset_framebuffers(&g_RenderGraph);
         g_SwapChainRebuild = false;
+
+        // The render pass was recreated; pipelines are rebuilt only if its format changed
+        PipelineKey key = { wd->SurfaceFormat.format, VK_SAMPLE_COUNT_1_BIT };
+        pipeline_registry_update(&g_Pipelines, wd->RenderPass, key);
+        pipeline_variants_build(&g_TriVariants, key, g_TriStartupVariants, g_TriStartupVariantCount);
     }
 }
 
-void window_device_info(VkPhysicalDevice device, int device_index)
+void window_info(bool *show_info_window)
 {
-    const char *arrow = " <-";
-    const char *no_arrow = "";
-
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(device, &properties);
-
-    if (ImGui::TreeNode(properties.deviceName, "%d: %s%s", device_index, properties.deviceName, device_index == g_SelectedGpuIndex ? arrow : no_arrow))
+    if (*show_info_window)
     {
-        if (ImGui::TreeNode("Properties"))
-        {
-            ImGui::BulletText("API version: %u", properties.apiVersion);
-            ImGui::BulletText("Driver version: %u", properties.driverVersion);
-            ImGui::BulletText("Vendor ID: %u", properties.vendorID);
-            ImGui::BulletText("Device ID: %u", properties.deviceID);
+        ImGui::Begin("Info", show_info_window);
 
-            const char * device_type = get_vk_device_type_str(properties.deviceType);
-            ImGui::BulletText("Type: %s", device_type);
+        if (ImGui::TreeNode("Available GPUs"))
+        {
+            for (int i = 0; i < g_DeviceSnapshotCount; i++)
+                device_info_draw_ui(&g_DeviceSnapshots[i], i, i == g_SelectedGpuIndex);
+            if (ImGui::Button("Export JSON"))
+                device_info_write_json(g_DeviceSnapshots, g_DeviceSnapshotCount, DEVICE_INFO_JSON_PATH);
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s", DEVICE_INFO_JSON_PATH);
+            ImGui::TreePop();
+        }
 
-            if (ImGui::TreeNode("Limits"))
+        if (ImGui::TreeNode("Pipeline cache"))
+        {
+            ImGui::BulletText("Start: %s", g_PipelineCacheWarm ? "warm" : "cold");
+            ImGui::BulletText("Creation feedback: %s", g_PipelineCreationFeedback ? "true" : "false");
+            std::lock_guard<std::mutex> lock(g_PipelineCreateStatsMutex);
+            for (const PipelineCreateStat& stat : g_PipelineCreateStats)
             {
-                ImGui::BulletText("maxImageDimension1D = %u", properties.limits.maxImageDimension1D);
-                ImGui::BulletText("maxImageDimension2D = %u", properties.limits.maxImageDimension2D);
-                ImGui::BulletText("maxImageDimension3D = %u", properties.limits.maxImageDimension3D);
-                ImGui::BulletText("maxImageDimensionCube = %u", properties.limits.maxImageDimensionCube);
-                ImGui::BulletText("maxImageArrayLayers = %u", properties.limits.maxImageArrayLayers);
-                ImGui::BulletText("maxTexelBufferElements = %u", properties.limits.maxTexelBufferElements);
-                ImGui::BulletText("maxUniformBufferRange = %u", properties.limits.maxUniformBufferRange);
-                ImGui::BulletText("maxStorageBufferRange = %u", properties.limits.maxStorageBufferRange);
-                ImGui::BulletText("maxPushConstantsSize = %u", properties.limits.maxPushConstantsSize);
-                ImGui::BulletText("maxMemoryAllocationCount = %u", properties.limits.maxMemoryAllocationCount);
-                ImGui::BulletText("maxSamplerAllocationCount = %u", properties.limits.maxSamplerAllocationCount);
-                ImGui::BulletText("bufferImageGranularity = %llu", properties.limits.bufferImageGranularity);
-                ImGui::BulletText("sparseAddressSpaceSize = %llu", properties.limits.sparseAddressSpaceSize);
-                ImGui::BulletText("maxBoundDescriptorSets = %u", properties.limits.maxBoundDescriptorSets);
-                ImGui::BulletText("maxPerStageDescriptorSamplers = %u", properties.limits.maxPerStageDescriptorSamplers);
-                ImGui::BulletText("maxPerStageDescriptorUniformBuffers = %u", properties.limits.maxPerStageDescriptorUniformBuffers);
-                ImGui::BulletText("maxPerStageDescriptorStorageBuffers = %u", properties.limits.maxPerStageDescriptorStorageBuffers);
-                ImGui::BulletText("maxPerStageDescriptorSampledImages = %u", properties.limits.maxPerStageDescriptorSampledImages);
-                ImGui::BulletText("maxPerStageDescriptorStorageImages = %u", properties.limits.maxPerStageDescriptorStorageImages);
-                ImGui::BulletText("maxPerStageDescriptorInputAttachments = %u", properties.limits.maxPerStageDescriptorInputAttachments);
-                ImGui::BulletText("maxPerStageResources = %u", properties.limits.maxPerStageResources);
-                ImGui::BulletText("maxDescriptorSetSamplers = %u", properties.limits.maxDescriptorSetSamplers);
-                ImGui::BulletText("maxDescriptorSetUniformBuffers = %u", properties.limits.maxDescriptorSetUniformBuffers);
-                ImGui::BulletText("maxDescriptorSetUniformBuffersDynamic = %u", properties.limits.maxDescriptorSetUniformBuffersDynamic);
-                ImGui::BulletText("maxDescriptorSetStorageBuffers = %u", properties.limits.maxDescriptorSetStorageBuffers);
-                ImGui::BulletText("maxDescriptorSetStorageBuffersDynamic = %u", properties.limits.maxDescriptorSetStorageBuffersDynamic);
-                ImGui::BulletText("maxDescriptorSetSampledImages = %u", properties.limits.maxDescriptorSetSampledImages);
-                ImGui::BulletText("maxDescriptorSetStorageImages = %u", properties.limits.maxDescriptorSetStorageImages);
-                ImGui::BulletText("maxDescriptorSetInputAttachments = %u", properties.limits.maxDescriptorSetInputAttachments);
-                ImGui::BulletText("maxVertexInputAttributes = %u", properties.limits.maxVertexInputAttributes);
-                ImGui::BulletText("maxVertexInputBindings = %u", properties.limits.maxVertexInputBindings);
-                ImGui::BulletText("maxVertexInputAttributeOffset = %u", properties.limits.maxVertexInputAttributeOffset);
-                ImGui::BulletText("maxVertexInputBindingStride = %u", properties.limits.maxVertexInputBindingStride);
-                ImGui::BulletText("maxVertexOutputComponents = %u", properties.limits.maxVertexOutputComponents);
-                ImGui::BulletText("maxTessellationGenerationLevel = %u", properties.limits.maxTessellationGenerationLevel);
-                ImGui::BulletText("maxTessellationPatchSize = %u", properties.limits.maxTessellationPatchSize);
-                ImGui::BulletText("maxTessellationControlPerVertexInputComponents = %u", properties.limits.maxTessellationControlPerVertexInputComponents);
-                ImGui::BulletText("maxTessellationControlPerVertexOutputComponents = %u", properties.limits.maxTessellationControlPerVertexOutputComponents);
-                ImGui::BulletText("maxTessellationControlPerPatchOutputComponents = %u", properties.limits.maxTessellationControlPerPatchOutputComponents);
-                ImGui::BulletText("maxTessellationControlTotalOutputComponents = %u", properties.limits.maxTessellationControlTotalOutputComponents);
-                ImGui::BulletText("maxTessellationEvaluationInputComponents = %u", properties.limits.maxTessellationEvaluationInputComponents);
-                ImGui::BulletText("maxTessellationEvaluationOutputComponents = %u", properties.limits.maxTessellationEvaluationOutputComponents);
-                ImGui::BulletText("maxGeometryShaderInvocations = %u", properties.limits.maxGeometryShaderInvocations);
-                ImGui::BulletText("maxGeometryInputComponents = %u", properties.limits.maxGeometryInputComponents);
-                ImGui::BulletText("maxGeometryOutputComponents = %u", properties.limits.maxGeometryOutputComponents);
-                ImGui::BulletText("maxGeometryOutputVertices = %u", properties.limits.maxGeometryOutputVertices);
-                ImGui::BulletText("maxGeometryTotalOutputComponents = %u", properties.limits.maxGeometryTotalOutputComponents);
-                ImGui::BulletText("maxFragmentInputComponents = %u", properties.limits.maxFragmentInputComponents);
-                ImGui::BulletText("maxFragmentOutputAttachments = %u", properties.limits.maxFragmentOutputAttachments);
-                ImGui::BulletText("maxFragmentDualSrcAttachments = %u", properties.limits.maxFragmentDualSrcAttachments);
-                ImGui::BulletText("maxFragmentCombinedOutputResources = %u", properties.limits.maxFragmentCombinedOutputResources);
-                ImGui::BulletText("maxComputeSharedMemorySize = %u", properties.limits.maxComputeSharedMemorySize);
-                ImGui::BulletText("maxComputeWorkGroupCount = [%u, %u, %u]", properties.limits.maxComputeWorkGroupCount[0], properties.limits.maxComputeWorkGroupCount[1], properties.limits.maxComputeWorkGroupCount[2]);
-                ImGui::BulletText("maxComputeWorkGroupInvocations = %u", properties.limits.maxComputeWorkGroupInvocations);
-                ImGui::BulletText("maxComputeWorkGroupSize = [%u, %u, %u]", properties.limits.maxComputeWorkGroupSize[0], properties.limits.maxComputeWorkGroupSize[1], properties.limits.maxComputeWorkGroupSize[2]);
-                ImGui::BulletText("subPixelPrecisionBits = %u", properties.limits.subPixelPrecisionBits);
-                ImGui::BulletText("subTexelPrecisionBits = %u", properties.limits.subTexelPrecisionBits);
-                ImGui::BulletText("mipmapPrecisionBits = %u", properties.limits.mipmapPrecisionBits);
-                ImGui::BulletText("maxDrawIndexedIndexValue = %u", properties.limits.maxDrawIndexedIndexValue);
-                ImGui::BulletText("maxDrawIndirectCount = %u", properties.limits.maxDrawIndirectCount);
-                ImGui::BulletText("maxSamplerLodBias = %0.3f", properties.limits.maxSamplerLodBias);
-                ImGui::BulletText("maxSamplerAnisotropy = %0.3f", properties.limits.maxSamplerAnisotropy);
-                ImGui::BulletText("maxViewports = %u", properties.limits.maxViewports);
-                ImGui::BulletText("maxViewportDimensions = [%u, %u]", properties.limits.maxViewportDimensions[0], properties.limits.maxViewportDimensions[1]);
-                ImGui::BulletText("viewportBoundsRange = [%0.3f, %0.3f]", properties.limits.viewportBoundsRange[0], properties.limits.viewportBoundsRange[1]);
-                ImGui::BulletText("viewportSubPixelBits = %u", properties.limits.viewportSubPixelBits);
-                ImGui::BulletText("minTexelBufferOffsetAlignment = %llu", properties.limits.minTexelBufferOffsetAlignment);
-                ImGui::BulletText("minUniformBufferOffsetAlignment = %llu", properties.limits.minUniformBufferOffsetAlignment);
-                ImGui::BulletText("minStorageBufferOffsetAlignment = %llu", properties.limits.minStorageBufferOffsetAlignment);
-                ImGui::BulletText("minTexelOffset = %d", properties.limits.minTexelOffset);
-                ImGui::BulletText("maxTexelOffset = %u", properties.limits.maxTexelOffset);
-                ImGui::BulletText("minTexelGatherOffset = %d", properties.limits.minTexelGatherOffset);
-                ImGui::BulletText("maxTexelGatherOffset = %u", properties.limits.maxTexelGatherOffset);
-                ImGui::BulletText("minInterpolationOffset = %0.3f", properties.limits.minInterpolationOffset);
-                ImGui::BulletText("maxInterpolationOffset = %0.3f", properties.limits.maxInterpolationOffset);
-                ImGui::BulletText("subPixelInterpolationOffsetBits = %u", properties.limits.subPixelInterpolationOffsetBits);
-                ImGui::BulletText("maxFramebufferWidth = %u", properties.limits.maxFramebufferWidth);
-                ImGui::BulletText("maxFramebufferHeight = %u", properties.limits.maxFramebufferHeight);
-                ImGui::BulletText("maxFramebufferLayers = %u", properties.limits.maxFramebufferLayers);
-                ImGui::BulletText("framebufferColorSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.framebufferColorSampleCounts));
-                ImGui::BulletText("framebufferDepthSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.framebufferDepthSampleCounts));
-                ImGui::BulletText("framebufferStencilSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.framebufferStencilSampleCounts));
-                ImGui::BulletText("framebufferNoAttachmentsSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.framebufferNoAttachmentsSampleCounts));
-                ImGui::BulletText("maxColorAttachments = %u", properties.limits.maxColorAttachments);
-                ImGui::BulletText("sampledImageColorSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.sampledImageColorSampleCounts));
-                ImGui::BulletText("sampledImageIntegerSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.sampledImageIntegerSampleCounts));
-                ImGui::BulletText("sampledImageDepthSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.sampledImageDepthSampleCounts));
-                ImGui::BulletText("sampledImageStencilSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.sampledImageStencilSampleCounts));
-                ImGui::BulletText("storageImageSampleCounts = %s", get_vk_sample_count_flag_names(properties.limits.storageImageSampleCounts));
-                ImGui::BulletText("maxSampleMaskWords = %u", properties.limits.maxSampleMaskWords);
-                ImGui::BulletText("timestampComputeAndGraphics = %s", properties.limits.timestampComputeAndGraphics ? "true" : "false");
-                ImGui::BulletText("timestampPeriod = %0.3f", properties.limits.timestampPeriod);
-                ImGui::BulletText("maxClipDistances = %u", properties.limits.maxClipDistances);
-                ImGui::BulletText("maxCullDistances = %u", properties.limits.maxCullDistances);
-                ImGui::BulletText("maxCombinedClipAndCullDistances = %u", properties.limits.maxCombinedClipAndCullDistances);
-                ImGui::BulletText("discreteQueuePriorities = %u", properties.limits.discreteQueuePriorities);
-                ImGui::BulletText("pointSizeRange = [%0.3f, %0.3f]", properties.limits.pointSizeRange[0], properties.limits.pointSizeRange[1]);
-                ImGui::BulletText("lineWidthRange = [%0.3f, %0.3f]", properties.limits.lineWidthRange[0], properties.limits.lineWidthRange[1]);
-                ImGui::BulletText("pointSizeGranularity = %0.3f", properties.limits.pointSizeGranularity);
-                ImGui::BulletText("lineWidthGranularity = %0.3f", properties.limits.lineWidthGranularity);
-                ImGui::BulletText("strictLines = %s", properties.limits.strictLines ? "true" : "false");
-                ImGui::BulletText("standardSampleLocations = %s", properties.limits.standardSampleLocations ? "true" : "false");
-                ImGui::BulletText("optimalBufferCopyOffsetAlignment = %llu", properties.limits.optimalBufferCopyOffsetAlignment);
-                ImGui::BulletText("optimalBufferCopyRowPitchAlignment = %llu", properties.limits.optimalBufferCopyRowPitchAlignment);
-                ImGui::BulletText("nonCoherentAtomSize = %llu", properties.limits.nonCoherentAtomSize);
-
-                ImGui::TreePop();
+                ImGui::BulletText("%s: %0.3f ms (%s)", stat.name, stat.ms, get_pipeline_cache_result_str(stat.result));
             }
+            ImGui::TreePop();
+        }
 
-            ImGui::BulletText("Device Name: %s", properties.deviceName);
-
-            ImGui::BulletText("Pipeline Cache UUIDs: [%d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d]", properties.pipelineCacheUUID[0], properties.pipelineCacheUUID[1], properties.pipelineCacheUUID[2], properties.pipelineCacheUUID[3], properties.pipelineCacheUUID[4], properties.pipelineCacheUUID[5], properties.pipelineCacheUUID[6], properties.pipelineCacheUUID[7], properties.pipelineCacheUUID[8], properties.pipelineCacheUUID[9], properties.pipelineCacheUUID[10], properties.pipelineCacheUUID[11], properties.pipelineCacheUUID[12], properties.pipelineCacheUUID[13], properties.pipelineCacheUUID[14], properties.pipelineCacheUUID[15]);
-
-            if (ImGui::TreeNode("Sparse properties"))
-            {
-                ImGui::BulletText("residencyStandard2DBlockShape = %s", properties.sparseProperties.residencyStandard2DBlockShape ? "true" : "false");
-                ImGui::BulletText("residencyStandard2DMultisampleBlockShape = %s", properties.sparseProperties.residencyStandard2DMultisampleBlockShape ? "true" : "false");
-                ImGui::BulletText("residencyStandard3DBlockShape = %s", properties.sparseProperties.residencyStandard3DBlockShape ? "true" : "false");
-                ImGui::BulletText("residencyAlignedMipSize = %s", properties.sparseProperties.residencyAlignedMipSize ? "true" : "false");
-                ImGui::BulletText("residencyNonResidentStrict = %s", properties.sparseProperties.residencyNonResidentStrict ? "true" : "false");
-                ImGui::TreePop();
-            }
+        if (ImGui::TreeNode("Shader pack"))
+        {
+            shader_pack_draw_ui();
+            ImGui::TreePop();
+        }
 
+        if (ImGui::TreeNode("Pipelines"))
+        {
+            pipeline_registry_draw_ui(&g_Pipelines);
             ImGui::TreePop();
         }
-        ImGui::TreePop();
-    }
-}
 
-void window_info(bool *show_info_window)
-{
-    if (*show_info_window)
-    {
-        ImGui::Begin("Info", show_info_window);
+        if (ImGui::TreeNode("Device memory"))
+        {
+            gpu_allocator_draw_ui(&g_GpuAllocator);
+            ImGui::TreePop();
+        }
 
-        if (ImGui::TreeNode("Available GPUs"))
+        if (ImGui::TreeNode("Uploads"))
         {
-            int i = 0;
-            for (VkPhysicalDevice& device : g_Gpus)
-            {
-                window_device_info(device, i);
-                i++;
-            }
+            upload_draw_ui(&g_Upload);
             ImGui::TreePop();
         }
         ImGui::End();
     }
 }
 
-int main()
+static void init_imgui_vulkan(VkRenderPass render_pass, uint32_t image_count)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow *window = glfwCreateWindow(1000, 900, "Vulkan Playground", NULL, NULL);
-
-    ImVector<const char *> extensions;
-    uint32_t extensions_count;
-    const char **glfw_extensions = glfwGetRequiredInstanceExtensions(&extensions_count);
-    for (uint32_t i = 0; i < extensions_count; i++)
-    {
-        extensions.push_back(glfw_extensions[i]);
-    }
-    setup_vulkan(extensions);
-
-    // Create window surface
-    VkSurfaceKHR surface;
-    VkResult err = glfwCreateWindowSurface(g_Instance, window, g_Allocator, &surface);
-    check_vk_result(err);
-
-    // Create framebuffers
-    int w, h;
-    glfwGetFramebufferSize(window, &w, &h);
-    ImGui_ImplVulkanH_Window *wd = &g_MainWindowData;
-    setup_vulkan_window(wd, surface, w, h);
-
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO();
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
-
-    // Setup Dear ImGui Style
-    ImGui::StyleColorsDark();
-
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForVulkan(window, true);
     ImGui_ImplVulkan_InitInfo init_info = {};
     init_info.Instance = g_Instance;
     init_info.PhysicalDevice = g_PhysicalDevice;
@@ -633,87 +1015,1018 @@ int main()
     init_info.Queue = g_Queue;
     init_info.PipelineCache = g_PipelineCache;
     init_info.DescriptorPool = g_DescriptorPool;
-    init_info.RenderPass = wd->RenderPass;
+    init_info.RenderPass = render_pass;
     init_info.Subpass = 0;
     init_info.MinImageCount = g_MinImageCount;
-    init_info.ImageCount = wd->ImageCount;
+    init_info.ImageCount = image_count;
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     init_info.Allocator = g_Allocator;
     init_info.CheckVkResultFn = check_vk_result_fn;
     ImGui_ImplVulkan_Init(&init_info);
+}
 
-    bool show_demo_window = true;
-    bool show_options_window = true;
-    bool show_info_window = true;
-    ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+static void draw_ui()
+{
+    if (g_ShowDemoWindow)
+    {
+        ImGui::ShowDemoWindow(&g_ShowDemoWindow);
+    }
 
-    bool enable_vsync = false;
+    // Deliberately unclipped: every row is laid out and drawn
+    if (g_BenchUiRows > 0)
+    {
+        ImGui::SetNextWindowSize(ImVec2(500, 600), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Bench UI");
+        if (ImGui::BeginTable("rows", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+        {
+            static float values[4096];
+            for (int row = 0; row < g_BenchUiRows && row < IM_ARRAYSIZE(values); row++)
+            {
+                ImGui::PushID(row);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("Row %d", row);
+                ImGui::TableNextColumn();
+                ImGui::SliderFloat("##value", &values[row], 0.0f, 1.0f);
+                ImGui::TableNextColumn();
+                ImGui::ProgressBar(values[row], ImVec2(-1.0f, 0.0f));
+                ImGui::TableNextColumn();
+                ImGui::SmallButton("Reset");
+                ImGui::PopID();
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+    }
 
-    g_TriPipeline = create_pipeline(g_Device, wd->RenderPass, wd->Width, wd->Height);
-    g_TriVertexBuffer = create_vertex_buffer(g_Device, g_PhysicalDevice);
+    bool prev_vsync = g_VSyncEnabled;
 
-    while (!glfwWindowShouldClose(window))
+    if (g_ShowOptionsWindow)
     {
-        glfwPollEvents();
+        ImGui::Begin("Options", &g_ShowOptionsWindow);
 
-        rebuild_swapchain_if_needed(wd, window);
+        ImGui::Checkbox("VSync", &g_VSyncEnabled);
 
-        // Sleep if minimized
-        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED))
+        if (!g_Headless && ImGui::CollapsingHeader("Frame pacing"))
         {
-            ImGui_ImplGlfw_Sleep(10);
-            continue;
+            frame_pacing_draw_ui(&g_Frames, &g_Limiter, g_VSyncEnabled, gpu_profiler_get_ms(&g_GpuProfiler, "Frame"));
         }
 
-        // Start the Dear ImGui frame
-        ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        if (show_demo_window)
+        if (ImGui::CollapsingHeader("Pipeline variants"))
         {
-            ImGui::ShowDemoWindow(&show_demo_window);
+            ImGui::Combo("Blend", (int *)&g_TriVariant.blend, g_TriBlendNames, TRI_BLEND_COUNT);
+            ImGui::Combo("Topology", (int *)&g_TriVariant.topology, g_TriTopologyNames, TRI_TOPOLOGY_COUNT);
+            ImGui::Combo("Color", (int *)&g_TriVariant.color, g_TriColorNames, TRI_COLOR_COUNT);
+            pipeline_variants_draw_ui(&g_TriVariants);
         }
 
-        bool prev_vsync = g_VSyncEnabled;
-
-        if (show_options_window)
+        if (ImGui::CollapsingHeader("Frame constants"))
         {
-            ImGui::Begin("Options", &show_options_window);
-
-            ImGui::Checkbox("VSync", &g_VSyncEnabled);
+            ImGui::SliderInt("Triangles", &g_TriCopies, 1, 64);
+            ImGui::SliderFloat("Spin (rad/s)", &g_TriSpin, -6.0f, 6.0f);
+            ImGui::Checkbox("Keep aspect ratio", &g_TriKeepAspect);
+            uniform_ring_draw_ui(&g_Uniforms);
+        }
 
-            ImGui::End();
+        if (ImGui::CollapsingHeader("Batch renderer", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            batch_draw_ui(&g_Batch, gpu_profiler_get_ms(&g_GpuProfiler, "Batch"));
         }
 
-        window_info(&show_info_window);
+        if (ImGui::CollapsingHeader("Bindless textures"))
+        {
+            sprites_draw_ui(&g_Sprites, &g_Bindless, gpu_profiler_get_ms(&g_GpuProfiler, "Sprites"));
+        }
 
-        if (g_VSyncEnabled != prev_vsync)
+        if (ImGui::CollapsingHeader("Culling"))
         {
-            g_SwapChainRebuild = true;
+            cull_draw_ui(&g_Cull, gpu_profiler_get_ms(&g_GpuProfiler, "Cull"), gpu_profiler_get_ms(&g_GpuProfiler, "Cull draw"));
         }
 
-        ImGui::Render();
+        if (ImGui::CollapsingHeader("Particles"))
+        {
+            particles_draw_ui(&g_Particles, gpu_profiler_get_ms(&g_GpuProfiler, "Particles"));
+        }
+
+        if (ImGui::CollapsingHeader("Procedural geometry"))
+        {
+            geometry_draw_ui(&g_Geometry);
+        }
+
+        if (ImGui::CollapsingHeader("Command recording"))
+        {
+            parallel_recorder_draw_ui(&g_Recorder);
+        }
+
+        if (ImGui::CollapsingHeader("Async compute"))
+        {
+            async_compute_draw_ui(&g_AsyncCompute, gpu_profiler_get_ms(&g_GpuProfiler, "Frame"));
+        }
+
+        if (ImGui::CollapsingHeader("Render graph"))
+        {
+            render_graph_draw_ui(&g_RenderGraph);
+        }
+
+        if (!g_Headless && ImGui::CollapsingHeader("Shader reload"))
+        {
+            shader_reload_draw_ui(&g_ShaderReload);
+        }
+
+        if (ImGui::CollapsingHeader("Capture"))
+        {
+            ImGui::InputInt("Frames", &g_CaptureFrames);
+            g_CaptureFrames = g_CaptureFrames < 1 ? 1 : g_CaptureFrames;
+            if (capture_active(&g_Capture))
+            {
+                ImGui::Text("Capturing to %s, %d frames left", g_Capture.path, g_Capture.frames_left);
+                if (ImGui::Button("Stop"))
+                    capture_stop(&g_Capture);
+            }
+            else if (ImGui::Button("Capture to bin/capture.vkcap"))
+            {
+                ImGuiIO& io = ImGui::GetIO();
+                capture_begin(&g_Capture, "bin/capture.vkcap", g_CaptureFrames, (uint32_t)(io.DisplaySize.x * io.DisplayFramebufferScale.x),
+                              (uint32_t)(io.DisplaySize.y * io.DisplayFramebufferScale.y));
+            }
+        }
+
+        if (ImGui::CollapsingHeader("CPU timings"))
+        {
+            cpu_profiler_draw_ui();
+        }
+
+        if (ImGui::CollapsingHeader("GPU timings", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            gpu_profiler_draw_ui(&g_GpuProfiler);
+        }
+
+        ImGui::End();
+    }
+
+    window_info(&g_ShowInfoWindow);
+
+    if (g_VSyncEnabled != prev_vsync)
+    {
+        g_SwapChainRebuild = true;
+    }
+}
+
+static void set_clear_value(VkClearValue *clear_value)
+{
+    clear_value->color.float32[0] = g_ClearColor.x * g_ClearColor.w;
+    clear_value->color.float32[1] = g_ClearColor.y * g_ClearColor.w;
+    clear_value->color.float32[2] = g_ClearColor.z * g_ClearColor.w;
+    clear_value->color.float32[3] = g_ClearColor.w;
+}
+
+// Scene resources shared by the windowed and headless paths. frame_count is
+// the number of frames that can be in flight.
+static void create_scene(VkRenderPass render_pass, PipelineKey key, uint32_t frame_count)
+{
+    g_TriPipeline = pipeline_registry_add(&g_Pipelines, "tri", create_pipeline);
+    pipeline_registry_add_shader(&g_Pipelines, g_TriPipeline, "tri.vert");
+    pipeline_registry_add_shader(&g_Pipelines, g_TriPipeline, "tri.frag");
+    batch_init(&g_Batch, &g_GpuAllocator, &g_Upload, &g_Pipelines);
+    sprites_init(&g_Sprites, &g_GpuAllocator, &g_Upload, &g_Bindless, &g_Pipelines);
+    particles_init(&g_Particles, &g_GpuAllocator, g_PipelineCache, &g_Pipelines);
+    pipeline_registry_update(&g_Pipelines, render_pass, key);
+
+    // Filled triangles are the common path and compiled up front; the line
+    // variants are debug views and wait until someone picks one
+    pipeline_variants_init(&g_TriVariants, "tri", g_Device, g_PipelineCache, &g_Jobs, create_tri_variant_pipeline, tri_variant_name, TRI_VARIANT_COUNT);
+    pipeline_variants_add_shader(&g_TriVariants, "tri.vert");
+    pipeline_variants_add_shader(&g_TriVariants, "tri.frag");
+    g_TriStartupVariantCount = 0;
+    for (int i = 0; i < TRI_VARIANT_COUNT; i++)
+    {
+        if (tri_variant_from_index(i).topology == TRI_TOPOLOGY_TRIANGLES)
+            g_TriStartupVariants[g_TriStartupVariantCount++] = i;
+    }
+    pipeline_variants_build(&g_TriVariants, key, g_TriStartupVariants, g_TriStartupVariantCount);
+
+    g_TriVertexBuffer = create_vertex_buffer(&g_GpuAllocator, &g_Upload);
+    // Static geometry is only ever bound by handle, so it may be moved
+    for (GpuBuffer *buffer : { &g_TriVertexBuffer, &g_Batch.vertices, &g_Batch.indices, &g_Batch.instances })
+        gpu_allocator_register_movable(&g_GpuAllocator, buffer);
+    cull_init(&g_Cull, &g_GpuAllocator, &g_Upload, g_PipelineCache, g_EnabledFeatures, g_DrawIndirectCount, frame_count);
+    geometry_init(&g_Geometry, frame_count);
+    async_compute_init(&g_AsyncCompute, &g_GpuAllocator, g_PipelineCache, g_QueueFamily, g_Queue, g_ComputeQueueFamily, g_ComputeQueue, g_SharedTimestamps);
+}
+
+static void destroy_scene()
+{
+    pipeline_variants_destroy(&g_TriVariants);
+    async_compute_destroy(&g_AsyncCompute, &g_GpuAllocator);
+    particles_destroy(&g_Particles, &g_GpuAllocator);
+    geometry_destroy(&g_Geometry, &g_GpuAllocator);
+    cull_destroy(&g_Cull, &g_GpuAllocator);
+    gpu_destroy_buffer(&g_GpuAllocator, &g_TriVertexBuffer);
+    sprites_destroy(&g_Sprites, &g_GpuAllocator);
+    batch_destroy(&g_Batch, &g_GpuAllocator);
+}
+
+static void headless_setup(uint32_t width, uint32_t height)
+{
+    setup_vulkan(ImVector<const char *>());
+
+    HeadlessTarget *target = &g_HeadlessTarget;
+    create_headless_target(g_Device, &g_GpuAllocator, g_QueueFamily, target, width, height);
+    set_clear_value(&target->clear_value);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2((float)width, (float)height);
+    io.DeltaTime = 1.0f / 60.0f;
+    ImGui::StyleColorsDark();
+    init_imgui_vulkan(target->render_pass, HEADLESS_FRAMES_IN_FLIGHT);
+
+    create_scene(target->render_pass, { target->format, VK_SAMPLE_COUNT_1_BIT }, HEADLESS_FRAMES_IN_FLIGHT);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+    printf("[headless] %s, %ux%u\n", properties.deviceName, width, height);
+    if (g_CapturePath)
+        capture_begin(&g_Capture, g_CapturePath, g_CaptureFrames, width, height);
+}
+
+static void headless_render(int frame_count)
+{
+    for (int i = 0; i < frame_count; i++)
+    {
+        cpu_profiler_collect();
+        CPU_SCOPE("frame");
+        {
+            CPU_SCOPE("imgui_new_frame");
+            ImGui_ImplVulkan_NewFrame();
+            ImGui::NewFrame();
+        }
+        {
+            CPU_SCOPE("draw_ui");
+            draw_ui();
+        }
+        {
+            CPU_SCOPE("imgui_render");
+            ImGui::Render();
+        }
+        headless_frame_render(&g_HeadlessTarget, ImGui::GetDrawData());
+    }
+}
+
+static void headless_teardown()
+{
+    capture_stop(&g_Capture);
+    VkResult err = vkDeviceWaitIdle(g_Device);
+    check_vk_result(err);
+
+    ImGui_ImplVulkan_Shutdown();
+    ImGui::DestroyContext();
+
+    destroy_scene();
+    destroy_headless_target(&g_GpuAllocator, &g_HeadlessTarget);
+    cleanup_vulkan();
+}
+
+// Renders frame_count frames into offscreen images as fast as the device allows.
+// Needs no display or surface, so it runs on software ICDs such as lavapipe.
+static int run_headless(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+
+    double start = get_time_ms();
+    headless_render(frame_count);
+    VkResult err = vkDeviceWaitIdle(g_Device);
+    check_vk_result(err);
+    double total_ms = get_time_ms() - start;
+
+    printf("[headless] %d frames in %.3f ms: %.3f ms/frame, %.1f frames/s\n",
+           frame_count, total_ms, total_ms / frame_count, frame_count * 1000.0 / total_ms);
+    gpu_profiler_print(&g_GpuProfiler);
+    cpu_profiler_print();
+
+    headless_teardown();
+    return 0;
+}
+
+// CPU recording cost and GPU time of the culling modes over 10k to 1M objects.
+// The batch renderer is switched off so only the culled scene is measured.
+static int run_cull_benchmark(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+    g_Batch.instance_count = 0;
+    g_Cull.enabled = true;
+
+    const int object_counts[] = { 10000, 100000, 1000000 };
+    printf("[cull bench] %d frames per run\n", frame_count);
+    printf("[cull bench] %-10s %-22s %10s %10s %12s %12s %12s\n", "objects", "mode", "visible", "cpu ms", "gpu cull ms", "gpu draw ms", "frame ms");
+    for (int object_count : object_counts)
+    {
+        for (int mode = 0; mode < CULL_MODE_COUNT; mode++)
+        {
+            if (mode != CULL_MODE_CPU_DRAWS && !g_Cull.indirect_supported)
+                continue;
+            g_Cull.object_count = object_count;
+            g_Cull.mode = (CullMode)mode;
+
+            // Warm up, then drop whatever the profiler saw so far
+            headless_render(8);
+            VkResult err = vkDeviceWaitIdle(g_Device);
+            check_vk_result(err);
+            gpu_profiler_flush(&g_GpuProfiler);
+            gpu_profiler_reset(&g_GpuProfiler);
+
+            double cpu_ms = 0.0;
+            double start = get_time_ms();
+            for (int i = 0; i < frame_count; i++)
+            {
+                headless_render(1);
+                cpu_ms += g_Cull.stats.cpu_ms;
+            }
+            err = vkDeviceWaitIdle(g_Device);
+            check_vk_result(err);
+            double frame_ms = (get_time_ms() - start) / frame_count;
+            gpu_profiler_flush(&g_GpuProfiler);
+
+            printf("[cull bench] %-10d %-22s %10u %10.3f %12.3f %12.3f %12.3f\n", object_count, g_CullModeNames[mode], g_Cull.stats.visible,
+                   cpu_ms / frame_count, gpu_profiler_get_avg_ms(&g_GpuProfiler, "Cull"), gpu_profiler_get_avg_ms(&g_GpuProfiler, "Cull draw"), frame_ms);
+        }
+    }
+
+    headless_teardown();
+    return 0;
+}
+
+// Recording time of the per-object draw path over 1..N threads. Everything is
+// in view, so each frame records one draw per object.
+static int run_record_benchmark(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+    g_Batch.instance_count = 0;
+    g_Cull.enabled = true;
+    g_Cull.mode = CULL_MODE_CPU_DRAWS;
+    g_Cull.object_count = 1000000;
+    g_Cull.view_half_extent = CULL_WORLD_EXTENT;
+    g_Recorder.enabled = true;
+
+    int thread_count = job_system_thread_count(&g_Jobs);
+    printf("[record bench] %d frames per run, %d objects, %d threads available\n", frame_count, g_Cull.object_count, thread_count);
+    printf("[record bench] %-8s %12s %10s %12s\n", "threads", "record ms", "speedup", "frame ms");
+    double single_ms = 0.0;
+    for (int threads = 1;; threads *= 2)
+    {
+        if (threads > thread_count)
+            threads = thread_count;
+        g_Recorder.slice_count = threads;
+        headless_render(8);
+        VkResult err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+
+        double record_ms = 0.0;
+        double start = get_time_ms();
+        for (int i = 0; i < frame_count; i++)
+        {
+            headless_render(1);
+            record_ms += g_Recorder.wall_ms;
+        }
+        err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        double frame_ms = (get_time_ms() - start) / frame_count;
+        record_ms /= frame_count;
+        if (threads == 1)
+            single_ms = record_ms;
+
+        printf("[record bench] %-8d %12.3f %9.2fx %12.3f\n", threads, record_ms, single_ms / record_ms, frame_ms);
+        if (threads == thread_count)
+            break;
+    }
+
+    headless_teardown();
+    return 0;
+}
+
+// Frame time with the compute pass off, on the graphics queue and on the
+// compute queue. Overlap is the measured intersection of the two queues'
+// busy intervals, reported only where their timestamps share a domain.
+static int run_async_benchmark(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+    if (!g_SharedTimestamps)
+        printf("[async bench] overlap not measured: no VK_EXT_calibrated_timestamps device domain to compare the queues in\n");
+    g_AsyncCompute.instance_count = 512 * 1024;
+    g_AsyncCompute.iterations = 256;
+
+    struct AsyncConfig
+    {
+        const char *name;
+        bool enabled;
+        bool dedicated;
+    };
+    const AsyncConfig configs[] =
+    {
+        { "graphics only", false, false },
+        { "graphics queue", true, false },
+        { "compute queue", true, true },
+    };
+
+    printf("[async bench] %d frames per run, %d instances, %d iterations\n", frame_count, g_AsyncCompute.instance_count, g_AsyncCompute.iterations);
+    printf("[async bench] %-16s %12s %12s %12s %12s %10s\n", "config", "graphics ms", "compute ms", "frame ms", "overlap ms", "overlap %");
+    double serial_ms = 0.0;
+    for (const AsyncConfig& config : configs)
+    {
+        VkResult err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        if (config.dedicated && g_ComputeQueue == g_Queue)
+        {
+            printf("[async bench] %-16s skipped, no separate compute queue\n", config.name);
+            continue;
+        }
+
+        // Recreated on the queue under test, keeping the settings
+        AsyncCompute settings = g_AsyncCompute;
+        async_compute_destroy(&g_AsyncCompute, &g_GpuAllocator);
+        if (config.dedicated)
+            async_compute_init(&g_AsyncCompute, &g_GpuAllocator, g_PipelineCache, g_QueueFamily, g_Queue, g_ComputeQueueFamily, g_ComputeQueue, g_SharedTimestamps);
+        else
+            async_compute_init(&g_AsyncCompute, &g_GpuAllocator, g_PipelineCache, g_QueueFamily, g_Queue, g_QueueFamily, g_Queue, g_SharedTimestamps);
+        g_AsyncCompute.instance_count = settings.instance_count;
+        g_AsyncCompute.iterations = settings.iterations;
+        g_AsyncCompute.enabled = config.enabled;
+
+        headless_render(8);
+        err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        gpu_profiler_flush(&g_GpuProfiler);
+        gpu_profiler_reset(&g_GpuProfiler);
+        async_compute_reset_stats(&g_AsyncCompute);
+
+        double start = get_time_ms();
+        headless_render(frame_count);
+        err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        double frame_ms = (get_time_ms() - start) / frame_count;
+        gpu_profiler_flush(&g_GpuProfiler);
+
+        double graphics_ms = gpu_profiler_get_avg_ms(&g_GpuProfiler, "Frame");
+        double compute_ms = config.enabled ? async_compute_get_avg_ms(&g_AsyncCompute) : 0.0;
+        // Measured from both queues' timestamps; not inferred from frame times
+        double overlap_ms, overlap_fraction;
+        if (config.enabled && async_compute_get_overlap(&g_AsyncCompute, &overlap_ms, &overlap_fraction))
+            printf("[async bench] %-16s %12.3f %12.3f %12.3f %12.3f %9.1f%%\n", config.name, graphics_ms, compute_ms, frame_ms, overlap_ms,
+                   overlap_fraction * 100.0);
+        else
+            printf("[async bench] %-16s %12.3f %12.3f %12.3f %12s %10s\n", config.name, graphics_ms, compute_ms, frame_ms, "-", "-");
+        if (config.enabled && !config.dedicated)
+            serial_ms = frame_ms;
+        else if (config.dedicated && serial_ms > 0.0)
+            printf("[async bench] compute queue vs graphics queue: %.2fx\n", serial_ms / frame_ms);
+    }
+
+    headless_teardown();
+    return 0;
+}
+
+// Simulation GPU time and particles updated per second from 1M up to the
+// device's limit. The batch renderer is switched off so only the particles
+// are measured.
+static int run_particle_benchmark(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+    g_Batch.instance_count = 0;
+    g_Particles.enabled = true;
+
+    printf("[particle bench] %d frames per run, workgroup %u\n", frame_count, g_Particles.local_size);
+    printf("[particle bench] %-10s %12s %12s %12s %16s\n", "particles", "sim ms", "draw ms", "frame ms", "M particles/s");
+    for (int count : { 1 << 20, 1 << 22, 1 << 24, 1 << 25 })
+    {
+        if (count > (int)g_Particles.max_count)
+        {
+            printf("[particle bench] %-10d skipped, over the device limit of %u\n", count, g_Particles.max_count);
+            continue;
+        }
+        g_Particles.count = count;
+
+        headless_render(8);
+        VkResult err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        gpu_profiler_flush(&g_GpuProfiler);
+        gpu_profiler_reset(&g_GpuProfiler);
+
+        double start = get_time_ms();
+        headless_render(frame_count);
+        err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        double frame_ms = (get_time_ms() - start) / frame_count;
+        gpu_profiler_flush(&g_GpuProfiler);
+
+        double sim_ms = gpu_profiler_get_avg_ms(&g_GpuProfiler, "Particles");
+        printf("[particle bench] %-10d %12.3f %12.3f %12.3f %16.1f\n", count, sim_ms, gpu_profiler_get_avg_ms(&g_GpuProfiler, "Particles draw"),
+               frame_ms, sim_ms > 0.0 ? count / (sim_ms * 1000.0) : 0.0);
+    }
+
+    headless_teardown();
+    return 0;
+}
+
+// CPU geometry generation per kernel and shape at 1M segments (6M vertices).
+// Per core is over the summed job time, so it doesn't depend on how many
+// threads the job system has.
+static int run_geometry_benchmark(int frame_count, uint32_t width, uint32_t height)
+{
+    headless_setup(width, height);
+    g_Batch.instance_count = 0;
+    g_Geometry.enabled = true;
+    g_Geometry.lines = 256;
+    g_Geometry.segments_per_line = GEOMETRY_MAX_SEGMENTS / g_Geometry.lines;
+
+    printf("[geometry bench] %d frames per run, %d threads available\n", frame_count, job_system_thread_count(&g_Jobs));
+    printf("[geometry bench] %-10s %-8s %10s %10s %16s %20s\n", "shape", "kernel", "wall ms", "cpu ms", "M vertices/s", "M vertices/s/core");
+    for (int kernel = 0; kernel < GEOMETRY_KERNEL_COUNT; kernel++)
+    {
+#if !defined(GEOMETRY_SIMD_NAME)
+        if (kernel == GEOMETRY_KERNEL_SIMD)
+        {
+            printf("[geometry bench] SIMD skipped, no vector unit targeted\n");
+            continue;
+        }
+        const char *kernel_name = "scalar";
+#else
+        const char *kernel_name = kernel == GEOMETRY_KERNEL_SIMD ? GEOMETRY_SIMD_NAME : "scalar";
+#endif
+        for (int shape = 0; shape < GEOMETRY_SHAPE_COUNT; shape++)
+        {
+            g_Geometry.kernel = (GeometryKernel)kernel;
+            g_Geometry.shape = (GeometryShape)shape;
+            headless_render(8);
+            geometry_reset_stats(&g_Geometry);
+            headless_render(frame_count);
+            VkResult err = vkDeviceWaitIdle(g_Device);
+            check_vk_result(err);
+
+            double vertices = (double)g_Geometry.total_vertices;
+            printf("[geometry bench] %-10s %-8s %10.3f %10.3f %16.1f %20.1f\n", g_GeometryShapeNames[shape], kernel_name,
+                   g_Geometry.total_wall_ms / frame_count, g_Geometry.total_cpu_ms / frame_count,
+                   vertices / (g_Geometry.total_wall_ms * 1000.0), vertices / (g_Geometry.total_cpu_ms * 1000.0));
+        }
+    }
+
+    headless_teardown();
+    return 0;
+}
+
+// Every value is range checked, since it comes from a file.
+static void apply_scene_state(const CaptureSceneState *state)
+{
+    g_SceneTime = state->scene_time;
+    g_Cull.time = state->cull_time;
+    g_AsyncCompute.time = state->async_time;
+    g_Particles.time = state->particles_time;
+    g_Geometry.time = state->geometry_time;
+    ImGui::GetIO().DeltaTime = state->delta_time;
+    memcpy(&g_ClearColor, state->clear_color, sizeof(state->clear_color));
+    set_clear_value(&g_HeadlessTarget.clear_value);
+
+    g_TriCopies = capture_check_range(state->tri_copies, 1, 64, "tri_copies");
+    g_TriSpin = state->tri_spin;
+    g_TriKeepAspect = state->tri_keep_aspect != 0;
+    g_TriVariant.blend = (TriBlend)capture_check_range(state->tri_blend, 0, TRI_BLEND_COUNT - 1, "tri_blend");
+    g_TriVariant.topology = (TriTopology)capture_check_range(state->tri_topology, 0, TRI_TOPOLOGY_COUNT - 1, "tri_topology");
+    g_TriVariant.color = (TriColor)capture_check_range(state->tri_color, 0, TRI_COLOR_COUNT - 1, "tri_color");
+    g_Batch.instance_count = capture_check_range(state->batch_instance_count, 0, BATCH_MAX_INSTANCES, "batch_instance_count");
+    for (int i = 0; i < BATCH_SHAPE_COUNT; i++)
+        g_Batch.shape_enabled[i] = (state->batch_shape_mask >> i) & 1;
+    g_Sprites.enabled = state->sprites_enabled != 0;
+    g_Sprites.stream = state->sprites_stream != 0;
+    g_Sprites.instance_count = capture_check_range(state->sprites_instance_count, 0, SPRITE_MAX_INSTANCES, "sprites_instance_count");
+    g_Sprites.sampler_index = capture_check_range(state->sprites_sampler, 0, BINDLESS_SAMPLER_COUNT - 1, "sprites_sampler");
+    g_Sprites.seed = state->sprites_seed;
+    g_Sprites.next_stream = capture_check_range(state->sprites_next_stream, 0, SPRITE_TEXTURE_COUNT - 1, "sprites_next_stream");
+    g_Cull.enabled = state->cull_enabled != 0;
+    g_Cull.mode = (CullMode)capture_check_range(state->cull_mode, 0, CULL_MODE_COUNT - 1, "cull_mode");
+    g_Cull.object_count = capture_check_range(state->cull_object_count, 1000, CULL_MAX_OBJECTS, "cull_object_count");
+    g_Cull.view_half_extent = state->cull_view_half_extent;
+    if (!(g_Cull.view_half_extent >= 0.1f && g_Cull.view_half_extent <= CULL_WORLD_EXTENT))
+        fatal("Corrupt capture, cull_view_half_extent is %f, outside 0.1..%g", g_Cull.view_half_extent, (double)CULL_WORLD_EXTENT);
+    g_Cull.animate_view = state->cull_animate_view != 0;
+    g_AsyncCompute.enabled = state->async_enabled != 0;
+    g_AsyncCompute.instance_count = capture_check_range(state->async_instance_count, 1024, ASYNC_MAX_INSTANCES, "async_instance_count");
+    g_AsyncCompute.iterations = capture_check_range(state->async_iterations, 1, 1024, "async_iterations");
+    g_Particles.enabled = state->particles_enabled != 0;
+    if (state->particles_count > (int32_t)g_Particles.max_count)
+        fatal("The capture simulates %d particles, this device runs at most %u", state->particles_count, g_Particles.max_count);
+    g_Particles.count = capture_check_range(state->particles_count, 1, (int)g_Particles.max_count, "particles_count");
+    g_Geometry.enabled = state->geometry_enabled != 0;
+    g_Geometry.shape = (GeometryShape)capture_check_range(state->geometry_shape, 0, GEOMETRY_SHAPE_COUNT - 1, "geometry_shape");
+    g_Geometry.kernel = (GeometryKernel)capture_check_range(state->geometry_kernel, 0, GEOMETRY_KERNEL_COUNT - 1, "geometry_kernel");
+    g_Geometry.lines = capture_check_range(state->geometry_lines, 1, 1024, "geometry_lines");
+    g_Geometry.segments_per_line = capture_check_range(state->geometry_segments_per_line, 16, 65536, "geometry_segments_per_line");
+    g_Recorder.enabled = state->recorder_enabled != 0;
+    g_Recorder.slice_count = capture_check_range(state->recorder_slice_count, 1, RECORD_MAX_SLICES, "recorder_slice_count");
+}
+
+// Re-executes a capture loop_count times at its original size. Every frame
+// is waited on, so the CPU and GPU times below belong to that frame alone;
+// the first pass over the capture is a warm-up and isn't counted. Particles
+// live on the GPU and aren't captured, they restart from zero.
+static int run_replay(const char *path, int loop_count)
+{
+    // The header decides the size; the draw lists are loaded once ImGui is up
+    CaptureFileHeader header = {};
+    FILE *f = xfopen(path, "rb");
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != CAPTURE_MAGIC)
+        fatal("%s is not a capture", path);
+    fclose(f);
+    headless_setup(header.width, header.height);
+    // Creates the font texture the captured draw commands are pointed at
+    ImGui_ImplVulkan_NewFrame();
+    CaptureReplay replay = {};
+    capture_load(&replay, path);
+    if (replay.frames.Size == 0)
+        fatal("%s has no frames", path);
+
+    int frame_count = replay.frames.Size;
+    ImVector<double> cpu_min, cpu_sum, gpu_min, gpu_sum;
+    for (ImVector<double> *v : { &cpu_min, &cpu_sum, &gpu_min, &gpu_sum })
+    {
+        v->resize(frame_count);
+        memset(v->Data, 0, frame_count * sizeof(double));
+    }
+
+    for (int loop = 0; loop <= loop_count; loop++)
+    {
+        if (loop == 1)
+        {
+            gpu_profiler_reset(&g_GpuProfiler);
+            cpu_profiler_reset_totals();
+        }
+        for (int i = 0; i < frame_count; i++)
+        {
+            CapturedFrame *frame = replay.frames[i];
+            cpu_profiler_collect();
+            apply_scene_state(&frame->state);
+
+            double start = get_time_ms();
+            {
+                CPU_SCOPE("replay_frame");
+                headless_frame_render(&g_HeadlessTarget, &frame->draw_data);
+            }
+            double cpu_ms = get_time_ms() - start;
+            VkResult err = vkDeviceWaitIdle(g_Device);
+            check_vk_result(err);
+            gpu_profiler_flush(&g_GpuProfiler);
+            double gpu_ms = gpu_profiler_get_ms(&g_GpuProfiler, "Frame");
+            if (loop == 0)
+                continue;
+
+            cpu_min[i] = loop == 1 || cpu_ms < cpu_min[i] ? cpu_ms : cpu_min[i];
+            gpu_min[i] = loop == 1 || gpu_ms < gpu_min[i] ? gpu_ms : gpu_min[i];
+            cpu_sum[i] += cpu_ms;
+            gpu_sum[i] += gpu_ms;
+        }
+    }
+
+    if (loop_count > 0)
+    {
+        printf("[replay] %d frames x %d loops\n", frame_count, loop_count);
+        printf("[replay] %-6s %12s %12s %12s %12s\n", "frame", "cpu min ms", "cpu avg ms", "gpu min ms", "gpu avg ms");
+        double cpu_total = 0.0, gpu_total = 0.0;
+        for (int i = 0; i < frame_count; i++)
+        {
+            printf("[replay] %-6d %12.3f %12.3f %12.3f %12.3f\n", i, cpu_min[i], cpu_sum[i] / loop_count, gpu_min[i], gpu_sum[i] / loop_count);
+            cpu_total += cpu_sum[i];
+            gpu_total += gpu_sum[i];
+        }
+        int samples = frame_count * loop_count;
+        printf("[replay] %-6s %12s %12.3f %12s %12.3f\n", "all", "", cpu_total / samples, "", gpu_total / samples);
+        gpu_profiler_print(&g_GpuProfiler);
+        cpu_profiler_print();
+    }
+
+    // Before the teardown, which needs the ImGui context this depends on
+    capture_unload(&replay);
+    headless_teardown();
+    return 0;
+}
+
+#define BENCH_UPLOAD_BYTES (8ull * 1024 * 1024) // per frame in the upload scenario
+
+static void bench_warm_up()
+{
+    headless_render(8);
+    VkResult err = vkDeviceWaitIdle(g_Device);
+    check_vk_result(err);
+}
+
+static void bench_finish(BenchSuite *suite, BenchScenario *scenario, int frame_count)
+{
+    VkResult err = vkDeviceWaitIdle(g_Device);
+    check_vk_result(err);
+    bench_scenario_end(scenario, frame_count, &g_GpuAllocator, &g_GpuProfiler);
+    suite->scenarios.push_back(*scenario);
+}
+
+// Scripted headless scenarios, frame_count frames each, written to out_path as
+// JSON and checked against baseline_path if given. Fails on any regression of
+// more than threshold (a fraction).
+static int run_bench_suite(int frame_count, uint32_t width, uint32_t height, const char *out_path, const char *baseline_path, double threshold)
+{
+    headless_setup(width, height);
+
+    BenchSuite suite;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+    snprintf(suite.device, sizeof(suite.device), "%s", properties.deviceName);
+    suite.width = width;
+    suite.height = height;
+    printf("[bench] %d frames per scenario\n", frame_count);
+
+    BenchScenario scenario;
+    char name[64];
+
+    // Triangle count sweep over the batch renderer's triangle shape
+    BatchRenderer batch_settings = g_Batch;
+    for (int shape = 0; shape < BATCH_SHAPE_COUNT; shape++)
+        g_Batch.shape_enabled[shape] = shape == BATCH_SHAPE_TRIANGLE;
+    for (int triangles : { 1000, 10000, 100000, 1000000 })
+    {
+        g_Batch.instance_count = triangles;
+        snprintf(name, sizeof(name), "triangles_%d", triangles);
+        bench_warm_up();
+        bench_scenario_begin(&scenario, name, &g_GpuAllocator, &g_GpuProfiler);
+        headless_render(frame_count);
+        bench_finish(&suite, &scenario, frame_count);
+    }
+    memcpy(g_Batch.shape_enabled, batch_settings.shape_enabled, sizeof(g_Batch.shape_enabled));
+    g_Batch.instance_count = batch_settings.instance_count;
+
+    // Resize storm: a new target size every frame, like dragging a window edge
+    {
+        const float scales[][2] = { { 1.0f, 1.0f }, { 0.5f, 0.75f }, { 0.75f, 0.5f }, { 0.33f, 0.9f }, { 1.0f, 0.6f } };
+        bench_warm_up();
+        bench_scenario_begin(&scenario, "resize_storm", &g_GpuAllocator, &g_GpuProfiler);
+        for (int i = 0; i < frame_count; i++)
+        {
+            const float *scale = scales[i % IM_ARRAYSIZE(scales)];
+            uint32_t w = (uint32_t)(width * scale[0]);
+            uint32_t h = (uint32_t)(height * scale[1]);
+            {
+                CPU_SCOPE("resize");
+                VkResult err = vkDeviceWaitIdle(g_Device);
+                check_vk_result(err);
+                resize_headless_target(&g_GpuAllocator, g_QueueFamily, &g_HeadlessTarget, w > 0 ? w : 1, h > 0 ? h : 1);
+                render_graph_reset_framebuffers(&g_RenderGraph);
+                ImGui::GetIO().DisplaySize = ImVec2((float)w, (float)h);
+            }
+            headless_render(1);
+        }
+        bench_finish(&suite, &scenario, frame_count);
+        resize_headless_target(&g_GpuAllocator, g_QueueFamily, &g_HeadlessTarget, width, height);
+        render_graph_reset_framebuffers(&g_RenderGraph);
+        ImGui::GetIO().DisplaySize = ImVec2((float)width, (float)height);
+    }
+
+    // Pipeline creation: one triangle variant per frame without a pipeline cache
+    {
+        bench_warm_up();
+        bench_scenario_begin(&scenario, "pipeline_create", &g_GpuAllocator, &g_GpuProfiler);
+        double create_ms = 0.0;
+        for (int i = 0; i < frame_count; i++)
+        {
+            {
+                CPU_SCOPE("pipeline_create");
+                double start = get_time_ms();
+                VkPipeline pipeline = create_tri_variant_pipeline(g_Device, VK_NULL_HANDLE, g_HeadlessTarget.render_pass, i % TRI_VARIANT_COUNT);
+                create_ms += get_time_ms() - start;
+                vkDestroyPipeline(g_Device, pipeline, nullptr);
+            }
+            headless_render(1);
+        }
+        scenario.throughput_name = "pipelines_per_s";
+        scenario.throughput = create_ms > 0.0 ? frame_count * 1000.0 / create_ms : 0.0;
+        bench_finish(&suite, &scenario, frame_count);
+    }
+
+    // Buffer upload throughput, rendering alongside
+    {
+        GpuBuffer buffer;
+        gpu_create_buffer(&g_GpuAllocator, BENCH_UPLOAD_BYTES, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer);
+        uint32_t *data = (uint32_t *)xmalloc(BENCH_UPLOAD_BYTES);
+        for (size_t i = 0; i < BENCH_UPLOAD_BYTES / sizeof(uint32_t); i++)
+            data[i] = (uint32_t)(i * 2654435761u);
+
+        bench_warm_up();
+        bench_scenario_begin(&scenario, "buffer_upload", &g_GpuAllocator, &g_GpuProfiler);
+        for (int i = 0; i < frame_count; i++)
+        {
+            {
+                CPU_SCOPE("upload_buffer");
+                upload_buffer(&g_Upload, buffer.buffer, 0, data, BENCH_UPLOAD_BYTES, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            }
+            headless_render(1);
+        }
+        VkResult err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        double seconds = (get_time_ms() - scenario.start_ms) / 1000.0;
+        scenario.throughput_name = "upload_mb_per_s";
+        scenario.throughput = (double)BENCH_UPLOAD_BYTES * frame_count / (1024.0 * 1024.0) / seconds;
+        bench_finish(&suite, &scenario, frame_count);
+
+        free(data);
+        gpu_destroy_buffer(&g_GpuAllocator, &buffer);
+    }
+
+    // ImGui-heavy frame: a few thousand unclipped widget rows
+    {
+        g_BenchUiRows = 2000;
+        bench_warm_up();
+        bench_scenario_begin(&scenario, "imgui_heavy", &g_GpuAllocator, &g_GpuProfiler);
+        headless_render(frame_count);
+        bench_finish(&suite, &scenario, frame_count);
+        g_BenchUiRows = 0;
+    }
+
+    // Particle simulation, reported as particles updated per second of GPU time
+    {
+        g_Particles.enabled = true;
+        g_Particles.count = g_Particles.max_count < 1000000 ? (int)g_Particles.max_count : 1000000;
+        bench_warm_up();
+        // Named after the count that ran, so a device capped below 1M isn't
+        // compared against a baseline that simulated more
+        snprintf(name, sizeof(name), "particles_%d", g_Particles.count);
+        bench_scenario_begin(&scenario, name, &g_GpuAllocator, &g_GpuProfiler);
+        headless_render(frame_count);
+        VkResult err = vkDeviceWaitIdle(g_Device);
+        check_vk_result(err);
+        gpu_profiler_flush(&g_GpuProfiler);
+        double sim_ms = gpu_profiler_get_avg_ms(&g_GpuProfiler, "Particles");
+        scenario.throughput_name = "particles_per_s";
+        scenario.throughput = sim_ms > 0.0 ? g_Particles.count * 1000.0 / sim_ms : 0.0;
+        bench_finish(&suite, &scenario, frame_count);
+        g_Particles.enabled = false;
+    }
+
+    // Procedural geometry on the CPU, vertices generated per second per core
+    {
+        GeometryGenerator geometry_settings = g_Geometry;
+        g_Geometry.enabled = true;
+        g_Geometry.lines = 256;
+        g_Geometry.segments_per_line = 1024;
+        bench_warm_up();
+        geometry_reset_stats(&g_Geometry);
+        // Warm-up has applied any clamp, so the name is the vertex count that runs
+        snprintf(name, sizeof(name), "geometry_%d", g_Geometry.lines * g_Geometry.segments_per_line * 6);
+        bench_scenario_begin(&scenario, name, &g_GpuAllocator, &g_GpuProfiler);
+        headless_render(frame_count);
+        scenario.throughput_name = "vertices_per_core_per_s";
+        scenario.throughput = g_Geometry.total_cpu_ms > 0.0 ? g_Geometry.total_vertices * 1000.0 / g_Geometry.total_cpu_ms : 0.0;
+        bench_finish(&suite, &scenario, frame_count);
+        g_Geometry.enabled = geometry_settings.enabled;
+        g_Geometry.lines = geometry_settings.lines;
+        g_Geometry.segments_per_line = geometry_settings.segments_per_line;
+    }
+
+    headless_teardown();
+
+    if (!bench_write_json(&suite, out_path))
+        return EXIT_FAILURE;
+    if (!baseline_path)
+        return 0;
+    int regressions = bench_compare(baseline_path, out_path, threshold);
+    return regressions != 0 ? EXIT_FAILURE : 0;
+}
+
+static int run_window()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow *window = glfwCreateWindow(1000, 900, "Vulkan Playground", NULL, NULL);
+
+    ImVector<const char *> extensions;
+    uint32_t extensions_count;
+    const char **glfw_extensions = glfwGetRequiredInstanceExtensions(&extensions_count);
+    for (uint32_t i = 0; i < extensions_count; i++)
+    {
+        extensions.push_back(glfw_extensions[i]);
+    }
+    setup_vulkan(extensions);
+
+    // Create window surface
+    VkSurfaceKHR surface;
+    VkResult err = glfwCreateWindowSurface(g_Instance, window, g_Allocator, &surface);
+    check_vk_result(err);
+
+    // Create framebuffers
+    int w, h;
+    glfwGetFramebufferSize(window, &w, &h);
+    ImGui_ImplVulkanH_Window *wd = &g_MainWindowData;
+    setup_vulkan_window(wd, surface, w, h);
+
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
+
+    // Setup Dear ImGui Style
+    ImGui::StyleColorsDark();
+
+    frame_queue_init(&g_Frames, g_Device, g_QueueFamily, 2);
+    frame_queue_set_images(&g_Frames, wd->ImageCount);
+    const GLFWvidmode *video_mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    frame_limiter_init(&g_Limiter, video_mode ? video_mode->refreshRate : 60.0);
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplGlfw_InitForVulkan(window, true);
+    // ImGui rotates its vertex buffers by its image count, which must cover every frame in flight
+    init_imgui_vulkan(wd->RenderPass, wd->ImageCount > FRAMES_MAX_IN_FLIGHT ? wd->ImageCount : FRAMES_MAX_IN_FLIGHT);
+
+    create_scene(wd->RenderPass, { wd->SurfaceFormat.format, VK_SAMPLE_COUNT_1_BIT }, FRAMES_MAX_IN_FLIGHT);
+    PipelineVariantSet *variant_sets[] = { &g_TriVariants };
+    shader_reload_init(&g_ShaderReload, g_Device, g_PipelineCache, &g_Pipelines, variant_sets, IM_ARRAYSIZE(variant_sets));
+    if (g_CapturePath)
+        capture_begin(&g_Capture, g_CapturePath, g_CaptureFrames, (uint32_t)w, (uint32_t)h);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        cpu_profiler_collect();
+        CPU_SCOPE("frame");
+
+        // Low latency: block on the GPU and swapchain first, then sleep so
+        // input is sampled as late as the present slot allows
+        bool acquired = false;
+        if (g_Limiter.low_latency && !g_SwapChainRebuild && !glfwGetWindowAttrib(window, GLFW_ICONIFIED))
+        {
+            acquired = frame_acquire(wd);
+            if (acquired)
+                frame_limiter_wait(&g_Limiter, g_VSyncEnabled);
+        }
+
+        {
+            CPU_SCOPE("poll_events");
+            glfwPollEvents();
+        }
+        frame_limiter_input_sampled(&g_Limiter);
+
+        // An acquired image has to be rendered and presented; resizes and
+        // minimizing are picked up on the next frame
+        if (!acquired)
+        {
+            {
+                CPU_SCOPE("rebuild_swapchain");
+                rebuild_swapchain_if_needed(wd, window);
+            }
+
+            // Sleep if minimized
+            if (glfwGetWindowAttrib(window, GLFW_ICONIFIED))
+            {
+                ImGui_ImplGlfw_Sleep(10);
+                continue;
+            }
+        }
+
+        // Start the Dear ImGui frame
+        {
+            CPU_SCOPE("imgui_new_frame");
+            ImGui_ImplVulkan_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
+        {
+            CPU_SCOPE("draw_ui");
+            draw_ui();
+        }
+        {
+            CPU_SCOPE("imgui_render");
+            ImGui::Render();
+        }
         ImDrawData *draw_data = ImGui::GetDrawData();
         const bool is_minimized = (draw_data->DisplaySize.x <= 0.0f || draw_data->DisplaySize.y <= 0.0f);
-        if (!is_minimized)
+        if (!acquired && !is_minimized)
+        {
+            acquired = frame_acquire(wd);
+        }
+        if (acquired)
         {
-            wd->ClearValue.color.float32[0] = clear_color.x * clear_color.w;
-            wd->ClearValue.color.float32[1] = clear_color.y * clear_color.w;
-            wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
-            wd->ClearValue.color.float32[3] = clear_color.w;
+            set_clear_value(&wd->ClearValue);
             frame_render(wd, draw_data);
             frame_present(wd);
         }
     }
 
     // Cleanup
+    capture_stop(&g_Capture);
     err = vkDeviceWaitIdle(g_Device);
     check_vk_result(err);
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    shader_reload_destroy(&g_ShaderReload);
+    destroy_scene();
+    frame_queue_destroy(&g_Frames);
     cleanup_vulkan_window();
     cleanup_vulkan();
 
@@ -722,3 +2035,192 @@ int main()
 
     return 0;
 }
+
+// Frame and loop counts divide the timings, so anything but a positive
+// number is rejected rather than read as 0 the way atoi would.
+static int parse_count(const char *arg, const char *option)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || value < 1 || value > INT_MAX)
+        fatal("Expected a count of at least 1 after %s, got %s", option, arg);
+    return (int)value;
+}
+
+int main(int argc, char **argv)
+{
+    g_StartupMs = get_time_ms();
+    int headless_frames = 1000;
+    bool cull_benchmark = false;
+    bool record_benchmark = false;
+    bool async_benchmark = false;
+    bool particle_benchmark = false;
+    bool geometry_benchmark = false;
+    bool bench_suite = false;
+    const char *bench_out_path = "bin/bench.json";
+    const char *bench_baseline_path = nullptr;
+    double bench_threshold = 0.1;
+    uint32_t headless_width = 1000;
+    uint32_t headless_height = 900;
+    const char *cpu_trace_path = nullptr;
+    const char *replay_path = nullptr;
+    int replay_loops = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            g_Headless = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--headless");
+        }
+        else if (strcmp(argv[i], "--cull-bench") == 0)
+        {
+            g_Headless = true;
+            cull_benchmark = true;
+            headless_frames = 100;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--cull-bench");
+        }
+        else if (strcmp(argv[i], "--record-bench") == 0)
+        {
+            g_Headless = true;
+            record_benchmark = true;
+            headless_frames = 100;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--record-bench");
+        }
+        else if (strcmp(argv[i], "--async-bench") == 0)
+        {
+            g_Headless = true;
+            async_benchmark = true;
+            headless_frames = 100;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--async-bench");
+        }
+        else if (strcmp(argv[i], "--particle-bench") == 0)
+        {
+            g_Headless = true;
+            particle_benchmark = true;
+            headless_frames = 100;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--particle-bench");
+        }
+        else if (strcmp(argv[i], "--geometry-bench") == 0)
+        {
+            g_Headless = true;
+            geometry_benchmark = true;
+            headless_frames = 100;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--geometry-bench");
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            g_Headless = true;
+            bench_suite = true;
+            headless_frames = 200;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                headless_frames = parse_count(argv[++i], "--bench");
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            g_CapturePath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                g_CaptureFrames = parse_count(argv[++i], "--capture");
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            g_Headless = true;
+            replay_path = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                replay_loops = parse_count(argv[++i], "--replay");
+        }
+        else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc)
+        {
+            bench_out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            bench_baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            bench_threshold = atof(argv[++i]) / 100.0;
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &headless_width, &headless_height) != 2)
+                fatal("Expected --size WIDTHxHEIGHT, got %s", argv[i]);
+        }
+        else if (strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+        {
+            cpu_trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            g_JobThreadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--device-info") == 0 && i + 1 < argc)
+        {
+            g_DeviceInfoPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-validation") == 0)
+        {
+            g_EnableValidation = false;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--headless [frames]] [--cull-bench [frames]] [--record-bench [frames]] [--async-bench [frames]] [--particle-bench [frames]] [--geometry-bench [frames]] [--bench [frames]] [--capture FILE [frames]] [--replay FILE [loops]] [--bench-out FILE] [--baseline FILE] [--threshold PERCENT] [--size WxH] [--threads N] [--cpu-trace FILE] [--device-info FILE] [--no-validation]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    cpu_profiler_init();
+    cpu_profiler_set_thread_name("main");
+    shader_pack_init();
+
+    int result;
+    if (replay_path)
+    {
+        result = run_replay(replay_path, replay_loops);
+    }
+    else if (cull_benchmark)
+    {
+        result = run_cull_benchmark(headless_frames, headless_width, headless_height);
+    }
+    else if (record_benchmark)
+    {
+        result = run_record_benchmark(headless_frames, headless_width, headless_height);
+    }
+    else if (async_benchmark)
+    {
+        result = run_async_benchmark(headless_frames, headless_width, headless_height);
+    }
+    else if (particle_benchmark)
+    {
+        result = run_particle_benchmark(headless_frames, headless_width, headless_height);
+    }
+    else if (geometry_benchmark)
+    {
+        result = run_geometry_benchmark(headless_frames, headless_width, headless_height);
+    }
+    else if (bench_suite)
+    {
+        result = run_bench_suite(headless_frames, headless_width, headless_height, bench_out_path, bench_baseline_path, bench_threshold);
+    }
+    else if (g_Headless)
+    {
+        result = run_headless(headless_frames, headless_width, headless_height);
+    }
+    else
+    {
+        result = run_window();
+    }
+
+    // Holds the most recent events of the whole run
+    if (cpu_trace_path && !cpu_profiler_dump_trace(cpu_trace_path))
+        result = EXIT_FAILURE;
+    shader_pack_destroy();
+    cpu_profiler_destroy();
+    return result;
+}
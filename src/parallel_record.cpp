@@ -0,0 +1,261 @@
+#include <cstdio>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Records the scene into secondary command buffers on the job system threads.
+// Every thread owns one command pool per frame in flight, so recording needs
+// no locks: the pools for a frame are reset on the calling thread once its
+// fence has signaled, then each job allocates from the pool of whichever
+// thread runs it. The scene is cut into slices, one secondary each, executed
+// in slice order from the primary. The calling thread records one more
+// secondary at the end for work that has to stay on it (ImGui).
+
+#define RECORD_MAX_FRAMES 8
+#define RECORD_MAX_SLICES (JOB_MAX_THREADS * 4)
+
+// Records slice out of slice_count into command_buffer. Viewport and scissor
+// are already set. Called concurrently for different slices.
+typedef void (*RecordSliceFn)(void *user, VkCommandBuffer command_buffer, int slice, int slice_count);
+
+struct RecordThreadFrame
+{
+    VkCommandPool pool;
+    ImVector<VkCommandBuffer> buffers;
+    int used;
+};
+
+struct RecordThread
+{
+    RecordThreadFrame frames[RECORD_MAX_FRAMES];
+    double ms;     // time spent recording, last frame
+    double ms_avg;
+    int slices;    // slices recorded, last frame
+};
+
+struct ParallelRecorder
+{
+    VkDevice device;
+    uint32_t queue_family;
+    JobSystem *jobs;
+    RecordThread threads[JOB_MAX_THREADS];
+
+    bool enabled;
+    int slice_count;
+
+    double wall_ms; // fork to join, last frame
+    double wall_ms_avg;
+
+    // Per-frame job arguments
+    uint32_t frame_slot;
+    VkCommandBufferInheritanceInfo inheritance;
+    VkViewport viewport;
+    VkRect2D scissor;
+    RecordSliceFn fn;
+    void *user;
+    VkCommandBuffer slice_buffers[RECORD_MAX_SLICES];
+};
+
+void parallel_recorder_init(ParallelRecorder *recorder, VkDevice device, uint32_t queue_family, JobSystem *jobs)
+{
+    recorder->device = device;
+    recorder->queue_family = queue_family;
+    recorder->jobs = jobs;
+    for (RecordThread& thread : recorder->threads)
+    {
+        for (RecordThreadFrame& frame : thread.frames)
+        {
+            frame.pool = VK_NULL_HANDLE;
+            frame.buffers.clear();
+            frame.used = 0;
+        }
+        thread.ms = 0.0;
+        thread.ms_avg = 0.0;
+        thread.slices = 0;
+    }
+    recorder->enabled = false;
+    recorder->slice_count = job_system_thread_count(jobs);
+    recorder->wall_ms = 0.0;
+    recorder->wall_ms_avg = 0.0;
+}
+
+void parallel_recorder_destroy(ParallelRecorder *recorder)
+{
+    for (RecordThread& thread : recorder->threads)
+    {
+        for (RecordThreadFrame& frame : thread.frames)
+        {
+            // Destroying the pool frees its command buffers
+            if (frame.pool != VK_NULL_HANDLE)
+                vkDestroyCommandPool(recorder->device, frame.pool, nullptr);
+            frame.pool = VK_NULL_HANDLE;
+            frame.buffers.clear();
+        }
+    }
+}
+
+// Only ever called by the thread owning the pool.
+static VkCommandBuffer parallel_record_begin_secondary(ParallelRecorder *recorder, int thread_index)
+{
+    RecordThreadFrame *frame = &recorder->threads[thread_index].frames[recorder->frame_slot];
+    if (frame->pool == VK_NULL_HANDLE)
+    {
+        VkCommandPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        info.queueFamilyIndex = recorder->queue_family;
+        VkResult err = vkCreateCommandPool(recorder->device, &info, nullptr, &frame->pool);
+        check_vk_result(err);
+    }
+    if (frame->used == frame->buffers.Size)
+    {
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = frame->pool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        info.commandBufferCount = 1;
+        VkCommandBuffer command_buffer;
+        VkResult err = vkAllocateCommandBuffers(recorder->device, &info, &command_buffer);
+        check_vk_result(err);
+        frame->buffers.push_back(command_buffer);
+    }
+    VkCommandBuffer command_buffer = frame->buffers[frame->used++];
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    info.pInheritanceInfo = &recorder->inheritance;
+    VkResult err = vkBeginCommandBuffer(command_buffer, &info);
+    check_vk_result(err);
+
+    // Dynamic state is not inherited from the primary
+    vkCmdSetViewport(command_buffer, 0, 1, &recorder->viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &recorder->scissor);
+    return command_buffer;
+}
+
+static void parallel_record_job(void *user, int slice, int thread_index)
+{
+    ParallelRecorder *recorder = (ParallelRecorder *)user;
+    CPU_SCOPE("record_slice");
+    double start = get_time_ms();
+
+    VkCommandBuffer command_buffer = parallel_record_begin_secondary(recorder, thread_index);
+    recorder->fn(recorder->user, command_buffer, slice, recorder->slice_count);
+    VkResult err = vkEndCommandBuffer(command_buffer);
+    check_vk_result(err);
+    recorder->slice_buffers[slice] = command_buffer;
+
+    RecordThread *thread = &recorder->threads[thread_index];
+    thread->ms += get_time_ms() - start;
+    thread->slices++;
+}
+
+// Records all slices in parallel, then main_fn (may be null) on the calling
+// thread, and executes them from primary. The render pass must have been begun
+// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, and frame_index must
+// identify a frame whose fence has been waited on.
+void parallel_record(ParallelRecorder *recorder, VkCommandBuffer primary, uint32_t frame_index, VkRenderPass render_pass, VkFramebuffer framebuffer,
+                     uint32_t width, uint32_t height, RecordSliceFn fn, void *user, RecordSliceFn main_fn, void *main_user)
+{
+    IM_ASSERT(frame_index < RECORD_MAX_FRAMES);
+    recorder->frame_slot = frame_index;
+    if (recorder->slice_count < 1)
+        recorder->slice_count = 1;
+    if (recorder->slice_count > RECORD_MAX_SLICES)
+        recorder->slice_count = RECORD_MAX_SLICES;
+
+    int thread_count = job_system_thread_count(recorder->jobs);
+    for (int i = 0; i < thread_count; i++)
+    {
+        RecordThread *thread = &recorder->threads[i];
+        RecordThreadFrame *frame = &thread->frames[recorder->frame_slot];
+        if (frame->pool != VK_NULL_HANDLE)
+        {
+            VkResult err = vkResetCommandPool(recorder->device, frame->pool, 0);
+            check_vk_result(err);
+        }
+        frame->used = 0;
+        thread->ms = 0.0;
+        thread->slices = 0;
+    }
+
+    VkCommandBufferInheritanceInfo *inheritance = &recorder->inheritance;
+    *inheritance = {};
+    inheritance->sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance->renderPass = render_pass;
+    inheritance->subpass = 0;
+    inheritance->framebuffer = framebuffer;
+    recorder->viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+    recorder->scissor = { { 0, 0 }, { width, height } };
+    recorder->fn = fn;
+    recorder->user = user;
+
+    double start = get_time_ms();
+    job_system_run(recorder->jobs, recorder->slice_count, parallel_record_job, recorder);
+    recorder->wall_ms = get_time_ms() - start;
+
+    uint32_t buffer_count = (uint32_t)recorder->slice_count;
+    VkCommandBuffer buffers[RECORD_MAX_SLICES + 1];
+    for (uint32_t i = 0; i < buffer_count; i++)
+        buffers[i] = recorder->slice_buffers[i];
+    if (main_fn)
+    {
+        VkCommandBuffer command_buffer = parallel_record_begin_secondary(recorder, 0);
+        main_fn(main_user, command_buffer, 0, 1);
+        VkResult err = vkEndCommandBuffer(command_buffer);
+        check_vk_result(err);
+        buffers[buffer_count++] = command_buffer;
+    }
+    vkCmdExecuteCommands(primary, buffer_count, buffers);
+
+    const float k = 0.05f;
+    recorder->wall_ms_avg += (recorder->wall_ms - recorder->wall_ms_avg) * k;
+    for (int i = 0; i < thread_count; i++)
+    {
+        RecordThread *thread = &recorder->threads[i];
+        thread->ms_avg += (thread->ms - thread->ms_avg) * k;
+    }
+}
+
+void parallel_recorder_draw_ui(ParallelRecorder *recorder)
+{
+    int thread_count = job_system_thread_count(recorder->jobs);
+    ImGui::Checkbox("Record on worker threads", &recorder->enabled);
+    ImGui::SliderInt("Slices", &recorder->slice_count, 1, thread_count * 4);
+    ImGui::Text("%d threads, one command pool per thread and frame", thread_count);
+    if (!recorder->enabled)
+        return;
+
+    double serial_ms = 0.0;
+    for (int i = 0; i < thread_count; i++)
+        serial_ms += recorder->threads[i].ms_avg;
+    ImGui::Text("Wall: %.3f ms, summed: %.3f ms, speedup %.2fx", recorder->wall_ms_avg, serial_ms,
+                recorder->wall_ms_avg > 0.0 ? serial_ms / recorder->wall_ms_avg : 0.0);
+
+    if (ImGui::BeginTable("record_threads", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Thread");
+        ImGui::TableSetupColumn("Slices");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < thread_count; i++)
+        {
+            const RecordThread& thread = recorder->threads[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (i == 0)
+                ImGui::TextUnformatted("main");
+            else
+                ImGui::Text("worker %d", i);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", thread.slices);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", thread.ms_avg);
+        }
+        ImGui::EndTable();
+    }
+}
@@ -0,0 +1,409 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Compute-shader particle simulation. State lives in structure-of-arrays
+// storage buffers, one per ParticleStream, integrated in place by
+// particles.comp each frame and drawn straight from the same buffers as one
+// point per particle, so nothing goes back to the CPU.
+//
+// Buffers are sized to the particle count, rounded up to a power of two, and
+// only allocated once the system is enabled. Growing them waits for the device.
+// New buffers are zero-filled on the GPU, and zero life means respawn.
+//
+// The workgroup size is the largest power of two up to PARTICLES_LOCAL_SIZE
+// that maxComputeWorkGroupSize and maxComputeWorkGroupInvocations allow. Groups
+// beyond maxComputeWorkGroupCount[0] go into a second dispatch dimension.
+
+#define PARTICLES_MAX (1 << 25)
+#define PARTICLES_MIN_CAPACITY (1 << 16)
+#define PARTICLES_LOCAL_SIZE 256
+
+enum ParticleStream
+{
+    PARTICLE_POSITION, // vec2
+    PARTICLE_VELOCITY, // vec2
+    PARTICLE_LIFE,     // float, seconds left
+    PARTICLE_STREAM_COUNT,
+};
+
+static const char *g_ParticleStreamNames[PARTICLE_STREAM_COUNT] = { "particle_positions", "particle_velocities", "particle_lives" };
+static const uint32_t g_ParticleStreamStrides[PARTICLE_STREAM_COUNT] = { 8, 8, 4 };
+
+// Matches the push constants in particles.comp
+struct ParticlePushConstants
+{
+    float delta_time;
+    float time;
+    uint32_t count;
+};
+
+struct ParticleSystem
+{
+    VkDevice device;
+    GpuBuffer streams[PARTICLE_STREAM_COUNT];
+    uint32_t capacity; // particles the streams hold, 0 until first enabled
+    uint32_t max_count;
+    uint32_t local_size;
+    uint32_t max_groups_x;
+    bool clear_pending; // streams were just (re)created and need zeroing
+
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet set;
+    VkPipeline compute_pipeline;
+    int pipeline;
+
+    bool enabled;
+    int count;
+    float delta_time;
+    double time;
+};
+
+static VkPipelineLayout g_ParticlePipelineLayout = VK_NULL_HANDLE;
+
+static VkPipeline create_particle_compute_pipeline(VkDevice device, VkPipelineCache pipeline_cache, uint32_t local_size)
+{
+    VkShaderModule shader = create_shader_module("particles.comp", device);
+
+    VkSpecializationMapEntry entry = { 0, 0, sizeof(uint32_t) };
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = 1;
+    specialization.pMapEntries = &entry;
+    specialization.dataSize = sizeof(local_size);
+    specialization.pData = &local_size;
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = shader;
+    info.stage.pName = "main";
+    info.stage.pSpecializationInfo = &specialization;
+    info.layout = g_ParticlePipelineLayout;
+
+    VkPipeline pipeline;
+    VkResult err = vkCreateComputePipelines(device, pipeline_cache, 1, &info, nullptr, &pipeline);
+    check_vk_result(err);
+    vkDestroyShaderModule(device, shader, nullptr);
+    return pipeline;
+}
+
+static VkPipeline create_particle_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+    VkShaderModule vert_shader = create_shader_module("particle.vert", device);
+    VkShaderModule frag_shader = create_shader_module("tri.frag", device);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert_shader;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag_shader;
+    stages[1].pName = "main";
+
+    // particle.vert indexes the streams with gl_VertexIndex
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = (uint32_t)IM_ARRAYSIZE(dynamic_states);
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask = (VK_COLOR_COMPONENT_R_BIT |
+                                             VK_COLOR_COMPONENT_G_BIT |
+                                             VK_COLOR_COMPONENT_B_BIT |
+                                             VK_COLOR_COMPONENT_A_BIT);
+    color_blend_attachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_ParticlePipelineLayout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipeline pipeline = create_graphics_pipeline_timed(device, pipeline_cache, &pipeline_info, "particles");
+    vkDestroyShaderModule(device, vert_shader, nullptr);
+    vkDestroyShaderModule(device, frag_shader, nullptr);
+    return pipeline;
+}
+
+static void create_particle_descriptors(ParticleSystem *particles)
+{
+    VkDevice device = particles->device;
+    VkResult err;
+
+    // The simulation writes the streams, the vertex shader reads them
+    VkDescriptorSetLayoutBinding bindings[PARTICLE_STREAM_COUNT] = {};
+    for (uint32_t i = 0; i < PARTICLE_STREAM_COUNT; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = PARTICLE_STREAM_COUNT;
+    layout_info.pBindings = bindings;
+    err = vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &particles->set_layout);
+    check_vk_result(err);
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, PARTICLE_STREAM_COUNT };
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    err = vkCreateDescriptorPool(device, &pool_info, nullptr, &particles->descriptor_pool);
+    check_vk_result(err);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = particles->descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &particles->set_layout;
+    err = vkAllocateDescriptorSets(device, &alloc_info, &particles->set);
+    check_vk_result(err);
+
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(ParticlePushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &particles->set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &range;
+    err = vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &g_ParticlePipelineLayout);
+    check_vk_result(err);
+}
+
+void particles_init(ParticleSystem *particles, GpuAllocator *allocator, VkPipelineCache pipeline_cache, PipelineRegistry *registry)
+{
+    memset(particles, 0, sizeof(*particles));
+    particles->device = allocator->device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    uint32_t local_size = PARTICLES_LOCAL_SIZE;
+    while (local_size > limits.maxComputeWorkGroupSize[0] || local_size > limits.maxComputeWorkGroupInvocations)
+        local_size /= 2;
+    particles->local_size = local_size;
+    particles->max_groups_x = limits.maxComputeWorkGroupCount[0];
+
+    // Each stream has to fit in one storage buffer binding, and all of them
+    // in half of the device local heap's budget
+    uint64_t max_count = PARTICLES_MAX;
+    uint32_t widest = 0;
+    uint32_t particle_bytes = 0;
+    for (uint32_t stride : g_ParticleStreamStrides)
+    {
+        widest = stride > widest ? stride : widest;
+        particle_bytes += stride;
+    }
+    if (limits.maxStorageBufferRange / widest < max_count)
+        max_count = limits.maxStorageBufferRange / widest;
+    for (uint32_t type = 0; type < allocator->memory_properties.memoryTypeCount; type++)
+    {
+        if (allocator->memory_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        {
+            uint64_t budget_count = allocator->heap_budget[allocator->memory_properties.memoryTypes[type].heapIndex] / 2 / particle_bytes;
+            max_count = budget_count < max_count ? budget_count : max_count;
+            break;
+        }
+    }
+    particles->max_count = (uint32_t)max_count;
+
+    create_particle_descriptors(particles);
+    particles->compute_pipeline = create_particle_compute_pipeline(particles->device, pipeline_cache, local_size);
+    particles->pipeline = pipeline_registry_add(registry, "particles", create_particle_pipeline);
+    pipeline_registry_add_shader(registry, particles->pipeline, "particle.vert");
+    pipeline_registry_add_shader(registry, particles->pipeline, "tri.frag");
+
+    particles->enabled = false;
+    particles->count = 1 << 20;
+    if (particles->count > (int)particles->max_count)
+        particles->count = (int)particles->max_count;
+
+    printf("[particles] workgroup %u, up to %u particles\n", local_size, particles->max_count);
+}
+
+static void destroy_particle_streams(ParticleSystem *particles, GpuAllocator *allocator)
+{
+    if (particles->capacity == 0)
+        return;
+    for (GpuBuffer& stream : particles->streams)
+        gpu_destroy_buffer(allocator, &stream);
+    particles->capacity = 0;
+}
+
+// The device must be idle.
+void particles_destroy(ParticleSystem *particles, GpuAllocator *allocator)
+{
+    destroy_particle_streams(particles, allocator);
+    vkDestroyPipeline(particles->device, particles->compute_pipeline, nullptr);
+    vkDestroyPipelineLayout(particles->device, g_ParticlePipelineLayout, nullptr);
+    vkDestroyDescriptorPool(particles->device, particles->descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(particles->device, particles->set_layout, nullptr);
+    g_ParticlePipelineLayout = VK_NULL_HANDLE;
+}
+
+static void grow_particle_streams(ParticleSystem *particles, GpuAllocator *allocator, uint32_t count)
+{
+    uint32_t capacity = PARTICLES_MIN_CAPACITY;
+    while (capacity < count)
+        capacity *= 2;
+    capacity = capacity < particles->max_count ? capacity : particles->max_count;
+
+    // The descriptor set is in use by every frame in flight
+    VkResult err = vkDeviceWaitIdle(particles->device);
+    check_vk_result(err);
+    destroy_particle_streams(particles, allocator);
+
+    VkDescriptorBufferInfo buffer_infos[PARTICLE_STREAM_COUNT];
+    VkWriteDescriptorSet writes[PARTICLE_STREAM_COUNT] = {};
+    for (uint32_t i = 0; i < PARTICLE_STREAM_COUNT; i++)
+    {
+        gpu_create_buffer(allocator, (VkDeviceSize)g_ParticleStreamStrides[i] * capacity,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &particles->streams[i]);
+        buffer_infos[i] = { particles->streams[i].buffer, 0, VK_WHOLE_SIZE };
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = particles->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(particles->device, PARTICLE_STREAM_COUNT, writes, 0, nullptr);
+    particles->capacity = capacity;
+    particles->clear_pending = true;
+}
+
+// CPU side of the frame: clamps the count and grows the streams if needed.
+// Call before the render graph is declared.
+void particles_update(ParticleSystem *particles, GpuAllocator *allocator, float dt)
+{
+    if (!particles->enabled)
+        return;
+    if (particles->count < 1)
+        particles->count = 1;
+    if (particles->count > (int)particles->max_count)
+        particles->count = (int)particles->max_count;
+    if ((uint32_t)particles->count > particles->capacity)
+        grow_particle_streams(particles, allocator, (uint32_t)particles->count);
+    particles->delta_time = dt < 0.1f ? dt : 0.1f;
+    particles->time += particles->delta_time;
+}
+
+bool particles_active(const ParticleSystem *particles)
+{
+    return particles->enabled && particles->capacity > 0;
+}
+
+VkBuffer particles_get_stream(const ParticleSystem *particles, ParticleStream stream)
+{
+    return particles->streams[stream].buffer;
+}
+
+// The simulation step. Barriers against last frame's draw and this frame's
+// are the render graph's; only the zero fill after a resize is handled here.
+void particles_record_compute(ParticleSystem *particles, VkCommandBuffer command_buffer)
+{
+    if (!particles_active(particles))
+        return;
+
+    if (particles->clear_pending)
+    {
+        for (GpuBuffer& stream : particles->streams)
+            vkCmdFillBuffer(command_buffer, stream.buffer, 0, VK_WHOLE_SIZE, 0);
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        particles->clear_pending = false;
+    }
+
+    uint32_t count = (uint32_t)particles->count;
+    uint32_t groups = (count + particles->local_size - 1) / particles->local_size;
+    uint32_t groups_x = groups < particles->max_groups_x ? groups : particles->max_groups_x;
+    uint32_t groups_y = (groups + groups_x - 1) / groups_x;
+
+    ParticlePushConstants constants = { particles->delta_time, (float)particles->time, count };
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->compute_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, g_ParticlePipelineLayout, 0, 1, &particles->set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, g_ParticlePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+}
+
+// Expects viewport and scissor to be set already.
+void particles_record_draw(const ParticleSystem *particles, VkCommandBuffer command_buffer, PipelineRegistry *registry)
+{
+    if (!particles_active(particles))
+        return;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_registry_get(registry, particles->pipeline));
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_ParticlePipelineLayout, 0, 1, &particles->set, 0, nullptr);
+    vkCmdDraw(command_buffer, (uint32_t)particles->count, 1, 0, 0);
+}
+
+// gpu_ms is the simulation pass's GPU time.
+void particles_draw_ui(ParticleSystem *particles, float gpu_ms)
+{
+    ImGui::Checkbox("Enabled##particles", &particles->enabled);
+    ImGui::SliderInt("Particles", &particles->count, 1024, (int)particles->max_count, "%d", ImGuiSliderFlags_Logarithmic);
+    uint32_t groups = ((uint32_t)particles->count + particles->local_size - 1) / particles->local_size;
+    ImGui::Text("Workgroup %u, %u groups, %u allocated (%.1f MiB)", particles->local_size, groups, particles->capacity,
+                particles->capacity * (double)(g_ParticleStreamStrides[0] + g_ParticleStreamStrides[1] + g_ParticleStreamStrides[2]) / (1024.0 * 1024.0));
+    if (particles_active(particles) && gpu_ms > 0.0f)
+        ImGui::Text("Simulation: %.3f ms, %.1f M particles/s", gpu_ms, particles->count / (gpu_ms * 1000.0));
+}
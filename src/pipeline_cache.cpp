@@ -0,0 +1,217 @@
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <unistd.h>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+#define PIPELINE_CACHE_PATH "bin/pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC 0x43505056 // "VPPC"
+#define PIPELINE_CACHE_FILE_VERSION 1
+
+// On-disk layout: this header followed by the raw vkGetPipelineCacheData blob.
+// The checksum catches truncated writes, the driver header inside the blob is
+// checked against the device before anything is handed to the driver.
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t data_size;
+    uint64_t checksum;
+};
+
+enum PipelineCacheResult
+{
+    PIPELINE_CACHE_RESULT_UNKNOWN,
+    PIPELINE_CACHE_RESULT_HIT,
+    PIPELINE_CACHE_RESULT_MISS,
+};
+
+struct PipelineCreateStat
+{
+    char name[64];
+    double ms;
+    PipelineCacheResult result;
+};
+
+static bool g_PipelineCreationFeedback = false;
+static bool g_PipelineCacheWarm = false;
+static ImVector<PipelineCreateStat> g_PipelineCreateStats;
+static std::mutex g_PipelineCreateStatsMutex; // shader reloads build pipelines off the main thread
+
+static bool is_pipeline_cache_compatible(const void *data, size_t size, const VkPhysicalDeviceProperties& properties)
+{
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static const char *get_pipeline_cache_result_str(PipelineCacheResult result)
+{
+    switch (result)
+    {
+        case PIPELINE_CACHE_RESULT_HIT:
+            return "hit";
+        case PIPELINE_CACHE_RESULT_MISS:
+            return "miss";
+        default:
+            return g_PipelineCacheWarm ? "warm cache" : "cold cache";
+    }
+}
+
+// Returns an empty cache if the file is missing, corrupt or was written by a
+// different device/driver, so a stale cache never reaches the driver.
+VkPipelineCache load_pipeline_cache(VkDevice device, VkPhysicalDevice physical_device, const char *path)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    void *data = nullptr;
+    size_t data_size = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (f)
+    {
+        long file_size = -1;
+        if (fseek(f, 0, SEEK_END) == 0)
+            file_size = ftell(f);
+        rewind(f);
+
+        // Everything is checked against the file before allocating, so a
+        // corrupt size can't turn into a huge allocation
+        PipelineCacheFileHeader header;
+        VkPipelineCacheHeaderVersionOne driver_header;
+        if (fread(&header, sizeof(header), 1, f) == 1 &&
+            header.magic == PIPELINE_CACHE_MAGIC &&
+            header.version == PIPELINE_CACHE_FILE_VERSION &&
+            file_size >= (long)sizeof(header) &&
+            header.data_size == (uint64_t)file_size - sizeof(header) &&
+            fread(&driver_header, sizeof(driver_header), 1, f) == 1 &&
+            is_pipeline_cache_compatible(&driver_header, header.data_size, properties))
+        {
+            fseek(f, sizeof(header), SEEK_SET);
+            data = xmalloc(header.data_size);
+            if (fread(data, 1, header.data_size, f) == header.data_size &&
+                fnv1a64(data, header.data_size) == header.checksum &&
+                is_pipeline_cache_compatible(data, header.data_size, properties))
+            {
+                data_size = header.data_size;
+            }
+        }
+        fclose(f);
+
+        if (data_size == 0)
+            fprintf(stderr, "[pipeline cache] Ignoring stale or corrupt cache: %s\n", path);
+    }
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data_size;
+    info.pInitialData = data_size ? data : nullptr;
+
+    VkPipelineCache cache;
+    VkResult err = vkCreatePipelineCache(device, &info, nullptr, &cache);
+    check_vk_result(err);
+    free(data);
+
+    g_PipelineCacheWarm = data_size > 0;
+    printf("[pipeline cache] %s start (%zu bytes loaded)\n", g_PipelineCacheWarm ? "Warm" : "Cold", data_size);
+    return cache;
+}
+
+// Writes to a temporary file and renames it over the old one, so a crash
+// mid-write leaves the previous cache intact.
+void save_pipeline_cache(VkDevice device, VkPipelineCache cache, const char *path)
+{
+    size_t size = 0;
+    VkResult err = vkGetPipelineCacheData(device, cache, &size, nullptr);
+    check_vk_result(err);
+    if (size == 0)
+        return;
+
+    void *data = xmalloc(size);
+    err = vkGetPipelineCacheData(device, cache, &size, data);
+    check_vk_result(err);
+
+    PipelineCacheFileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_FILE_VERSION;
+    header.data_size = size;
+    header.checksum = fnv1a64(data, size);
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "[pipeline cache] Failed to open %s for writing\n", tmp_path);
+        free(data);
+        return;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(data, 1, size, f) == size &&
+              fflush(f) == 0 &&
+              fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    free(data);
+
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "[pipeline cache] Failed to write %s\n", path);
+        remove(tmp_path);
+        return;
+    }
+    printf("[pipeline cache] Saved %zu bytes to %s\n", size, path);
+}
+
+// vkCreateGraphicsPipelines with timing and, when VK_EXT_pipeline_creation_feedback
+// is enabled, the driver's own cache hit/miss report.
+VkPipeline create_graphics_pipeline_timed(VkDevice device, VkPipelineCache cache, VkGraphicsPipelineCreateInfo *info, const char *name)
+{
+    VkPipelineCreationFeedbackEXT feedback = {};
+    VkPipelineCreationFeedbackCreateInfoEXT feedback_info = {};
+    feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    feedback_info.pPipelineCreationFeedback = &feedback;
+    if (g_PipelineCreationFeedback)
+    {
+        feedback_info.pNext = info->pNext;
+        info->pNext = &feedback_info;
+    }
+
+    double start = get_time_ms();
+    VkPipeline pipeline;
+    VkResult err = vkCreateGraphicsPipelines(device, cache, 1, info, nullptr, &pipeline);
+    check_vk_result(err);
+    double ms = get_time_ms() - start;
+
+    if (g_PipelineCreationFeedback)
+        info->pNext = feedback_info.pNext;
+
+    PipelineCreateStat stat = {};
+    snprintf(stat.name, sizeof(stat.name), "%s", name);
+    stat.ms = ms;
+    stat.result = PIPELINE_CACHE_RESULT_UNKNOWN;
+    if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+    {
+        stat.result = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) ? PIPELINE_CACHE_RESULT_HIT : PIPELINE_CACHE_RESULT_MISS;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_PipelineCreateStatsMutex);
+        g_PipelineCreateStats.push_back(stat);
+    }
+
+    printf("[pipeline cache] %s: %.3f ms (%s)\n", stat.name, stat.ms, get_pipeline_cache_result_str(stat.result));
+    return pipeline;
+}
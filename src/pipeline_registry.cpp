@@ -0,0 +1,230 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Pipelines are built with dynamic viewport and scissor, so the only thing
+// tying them to the swapchain is render pass compatibility: attachment formats
+// and sample counts. The registry keys each pipeline on exactly that and
+// rebuilds it only when the key changes. A resize recreates the render pass
+// with the same formats, so it costs no pipeline builds at all.
+//
+// Entries also list the shaders they are built from, so a shader reload knows
+// which pipelines to rebuild. A replaced pipeline is retired rather than
+// destroyed, and freed once no frame in flight can still reference it.
+
+#define PIPELINE_MAX_SHADERS 4
+
+struct PipelineKey
+{
+    VkFormat color_format;
+    VkSampleCountFlagBits samples;
+};
+
+typedef VkPipeline (*PipelineCreateFn)(VkDevice device, VkPipelineCache cache, VkRenderPass render_pass);
+
+struct PipelineEntry
+{
+    const char *name;
+    PipelineCreateFn create;
+    PipelineKey key;
+    VkPipeline pipeline;
+    uint32_t build_count;
+    const char *shaders[PIPELINE_MAX_SHADERS]; // source names in src/shaders
+    int shader_count;
+};
+
+struct RetiredPipeline
+{
+    VkPipeline pipeline;
+    uint64_t frame;
+};
+
+struct PipelineRegistry
+{
+    VkDevice device;
+    VkPipelineCache cache;
+    ImVector<PipelineEntry> entries;
+    ImVector<RetiredPipeline> retired;
+    uint64_t frame;
+    uint32_t rebuilds;
+    uint32_t skips;
+    uint32_t replacements;
+};
+
+static bool pipeline_key_equal(const PipelineKey& a, const PipelineKey& b)
+{
+    return a.color_format == b.color_format && a.samples == b.samples;
+}
+
+// A single subpass render pass compatible with every render pass of key, for
+// building pipelines without holding on to the real one.
+VkRenderPass create_compatible_render_pass(VkDevice device, PipelineKey key)
+{
+    // Only formats and sample counts matter for render pass compatibility
+    VkAttachmentDescription attachment = {};
+    attachment.format = key.color_format;
+    attachment.samples = key.samples;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference color_ref = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_ref;
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = 1;
+    info.pAttachments = &attachment;
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+    VkRenderPass render_pass;
+    VkResult err = vkCreateRenderPass(device, &info, nullptr, &render_pass);
+    check_vk_result(err);
+    return render_pass;
+}
+
+void pipeline_registry_init(PipelineRegistry *registry, VkDevice device, VkPipelineCache cache)
+{
+    registry->device = device;
+    registry->cache = cache;
+    registry->entries.clear();
+    registry->retired.clear();
+    registry->frame = 0;
+    registry->rebuilds = 0;
+    registry->skips = 0;
+    registry->replacements = 0;
+}
+
+static void pipeline_registry_free_retired(PipelineRegistry *registry)
+{
+    for (RetiredPipeline& retired : registry->retired)
+        vkDestroyPipeline(registry->device, retired.pipeline, nullptr);
+    registry->retired.clear();
+}
+
+void pipeline_registry_destroy(PipelineRegistry *registry)
+{
+    for (PipelineEntry& entry : registry->entries)
+    {
+        if (entry.pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(registry->device, entry.pipeline, nullptr);
+    }
+    registry->entries.clear();
+    pipeline_registry_free_retired(registry);
+}
+
+// Returns a handle for pipeline_registry_get. Nothing is built until the first
+// pipeline_registry_update.
+int pipeline_registry_add(PipelineRegistry *registry, const char *name, PipelineCreateFn create)
+{
+    PipelineEntry entry = {};
+    entry.name = name;
+    entry.create = create;
+    entry.pipeline = VK_NULL_HANDLE;
+    registry->entries.push_back(entry);
+    return registry->entries.Size - 1;
+}
+
+// Records that the pipeline is built from src/shaders/<shader>.
+void pipeline_registry_add_shader(PipelineRegistry *registry, int handle, const char *shader)
+{
+    PipelineEntry *entry = &registry->entries[handle];
+    IM_ASSERT(entry->shader_count < PIPELINE_MAX_SHADERS);
+    entry->shaders[entry->shader_count++] = shader;
+}
+
+bool pipeline_registry_uses_shader(PipelineRegistry *registry, int handle, const char *shader)
+{
+    const PipelineEntry *entry = &registry->entries[handle];
+    for (int i = 0; i < entry->shader_count; i++)
+    {
+        if (strcmp(entry->shaders[i], shader) == 0)
+            return true;
+    }
+    return false;
+}
+
+VkPipeline pipeline_registry_get(PipelineRegistry *registry, int handle)
+{
+    return registry->entries[handle].pipeline;
+}
+
+// Call once per frame, after waiting for the frame slot's fence and before
+// recording. Frees pipelines retired at least frames_in_flight frames ago.
+void pipeline_registry_begin_frame(PipelineRegistry *registry, uint32_t frames_in_flight)
+{
+    registry->frame++;
+    for (int i = 0; i < registry->retired.Size;)
+    {
+        if (registry->frame - registry->retired[i].frame >= frames_in_flight)
+        {
+            vkDestroyPipeline(registry->device, registry->retired[i].pipeline, nullptr);
+            registry->retired.erase_unsorted(&registry->retired[i]);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+// Swaps in a pipeline built elsewhere for key. Takes ownership: if the entry
+// has moved on to another key since, the pipeline is destroyed and false is
+// returned. Call between frames.
+bool pipeline_registry_replace(PipelineRegistry *registry, int handle, PipelineKey key, VkPipeline pipeline)
+{
+    PipelineEntry *entry = &registry->entries[handle];
+    if (entry->pipeline == VK_NULL_HANDLE || !pipeline_key_equal(entry->key, key))
+    {
+        vkDestroyPipeline(registry->device, pipeline, nullptr);
+        return false;
+    }
+    registry->retired.push_back({ entry->pipeline, registry->frame });
+    entry->pipeline = pipeline;
+    entry->build_count++;
+    registry->replacements++;
+    return true;
+}
+
+// Call whenever the render pass may have been recreated. The device must be
+// idle, since pipelines whose key changed are destroyed right away.
+void pipeline_registry_update(PipelineRegistry *registry, VkRenderPass render_pass, PipelineKey key)
+{
+    pipeline_registry_free_retired(registry);
+    for (PipelineEntry& entry : registry->entries)
+    {
+        if (entry.pipeline != VK_NULL_HANDLE && pipeline_key_equal(entry.key, key))
+        {
+            registry->skips++;
+            continue;
+        }
+
+        if (entry.pipeline != VK_NULL_HANDLE)
+        {
+            printf("[pipelines] %s: render pass format changed, rebuilding\n", entry.name);
+            vkDestroyPipeline(registry->device, entry.pipeline, nullptr);
+            registry->rebuilds++;
+        }
+        entry.pipeline = entry.create(registry->device, registry->cache, render_pass);
+        entry.key = key;
+        entry.build_count++;
+    }
+}
+
+void pipeline_registry_draw_ui(PipelineRegistry *registry)
+{
+    ImGui::BulletText("Rebuilds: %u, skipped: %u, hot swapped: %u, retired: %d", registry->rebuilds, registry->skips, registry->replacements, registry->retired.Size);
+    for (PipelineEntry& entry : registry->entries)
+    {
+        ImGui::BulletText("%s: format %d, %d samples, built %u times", entry.name, entry.key.color_format, entry.key.samples, entry.build_count);
+    }
+}
@@ -0,0 +1,331 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// A family of pipelines that differ in fixed function state and
+// specialization constants, indexed 0..count-1. The variants the app knows it
+// needs are compiled up front, spread over the job system. Anything else is
+// compiled the first time it's asked for, on a background thread, and the
+// caller's fallback pipeline is used until it's ready, so a frame never waits
+// on a compile. Variants are built against a private compatible render pass
+// and depend on the render pass key only, like registry entries.
+
+#define PIPELINE_MAX_VARIANTS 64
+
+typedef VkPipeline (*VariantCreateFn)(VkDevice device, VkPipelineCache cache, VkRenderPass render_pass, int variant);
+typedef void (*VariantNameFn)(int variant, char *buf, size_t size);
+
+enum VariantState
+{
+    VARIANT_MISSING,
+    VARIANT_QUEUED,
+    VARIANT_READY,
+};
+
+struct PipelineVariant
+{
+    std::atomic<int> state; // VariantState; pipeline is valid once READY
+    VkPipeline pipeline;
+    double ms;
+    int thread_index; // -1 for the lazy compile thread
+};
+
+struct PipelineVariantSet
+{
+    const char *name;
+    VkDevice device;
+    VkPipelineCache cache;
+    JobSystem *jobs;
+    VariantCreateFn create;
+    VariantNameFn get_name;
+    int variant_count;
+    PipelineVariant variants[PIPELINE_MAX_VARIANTS];
+    const char *shaders[PIPELINE_MAX_SHADERS]; // source names, for the shader reloader
+    int shader_count;
+    ImVector<int> rebuild; // variants pipeline_variants_rebuild compiles
+
+    PipelineKey key;
+    VkRenderPass render_pass;
+
+    // Startup compile, last build
+    const int *startup;
+    int startup_count;
+    double startup_wall_ms;
+    double startup_serial_ms;
+    int startup_threads;
+
+    // Lazy compile thread; the mutex guards the fields below
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    ImVector<int> queue;
+    bool busy;
+    bool quit;
+    int lazy_compiles;
+};
+
+static void pipeline_variants_compile(PipelineVariantSet *set, int variant, int thread_index)
+{
+    PipelineVariant *v = &set->variants[variant];
+    double start = get_time_ms();
+    v->pipeline = set->create(set->device, set->cache, set->render_pass, variant);
+    v->ms = get_time_ms() - start;
+    v->thread_index = thread_index;
+    v->state.store(VARIANT_READY, std::memory_order_release);
+}
+
+static void pipeline_variants_thread(PipelineVariantSet *set)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%s variants", set->name);
+    cpu_profiler_set_thread_name(name);
+
+    std::unique_lock<std::mutex> lock(set->mutex);
+    for (;;)
+    {
+        set->cv.wait(lock, [&] { return set->quit || set->queue.Size > 0; });
+        if (set->quit)
+            return;
+        int variant = set->queue[0];
+        set->queue.erase(set->queue.begin());
+        set->busy = true;
+        lock.unlock();
+
+        {
+            CPU_SCOPE("variant_compile");
+            pipeline_variants_compile(set, variant, -1);
+        }
+        char variant_name[64];
+        set->get_name(variant, variant_name, sizeof(variant_name));
+        printf("[variants] %s compiled on demand in %.3f ms\n", variant_name, set->variants[variant].ms);
+
+        lock.lock();
+        set->busy = false;
+        set->lazy_compiles++;
+        set->cv.notify_all();
+    }
+}
+
+static void pipeline_variants_startup_job(void *user, int job, int thread_index)
+{
+    PipelineVariantSet *set = (PipelineVariantSet *)user;
+    CPU_SCOPE("variant_compile");
+    pipeline_variants_compile(set, set->startup[job], thread_index);
+}
+
+static void pipeline_variants_rebuild_job(void *user, int job, int thread_index)
+{
+    PipelineVariantSet *set = (PipelineVariantSet *)user;
+    CPU_SCOPE("variant_compile");
+    pipeline_variants_compile(set, set->rebuild[job], thread_index);
+}
+
+void pipeline_variants_init(PipelineVariantSet *set, const char *name, VkDevice device, VkPipelineCache cache, JobSystem *jobs,
+                            VariantCreateFn create, VariantNameFn get_name, int variant_count)
+{
+    IM_ASSERT(variant_count <= PIPELINE_MAX_VARIANTS);
+    set->name = name;
+    set->device = device;
+    set->cache = cache;
+    set->jobs = jobs;
+    set->create = create;
+    set->get_name = get_name;
+    set->variant_count = variant_count;
+    set->shader_count = 0;
+    for (PipelineVariant& v : set->variants)
+    {
+        v.state = VARIANT_MISSING;
+        v.pipeline = VK_NULL_HANDLE;
+        v.ms = 0.0;
+        v.thread_index = 0;
+    }
+    set->key = {};
+    set->render_pass = VK_NULL_HANDLE;
+    set->startup = nullptr;
+    set->startup_count = 0;
+    set->startup_wall_ms = 0.0;
+    set->startup_serial_ms = 0.0;
+    set->startup_threads = 0;
+    set->queue.clear();
+    set->busy = false;
+    set->quit = false;
+    set->lazy_compiles = 0;
+    set->thread = std::thread(pipeline_variants_thread, set);
+}
+
+// Like pipeline_registry_add_shader: a change to shader rebuilds the set.
+void pipeline_variants_add_shader(PipelineVariantSet *set, const char *shader)
+{
+    IM_ASSERT(set->shader_count < PIPELINE_MAX_SHADERS);
+    set->shaders[set->shader_count++] = shader;
+}
+
+bool pipeline_variants_uses_shader(const PipelineVariantSet *set, const char *shader)
+{
+    for (int i = 0; i < set->shader_count; i++)
+    {
+        if (strcmp(set->shaders[i], shader) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Drops queued compiles and waits out the one in progress.
+static void pipeline_variants_drain(PipelineVariantSet *set)
+{
+    std::unique_lock<std::mutex> lock(set->mutex);
+    for (int variant : set->queue)
+        set->variants[variant].state = VARIANT_MISSING;
+    set->queue.clear();
+    set->cv.wait(lock, [&] { return !set->busy; });
+}
+
+static void pipeline_variants_release(PipelineVariantSet *set)
+{
+    for (PipelineVariant& v : set->variants)
+    {
+        if (v.state.load(std::memory_order_acquire) == VARIANT_READY)
+            vkDestroyPipeline(set->device, v.pipeline, nullptr);
+        v.state = VARIANT_MISSING;
+        v.pipeline = VK_NULL_HANDLE;
+    }
+    if (set->render_pass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(set->device, set->render_pass, nullptr);
+    set->render_pass = VK_NULL_HANDLE;
+}
+
+// The device must be idle.
+void pipeline_variants_destroy(PipelineVariantSet *set)
+{
+    pipeline_variants_drain(set);
+    {
+        std::lock_guard<std::mutex> lock(set->mutex);
+        set->quit = true;
+    }
+    set->cv.notify_all();
+    set->thread.join();
+    pipeline_variants_release(set);
+}
+
+// Compiles the startup variants for key in parallel and blocks until they are
+// done. startup must stay valid until the next build. Like
+// pipeline_registry_update, call whenever the render pass may have changed,
+// with the device idle; nothing happens if the key is the same.
+void pipeline_variants_build(PipelineVariantSet *set, PipelineKey key, const int *startup, int startup_count)
+{
+    if (set->render_pass != VK_NULL_HANDLE && pipeline_key_equal(set->key, key))
+        return;
+    pipeline_variants_drain(set);
+    pipeline_variants_release(set);
+    set->key = key;
+    set->render_pass = create_compatible_render_pass(set->device, key);
+    set->startup = startup;
+    set->startup_count = startup_count;
+
+    double start = get_time_ms();
+    job_system_run(set->jobs, startup_count, pipeline_variants_startup_job, set);
+    set->startup_wall_ms = get_time_ms() - start;
+    set->startup_threads = job_system_thread_count(set->jobs);
+
+    set->startup_serial_ms = 0.0;
+    for (int i = 0; i < startup_count; i++)
+        set->startup_serial_ms += set->variants[startup[i]].ms;
+    printf("[variants] %s: %d of %d variants in %.3f ms on %d threads (%.3f ms summed, %.2fx)\n", set->name, startup_count, set->variant_count,
+           set->startup_wall_ms, set->startup_threads, set->startup_serial_ms, set->startup_wall_ms > 0.0 ? set->startup_serial_ms / set->startup_wall_ms : 0.0);
+}
+
+// Recompiles every variant compiled so far against the same render pass, in
+// parallel, for when one of the set's shaders changed. Queued variants are
+// dropped and queued again on their next use. The device must be idle.
+void pipeline_variants_rebuild(PipelineVariantSet *set)
+{
+    if (set->render_pass == VK_NULL_HANDLE)
+        return;
+    pipeline_variants_drain(set);
+    set->rebuild.clear();
+    for (int i = 0; i < set->variant_count; i++)
+    {
+        PipelineVariant *v = &set->variants[i];
+        if (v->state.load(std::memory_order_acquire) != VARIANT_READY)
+            continue;
+        vkDestroyPipeline(set->device, v->pipeline, nullptr);
+        v->pipeline = VK_NULL_HANDLE;
+        v->state = VARIANT_MISSING;
+        set->rebuild.push_back(i);
+    }
+
+    double start = get_time_ms();
+    job_system_run(set->jobs, set->rebuild.Size, pipeline_variants_rebuild_job, set);
+    printf("[variants] %s: rebuilt %d variants in %.3f ms\n", set->name, set->rebuild.Size, get_time_ms() - start);
+}
+
+// Returns the variant if it's compiled, otherwise queues it and returns
+// fallback. Safe to call from recording threads.
+VkPipeline pipeline_variants_get(PipelineVariantSet *set, int variant, VkPipeline fallback)
+{
+    PipelineVariant *v = &set->variants[variant];
+    int state = v->state.load(std::memory_order_acquire);
+    if (state == VARIANT_READY)
+        return v->pipeline;
+    if (state == VARIANT_MISSING && v->state.compare_exchange_strong(state, VARIANT_QUEUED))
+    {
+        {
+            std::lock_guard<std::mutex> lock(set->mutex);
+            set->queue.push_back(variant);
+        }
+        set->cv.notify_all();
+    }
+    return fallback;
+}
+
+void pipeline_variants_draw_ui(PipelineVariantSet *set)
+{
+    ImGui::Text("Startup: %d variants in %.3f ms on %d threads, %.3f ms summed (%.2fx)", set->startup_count, set->startup_wall_ms, set->startup_threads,
+                set->startup_serial_ms, set->startup_wall_ms > 0.0 ? set->startup_serial_ms / set->startup_wall_ms : 0.0);
+    {
+        std::lock_guard<std::mutex> lock(set->mutex);
+        ImGui::Text("Compiled on demand: %d, queued: %d", set->lazy_compiles, set->queue.Size);
+    }
+
+    if (ImGui::BeginTable("variants", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 200.0f)))
+    {
+        ImGui::TableSetupColumn("Variant");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("Compiled by");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < set->variant_count; i++)
+        {
+            const PipelineVariant& v = set->variants[i];
+            char name[64];
+            set->get_name(i, name, sizeof(name));
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            int state = v.state.load(std::memory_order_acquire);
+            ImGui::TableNextColumn();
+            if (state == VARIANT_READY)
+                ImGui::Text("%.3f", v.ms);
+            ImGui::TableNextColumn();
+            if (state == VARIANT_MISSING)
+                ImGui::TextDisabled("not requested");
+            else if (state == VARIANT_QUEUED)
+                ImGui::TextUnformatted("compiling...");
+            else if (v.thread_index < 0)
+                ImGui::TextUnformatted("on demand");
+            else if (v.thread_index == 0)
+                ImGui::TextUnformatted("startup, main");
+            else
+                ImGui::Text("startup, worker %d", v.thread_index);
+        }
+        ImGui::EndTable();
+    }
+}
@@ -0,0 +1,847 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Per-frame render graph. Every frame, passes are declared in execution
+// order together with the resources they read and write. Compiling the graph
+// then works out:
+//
+// - which passes to run: passes whose writes reach no output are culled
+// - which consecutive graphics passes share one render pass instance: same
+//   attachments, later passes load rather than clear
+// - the pipeline barriers and image layout transitions between them, folded
+//   into one vkCmdPipelineBarrier per step, or into the render pass's
+//   external dependency and initial/final layouts for attachments
+//
+// The compiled steps are cached against a key built from the declarations
+// (not the handles), so a frame with the same topology as the last one only
+// rebuilds the key. Render passes are cached by description for the life of
+// the graph, and framebuffers by attachment views until
+// render_graph_reset_framebuffers.
+//
+// Resources are imported: the graph tracks their state but doesn't own them.
+// Imported buffers declare the stage and access they may still be in from the
+// previous frame, so the first write of the frame waits for it.
+
+#define RENDER_GRAPH_MAX_ATTACHMENTS 4
+
+enum RenderGraphPassType
+{
+    RENDER_GRAPH_GRAPHICS,
+    RENDER_GRAPH_COMPUTE,
+};
+
+enum RenderGraphPassFlags
+{
+    RENDER_GRAPH_SECONDARY = 1 << 0,   // records the render pass contents into secondaries
+    RENDER_GRAPH_SIDE_EFFECTS = 1 << 1, // never culled
+};
+
+struct RenderGraphContext
+{
+    VkCommandBuffer command_buffer;
+    VkRenderPass render_pass; // graphics passes only
+    VkFramebuffer framebuffer;
+    uint32_t width;
+    uint32_t height;
+};
+
+typedef void (*RenderGraphPassFn)(const RenderGraphContext *ctx, void *user);
+typedef int (*RenderGraphScopeBeginFn)(void *user, VkCommandBuffer command_buffer, const char *name);
+typedef void (*RenderGraphScopeEndFn)(void *user, VkCommandBuffer command_buffer, int scope);
+
+struct RenderGraphResource
+{
+    const char *name;
+    bool image;
+    bool output; // its final contents are used after the graph
+    VkImage vk_image;
+    VkImageView view;
+    VkBuffer buffer;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    VkImageLayout final_layout;  // images: left in this layout, UNDEFINED for don't care
+    VkPipelineStageFlags initial_stage; // from before the graph
+    VkAccessFlags initial_access;
+};
+
+struct RenderGraphUse
+{
+    int pass;
+    int resource;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    bool write;
+    bool attachment;
+    VkAttachmentLoadOp load_op;
+    VkClearValue clear_value;
+};
+
+struct RenderGraphPass
+{
+    const char *name;
+    RenderGraphPassType type;
+    uint32_t flags;
+    RenderGraphPassFn fn;
+    void *user;
+};
+
+struct RenderGraphBarrier
+{
+    int resource;
+    VkPipelineStageFlags src_stage;
+    VkPipelineStageFlags dst_stage;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+};
+
+// One render pass instance, one compute pass, or the trailing transitions
+struct RenderGraphStep
+{
+    int first_pass; // into RenderGraph::order
+    int pass_count;
+    int first_barrier; // issued before the step
+    int barrier_count;
+    VkRenderPass render_pass;
+    int attachments[RENDER_GRAPH_MAX_ATTACHMENTS];
+    int attachment_count;
+    bool secondary;
+};
+
+struct RenderGraphRenderPassKey
+{
+    VkFormat formats[RENDER_GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentLoadOp load_ops[RENDER_GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentStoreOp store_ops[RENDER_GRAPH_MAX_ATTACHMENTS];
+    VkImageLayout initial_layouts[RENDER_GRAPH_MAX_ATTACHMENTS];
+    VkImageLayout final_layouts[RENDER_GRAPH_MAX_ATTACHMENTS];
+    uint32_t attachment_count;
+    VkPipelineStageFlags src_stage;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+};
+
+struct RenderGraphRenderPass
+{
+    RenderGraphRenderPassKey key;
+    VkRenderPass render_pass;
+};
+
+struct RenderGraphFramebuffer
+{
+    VkRenderPass render_pass;
+    VkImageView views[RENDER_GRAPH_MAX_ATTACHMENTS];
+    uint32_t width;
+    uint32_t height;
+    VkFramebuffer framebuffer;
+};
+
+struct RenderGraph
+{
+    VkDevice device;
+
+    // Declared this frame
+    ImVector<RenderGraphResource> resources;
+    ImVector<RenderGraphPass> passes;
+    ImVector<RenderGraphUse> uses;
+
+    // Compiled, valid while key matches
+    ImVector<uint64_t> key;
+    ImVector<uint64_t> next_key;
+    ImVector<int> order; // surviving passes
+    ImVector<RenderGraphStep> steps;
+    ImVector<RenderGraphBarrier> barriers;
+    ImVector<bool> culled; // per declared pass
+
+    ImVector<RenderGraphRenderPass> render_passes;
+    ImVector<RenderGraphFramebuffer> framebuffers;
+
+    uint64_t compile_count;
+    double compile_ms;
+    uint32_t frame_barriers; // vkCmdPipelineBarrier calls last frame
+
+    // Wrapped around render pass instances recorded into secondaries, which
+    // can't time themselves from the primary: inside the render pass it may
+    // only execute the secondaries
+    RenderGraphScopeBeginFn scope_begin;
+    RenderGraphScopeEndFn scope_end;
+    void *scope_user;
+};
+
+void render_graph_init(RenderGraph *graph, VkDevice device)
+{
+    graph->device = device;
+    graph->compile_count = 0;
+    graph->compile_ms = 0.0;
+    graph->frame_barriers = 0;
+    graph->scope_begin = nullptr;
+    graph->scope_end = nullptr;
+    graph->scope_user = nullptr;
+}
+
+// Scopes are named after the first pass of the render pass instance.
+void render_graph_set_scope_fns(RenderGraph *graph, RenderGraphScopeBeginFn begin, RenderGraphScopeEndFn end, void *user)
+{
+    graph->scope_begin = begin;
+    graph->scope_end = end;
+    graph->scope_user = user;
+}
+
+void render_graph_reset_framebuffers(RenderGraph *graph)
+{
+    for (RenderGraphFramebuffer& fb : graph->framebuffers)
+        vkDestroyFramebuffer(graph->device, fb.framebuffer, nullptr);
+    graph->framebuffers.clear();
+}
+
+void render_graph_destroy(RenderGraph *graph)
+{
+    render_graph_reset_framebuffers(graph);
+    for (RenderGraphRenderPass& rp : graph->render_passes)
+        vkDestroyRenderPass(graph->device, rp.render_pass, nullptr);
+    graph->render_passes.clear();
+    graph->key.clear();
+}
+
+//
+// Declaration
+//
+
+void render_graph_begin(RenderGraph *graph)
+{
+    graph->resources.resize(0);
+    graph->passes.resize(0);
+    graph->uses.resize(0);
+}
+
+int render_graph_import_image(RenderGraph *graph, const char *name, VkImage image, VkImageView view, VkFormat format, uint32_t width, uint32_t height,
+                              VkPipelineStageFlags initial_stage, VkImageLayout final_layout, bool output)
+{
+    RenderGraphResource resource = {};
+    resource.name = name;
+    resource.image = true;
+    resource.output = output;
+    resource.vk_image = image;
+    resource.view = view;
+    resource.format = format;
+    resource.width = width;
+    resource.height = height;
+    resource.final_layout = final_layout;
+    resource.initial_stage = initial_stage;
+    graph->resources.push_back(resource);
+    return graph->resources.Size - 1;
+}
+
+int render_graph_import_buffer(RenderGraph *graph, const char *name, VkBuffer buffer, VkPipelineStageFlags initial_stage, VkAccessFlags initial_access)
+{
+    RenderGraphResource resource = {};
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.initial_stage = initial_stage;
+    resource.initial_access = initial_access;
+    graph->resources.push_back(resource);
+    return graph->resources.Size - 1;
+}
+
+int render_graph_add_pass(RenderGraph *graph, const char *name, RenderGraphPassType type, uint32_t flags, RenderGraphPassFn fn, void *user)
+{
+    RenderGraphPass pass = { name, type, flags, fn, user };
+    graph->passes.push_back(pass);
+    return graph->passes.Size - 1;
+}
+
+static void render_graph_add_use(RenderGraph *graph, int pass, int resource, VkPipelineStageFlags stage, VkAccessFlags access, VkImageLayout layout, bool write)
+{
+    RenderGraphUse use = {};
+    use.pass = pass;
+    use.resource = resource;
+    use.stage = stage;
+    use.access = access;
+    use.layout = layout;
+    use.write = write;
+    graph->uses.push_back(use);
+}
+
+void render_graph_read_buffer(RenderGraph *graph, int pass, int resource, VkPipelineStageFlags stage, VkAccessFlags access)
+{
+    render_graph_add_use(graph, pass, resource, stage, access, VK_IMAGE_LAYOUT_UNDEFINED, false);
+}
+
+void render_graph_write_buffer(RenderGraph *graph, int pass, int resource, VkPipelineStageFlags stage, VkAccessFlags access)
+{
+    render_graph_add_use(graph, pass, resource, stage, access, VK_IMAGE_LAYOUT_UNDEFINED, true);
+}
+
+// E.g. a sampled input of a post-processing pass.
+void render_graph_read_image(RenderGraph *graph, int pass, int resource, VkPipelineStageFlags stage, VkAccessFlags access, VkImageLayout layout)
+{
+    render_graph_add_use(graph, pass, resource, stage, access, layout, false);
+}
+
+// LOAD keeps what earlier passes rendered, so it also reads the image.
+// clear_value is only used with CLEAR and may change every frame.
+void render_graph_color_attachment(RenderGraph *graph, int pass, int resource, VkAttachmentLoadOp load_op, const VkClearValue *clear_value)
+{
+    VkAccessFlags access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    if (load_op == VK_ATTACHMENT_LOAD_OP_LOAD)
+        access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    render_graph_add_use(graph, pass, resource, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, access, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+    RenderGraphUse& use = graph->uses.back();
+    use.attachment = true;
+    use.load_op = load_op;
+    if (clear_value)
+        use.clear_value = *clear_value;
+}
+
+//
+// Compilation
+//
+
+static void render_graph_build_key(RenderGraph *graph, ImVector<uint64_t> *key)
+{
+    key->resize(0);
+    for (const RenderGraphResource& r : graph->resources)
+    {
+        key->push_back(fnv1a64(r.name, strlen(r.name)));
+        key->push_back((uint64_t)r.image | (uint64_t)r.output << 1);
+        key->push_back((uint64_t)r.format | (uint64_t)r.final_layout << 32);
+        key->push_back((uint64_t)r.width | (uint64_t)r.height << 32);
+        key->push_back((uint64_t)r.initial_stage | (uint64_t)r.initial_access << 32);
+    }
+    for (const RenderGraphPass& p : graph->passes)
+    {
+        key->push_back(fnv1a64(p.name, strlen(p.name)));
+        key->push_back((uint64_t)p.type | (uint64_t)p.flags << 8);
+    }
+    for (const RenderGraphUse& u : graph->uses)
+    {
+        key->push_back((uint64_t)u.pass | (uint64_t)u.resource << 32);
+        key->push_back((uint64_t)u.stage | (uint64_t)u.access << 32);
+        key->push_back((uint64_t)u.layout | (uint64_t)u.write << 32 | (uint64_t)u.attachment << 33 | (uint64_t)u.load_op << 40);
+    }
+}
+
+// Walks back from the outputs: a pass survives if it writes something a
+// later surviving pass reads or that leaves the graph.
+static void render_graph_cull(RenderGraph *graph)
+{
+    ImVector<bool> needed;
+    needed.resize(graph->resources.Size);
+    for (int i = 0; i < graph->resources.Size; i++)
+        needed[i] = graph->resources[i].output;
+
+    graph->culled.resize(graph->passes.Size);
+    for (int p = graph->passes.Size - 1; p >= 0; p--)
+    {
+        bool alive = (graph->passes[p].flags & RENDER_GRAPH_SIDE_EFFECTS) != 0;
+        for (const RenderGraphUse& u : graph->uses)
+        {
+            if (u.pass == p && u.write && needed[u.resource])
+                alive = true;
+        }
+        graph->culled[p] = !alive;
+        if (!alive)
+            continue;
+
+        // A clear replaces the whole image, so earlier writers are only needed through other reads
+        for (const RenderGraphUse& u : graph->uses)
+        {
+            if (u.pass == p && u.attachment && u.load_op != VK_ATTACHMENT_LOAD_OP_LOAD)
+                needed[u.resource] = false;
+        }
+        for (const RenderGraphUse& u : graph->uses)
+        {
+            if (u.pass == p && (!u.write || (u.attachment && u.load_op == VK_ATTACHMENT_LOAD_OP_LOAD)))
+                needed[u.resource] = true;
+        }
+    }
+}
+
+static const VkAccessFlags RENDER_GRAPH_READ_ACCESS = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                                     VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                                     VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+struct RenderGraphState
+{
+    VkPipelineStageFlags write_stage; // last write
+    VkAccessFlags write_access;
+    VkPipelineStageFlags read_stages;    // reads since the last write
+    VkPipelineStageFlags visible_stages; // stages the last write is already visible to
+    VkImageLayout layout;
+};
+
+// Adds the barrier a use needs against the tracked state and updates it.
+// Returns false if none was needed.
+static bool render_graph_sync(RenderGraphState *state, int resource, bool image, const RenderGraphUse& use, RenderGraphBarrier *out)
+{
+    RenderGraphBarrier barrier = {};
+    barrier.resource = resource;
+    barrier.old_layout = state->layout;
+    barrier.new_layout = image ? use.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.dst_stage = use.stage;
+    barrier.dst_access = use.access;
+
+    bool transition = image && state->layout != use.layout;
+    bool needed = transition;
+    if (use.write || transition)
+    {
+        // Write after write/read, or a layout change, which is a write too
+        barrier.src_stage = state->write_stage | state->read_stages;
+        barrier.src_access = state->write_access;
+        needed |= barrier.src_stage != 0;
+        state->write_stage = use.write ? use.stage : state->write_stage;
+        state->write_access = use.write ? use.access & ~RENDER_GRAPH_READ_ACCESS : state->write_access;
+        state->read_stages = use.write ? 0 : use.stage;
+        state->visible_stages = use.write ? 0 : use.stage;
+    }
+    else if (state->write_access && (state->visible_stages & use.stage) != use.stage)
+    {
+        barrier.src_stage = state->write_stage;
+        barrier.src_access = state->write_access;
+        needed = true;
+        state->visible_stages |= use.stage;
+        state->read_stages |= use.stage;
+    }
+    else
+    {
+        state->read_stages |= use.stage;
+    }
+    if (image)
+        state->layout = use.layout;
+    if (needed && barrier.src_stage == 0)
+        barrier.src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    *out = barrier;
+    return needed;
+}
+
+static VkRenderPass render_graph_get_render_pass(RenderGraph *graph, const RenderGraphRenderPassKey& key)
+{
+    for (const RenderGraphRenderPass& rp : graph->render_passes)
+    {
+        if (memcmp(&rp.key, &key, sizeof(key)) == 0)
+            return rp.render_pass;
+    }
+
+    VkAttachmentDescription attachments[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+    VkAttachmentReference references[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+    for (uint32_t i = 0; i < key.attachment_count; i++)
+    {
+        attachments[i].format = key.formats[i];
+        attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[i].loadOp = key.load_ops[i];
+        attachments[i].storeOp = key.store_ops[i];
+        attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].initialLayout = key.initial_layouts[i];
+        attachments[i].finalLayout = key.final_layouts[i];
+        references[i].attachment = i;
+        references[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = key.attachment_count;
+    subpass.pColorAttachments = references;
+
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = key.src_stage;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = key.src_access;
+    dependency.dstAccessMask = key.dst_access;
+
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = key.attachment_count;
+    info.pAttachments = attachments;
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+    info.dependencyCount = 1;
+    info.pDependencies = &dependency;
+
+    RenderGraphRenderPass rp;
+    rp.key = key;
+    VkResult err = vkCreateRenderPass(graph->device, &info, nullptr, &rp.render_pass);
+    check_vk_result(err);
+    graph->render_passes.push_back(rp);
+    return rp.render_pass;
+}
+
+static bool render_graph_used_after(RenderGraph *graph, int resource, int order_index)
+{
+    for (int i = order_index; i < graph->order.Size; i++)
+    {
+        for (const RenderGraphUse& u : graph->uses)
+        {
+            if (u.pass == graph->order[i] && u.resource == resource)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Pass b can join the render pass of the group starting at order[first]:
+// same attachments in the same order, nothing cleared, and none of its other
+// resources written inside the group, so its barriers can go in front of it.
+static bool render_graph_can_merge(RenderGraph *graph, const RenderGraphStep& step, int b)
+{
+    const RenderGraphPass& pass = graph->passes[b];
+    if (pass.type != RENDER_GRAPH_GRAPHICS || ((pass.flags & RENDER_GRAPH_SECONDARY) != 0) != step.secondary)
+        return false;
+
+    int attachment_count = 0;
+    for (const RenderGraphUse& u : graph->uses)
+    {
+        if (u.pass != b)
+            continue;
+        if (u.attachment)
+        {
+            if (attachment_count >= step.attachment_count || step.attachments[attachment_count] != u.resource || u.load_op != VK_ATTACHMENT_LOAD_OP_LOAD)
+                return false;
+            attachment_count++;
+            continue;
+        }
+        for (int i = step.first_pass; i < step.first_pass + step.pass_count; i++)
+        {
+            for (const RenderGraphUse& g : graph->uses)
+            {
+                if (g.pass == graph->order[i] && g.resource == u.resource && (g.write || u.write))
+                    return false;
+            }
+        }
+    }
+    return attachment_count == step.attachment_count;
+}
+
+static void render_graph_compile_steps(RenderGraph *graph)
+{
+    graph->order.resize(0);
+    for (int p = 0; p < graph->passes.Size; p++)
+    {
+        if (!graph->culled[p])
+            graph->order.push_back(p);
+    }
+
+    ImVector<RenderGraphState> states;
+    states.resize(graph->resources.Size);
+    for (int i = 0; i < graph->resources.Size; i++)
+    {
+        const RenderGraphResource& r = graph->resources[i];
+        // Initial writes have to be made visible, initial reads only waited for. An
+        // image's initial stage is what its contents wait on, like the swapchain acquire.
+        RenderGraphState state = {};
+        state.write_access = r.initial_access & ~RENDER_GRAPH_READ_ACCESS;
+        if (state.write_access)
+            state.write_stage = r.initial_stage;
+        else
+            state.read_stages = r.initial_stage;
+        state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        states[i] = state;
+    }
+
+    graph->steps.resize(0);
+    graph->barriers.resize(0);
+    for (int o = 0; o < graph->order.Size;)
+    {
+        int p = graph->order[o];
+        const RenderGraphPass& pass = graph->passes[p];
+        RenderGraphStep step = {};
+        step.first_pass = o;
+        step.pass_count = 1;
+        step.first_barrier = graph->barriers.Size;
+        step.secondary = (pass.flags & RENDER_GRAPH_SECONDARY) != 0;
+        for (const RenderGraphUse& u : graph->uses)
+        {
+            if (u.pass == p && u.attachment)
+            {
+                IM_ASSERT(step.attachment_count < RENDER_GRAPH_MAX_ATTACHMENTS);
+                step.attachments[step.attachment_count++] = u.resource;
+            }
+        }
+        while (pass.type == RENDER_GRAPH_GRAPHICS && o + step.pass_count < graph->order.Size &&
+               render_graph_can_merge(graph, step, graph->order[o + step.pass_count]))
+            step.pass_count++;
+
+        // Barriers for everything but attachments go in front of the step
+        for (int i = o; i < o + step.pass_count; i++)
+        {
+            for (const RenderGraphUse& u : graph->uses)
+            {
+                if (u.pass != graph->order[i] || u.attachment)
+                    continue;
+                RenderGraphBarrier barrier;
+                if (render_graph_sync(&states[u.resource], u.resource, graph->resources[u.resource].image, u, &barrier))
+                    graph->barriers.push_back(barrier);
+            }
+        }
+
+        // Attachments: the dependency and layout changes go in the render pass
+        if (pass.type == RENDER_GRAPH_GRAPHICS)
+        {
+            RenderGraphRenderPassKey key;
+            memset(&key, 0, sizeof(key));
+            key.attachment_count = step.attachment_count;
+            key.dst_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            for (int a = 0; a < step.attachment_count; a++)
+            {
+                int resource = step.attachments[a];
+                const RenderGraphResource& r = graph->resources[resource];
+                const RenderGraphUse *first_use = nullptr;
+                for (const RenderGraphUse& u : graph->uses)
+                {
+                    if (u.pass == p && u.resource == resource && u.attachment)
+                        first_use = &u;
+                }
+                RenderGraphState *state = &states[resource];
+                bool load = first_use->load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+                key.formats[a] = r.format;
+                key.load_ops[a] = first_use->load_op;
+                key.initial_layouts[a] = load ? state->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                key.src_stage |= state->write_stage | state->read_stages;
+                key.src_access |= state->write_access;
+                if (load)
+                    key.dst_access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+
+                // Leave the image in its final layout straight from the render pass if nothing uses it later
+                bool used_later = render_graph_used_after(graph, resource, o + step.pass_count);
+                key.store_ops[a] = used_later || r.output ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                key.final_layouts[a] = !used_later && r.final_layout != VK_IMAGE_LAYOUT_UNDEFINED ? r.final_layout : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                state->write_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                state->write_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                state->read_stages = 0;
+                state->visible_stages = 0;
+                state->layout = key.final_layouts[a];
+            }
+            if (key.src_stage == 0)
+                key.src_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            step.render_pass = render_graph_get_render_pass(graph, key);
+        }
+
+        step.barrier_count = graph->barriers.Size - step.first_barrier;
+        graph->steps.push_back(step);
+        o += step.pass_count;
+    }
+
+    // Whatever isn't in its final layout yet
+    RenderGraphStep tail = {};
+    tail.first_pass = graph->order.Size;
+    tail.first_barrier = graph->barriers.Size;
+    for (int i = 0; i < graph->resources.Size; i++)
+    {
+        const RenderGraphResource& r = graph->resources[i];
+        if (!r.image || r.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || states[i].layout == r.final_layout)
+            continue;
+        RenderGraphUse use = {};
+        use.stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        use.layout = r.final_layout;
+        RenderGraphBarrier barrier;
+        render_graph_sync(&states[i], i, true, use, &barrier);
+        graph->barriers.push_back(barrier);
+    }
+    tail.barrier_count = graph->barriers.Size - tail.first_barrier;
+    if (tail.barrier_count > 0)
+        graph->steps.push_back(tail);
+}
+
+// Recompiles only if the declarations differ from the last compiled frame.
+void render_graph_compile(RenderGraph *graph)
+{
+    render_graph_build_key(graph, &graph->next_key);
+    if (graph->next_key.Size == graph->key.Size && memcmp(graph->next_key.Data, graph->key.Data, sizeof(uint64_t) * graph->key.Size) == 0)
+        return;
+
+    double start = get_time_ms();
+    graph->key.swap(graph->next_key);
+    render_graph_cull(graph);
+    render_graph_compile_steps(graph);
+    graph->compile_count++;
+    graph->compile_ms = get_time_ms() - start;
+}
+
+//
+// Execution
+//
+
+static VkFramebuffer render_graph_get_framebuffer(RenderGraph *graph, const RenderGraphStep& step)
+{
+    RenderGraphFramebuffer fb = {};
+    fb.render_pass = step.render_pass;
+    for (int a = 0; a < step.attachment_count; a++)
+    {
+        const RenderGraphResource& r = graph->resources[step.attachments[a]];
+        fb.views[a] = r.view;
+        fb.width = r.width;
+        fb.height = r.height;
+    }
+    for (const RenderGraphFramebuffer& cached : graph->framebuffers)
+    {
+        if (cached.render_pass == fb.render_pass && memcmp(cached.views, fb.views, sizeof(fb.views)) == 0 &&
+            cached.width == fb.width && cached.height == fb.height)
+            return cached.framebuffer;
+    }
+
+    VkFramebufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    info.renderPass = step.render_pass;
+    info.attachmentCount = (uint32_t)step.attachment_count;
+    info.pAttachments = fb.views;
+    info.width = fb.width;
+    info.height = fb.height;
+    info.layers = 1;
+    VkResult err = vkCreateFramebuffer(graph->device, &info, nullptr, &fb.framebuffer);
+    check_vk_result(err);
+    graph->framebuffers.push_back(fb);
+    return fb.framebuffer;
+}
+
+static void render_graph_issue_barriers(RenderGraph *graph, VkCommandBuffer command_buffer, const RenderGraphStep& step)
+{
+    if (step.barrier_count == 0)
+        return;
+
+    VkBufferMemoryBarrier buffer_barriers[16];
+    VkImageMemoryBarrier image_barriers[16];
+    int buffer_count = 0;
+    int image_count = 0;
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    for (int i = step.first_barrier; i < step.first_barrier + step.barrier_count; i++)
+    {
+        const RenderGraphBarrier& b = graph->barriers[i];
+        const RenderGraphResource& r = graph->resources[b.resource];
+        src_stages |= b.src_stage;
+        dst_stages |= b.dst_stage;
+        if (r.image)
+        {
+            IM_ASSERT(image_count < IM_ARRAYSIZE(image_barriers));
+            VkImageMemoryBarrier& barrier = image_barriers[image_count++];
+            barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.oldLayout = b.old_layout;
+            barrier.newLayout = b.new_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = r.vk_image;
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        }
+        else
+        {
+            IM_ASSERT(buffer_count < IM_ARRAYSIZE(buffer_barriers));
+            VkBufferMemoryBarrier& barrier = buffer_barriers[buffer_count++];
+            barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = r.buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+        }
+    }
+    vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr,
+                         (uint32_t)buffer_count, buffer_barriers, (uint32_t)image_count, image_barriers);
+    graph->frame_barriers++;
+}
+
+// Compiles if needed and records every surviving pass.
+void render_graph_execute(RenderGraph *graph, VkCommandBuffer command_buffer)
+{
+    render_graph_compile(graph);
+    graph->frame_barriers = 0;
+    for (const RenderGraphStep& step : graph->steps)
+    {
+        render_graph_issue_barriers(graph, command_buffer, step);
+
+        RenderGraphContext ctx = {};
+        ctx.command_buffer = command_buffer;
+        if (step.render_pass == VK_NULL_HANDLE)
+        {
+            for (int i = step.first_pass; i < step.first_pass + step.pass_count; i++)
+            {
+                const RenderGraphPass& pass = graph->passes[graph->order[i]];
+                pass.fn(&ctx, pass.user);
+            }
+            continue;
+        }
+
+        VkClearValue clear_values[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+        int first = graph->order[step.first_pass];
+        for (int a = 0; a < step.attachment_count; a++)
+        {
+            for (const RenderGraphUse& u : graph->uses)
+            {
+                if (u.pass == first && u.resource == step.attachments[a] && u.attachment)
+                    clear_values[a] = u.clear_value;
+            }
+        }
+        const RenderGraphResource& target = graph->resources[step.attachments[0]];
+        ctx.render_pass = step.render_pass;
+        ctx.framebuffer = render_graph_get_framebuffer(graph, step);
+        ctx.width = target.width;
+        ctx.height = target.height;
+
+        VkRenderPassBeginInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        info.renderPass = ctx.render_pass;
+        info.framebuffer = ctx.framebuffer;
+        info.renderArea.extent.width = ctx.width;
+        info.renderArea.extent.height = ctx.height;
+        info.clearValueCount = (uint32_t)step.attachment_count;
+        info.pClearValues = clear_values;
+        int scope = -1;
+        if (step.secondary && graph->scope_begin)
+            scope = graph->scope_begin(graph->scope_user, command_buffer, graph->passes[first].name);
+        vkCmdBeginRenderPass(command_buffer, &info, step.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        for (int i = step.first_pass; i < step.first_pass + step.pass_count; i++)
+        {
+            const RenderGraphPass& pass = graph->passes[graph->order[i]];
+            pass.fn(&ctx, pass.user);
+        }
+        vkCmdEndRenderPass(command_buffer);
+        if (step.secondary && graph->scope_end)
+            graph->scope_end(graph->scope_user, command_buffer, scope);
+    }
+}
+
+void render_graph_draw_ui(RenderGraph *graph)
+{
+    ImGui::Text("%d passes declared, %d culled, %d steps, %u barriers last frame", graph->passes.Size,
+                graph->passes.Size - graph->order.Size, graph->steps.Size, graph->frame_barriers);
+    ImGui::Text("Compiled %llu times, last took %.3f ms; %d render passes, %d framebuffers cached",
+                (unsigned long long)graph->compile_count, graph->compile_ms, graph->render_passes.Size, graph->framebuffers.Size);
+    for (const RenderGraphStep& step : graph->steps)
+    {
+        if (step.pass_count == 0)
+        {
+            ImGui::BulletText("final transitions (%d barriers)", step.barrier_count);
+            continue;
+        }
+        char names[256];
+        names[0] = '\0';
+        for (int i = step.first_pass; i < step.first_pass + step.pass_count; i++)
+        {
+            size_t length = strlen(names);
+            snprintf(names + length, sizeof(names) - length, "%s%s", i > step.first_pass ? " + " : "", graph->passes[graph->order[i]].name);
+        }
+        ImGui::BulletText("%s: %s, %d barriers before", step.render_pass ? "render pass" : "compute", names, step.barrier_count);
+    }
+    for (int p = 0; p < graph->passes.Size && p < graph->culled.Size; p++)
+    {
+        if (graph->culled[p])
+            ImGui::BulletText("%s: culled, outputs unused", graph->passes[p].name);
+    }
+}
@@ -0,0 +1,206 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <imgui.h>
+
+#include "helpers.hpp"
+#include "shader_pack.hpp"
+
+#ifdef SHADER_PACK_EMBED
+#include "shaders_embedded.hpp" // generated by tools/shader_pack --embed
+#endif
+
+// All SPIR-V modules in one bundle built by the Makefile, either mapped from
+// bin/shaders.pack or, with make EMBED_SHADERS=1, compiled into the binary.
+// Modules are checked once when the pack is opened and then handed to
+// vkCreateShaderModule straight from the mapping, with no reads or copies.
+// Shaders the hot reloader has rebuilt since are loaded from their loose .spv
+// instead.
+
+#define SHADER_PACK_PATH "bin/shaders.pack"
+#define SHADER_PACK_MAX_ENTRIES 64
+
+enum ShaderPackSource
+{
+    SHADER_PACK_NONE,
+    SHADER_PACK_MAPPED,
+    SHADER_PACK_EMBEDDED,
+};
+
+struct ShaderPack
+{
+    ShaderPackSource source;
+    const uint8_t *data;
+    size_t size;
+    const ShaderPackEntry *entries;
+    uint32_t entry_count;
+    std::atomic<bool> overridden[SHADER_PACK_MAX_ENTRIES];
+    double open_ms;
+};
+
+static ShaderPack g_ShaderPack;
+
+static const char *get_shader_pack_source_str(ShaderPackSource source)
+{
+    switch (source)
+    {
+        case SHADER_PACK_NONE: return "loose files";
+        case SHADER_PACK_MAPPED: return "mapped pack";
+        case SHADER_PACK_EMBEDDED: return "embedded";
+    }
+    return "?";
+}
+
+// Validates everything up front so lookups can trust the index.
+static bool shader_pack_validate(const uint8_t *data, size_t size, const char *what)
+{
+    if (size < sizeof(ShaderPackHeader))
+    {
+        fprintf(stderr, "[shader pack] %s: truncated header\n", what);
+        return false;
+    }
+    ShaderPackHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != SHADER_PACK_MAGIC || header.version != SHADER_PACK_VERSION || header.total_size != size)
+    {
+        fprintf(stderr, "[shader pack] %s: bad header (magic %08x, version %u, size %llu of %zu)\n", what,
+                header.magic, header.version, (unsigned long long)header.total_size, size);
+        return false;
+    }
+    if (header.entry_count > SHADER_PACK_MAX_ENTRIES || header.index_offset % alignof(ShaderPackEntry) != 0 ||
+        header.index_offset + (uint64_t)header.entry_count * sizeof(ShaderPackEntry) > size)
+    {
+        fprintf(stderr, "[shader pack] %s: bad index\n", what);
+        return false;
+    }
+    const ShaderPackEntry *entries = (const ShaderPackEntry *)(data + header.index_offset);
+    for (uint32_t i = 0; i < header.entry_count; i++)
+    {
+        const ShaderPackEntry& entry = entries[i];
+        if (entry.name[SHADER_PACK_NAME_SIZE - 1] != 0 || entry.offset % SHADER_PACK_ALIGNMENT != 0 || entry.size % 4 != 0 ||
+            (uint64_t)entry.offset + entry.size > size)
+        {
+            fprintf(stderr, "[shader pack] %s: bad entry %u\n", what, i);
+            return false;
+        }
+        if (fnv1a64(data + entry.offset, entry.size) != entry.checksum)
+        {
+            fprintf(stderr, "[shader pack] %s: checksum mismatch for %s\n", what, entry.name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void shader_pack_use(ShaderPack *pack, ShaderPackSource source, const uint8_t *data, size_t size)
+{
+    ShaderPackHeader header;
+    memcpy(&header, data, sizeof(header));
+    pack->source = source;
+    pack->data = data;
+    pack->size = size;
+    pack->entries = (const ShaderPackEntry *)(data + header.index_offset);
+    pack->entry_count = header.entry_count;
+}
+
+// Prefers the embedded pack, then bin/shaders.pack. Without either, shaders
+// are read from bin/shaders one file at a time as before.
+void shader_pack_init()
+{
+    ShaderPack *pack = &g_ShaderPack;
+    double start = get_time_ms();
+    pack->source = SHADER_PACK_NONE;
+    pack->data = nullptr;
+    pack->size = 0;
+    pack->entries = nullptr;
+    pack->entry_count = 0;
+    for (std::atomic<bool>& overridden : pack->overridden)
+        overridden = false;
+
+#ifdef SHADER_PACK_EMBED
+    if (shader_pack_validate(g_EmbeddedShaderPack, sizeof(g_EmbeddedShaderPack), "embedded"))
+        shader_pack_use(pack, SHADER_PACK_EMBEDDED, g_EmbeddedShaderPack, sizeof(g_EmbeddedShaderPack));
+#endif
+
+    if (pack->source == SHADER_PACK_NONE)
+    {
+        int fd = open(SHADER_PACK_PATH, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                if (shader_pack_validate((const uint8_t *)mapping, (size_t)st.st_size, SHADER_PACK_PATH))
+                    shader_pack_use(pack, SHADER_PACK_MAPPED, (const uint8_t *)mapping, (size_t)st.st_size);
+                else
+                    munmap(mapping, (size_t)st.st_size);
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+    }
+
+    pack->open_ms = get_time_ms() - start;
+    printf("[shader pack] %s, %u modules, %zu bytes, %.3f ms\n", get_shader_pack_source_str(pack->source), pack->entry_count, pack->size, pack->open_ms);
+}
+
+void shader_pack_destroy()
+{
+    ShaderPack *pack = &g_ShaderPack;
+    if (pack->source == SHADER_PACK_MAPPED)
+        munmap((void *)pack->data, pack->size);
+    pack->source = SHADER_PACK_NONE;
+    pack->data = nullptr;
+    pack->entry_count = 0;
+}
+
+static int shader_pack_find(const ShaderPack *pack, const char *name)
+{
+    for (uint32_t i = 0; i < pack->entry_count; i++)
+    {
+        if (strcmp(pack->entries[i].name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+// Returns the module's SPIR-V in the pack, or null if it isn't packed or has
+// been overridden. Thread safe.
+const uint32_t *shader_pack_get(const char *name, size_t *size)
+{
+    const ShaderPack *pack = &g_ShaderPack;
+    int index = shader_pack_find(pack, name);
+    if (index < 0 || pack->overridden[index].load(std::memory_order_acquire))
+        return nullptr;
+    *size = pack->entries[index].size;
+    return (const uint32_t *)(pack->data + pack->entries[index].offset);
+}
+
+// From now on, name is loaded from its loose .spv; used once it's been
+// rebuilt at runtime. Thread safe.
+void shader_pack_override(const char *name)
+{
+    ShaderPack *pack = &g_ShaderPack;
+    int index = shader_pack_find(pack, name);
+    if (index >= 0)
+        pack->overridden[index].store(true, std::memory_order_release);
+}
+
+void shader_pack_draw_ui()
+{
+    const ShaderPack *pack = &g_ShaderPack;
+    ImGui::BulletText("Source: %s, opened in %.3f ms", get_shader_pack_source_str(pack->source), pack->open_ms);
+    for (uint32_t i = 0; i < pack->entry_count; i++)
+    {
+        const ShaderPackEntry& entry = pack->entries[i];
+        bool overridden = pack->overridden[i].load(std::memory_order_relaxed);
+        ImGui::BulletText("%s: %u bytes at %u%s", entry.name, entry.size, entry.offset, overridden ? " (reloaded from disk)" : "");
+    }
+}
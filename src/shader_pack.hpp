@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of bin/shaders.pack, shared by the runtime and
+// tools/shader_pack.cpp. A header, then the index, then each module's SPIR-V
+// at a SHADER_PACK_ALIGNMENT aligned offset so it can be handed to Vulkan in
+// place. All offsets are from the start of the file.
+
+#define SHADER_PACK_MAGIC 0x50535056 // "VPSP"
+#define SHADER_PACK_VERSION 1
+#define SHADER_PACK_ALIGNMENT 16
+#define SHADER_PACK_NAME_SIZE 32
+
+struct ShaderPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t index_offset;
+    uint64_t total_size;
+};
+
+struct ShaderPackEntry
+{
+    char name[SHADER_PACK_NAME_SIZE]; // source name, e.g. "tri.vert"
+    uint32_t offset;
+    uint32_t size;
+    uint64_t checksum; // fnv1a64 of the SPIR-V
+};
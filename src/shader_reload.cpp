@@ -0,0 +1,517 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Shader hot reload. A background thread watches src/shaders and bin/shaders
+// (inotify on Linux, mtime polling elsewhere). An edited source is compiled
+// with glslc into bin/shaders; a .spv replaced by anything else, such as make,
+// is taken as is. The frame loop then hands back the registry pipelines built
+// from that shader, the thread rebuilds them through the pipeline cache
+// against a private render pass of the same format, and the frame loop swaps
+// them all in at once between frames. The old pipelines are retired by the
+// registry. The frame loop itself only ever holds the lock for a list swap.
+//
+// Pipeline variant sets are the exception: their compiled variants are
+// rebuilt in place, in parallel, with the device idle, as soon as a shader
+// of theirs has been compiled.
+
+#define SHADER_RELOAD_MAX_SHADERS 32
+#define SHADER_RELOAD_MAX_BUILDS 16
+#define SHADER_RELOAD_MAX_VARIANT_SETS 4
+#define SHADER_RELOAD_HISTORY 16
+#define SHADER_RELOAD_DEBOUNCE_MS 30
+#define SHADER_RELOAD_POLL_MS 250
+
+struct ReloadShader
+{
+    const char *name; // source name, e.g. "tri.vert"
+    int64_t src_mtime;
+    int64_t spv_mtime;
+};
+
+struct ReloadBuild
+{
+    int handle;
+    PipelineCreateFn create;
+    PipelineKey key;
+    VkPipeline pipeline;
+};
+
+// One shader change and the pipelines rebuilt for it
+struct ReloadBatch
+{
+    int shader;
+    double compile_ms; // 0 if the .spv changed on its own
+    double link_ms;
+    ReloadBuild builds[SHADER_RELOAD_MAX_BUILDS];
+    int build_count;
+};
+
+struct ReloadRecord
+{
+    const char *shader;
+    double compile_ms;
+    double link_ms;
+    int pipelines;
+    bool ok;
+    char log[1024]; // glslc output on failure
+};
+
+struct ShaderReloader
+{
+    VkDevice device;
+    VkPipelineCache cache;
+    ReloadShader shaders[SHADER_RELOAD_MAX_SHADERS];
+    int shader_count;
+    PipelineVariantSet *variant_sets[SHADER_RELOAD_MAX_VARIANT_SETS];
+    int variant_set_count;
+
+    std::thread thread;
+    int wake_pipe[2];
+    int inotify_fd; // -1 when polling
+
+    // Render pass the thread builds against; only touched by the thread
+    VkRenderPass render_pass;
+    PipelineKey render_pass_key;
+
+    // Guards everything below
+    std::mutex mutex;
+    bool quit;
+    ImVector<ReloadBatch> changed; // thread -> frame loop, builds not filled in yet
+    ImVector<ReloadBatch> pending; // frame loop -> thread
+    ImVector<ReloadBatch> done;    // thread -> frame loop, pipelines built
+    ImVector<ReloadRecord> history;
+};
+
+static int64_t shader_reload_mtime(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+static void shader_reload_paths(const ReloadShader *shader, char *src, char *spv, size_t size)
+{
+    snprintf(src, size, "src/shaders/%s", shader->name);
+    snprintf(spv, size, "bin/shaders/%s.spv", shader->name);
+}
+
+static void shader_reload_wake(ShaderReloader *reloader)
+{
+    char byte = 1;
+    ssize_t written = write(reloader->wake_pipe[1], &byte, 1);
+    (void)written;
+}
+
+static void shader_reload_record(ShaderReloader *reloader, const ReloadRecord& record)
+{
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    if (reloader->history.Size == SHADER_RELOAD_HISTORY)
+        reloader->history.erase(reloader->history.begin());
+    reloader->history.push_back(record);
+}
+
+// Compiles to a temporary file and renames it over the old .spv, so nobody
+// ever reads a half written module.
+static bool shader_reload_compile(const ReloadShader *shader, char *log, size_t log_size)
+{
+    char src[256], spv[256], tmp[272], cmd[640];
+    shader_reload_paths(shader, src, spv, sizeof(src));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", spv);
+    snprintf(cmd, sizeof(cmd), "glslc %s -o %s 2>&1", src, tmp);
+
+    log[0] = 0;
+    FILE *p = popen(cmd, "r");
+    if (!p)
+    {
+        snprintf(log, log_size, "popen failed: %s", strerror(errno));
+        return false;
+    }
+    size_t used = 0;
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), p)) > 0)
+    {
+        size_t copy = used + n < log_size - 1 ? n : log_size - 1 - used;
+        memcpy(log + used, buf, copy);
+        used += copy;
+    }
+    log[used] = 0;
+    if (pclose(p) != 0)
+        return false;
+
+    if (rename(tmp, spv) != 0)
+    {
+        snprintf(log, log_size, "rename %s failed: %s", tmp, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Checks every shader for a newer source or .spv and queues the changes.
+static void shader_reload_scan(ShaderReloader *reloader)
+{
+    for (int i = 0; i < reloader->shader_count; i++)
+    {
+        ReloadShader *shader = &reloader->shaders[i];
+        char src[256], spv[256];
+        shader_reload_paths(shader, src, spv, sizeof(src));
+
+        ReloadBatch batch = {};
+        batch.shader = i;
+        int64_t src_mtime = shader_reload_mtime(src);
+        if (src_mtime != shader->src_mtime)
+        {
+            shader->src_mtime = src_mtime;
+            CPU_SCOPE("shader_compile");
+            ReloadRecord record = {};
+            record.shader = shader->name;
+            double start = get_time_ms();
+            record.ok = shader_reload_compile(shader, record.log, sizeof(record.log));
+            batch.compile_ms = record.compile_ms = get_time_ms() - start;
+            if (!record.ok)
+            {
+                // The old pipelines stay in use
+                fprintf(stderr, "[shader reload] %s: compile failed after %.1f ms\n%s", shader->name, record.compile_ms, record.log);
+                shader_reload_record(reloader, record);
+                continue;
+            }
+            shader->spv_mtime = shader_reload_mtime(spv);
+        }
+        else
+        {
+            int64_t spv_mtime = shader_reload_mtime(spv);
+            if (spv_mtime == shader->spv_mtime)
+                continue;
+            shader->spv_mtime = spv_mtime;
+        }
+
+        // The pack still holds the module as it was at startup
+        shader_pack_override(shader->name);
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        reloader->changed.push_back(batch);
+    }
+}
+
+static VkRenderPass shader_reload_get_render_pass(ShaderReloader *reloader, PipelineKey key)
+{
+    if (reloader->render_pass != VK_NULL_HANDLE && pipeline_key_equal(reloader->render_pass_key, key))
+        return reloader->render_pass;
+    if (reloader->render_pass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(reloader->device, reloader->render_pass, nullptr);
+
+    reloader->render_pass = create_compatible_render_pass(reloader->device, key);
+    reloader->render_pass_key = key;
+    return reloader->render_pass;
+}
+
+static void shader_reload_build(ShaderReloader *reloader, ReloadBatch *batch)
+{
+    CPU_SCOPE("pipeline_build");
+    double start = get_time_ms();
+    for (int i = 0; i < batch->build_count; i++)
+    {
+        ReloadBuild *build = &batch->builds[i];
+        VkRenderPass render_pass = shader_reload_get_render_pass(reloader, build->key);
+        build->pipeline = build->create(reloader->device, reloader->cache, render_pass);
+    }
+    batch->link_ms = get_time_ms() - start;
+
+    const char *name = reloader->shaders[batch->shader].name;
+    printf("[shader reload] %s: compile %.1f ms, link %.1f ms (%d pipelines)\n", name, batch->compile_ms, batch->link_ms, batch->build_count);
+    ReloadRecord record = {};
+    record.shader = name;
+    record.compile_ms = batch->compile_ms;
+    record.link_ms = batch->link_ms;
+    record.pipelines = batch->build_count;
+    record.ok = true;
+    shader_reload_record(reloader, record);
+}
+
+// Blocks until a watched directory changes, the frame loop wakes the thread
+// or, when polling, the poll interval passes.
+static void shader_reload_wait(ShaderReloader *reloader)
+{
+    struct pollfd fds[2] = {};
+    fds[0].fd = reloader->wake_pipe[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = reloader->inotify_fd;
+    fds[1].events = POLLIN;
+    int fd_count = reloader->inotify_fd >= 0 ? 2 : 1;
+    int timeout = reloader->inotify_fd >= 0 ? -1 : SHADER_RELOAD_POLL_MS;
+    if (poll(fds, fd_count, timeout) <= 0)
+        return;
+
+    char buf[4096];
+    if (fds[0].revents & POLLIN)
+    {
+        ssize_t n = read(reloader->wake_pipe[0], buf, sizeof(buf));
+        (void)n;
+    }
+    if (fd_count == 2 && (fds[1].revents & POLLIN))
+    {
+        // Editors and glslc write in several steps; let them finish
+        usleep(SHADER_RELOAD_DEBOUNCE_MS * 1000);
+        while (read(reloader->inotify_fd, buf, sizeof(buf)) > 0)
+            ;
+    }
+}
+
+static void shader_reload_thread(ShaderReloader *reloader)
+{
+    cpu_profiler_set_thread_name("shader reload");
+    for (;;)
+    {
+        shader_reload_wait(reloader);
+
+        ImVector<ReloadBatch> pending;
+        {
+            std::lock_guard<std::mutex> lock(reloader->mutex);
+            if (reloader->quit)
+                return;
+            pending.swap(reloader->pending);
+        }
+        for (ReloadBatch& batch : pending)
+            shader_reload_build(reloader, &batch);
+        if (pending.Size > 0)
+        {
+            std::lock_guard<std::mutex> lock(reloader->mutex);
+            for (ReloadBatch& batch : pending)
+                reloader->done.push_back(batch);
+        }
+
+        shader_reload_scan(reloader);
+    }
+}
+
+static void shader_reload_watch(ShaderReloader *reloader, const char *name)
+{
+    for (int j = 0; j < reloader->shader_count; j++)
+    {
+        if (strcmp(reloader->shaders[j].name, name) == 0)
+            return;
+    }
+    IM_ASSERT(reloader->shader_count < SHADER_RELOAD_MAX_SHADERS);
+    ReloadShader *shader = &reloader->shaders[reloader->shader_count++];
+    shader->name = name;
+    char src[256], spv[256];
+    shader_reload_paths(shader, src, spv, sizeof(src));
+    shader->src_mtime = shader_reload_mtime(src);
+    shader->spv_mtime = shader_reload_mtime(spv);
+}
+
+// Watches the shaders of every pipeline in the registry and of the given
+// variant sets. Call once all pipelines are registered.
+void shader_reload_init(ShaderReloader *reloader, VkDevice device, VkPipelineCache cache, PipelineRegistry *registry,
+                        PipelineVariantSet *const *variant_sets, int variant_set_count)
+{
+    reloader->device = device;
+    reloader->cache = cache;
+    reloader->shader_count = 0;
+    for (const PipelineEntry& entry : registry->entries)
+    {
+        for (int i = 0; i < entry.shader_count; i++)
+            shader_reload_watch(reloader, entry.shaders[i]);
+    }
+    IM_ASSERT(variant_set_count <= SHADER_RELOAD_MAX_VARIANT_SETS);
+    reloader->variant_set_count = variant_set_count;
+    for (int i = 0; i < variant_set_count; i++)
+    {
+        reloader->variant_sets[i] = variant_sets[i];
+        for (int j = 0; j < variant_sets[i]->shader_count; j++)
+            shader_reload_watch(reloader, variant_sets[i]->shaders[j]);
+    }
+
+    if (pipe(reloader->wake_pipe) != 0)
+        fatal("pipe failed: %s", strerror(errno));
+
+    reloader->inotify_fd = -1;
+#ifdef __linux__
+    reloader->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (reloader->inotify_fd >= 0)
+    {
+        uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+        if (inotify_add_watch(reloader->inotify_fd, "src/shaders", mask) < 0 ||
+            inotify_add_watch(reloader->inotify_fd, "bin/shaders", mask) < 0)
+        {
+            close(reloader->inotify_fd);
+            reloader->inotify_fd = -1;
+        }
+    }
+#endif
+
+    reloader->render_pass = VK_NULL_HANDLE;
+    reloader->quit = false;
+    reloader->changed.clear();
+    reloader->pending.clear();
+    reloader->done.clear();
+    reloader->history.clear();
+    reloader->thread = std::thread(shader_reload_thread, reloader);
+
+    printf("[shader reload] watching %d shaders (%s)\n", reloader->shader_count, reloader->inotify_fd >= 0 ? "inotify" : "polling");
+}
+
+// The device must be idle.
+void shader_reload_destroy(ShaderReloader *reloader)
+{
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        reloader->quit = true;
+    }
+    shader_reload_wake(reloader);
+    reloader->thread.join();
+
+    for (ReloadBatch& batch : reloader->done)
+    {
+        for (int i = 0; i < batch.build_count; i++)
+            vkDestroyPipeline(reloader->device, batch.builds[i].pipeline, nullptr);
+    }
+    reloader->done.clear();
+    if (reloader->render_pass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(reloader->device, reloader->render_pass, nullptr);
+    if (reloader->inotify_fd >= 0)
+        close(reloader->inotify_fd);
+    close(reloader->wake_pipe[0]);
+    close(reloader->wake_pipe[1]);
+}
+
+// Call at a frame boundary, before recording. Swaps in finished pipelines and
+// hands new shader changes to the thread. Only waits on compilation, and on
+// the device, when a variant set has to be rebuilt.
+void shader_reload_update(ShaderReloader *reloader, PipelineRegistry *registry)
+{
+    ImVector<ReloadBatch> changed, done;
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        changed.swap(reloader->changed);
+        done.swap(reloader->done);
+    }
+
+    // A batch goes in as a whole, so no frame mixes old and new pipelines of
+    // one shader
+    for (ReloadBatch& batch : done)
+    {
+        for (int i = 0; i < batch.build_count; i++)
+        {
+            const ReloadBuild& build = batch.builds[i];
+            if (!pipeline_registry_replace(registry, build.handle, build.key, build.pipeline))
+                printf("[shader reload] %s: render pass changed during the build, dropped\n", registry->entries[build.handle].name);
+        }
+    }
+
+    if (changed.Size == 0)
+        return;
+
+    // The .spv is already compiled, only the variants are left to build
+    bool rebuild[SHADER_RELOAD_MAX_VARIANT_SETS] = {};
+    bool any_rebuild = false;
+    for (const ReloadBatch& batch : changed)
+    {
+        for (int i = 0; i < reloader->variant_set_count; i++)
+        {
+            rebuild[i] |= pipeline_variants_uses_shader(reloader->variant_sets[i], reloader->shaders[batch.shader].name);
+            any_rebuild |= rebuild[i];
+        }
+    }
+    if (any_rebuild)
+    {
+        CPU_SCOPE("variant_rebuild");
+        VkResult err = vkDeviceWaitIdle(reloader->device);
+        check_vk_result(err);
+        for (int i = 0; i < reloader->variant_set_count; i++)
+        {
+            if (rebuild[i])
+                pipeline_variants_rebuild(reloader->variant_sets[i]);
+        }
+    }
+
+    for (ReloadBatch& batch : changed)
+    {
+        const char *name = reloader->shaders[batch.shader].name;
+        for (int handle = 0; handle < registry->entries.Size; handle++)
+        {
+            const PipelineEntry& entry = registry->entries[handle];
+            if (entry.pipeline == VK_NULL_HANDLE || !pipeline_registry_uses_shader(registry, handle, name))
+                continue;
+            IM_ASSERT(batch.build_count < SHADER_RELOAD_MAX_BUILDS);
+            ReloadBuild *build = &batch.builds[batch.build_count++];
+            build->handle = handle;
+            build->create = entry.create;
+            build->key = entry.key;
+            build->pipeline = VK_NULL_HANDLE;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        for (ReloadBatch& batch : changed)
+        {
+            if (batch.build_count > 0)
+                reloader->pending.push_back(batch);
+        }
+    }
+    shader_reload_wake(reloader);
+}
+
+void shader_reload_draw_ui(ShaderReloader *reloader)
+{
+    ImGui::Text("Watching %d shaders (%s)", reloader->shader_count, reloader->inotify_fd >= 0 ? "inotify" : "polling");
+
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    if (reloader->history.Size == 0)
+    {
+        ImGui::TextDisabled("Edit a file in src/shaders to reload it");
+        return;
+    }
+    if (ImGui::BeginTable("shader_reloads", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Shader");
+        ImGui::TableSetupColumn("Compile ms");
+        ImGui::TableSetupColumn("Link ms");
+        ImGui::TableSetupColumn("Result");
+        ImGui::TableHeadersRow();
+        for (int i = reloader->history.Size - 1; i >= 0; i--)
+        {
+            const ReloadRecord& record = reloader->history[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(record.shader);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", record.compile_ms);
+            ImGui::TableNextColumn();
+            if (record.ok)
+                ImGui::Text("%.1f", record.link_ms);
+            ImGui::TableNextColumn();
+            if (record.ok)
+            {
+                ImGui::Text("%d pipelines", record.pipelines);
+            }
+            else
+            {
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "failed");
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("%s", record.log);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
@@ -0,0 +1,29 @@
+#version 450
+
+// Per vertex: the unit shape, same layout as tri.vert
+layout(location = 0) in vec2 inPos;
+layout(location = 1) in vec3 inColor;
+
+// Per instance
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in vec2 inScaleRotation;
+layout(location = 4) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// xy: view center, zw: 1 / view half extents
+layout(push_constant) uniform PushConstants
+{
+    vec4 view;
+} pc;
+
+void main()
+{
+    float c = cos(inScaleRotation.y);
+    float s = sin(inScaleRotation.y);
+    vec2 pos = mat2(c, s, -s, c) * inPos * inScaleRotation.x + inOffset;
+    pos = (pos - pc.view.xy) * pc.view.zw;
+
+    fragColor = inColor * inInstanceColor.rgb;
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
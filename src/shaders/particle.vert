@@ -0,0 +1,29 @@
+#version 450
+
+// The simulation's arrays, read directly: one point per particle, no vertex buffers
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    vec2 positions[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Velocities
+{
+    vec2 velocities[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Lives
+{
+    float lives[];
+};
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+    uint i = gl_VertexIndex;
+    float speed = clamp(length(velocities[i]) * 0.5, 0.0, 1.0);
+    float fade = 0.3 + 0.7 * clamp(lives[i] / 3.0, 0.0, 1.0);
+    fragColor = mix(vec3(0.9, 0.3, 0.1), vec3(0.2, 0.6, 1.0), speed) * fade;
+    gl_Position = vec4(positions[i], 0.0, 1.0);
+    gl_PointSize = 1.0;
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) flat in uint fragTexture;
+layout(location = 0) out vec4 outColor;
+
+// The bindless set, see bindless.cpp
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 0, binding = 1) uniform sampler samplers[2];
+
+layout(push_constant) uniform PushConstants
+{
+    vec4 view;
+    uint sampler_index;
+    uint textures[16];
+} pc;
+
+void main()
+{
+    // Neighbouring sprites in one draw use different textures
+    outColor = texture(sampler2D(textures[nonuniformEXT(fragTexture)], samplers[pc.sampler_index]), fragUV);
+}
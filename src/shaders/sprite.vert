@@ -0,0 +1,32 @@
+#version 450
+
+// Per vertex: the unit quad from the batch renderer
+layout(location = 0) in vec2 inPos;
+
+// Per instance
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in vec2 inScaleRotation;
+layout(location = 4) in uint inTexture; // into pc.textures
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) flat out uint fragTexture;
+
+// Same block in sprite.frag, must match SpritePushConstants
+layout(push_constant) uniform PushConstants
+{
+    vec4 view; // xy: view center, zw: 1 / view half extents
+    uint sampler_index;
+    uint textures[16]; // bindless slots
+} pc;
+
+void main()
+{
+    float c = cos(inScaleRotation.y);
+    float s = sin(inScaleRotation.y);
+    vec2 pos = mat2(c, s, -s, c) * inPos * inScaleRotation.x + inOffset;
+    pos = (pos - pc.view.xy) * pc.view.zw;
+
+    fragUV = inPos + 0.5;
+    fragTexture = pc.textures[inTexture];
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
@@ -1,9 +1,24 @@
 #version 450 core
 
+// Specialized per pipeline variant; the defaults are the plain vertex color
+// path the batch pipelines use.
+layout(constant_id = 0) const int COLOR_MODE = 0; // 0: vertex color, 1: flat, 2: checker
+layout(constant_id = 1) const float ALPHA = 1.0;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (COLOR_MODE == 1)
+    {
+        color = vec3(1.0);
+    }
+    else if (COLOR_MODE == 2)
+    {
+        ivec2 cell = ivec2(gl_FragCoord.xy) / 16;
+        color *= ((cell.x + cell.y) & 1) == 0 ? 1.0 : 0.4;
+    }
+    outColor = vec4(color, ALPHA);
 }
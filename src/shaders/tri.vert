@@ -5,8 +5,31 @@ layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
+// Per frame, from the uniform ring; matches FrameConstants in uniforms.cpp
+layout(set = 0, binding = 0) uniform FrameConstants
+{
+    mat4 transform;
+    vec2 resolution;
+    float time;
+    float delta_time;
+} frame;
+
+// Per draw; matches TriPushConstants in tri.cpp
+layout(push_constant) uniform PushConstants
+{
+    vec2 offset;
+    float scale;
+    float rotation;
+    float spin; // radians per second
+} pc;
+
 void main()
 {
+    float angle = pc.rotation + pc.spin * frame.time;
+    float c = cos(angle);
+    float s = sin(angle);
+    vec2 pos = mat2(c, s, -s, c) * inPos * pc.scale + pc.offset;
+
     fragColor = inColor;
-    gl_Position = vec4(inPos, 0.0, 1.0);
+    gl_Position = frame.transform * vec4(pos, 0.0, 1.0);
 }
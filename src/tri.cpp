@@ -5,28 +5,163 @@
 #include <vulkan/vulkan_core.h>
 
 #include "helpers.hpp"
+#include "vertex_layout.hpp"
 
+// 8 bytes instead of the 20 of float position and color. Meshes are written
+// as VertexSource and packed with pack_vertices.
 struct Vertex
+{
+    Half2 pos;
+    Unorm8x4 color; // alpha unused
+};
+
+struct VertexSource
 {
     float pos[2];
     float color[3];
 };
 
-VkShaderModule create_shader_module(const char *path, VkDevice device)
+using VertexLayout = VertexBinding<Vertex, VK_VERTEX_INPUT_RATE_VERTEX, VERTEX_ATTR(Vertex, pos), VERTEX_ATTR(Vertex, color)>;
+
+void pack_vertices(const VertexSource *src, Vertex *dst, size_t count)
+{
+    float pos[64 * 2];
+    float color[64 * 4];
+    uint16_t pos_half[64 * 2];
+    uint8_t color_unorm[64 * 4];
+    for (size_t first = 0; first < count; first += 64)
+    {
+        size_t n = count - first < 64 ? count - first : 64;
+        for (size_t i = 0; i < n; i++)
+        {
+            const VertexSource& v = src[first + i];
+            pos[2 * i] = v.pos[0];
+            pos[2 * i + 1] = v.pos[1];
+            color[4 * i] = v.color[0];
+            color[4 * i + 1] = v.color[1];
+            color[4 * i + 2] = v.color[2];
+            color[4 * i + 3] = 1.0f;
+        }
+        pack_half(pos, pos_half, n * 2);
+        pack_unorm8(color, color_unorm, n * 4);
+        for (size_t i = 0; i < n; i++)
+        {
+            Vertex& v = dst[first + i];
+            v.pos = { pos_half[2 * i], pos_half[2 * i + 1] };
+            v.color = { color_unorm[4 * i], color_unorm[4 * i + 1], color_unorm[4 * i + 2], color_unorm[4 * i + 3] };
+        }
+    }
+}
+
+static VkPipelineLayout g_TriPipelineLayout = VK_NULL_HANDLE;
+
+// Triangle pipeline permutations: fixed function state plus the
+// specialization constants in tri.frag. Variant 0 is the plain pipeline.
+enum TriBlend
+{
+    TRI_BLEND_OPAQUE,
+    TRI_BLEND_ALPHA,
+    TRI_BLEND_ADDITIVE,
+    TRI_BLEND_COUNT,
+};
+
+enum TriTopology
+{
+    TRI_TOPOLOGY_TRIANGLES,
+    TRI_TOPOLOGY_LINES,
+    TRI_TOPOLOGY_COUNT,
+};
+
+enum TriColor
+{
+    TRI_COLOR_VERTEX,
+    TRI_COLOR_FLAT,
+    TRI_COLOR_CHECKER,
+    TRI_COLOR_COUNT,
+};
+
+#define TRI_VARIANT_COUNT (TRI_BLEND_COUNT * TRI_TOPOLOGY_COUNT * TRI_COLOR_COUNT)
+
+static const char *g_TriBlendNames[] = { "opaque", "alpha", "additive" };
+static const char *g_TriTopologyNames[] = { "triangles", "lines" };
+static const char *g_TriColorNames[] = { "vertex", "flat", "checker" };
+
+struct TriVariant
+{
+    TriBlend blend;
+    TriTopology topology;
+    TriColor color;
+};
+
+// Matches the push constants in tri.vert. Kept within the 128 bytes every
+// device guarantees for maxPushConstantsSize.
+struct TriPushConstants
 {
-    FILE *f = xfopen(path, "rb");
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    rewind(f);
+    float offset[2];
+    float scale;
+    float rotation;
+    float spin;
+};
+
+static_assert(sizeof(TriPushConstants) <= 128, "TriPushConstants exceeds the guaranteed push constant size");
 
-    char *buf = (char *)xmalloc(size);
-    fread(buf, 1, size, f);
-    fclose(f);
+// Matches the specialization constants in tri.frag
+struct TriSpecialization
+{
+    int32_t color_mode;
+    float alpha;
+};
+
+int tri_variant_index(TriVariant variant)
+{
+    return (variant.blend * TRI_TOPOLOGY_COUNT + variant.topology) * TRI_COLOR_COUNT + variant.color;
+}
+
+TriVariant tri_variant_from_index(int index)
+{
+    TriVariant variant;
+    variant.color = (TriColor)(index % TRI_COLOR_COUNT);
+    variant.topology = (TriTopology)(index / TRI_COLOR_COUNT % TRI_TOPOLOGY_COUNT);
+    variant.blend = (TriBlend)(index / (TRI_COLOR_COUNT * TRI_TOPOLOGY_COUNT));
+    return variant;
+}
+
+void tri_variant_name(int index, char *buf, size_t size)
+{
+    TriVariant variant = tri_variant_from_index(index);
+    snprintf(buf, size, "tri/%s/%s/%s", g_TriBlendNames[variant.blend], g_TriTopologyNames[variant.topology], g_TriColorNames[variant.color]);
+}
+
+// name is the source name, e.g. "tri.vert". Comes straight from the shader
+// pack when there is one; otherwise bin/shaders/<name>.spv is read in one go.
+VkShaderModule create_shader_module(const char *name, VkDevice device)
+{
+    size_t size = 0;
+    const uint32_t *code = shader_pack_get(name, &size);
+    char *buf = nullptr;
+    if (!code)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "bin/shaders/%s.spv", name);
+        FILE *f = xfopen(path, "rb");
+        fseek(f, 0, SEEK_END);
+        long file_size = ftell(f);
+        rewind(f);
+        if (file_size <= 0)
+            fatal("Empty shader %s", path);
+
+        size = (size_t)file_size;
+        buf = (char *)xmalloc(size);
+        if (fread(buf, 1, size, f) != size)
+            fatal("Short read on %s", path);
+        fclose(f);
+        code = (const uint32_t *)buf;
+    }
 
     VkShaderModuleCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     info.codeSize = size;
-    info.pCode = (const uint32_t *)buf;
+    info.pCode = code;
 
     VkShaderModule shader;
     VkResult err = vkCreateShaderModule(device, &info, nullptr, &shader);
@@ -35,20 +170,33 @@ VkShaderModule create_shader_module(const char *path, VkDevice device)
     return shader;
 }
 
-VkPipelineLayout create_pipeline_layout(VkDevice device)
+// Set 0 is the uniform ring's frame constants; per-draw values are push constants.
+VkPipelineLayout create_pipeline_layout(VkDevice device, VkDescriptorSetLayout frame_set_layout)
 {
+    VkPushConstantRange range = {};
+    range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    range.offset = 0;
+    range.size = sizeof(TriPushConstants);
+
     VkPipelineLayoutCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.setLayoutCount = 1;
+    info.pSetLayouts = &frame_set_layout;
+    info.pushConstantRangeCount = 1;
+    info.pPushConstantRanges = &range;
     VkPipelineLayout pipeline_layout;
     VkResult err = vkCreatePipelineLayout(device, &info, nullptr, &pipeline_layout);
     check_vk_result(err);
     return pipeline_layout;
 }
 
-VkPipeline create_pipeline(VkDevice device, VkRenderPass render_pass, uint32_t w, uint32_t h)
+// Viewport and scissor are dynamic, so the pipeline only depends on the render
+// pass formats and survives window resizes. Safe to call from any thread;
+// g_TriPipelineLayout must exist.
+static VkPipeline create_tri_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass, TriVariant variant, const char *name)
 {
-    VkShaderModule vert_shader = create_shader_module("bin/shaders/tri.vert.spv", device);
-    VkShaderModule frag_shader = create_shader_module("bin/shaders/tri.frag.spv", device);
+    VkShaderModule vert_shader = create_shader_module("tri.vert", device);
+    VkShaderModule frag_shader = create_shader_module("tri.frag", device);
 
     VkPipelineShaderStageCreateInfo stages[2] = {};
     stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -60,40 +208,35 @@ VkPipeline create_pipeline(VkDevice device, VkRenderPass render_pass, uint32_t w
     stages[1].module = frag_shader;
     stages[1].pName = "main";
 
-    VkVertexInputBindingDescription binding = {};
-    binding.binding = 0;
-    binding.stride = sizeof(Vertex);
-    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription attrs[2] = {};
-    attrs[0].location = 0;
-    attrs[0].binding = 0;
-    attrs[0].format = VK_FORMAT_R32G32_SFLOAT;
-    attrs[0].offset = offsetof(Vertex, pos);
-    attrs[1].location = 1;
-    attrs[1].binding = 0,
-    attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attrs[1].offset = offsetof(Vertex, color);
-
-    VkPipelineVertexInputStateCreateInfo vertex_input = {};
-    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input.vertexBindingDescriptionCount = 1;
-    vertex_input.pVertexBindingDescriptions = &binding;
-    vertex_input.vertexAttributeDescriptionCount = 2;
-    vertex_input.pVertexAttributeDescriptions = attrs;
+    TriSpecialization specialization = {};
+    specialization.color_mode = variant.color;
+    specialization.alpha = variant.blend == TRI_BLEND_OPAQUE ? 1.0f : 0.5f;
+    VkSpecializationMapEntry map_entries[2] = {};
+    map_entries[0] = { 0, offsetof(TriSpecialization, color_mode), sizeof(specialization.color_mode) };
+    map_entries[1] = { 1, offsetof(TriSpecialization, alpha), sizeof(specialization.alpha) };
+    VkSpecializationInfo specialization_info = {};
+    specialization_info.mapEntryCount = 2;
+    specialization_info.pMapEntries = map_entries;
+    specialization_info.dataSize = sizeof(specialization);
+    specialization_info.pData = &specialization;
+    stages[1].pSpecializationInfo = &specialization_info;
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = VertexInput<VertexLayout>::state();
 
     VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
     input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly.topology = variant.topology == TRI_TOPOLOGY_LINES ? VK_PRIMITIVE_TOPOLOGY_LINE_STRIP : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-    VkViewport viewport = {0, 0, (float)w, (float)h, 0.0f, 1.0f};
-    VkRect2D scissor = {{0, 0}, {w, h}};
     VkPipelineViewportStateCreateInfo viewport_state = {};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = sizeof(dynamic_states) / sizeof(dynamic_states[0]);
+    dynamic_state.pDynamicStates = dynamic_states;
 
     VkPipelineRasterizationStateCreateInfo rasterizer = {};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -111,15 +254,19 @@ VkPipeline create_pipeline(VkDevice device, VkRenderPass render_pass, uint32_t w
                                              VK_COLOR_COMPONENT_G_BIT |
                                              VK_COLOR_COMPONENT_B_BIT |
                                              VK_COLOR_COMPONENT_A_BIT);
-    color_blend_attachment.blendEnable = VK_FALSE;
+    color_blend_attachment.blendEnable = variant.blend != TRI_BLEND_OPAQUE;
+    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    color_blend_attachment.dstColorBlendFactor = variant.blend == TRI_BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
     VkPipelineColorBlendStateCreateInfo color_blending = {};
     color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     color_blending.attachmentCount = 1;
     color_blending.pAttachments = &color_blend_attachment;
 
-    VkPipelineLayout pipeline_layout = create_pipeline_layout(device);
-
     VkGraphicsPipelineCreateInfo pipeline_info = {};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipeline_info.stageCount = 2;
@@ -130,79 +277,47 @@ VkPipeline create_pipeline(VkDevice device, VkRenderPass render_pass, uint32_t w
     pipeline_info.pRasterizationState = &rasterizer;
     pipeline_info.pMultisampleState = &multisampling;
     pipeline_info.pColorBlendState = &color_blending;
-    pipeline_info.layout = pipeline_layout;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = g_TriPipelineLayout;
     pipeline_info.renderPass = render_pass;
     pipeline_info.subpass = 0;
-    
-    VkPipeline pipeline;
-    // TODO: What is pipeline cache?
-    VkResult err = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline);
-    check_vk_result(err);
 
+    VkPipeline pipeline = create_graphics_pipeline_timed(device, pipeline_cache, &pipeline_info, name);
+    vkDestroyShaderModule(device, vert_shader, nullptr);
+    vkDestroyShaderModule(device, frag_shader, nullptr);
     return pipeline;
 }
 
-uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags props)
+VkPipeline create_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
 {
-    VkPhysicalDeviceMemoryProperties mem_props;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
-    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++)
-    {
-        if ((type_filter & (1 << i)) &&
-            (mem_props.memoryTypes[i].propertyFlags & props) == props)
-        {
-            return i;
-        }
-    }
-    fatal("Failed to find suitable memory type");
-    return 0;
+    return create_tri_pipeline(device, pipeline_cache, render_pass, tri_variant_from_index(0), "tri");
+}
+
+VkPipeline create_tri_variant_pipeline(VkDevice device, VkPipelineCache pipeline_cache, VkRenderPass render_pass, int index)
+{
+    char name[64];
+    tri_variant_name(index, name, sizeof(name));
+    return create_tri_pipeline(device, pipeline_cache, render_pass, tri_variant_from_index(index), name);
 }
 
-VkBuffer create_vertex_buffer(VkDevice device, VkPhysicalDevice physical_device)
+GpuBuffer create_vertex_buffer(GpuAllocator *allocator, UploadContext *upload)
 {
-    const Vertex verts[] = {
+    const VertexSource source[] = {
         { {  0.0f, -0.5f }, {1.0f, 0.0f, 0.0f} },
         { {  0.5f,  0.5f }, {0.0f, 1.0f, 0.0f} },
         { { -0.5f,  0.5f }, {0.0f, 0.0f, 1.0f} },
     };
+    const size_t count = sizeof(source) / sizeof(source[0]);
+    Vertex verts[count];
+    pack_vertices(source, verts, count);
 
-    VkDeviceSize buffer_size = sizeof(verts);
+    GpuBuffer vertex_buffer;
+    gpu_create_buffer(allocator, sizeof(verts), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertex_buffer);
 
-    VkBufferCreateInfo buffer_info = {};
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.size = buffer_size;
-    buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VkBuffer vertex_buffer;
-    VkResult err = vkCreateBuffer(device, &buffer_info, nullptr, &vertex_buffer);
-    check_vk_result(err);
-
-    // Allocate memory
-    VkMemoryRequirements mem_reqs;
-    vkGetBufferMemoryRequirements(device, vertex_buffer, &mem_reqs);
-    uint32_t mem_type_index = find_memory_type(
-        physical_device,
-        mem_reqs.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    );
-    VkMemoryAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = mem_type_index;
-
-    VkDeviceMemory vertex_memory;
-    err = vkAllocateMemory(device, &alloc_info, NULL, &vertex_memory);
-    check_vk_result(err);
-
-    // Upload data
-    void *data;
-    vkMapMemory(device, vertex_memory, 0, buffer_size, 0, &data);
-    memcpy(data, verts, (size_t)buffer_size);
-    vkUnmapMemory(device, vertex_memory);
-
-    err = vkBindBufferMemory(device, vertex_buffer, vertex_memory, 0);
-    check_vk_result(err);
+    // Goes out with the next upload_flush, before the first frame is submitted
+    upload_buffer(upload, vertex_buffer.buffer, 0, verts, sizeof(verts),
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 
     return vertex_buffer;
 }
@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Per-frame uniform data through one persistently mapped ring.
+//
+// The ring is a GpuLinearPool with a region per frame in flight; writing
+// constants is a pointer bump and a memcpy into memory that stays mapped for
+// the life of the ring. Shaders see it through a single
+// UNIFORM_BUFFER_DYNAMIC descriptor allocated at init and covering
+// UNIFORM_RING_RANGE bytes, so each push is bound by passing its offset to
+// vkCmdBindDescriptorSets. Nothing is mapped, allocated or written to a
+// descriptor per frame. Small per-draw values go in push constants instead.
+
+#define UNIFORM_RING_FRAME_SIZE (64 * 1024)
+#define UNIFORM_RING_RANGE 256 // largest single push
+
+// Matches FrameConstants in tri.vert (std140)
+struct FrameConstants
+{
+    float transform[16]; // column major, applied after the per-draw transform
+    float resolution[2];
+    float time;
+    float delta_time;
+};
+
+static_assert(sizeof(FrameConstants) <= UNIFORM_RING_RANGE, "FrameConstants doesn't fit the descriptor range");
+
+struct UniformRing
+{
+    VkDevice device;
+    GpuLinearPool pool;
+    VkDeviceSize alignment; // minUniformBufferOffsetAlignment
+    uint32_t max_push_constants;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet set;
+
+    uint32_t frame_pushes;
+    VkDeviceSize frame_bytes;
+    uint32_t failed_pushes;
+};
+
+void uniform_ring_init(UniformRing *ring, GpuAllocator *allocator, uint32_t frame_count)
+{
+    VkDevice device = allocator->device;
+    ring->device = device;
+    ring->frame_pushes = 0;
+    ring->frame_bytes = 0;
+    ring->failed_pushes = 0;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+    ring->alignment = properties.limits.minUniformBufferOffsetAlignment;
+    ring->max_push_constants = properties.limits.maxPushConstantsSize;
+    if (properties.limits.maxUniformBufferRange < UNIFORM_RING_RANGE)
+        fatal("maxUniformBufferRange %u is below %d", properties.limits.maxUniformBufferRange, UNIFORM_RING_RANGE);
+
+    gpu_linear_pool_init(allocator, &ring->pool, UNIFORM_RING_FRAME_SIZE, frame_count, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    if (!ring->pool.buffer.allocation.mapped)
+        fatal("Uniform ring is not host mapped");
+
+    VkResult err;
+    {
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = 1;
+        info.pBindings = &binding;
+        err = vkCreateDescriptorSetLayout(device, &info, nullptr, &ring->set_layout);
+        check_vk_result(err);
+    }
+    {
+        VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 };
+        VkDescriptorPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.maxSets = 1;
+        info.poolSizeCount = 1;
+        info.pPoolSizes = &pool_size;
+        err = vkCreateDescriptorPool(device, &info, nullptr, &ring->descriptor_pool);
+        check_vk_result(err);
+
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = ring->descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &ring->set_layout;
+        err = vkAllocateDescriptorSets(device, &alloc_info, &ring->set);
+        check_vk_result(err);
+    }
+    {
+        VkDescriptorBufferInfo buffer_info = {};
+        buffer_info.buffer = ring->pool.buffer.buffer;
+        buffer_info.offset = 0;
+        buffer_info.range = UNIFORM_RING_RANGE;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = ring->set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &buffer_info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+}
+
+void uniform_ring_destroy(UniformRing *ring, GpuAllocator *allocator)
+{
+    vkDestroyDescriptorPool(ring->device, ring->descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(ring->device, ring->set_layout, nullptr);
+    gpu_linear_pool_destroy(allocator, &ring->pool);
+}
+
+// frame_index's previous use must have completed.
+void uniform_ring_begin_frame(UniformRing *ring, uint32_t frame_index)
+{
+    gpu_linear_pool_begin_frame(&ring->pool, frame_index);
+    ring->frame_pushes = 0;
+    ring->frame_bytes = 0;
+}
+
+// Copies size bytes into this frame's region and returns the dynamic offset to
+// bind them with. Only the recording thread may push.
+uint32_t uniform_ring_push(UniformRing *ring, const void *data, VkDeviceSize size)
+{
+    IM_ASSERT(size <= UNIFORM_RING_RANGE);
+    // Whole ranges, so the descriptor never reads past the frame's region
+    GpuLinearSlice slice;
+    if (!gpu_linear_alloc(&ring->pool, UNIFORM_RING_RANGE, ring->alignment, &slice))
+    {
+        // Falls back to the frame's first push rather than faulting; shows up in the UI
+        ring->failed_pushes++;
+        return (uint32_t)(ring->pool.frame_size * ring->pool.frame_index);
+    }
+    memcpy(slice.mapped, data, size);
+    ring->frame_pushes++;
+    ring->frame_bytes = ring->pool.head;
+    return (uint32_t)slice.offset;
+}
+
+void uniform_ring_bind(UniformRing *ring, VkCommandBuffer command_buffer, VkPipelineLayout layout, uint32_t set_index, uint32_t offset)
+{
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set_index, 1, &ring->set, 1, &offset);
+}
+
+void uniform_ring_draw_ui(UniformRing *ring)
+{
+    ImGui::Text("Ring: %u frames x %llu KB, offsets aligned to %llu", ring->pool.frame_count,
+                (unsigned long long)(ring->pool.frame_size / 1024), (unsigned long long)ring->alignment);
+    ImGui::Text("This frame: %u pushes, %llu bytes (peak %llu)", ring->frame_pushes,
+                (unsigned long long)ring->frame_bytes, (unsigned long long)ring->pool.peak);
+    ImGui::Text("Push constants: %u bytes available", ring->max_push_constants);
+    if (ring->failed_pushes > 0)
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%u pushes didn't fit", ring->failed_pushes);
+}
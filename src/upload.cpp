@@ -0,0 +1,514 @@
+#include <cstdio>
+#include <cstring>
+
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+
+// Staging uploads into DEVICE_LOCAL resources. Data is copied into a
+// persistently mapped ring buffer and the copies are batched into one command
+// buffer per flush. With a dedicated transfer queue family the batch runs
+// there, releases ownership to the graphics family and signals a semaphore
+// that a small acquire submit on the graphics queue waits on; otherwise the
+// batch goes straight to the graphics queue with plain barriers.
+//
+// Only meant for resources the GPU is not reading at the same time (initial
+// fills, freshly created buffers): there is no ownership release from the
+// graphics side before the transfer queue writes.
+
+#define UPLOAD_RING_SIZE (16ull * 1024 * 1024)
+#define UPLOAD_MAX_BATCHES 4
+
+struct UploadBatch
+{
+    VkCommandBuffer command_buffer;         // transfer family
+    VkCommandBuffer acquire_command_buffer; // graphics family, dedicated transfer queue only
+    VkFence fence;
+    VkSemaphore semaphore;
+    VkDeviceSize ring_end;
+    bool recording;
+    VkPipelineStageFlags dst_stages;
+    ImVector<VkBufferMemoryBarrier> buffer_barriers;
+    ImVector<VkImageMemoryBarrier> image_barriers;
+};
+
+struct UploadStats
+{
+    uint64_t bytes;
+    uint64_t copies;
+    uint64_t batches;
+    uint64_t stalls;
+};
+
+struct UploadContext
+{
+    VkDevice device;
+    uint32_t graphics_family;
+    VkQueue graphics_queue;
+    uint32_t transfer_family;
+    VkQueue transfer_queue;
+    bool dedicated;
+
+    VkDeviceSize copy_offset_alignment;
+    VkDeviceSize row_pitch_alignment;
+
+    GpuBuffer ring;
+    VkDeviceSize capacity;
+    VkDeviceSize head;
+    VkDeviceSize tail;
+
+    VkCommandPool transfer_pool;
+    VkCommandPool acquire_pool;
+    UploadBatch batches[UPLOAD_MAX_BATCHES];
+    uint64_t next_submit;
+    uint64_t next_retire;
+
+    UploadStats stats;
+};
+
+static VkDeviceSize gcd(VkDeviceSize a, VkDeviceSize b)
+{
+    while (b)
+    {
+        VkDeviceSize t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static VkDeviceSize lcm(VkDeviceSize a, VkDeviceSize b)
+{
+    return a / gcd(a, b) * b;
+}
+
+// Alignment that need not be a power of two (texel sizes of 3 or 6 bytes)
+static VkDeviceSize round_up(VkDeviceSize value, VkDeviceSize multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Prefers a transfer-only family (the DMA engine on discrete GPUs), then any
+// non-graphics family with transfer support, then the graphics family itself.
+uint32_t find_transfer_queue_family(VkPhysicalDevice physical_device, uint32_t graphics_family)
+{
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    ImVector<VkQueueFamilyProperties> families;
+    families.resize(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, families.Data);
+
+    uint32_t fallback = graphics_family;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        VkQueueFlags flags = families[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT) || families[i].queueCount == 0)
+            continue;
+        if (!(flags & VK_QUEUE_COMPUTE_BIT))
+            return i;
+        if (fallback == graphics_family)
+            fallback = i;
+    }
+    return fallback;
+}
+
+void upload_init(UploadContext *ctx, GpuAllocator *allocator, uint32_t graphics_family, VkQueue graphics_queue, uint32_t transfer_family, VkQueue transfer_queue)
+{
+    VkDevice device = allocator->device;
+    VkResult err;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+
+    ctx->device = device;
+    ctx->graphics_family = graphics_family;
+    ctx->graphics_queue = graphics_queue;
+    ctx->transfer_family = transfer_family;
+    ctx->transfer_queue = transfer_queue;
+    ctx->dedicated = transfer_family != graphics_family;
+    ctx->copy_offset_alignment = properties.limits.optimalBufferCopyOffsetAlignment;
+    ctx->row_pitch_alignment = properties.limits.optimalBufferCopyRowPitchAlignment;
+    if (ctx->copy_offset_alignment == 0)
+        ctx->copy_offset_alignment = 1;
+    if (ctx->row_pitch_alignment == 0)
+        ctx->row_pitch_alignment = 1;
+
+    ctx->capacity = UPLOAD_RING_SIZE;
+    ctx->head = 0;
+    ctx->tail = 0;
+    gpu_create_buffer(allocator, ctx->capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ctx->ring);
+
+    {
+        VkCommandPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        info.queueFamilyIndex = transfer_family;
+        err = vkCreateCommandPool(device, &info, nullptr, &ctx->transfer_pool);
+        check_vk_result(err);
+
+        ctx->acquire_pool = VK_NULL_HANDLE;
+        if (ctx->dedicated)
+        {
+            info.queueFamilyIndex = graphics_family;
+            err = vkCreateCommandPool(device, &info, nullptr, &ctx->acquire_pool);
+            check_vk_result(err);
+        }
+    }
+
+    for (UploadBatch& batch : ctx->batches)
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = ctx->transfer_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(device, &alloc_info, &batch.command_buffer);
+        check_vk_result(err);
+
+        batch.acquire_command_buffer = VK_NULL_HANDLE;
+        batch.semaphore = VK_NULL_HANDLE;
+        if (ctx->dedicated)
+        {
+            alloc_info.commandPool = ctx->acquire_pool;
+            err = vkAllocateCommandBuffers(device, &alloc_info, &batch.acquire_command_buffer);
+            check_vk_result(err);
+
+            VkSemaphoreCreateInfo semaphore_info = {};
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            err = vkCreateSemaphore(device, &semaphore_info, nullptr, &batch.semaphore);
+            check_vk_result(err);
+        }
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        err = vkCreateFence(device, &fence_info, nullptr, &batch.fence);
+        check_vk_result(err);
+
+        batch.ring_end = 0;
+        batch.recording = false;
+        batch.dst_stages = 0;
+    }
+    ctx->next_submit = 0;
+    ctx->next_retire = 0;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+
+    printf("[upload] Using queue family %u (%s)\n", transfer_family, ctx->dedicated ? "dedicated transfer" : "graphics");
+}
+
+// Frees ring space of finished batches. With wait == true blocks on the oldest one.
+static bool upload_retire(UploadContext *ctx, bool wait)
+{
+    bool retired = false;
+    while (ctx->next_retire < ctx->next_submit)
+    {
+        UploadBatch *batch = &ctx->batches[ctx->next_retire % UPLOAD_MAX_BATCHES];
+        VkResult err;
+        if (wait && !retired)
+        {
+            err = vkWaitForFences(ctx->device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+            check_vk_result(err);
+        }
+        else if (vkGetFenceStatus(ctx->device, batch->fence) != VK_SUCCESS)
+        {
+            break;
+        }
+        err = vkResetFences(ctx->device, 1, &batch->fence);
+        check_vk_result(err);
+
+        ctx->tail = batch->ring_end;
+        ctx->next_retire++;
+        retired = true;
+    }
+
+    UploadBatch *current = &ctx->batches[ctx->next_submit % UPLOAD_MAX_BATCHES];
+    if (ctx->next_retire == ctx->next_submit && !current->recording)
+    {
+        ctx->head = 0;
+        ctx->tail = 0;
+    }
+    return retired;
+}
+
+void upload_flush(UploadContext *ctx);
+
+// Returns the batch being recorded, starting one if needed.
+static UploadBatch *upload_begin(UploadContext *ctx)
+{
+    UploadBatch *batch = &ctx->batches[ctx->next_submit % UPLOAD_MAX_BATCHES];
+    if (batch->recording)
+        return batch;
+
+    if (ctx->next_submit - ctx->next_retire == UPLOAD_MAX_BATCHES)
+    {
+        ctx->stats.stalls++;
+        upload_retire(ctx, true);
+    }
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult err = vkBeginCommandBuffer(batch->command_buffer, &info);
+    check_vk_result(err);
+
+    batch->recording = true;
+    batch->dst_stages = 0;
+    batch->buffer_barriers.resize(0);
+    batch->image_barriers.resize(0);
+    return batch;
+}
+
+// Reserves size bytes of staging space, flushing and waiting on older batches
+// when the ring is full.
+static VkDeviceSize upload_reserve(UploadContext *ctx, VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (size > ctx->capacity / 2)
+        fatal("Upload of %llu bytes does not fit the staging ring", (unsigned long long)size);
+
+    for (;;)
+    {
+        upload_retire(ctx, false);
+
+        // Live data is [tail, head) or, once wrapped, [tail, capacity) + [0, head).
+        // head == tail only when the ring is empty.
+        VkDeviceSize offset = round_up(ctx->head, alignment);
+        if (ctx->head >= ctx->tail)
+        {
+            if (offset + size <= ctx->capacity)
+            {
+                ctx->head = offset + size;
+                return offset;
+            }
+            if (size < ctx->tail)
+            {
+                ctx->head = size;
+                return 0;
+            }
+        }
+        else if (offset + size < ctx->tail)
+        {
+            ctx->head = offset + size;
+            return offset;
+        }
+
+        ctx->stats.stalls++;
+        if (ctx->batches[ctx->next_submit % UPLOAD_MAX_BATCHES].recording)
+            upload_flush(ctx);
+        upload_retire(ctx, true);
+    }
+}
+
+void upload_buffer(UploadContext *ctx, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size,
+                   VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    // A zero-size barrier is invalid, and there is nothing to make visible
+    if (size == 0)
+        return;
+
+    // Large uploads go through the ring in chunks
+    VkDeviceSize chunk_size = ctx->capacity / 4;
+    for (VkDeviceSize done = 0; done < size; done += chunk_size)
+    {
+        VkDeviceSize chunk = size - done < chunk_size ? size - done : chunk_size;
+        VkDeviceSize offset = upload_reserve(ctx, chunk, lcm(ctx->copy_offset_alignment, 4));
+        memcpy((char *)ctx->ring.allocation.mapped + offset, (const char *)data + done, chunk);
+
+        UploadBatch *batch = upload_begin(ctx);
+        VkBufferCopy region = {};
+        region.srcOffset = offset;
+        region.dstOffset = dst_offset + done;
+        region.size = chunk;
+        vkCmdCopyBuffer(batch->command_buffer, ctx->ring.buffer, dst, 1, &region);
+        ctx->stats.copies++;
+    }
+
+    UploadBatch *batch = upload_begin(ctx);
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = ctx->dedicated ? ctx->transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = ctx->dedicated ? ctx->graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dst;
+    barrier.offset = dst_offset;
+    barrier.size = size;
+    batch->buffer_barriers.push_back(barrier);
+    batch->dst_stages |= dst_stage;
+    ctx->stats.bytes += size;
+}
+
+// Uploads a whole 2D image with tightly packed source texels. The staging rows
+// are padded to optimalBufferCopyRowPitchAlignment.
+void upload_image(UploadContext *ctx, VkImage image, uint32_t width, uint32_t height, uint32_t texel_size, const void *data,
+                  VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkDeviceSize row_size = (VkDeviceSize)width * texel_size;
+    VkDeviceSize row_pitch = round_up(row_size, lcm(ctx->row_pitch_alignment, texel_size));
+    VkDeviceSize size = row_pitch * height;
+    VkDeviceSize offset = upload_reserve(ctx, size, lcm(lcm(ctx->copy_offset_alignment, 4), texel_size));
+
+    char *dst = (char *)ctx->ring.allocation.mapped + offset;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        memcpy(dst + y * row_pitch, (const char *)data + y * row_size, row_size);
+    }
+
+    UploadBatch *batch = upload_begin(ctx);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = offset;
+    region.bufferRowLength = (uint32_t)(row_pitch / texel_size);
+    region.bufferImageHeight = height;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { width, height, 1 };
+    vkCmdCopyBufferToImage(batch->command_buffer, ctx->ring.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcQueueFamilyIndex = ctx->dedicated ? ctx->transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = ctx->dedicated ? ctx->graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    batch->image_barriers.push_back(barrier);
+    batch->dst_stages |= dst_stage;
+
+    ctx->stats.copies++;
+    ctx->stats.bytes += size;
+}
+
+// Submits everything recorded since the last flush. Cheap when nothing is pending.
+void upload_flush(UploadContext *ctx)
+{
+    CPU_SCOPE("upload_flush");
+    UploadBatch *batch = &ctx->batches[ctx->next_submit % UPLOAD_MAX_BATCHES];
+    if (!batch->recording)
+        return;
+
+    VkResult err;
+    VkPipelineStageFlags dst_stages = batch->dst_stages ? batch->dst_stages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkBufferMemoryBarrier *buffer_barriers = batch->buffer_barriers.Data;
+    VkImageMemoryBarrier *image_barriers = batch->image_barriers.Data;
+    uint32_t buffer_barrier_count = (uint32_t)batch->buffer_barriers.Size;
+    uint32_t image_barrier_count = (uint32_t)batch->image_barriers.Size;
+
+    if (!ctx->dedicated)
+    {
+        vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0,
+                             0, nullptr, buffer_barrier_count, buffer_barriers, image_barrier_count, image_barriers);
+        err = vkEndCommandBuffer(batch->command_buffer);
+        check_vk_result(err);
+
+        VkSubmitInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.commandBufferCount = 1;
+        info.pCommandBuffers = &batch->command_buffer;
+        err = vkQueueSubmit(ctx->graphics_queue, 1, &info, batch->fence);
+        check_vk_result(err);
+    }
+    else
+    {
+        // Release on the transfer queue: the destination access is ignored here
+        ImVector<VkBufferMemoryBarrier> release_buffers = batch->buffer_barriers;
+        ImVector<VkImageMemoryBarrier> release_images = batch->image_barriers;
+        for (VkBufferMemoryBarrier& b : release_buffers)
+            b.dstAccessMask = 0;
+        for (VkImageMemoryBarrier& b : release_images)
+            b.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, buffer_barrier_count, release_buffers.Data, image_barrier_count, release_images.Data);
+        err = vkEndCommandBuffer(batch->command_buffer);
+        check_vk_result(err);
+
+        VkSubmitInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.commandBufferCount = 1;
+        info.pCommandBuffers = &batch->command_buffer;
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores = &batch->semaphore;
+        err = vkQueueSubmit(ctx->transfer_queue, 1, &info, VK_NULL_HANDLE);
+        check_vk_result(err);
+
+        // Acquire on the graphics queue, chained to the semaphore wait through
+        // dst_stages; later graphics submits are ordered after this barrier.
+        // The source access is ignored here.
+        for (VkBufferMemoryBarrier& b : batch->buffer_barriers)
+            b.srcAccessMask = 0;
+        for (VkImageMemoryBarrier& b : batch->image_barriers)
+            b.srcAccessMask = 0;
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        err = vkBeginCommandBuffer(batch->acquire_command_buffer, &begin_info);
+        check_vk_result(err);
+        vkCmdPipelineBarrier(batch->acquire_command_buffer, dst_stages, dst_stages, 0,
+                             0, nullptr, buffer_barrier_count, buffer_barriers, image_barrier_count, image_barriers);
+        err = vkEndCommandBuffer(batch->acquire_command_buffer);
+        check_vk_result(err);
+
+        info.waitSemaphoreCount = 1;
+        info.pWaitSemaphores = &batch->semaphore;
+        info.pWaitDstStageMask = &dst_stages;
+        info.pCommandBuffers = &batch->acquire_command_buffer;
+        info.signalSemaphoreCount = 0;
+        info.pSignalSemaphores = nullptr;
+        err = vkQueueSubmit(ctx->graphics_queue, 1, &info, batch->fence);
+        check_vk_result(err);
+    }
+
+    batch->ring_end = ctx->head;
+    batch->recording = false;
+    ctx->next_submit++;
+    ctx->stats.batches++;
+}
+
+void upload_wait_idle(UploadContext *ctx)
+{
+    upload_flush(ctx);
+    while (ctx->next_retire < ctx->next_submit)
+    {
+        upload_retire(ctx, true);
+    }
+}
+
+void upload_destroy(UploadContext *ctx, GpuAllocator *allocator)
+{
+    upload_wait_idle(ctx);
+    for (UploadBatch& batch : ctx->batches)
+    {
+        vkDestroyFence(ctx->device, batch.fence, nullptr);
+        if (batch.semaphore != VK_NULL_HANDLE)
+            vkDestroySemaphore(ctx->device, batch.semaphore, nullptr);
+        batch.buffer_barriers.clear();
+        batch.image_barriers.clear();
+    }
+    vkDestroyCommandPool(ctx->device, ctx->transfer_pool, nullptr);
+    if (ctx->acquire_pool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(ctx->device, ctx->acquire_pool, nullptr);
+    gpu_destroy_buffer(allocator, &ctx->ring);
+}
+
+void upload_draw_ui(UploadContext *ctx)
+{
+    ImGui::BulletText("Queue family: %u (%s)", ctx->transfer_family, ctx->dedicated ? "dedicated transfer" : "graphics");
+    ImGui::BulletText("Staging ring: %.1f MiB, copy offset alignment %llu, row pitch alignment %llu",
+                      ctx->capacity / (1024.0 * 1024.0), (unsigned long long)ctx->copy_offset_alignment, (unsigned long long)ctx->row_pitch_alignment);
+    ImGui::BulletText("Uploaded: %.2f MiB in %llu copies, %llu batches, %llu stalls",
+                      ctx->stats.bytes / (1024.0 * 1024.0), (unsigned long long)ctx->stats.copies,
+                      (unsigned long long)ctx->stats.batches, (unsigned long long)ctx->stats.stalls);
+}
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Vertex input state generated at compile time from the vertex structs.
+//
+// Each member that feeds a shader is listed once with VERTEX_ATTR, which
+// takes its offset from offsetof and its format from its C++ type, and the
+// layouts of a pipeline's bindings are combined with VertexInput:
+//
+//   using VertexLayout = VertexBinding<Vertex, VK_VERTEX_INPUT_RATE_VERTEX, VERTEX_ATTR(Vertex, pos), VERTEX_ATTR(Vertex, color)>;
+//   VkPipelineVertexInputStateCreateInfo info = VertexInput<VertexLayout, InstanceLayout>::state();
+//
+// Bindings are numbered in order and locations run on across them, so the
+// shader's locations follow the member order. A member whose size doesn't
+// match its format, or that overlaps another or the end of the struct, fails
+// to compile.
+
+//
+// Compact attribute types
+//
+
+struct Half2 // VK_FORMAT_R16G16_SFLOAT
+{
+    uint16_t x, y;
+};
+
+struct Half4 // VK_FORMAT_R16G16B16A16_SFLOAT
+{
+    uint16_t x, y, z, w;
+};
+
+struct Unorm8x4 // VK_FORMAT_R8G8B8A8_UNORM
+{
+    uint8_t x, y, z, w;
+};
+
+struct OctNormal // unit vector, octahedral encoded, VK_FORMAT_R16G16_SNORM
+{
+    int16_t x, y;
+};
+
+template <typename T>
+struct VertexFormatOf; // no default: a member of an unknown type needs VERTEX_ATTR_AS
+
+template <> struct VertexFormatOf<float> { static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+template <> struct VertexFormatOf<float[2]> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+template <> struct VertexFormatOf<float[3]> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+template <> struct VertexFormatOf<float[4]> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template <> struct VertexFormatOf<uint32_t> { static constexpr VkFormat value = VK_FORMAT_R32_UINT; };
+template <> struct VertexFormatOf<Half2> { static constexpr VkFormat value = VK_FORMAT_R16G16_SFLOAT; };
+template <> struct VertexFormatOf<Half4> { static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_SFLOAT; };
+template <> struct VertexFormatOf<Unorm8x4> { static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM; };
+template <> struct VertexFormatOf<OctNormal> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+
+// Bytes per element for the formats vertices use; 0 for anything else.
+constexpr uint32_t vertex_format_size(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SNORM:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R16G16_UNORM:
+        case VK_FORMAT_R16G16_SNORM:
+        case VK_FORMAT_R16G16_UINT:
+        case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R16G16B16A16_SNORM:
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_R32G32_UINT:
+            return 8;
+        case VK_FORMAT_R32G32B32_SFLOAT:
+            return 12;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_UINT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+template <typename T, uint32_t Offset, VkFormat Format = VertexFormatOf<T>::value>
+struct VertexAttr
+{
+    static constexpr uint32_t offset = Offset;
+    static constexpr uint32_t size = sizeof(T);
+    static constexpr VkFormat format = Format;
+    static_assert(vertex_format_size(Format) == sizeof(T), "vertex format doesn't match the member's size");
+};
+
+#define VERTEX_ATTR(STRUCT, MEMBER) VertexAttr<decltype(STRUCT::MEMBER), offsetof(STRUCT, MEMBER)>
+#define VERTEX_ATTR_AS(STRUCT, MEMBER, FORMAT) VertexAttr<decltype(STRUCT::MEMBER), offsetof(STRUCT, MEMBER), FORMAT>
+
+// Attributes must be listed in member order, without overlap, inside the struct.
+template <typename... Attrs>
+constexpr bool vertex_attrs_fit(uint32_t stride)
+{
+    const uint32_t offsets[] = { Attrs::offset... };
+    const uint32_t sizes[] = { Attrs::size... };
+    uint32_t end = 0;
+    for (size_t i = 0; i < sizeof...(Attrs); i++)
+    {
+        if (offsets[i] < end)
+            return false;
+        end = offsets[i] + sizes[i];
+    }
+    return end <= stride;
+}
+
+// One vertex buffer binding: the struct, its input rate and the members shaders read.
+template <typename V, VkVertexInputRate Rate, typename... Attrs>
+struct VertexBinding
+{
+    static constexpr uint32_t stride = sizeof(V);
+    static constexpr VkVertexInputRate rate = Rate;
+    static constexpr uint32_t attribute_count = sizeof...(Attrs);
+    static_assert(attribute_count > 0, "a binding needs at least one attribute");
+    static_assert(vertex_attrs_fit<Attrs...>(sizeof(V)), "vertex attributes overlap or run past the struct");
+
+    static constexpr void append(VkVertexInputAttributeDescription *out, uint32_t binding, uint32_t *location)
+    {
+        const uint32_t offsets[] = { Attrs::offset... };
+        const VkFormat formats[] = { Attrs::format... };
+        for (uint32_t i = 0; i < attribute_count; i++)
+        {
+            out[i].location = (*location)++;
+            out[i].binding = binding;
+            out[i].format = formats[i];
+            out[i].offset = offsets[i];
+        }
+    }
+};
+
+template <typename... Bindings>
+struct VertexInput
+{
+    static constexpr uint32_t binding_count = sizeof...(Bindings);
+    static constexpr uint32_t attribute_count = (0 + ... + Bindings::attribute_count);
+
+    static constexpr std::array<VkVertexInputBindingDescription, binding_count> make_bindings()
+    {
+        std::array<VkVertexInputBindingDescription, binding_count> out = {};
+        const uint32_t strides[] = { Bindings::stride... };
+        const VkVertexInputRate rates[] = { Bindings::rate... };
+        for (uint32_t i = 0; i < binding_count; i++)
+        {
+            out[i].binding = i;
+            out[i].stride = strides[i];
+            out[i].inputRate = rates[i];
+        }
+        return out;
+    }
+
+    static constexpr std::array<VkVertexInputAttributeDescription, attribute_count> make_attributes()
+    {
+        std::array<VkVertexInputAttributeDescription, attribute_count> out = {};
+        uint32_t binding = 0;
+        uint32_t location = 0;
+        VkVertexInputAttributeDescription *next = out.data();
+        ((Bindings::append(next, binding++, &location), next += Bindings::attribute_count), ...);
+        return out;
+    }
+
+    static constexpr std::array<VkVertexInputBindingDescription, binding_count> bindings = make_bindings();
+    static constexpr std::array<VkVertexInputAttributeDescription, attribute_count> attributes = make_attributes();
+
+    static VkPipelineVertexInputStateCreateInfo state()
+    {
+        VkPipelineVertexInputStateCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        info.vertexBindingDescriptionCount = binding_count;
+        info.pVertexBindingDescriptions = bindings.data();
+        info.vertexAttributeDescriptionCount = attribute_count;
+        info.pVertexAttributeDescriptions = attributes.data();
+        return info;
+    }
+};
+
+//
+// Pack helpers. Each converts count values from float, four at a time with
+// F16C, SSE2 or NEON where available, the rest one at a time. Rounding is to
+// nearest even in every path, so results don't depend on the path.
+//
+
+// IEEE half, round to nearest even; overflow goes to infinity, NaN stays NaN.
+static inline uint16_t float_to_half(float value)
+{
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t h;
+    if (f >= (127u + 16) << 23) // too big for half, or inf/NaN
+    {
+        h = f > 255u << 23 ? 0x7e00 : 0x7c00;
+    }
+    else if (f < (127u - 14) << 23) // subnormal half; the FPU does the rounding
+    {
+        const uint32_t magic_bits = ((127u - 15) + (23 - 10) + 1) << 23;
+        float magic, d;
+        memcpy(&magic, &magic_bits, sizeof(magic));
+        memcpy(&d, &f, sizeof(d));
+        d += magic;
+        memcpy(&h, &d, sizeof(h));
+        h -= magic_bits;
+    }
+    else
+    {
+        uint32_t mantissa_odd = (f >> 13) & 1;
+        f += ((uint32_t)(15 - 127) << 23) + 0xfff + mantissa_odd;
+        h = f >> 13;
+    }
+    return (uint16_t)(h | (sign >> 16));
+}
+
+static inline float half_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    float value;
+    if (exponent == 0)
+        value = ldexpf((float)mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#if defined(__SSE2__) && !defined(__F16C__)
+// float_to_half for four lanes; halves end up sign extended in 32-bit lanes,
+// ready for _mm_packs_epi32.
+static inline __m128i float_to_half_sse2(__m128 f)
+{
+    const __m128i f16_max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23);
+    const __m128i subnormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+    __m128 sign = _mm_and_ps(f, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000u)));
+    __m128 abs_f = _mm_xor_ps(f, sign);
+    __m128i abs_i = _mm_castps_si128(abs_f);
+
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(abs_f, abs_f));
+    __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+    __m128i is_regular = _mm_cmpgt_epi32(f16_max, abs_i);
+    __m128i is_subnormal = _mm_cmpgt_epi32(min_normal, abs_i);
+
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs_f, _mm_castsi128_ps(subnormal_magic))), subnormal_magic);
+    __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs_i, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_i, normal_bias), mantissa_odd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+    __m128i joined = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, inf_or_nan));
+    return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+#endif
+
+static inline void pack_half(const float *src, uint16_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= count; i += 4)
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(__SSE2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = float_to_half_sse2(_mm_loadu_ps(src + i));
+        __m128i hi = float_to_half_sse2(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4)
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+#endif
+    for (; i < count; i++)
+        dst[i] = float_to_half(src[i]);
+}
+
+// Clamps to [0, 1] and scales to 0..255.
+static inline void pack_unorm8(const float *src, uint8_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v[4];
+        for (int j = 0; j < 4; j++)
+        {
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * j), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            v[j] = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t scale = vdupq_n_f32(255.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+        float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+        uint16x8_t packed = vcombine_u16(vmovn_u32(vcvtnq_u32_f32(vmulq_f32(a, scale))), vmovn_u32(vcvtnq_u32_f32(vmulq_f32(b, scale))));
+        vst1_u8(dst + i, vmovn_u16(packed));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float x = src[i] < 0.0f ? 0.0f : src[i] > 1.0f ? 1.0f : src[i];
+        dst[i] = (uint8_t)nearbyintf(x * 255.0f);
+    }
+}
+
+// Octahedral encoding: project onto the octahedron |x|+|y|+|z| = 1 and fold
+// the lower half over the diagonals, giving two snorm16 values with about
+// 0.04 degree worst case error. Decode in the shader with:
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(n.xy, vec2(0.0)));
+//   n = normalize(n);
+static inline OctNormal oct_encode(float x, float y, float z)
+{
+    float inv = 1.0f / (fabsf(x) + fabsf(y) + fabsf(z));
+    float u = x * inv;
+    float v = y * inv;
+    if (z < 0.0f)
+    {
+        float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    OctNormal n;
+    n.x = (int16_t)nearbyintf(fminf(fmaxf(u, -1.0f), 1.0f) * 32767.0f);
+    n.y = (int16_t)nearbyintf(fminf(fmaxf(v, -1.0f), 1.0f) * 32767.0f);
+    return n;
+}
+
+static inline void oct_decode(OctNormal n, float *x, float *y, float *z)
+{
+    float u = fmaxf(n.x / 32767.0f, -1.0f);
+    float v = fmaxf(n.y / 32767.0f, -1.0f);
+    float w = 1.0f - fabsf(u) - fabsf(v);
+    if (w < 0.0f)
+    {
+        float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    float inv_len = 1.0f / sqrtf(u * u + v * v + w * w);
+    *x = u * inv_len;
+    *y = v * inv_len;
+    *z = w * inv_len;
+}
+
+// xyz holds count tightly packed unit vectors.
+static inline void pack_oct_normals(const float *xyz, OctNormal *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000u));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        const float *p = xyz + 3 * i;
+        __m128 x = _mm_set_ps(p[9], p[6], p[3], p[0]);
+        __m128 y = _mm_set_ps(p[10], p[7], p[4], p[1]);
+        __m128 z = _mm_set_ps(p[11], p[8], p[5], p[2]);
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, x), _mm_andnot_ps(sign_mask, y)), _mm_andnot_ps(sign_mask, z));
+        __m128 inv = _mm_div_ps(one, l1);
+        __m128 u = _mm_mul_ps(x, inv);
+        __m128 v = _mm_mul_ps(y, inv);
+        // Sign of +0.0 is +1, like the scalar path
+        __m128 sign_u = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(u, _mm_setzero_ps()), sign_mask));
+        __m128 sign_v = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(v, _mm_setzero_ps()), sign_mask));
+        __m128 fu = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, v)), sign_u);
+        __m128 fv = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, u)), sign_v);
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        u = _mm_or_ps(_mm_and_ps(lower, fu), _mm_andnot_ps(lower, u));
+        v = _mm_or_ps(_mm_and_ps(lower, fv), _mm_andnot_ps(lower, v));
+        u = _mm_min_ps(_mm_max_ps(u, _mm_set1_ps(-1.0f)), one);
+        v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), one);
+        __m128i ui = _mm_cvtps_epi32(_mm_mul_ps(u, scale));
+        __m128i vi = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+        __m128i packed = _mm_packs_epi32(_mm_unpacklo_epi32(ui, vi), _mm_unpackhi_epi32(ui, vi));
+        _mm_storeu_si128((__m128i *)(dst + i), packed);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4x3_t p = vld3q_f32(xyz + 3 * i);
+        float32x4_t l1 = vaddq_f32(vaddq_f32(vabsq_f32(p.val[0]), vabsq_f32(p.val[1])), vabsq_f32(p.val[2]));
+        float32x4_t inv = vdivq_f32(one, l1);
+        float32x4_t u = vmulq_f32(p.val[0], inv);
+        float32x4_t v = vmulq_f32(p.val[1], inv);
+        float32x4_t sign_u = vbslq_f32(vcltq_f32(u, vdupq_n_f32(0.0f)), vdupq_n_f32(-1.0f), one);
+        float32x4_t sign_v = vbslq_f32(vcltq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(-1.0f), one);
+        float32x4_t fu = vmulq_f32(vsubq_f32(one, vabsq_f32(v)), sign_u);
+        float32x4_t fv = vmulq_f32(vsubq_f32(one, vabsq_f32(u)), sign_v);
+        uint32x4_t lower = vcltq_f32(p.val[2], vdupq_n_f32(0.0f));
+        u = vminq_f32(vmaxq_f32(vbslq_f32(lower, fu, u), vdupq_n_f32(-1.0f)), one);
+        v = vminq_f32(vmaxq_f32(vbslq_f32(lower, fv, v), vdupq_n_f32(-1.0f)), one);
+        int16x4x2_t packed;
+        packed.val[0] = vmovn_s32(vcvtnq_s32_f32(vmulq_f32(u, scale)));
+        packed.val[1] = vmovn_s32(vcvtnq_s32_f32(vmulq_f32(v, scale)));
+        vst2_s16((int16_t *)(dst + i), packed);
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = oct_encode(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Generates constexpr DeviceField tables for the Info window and the device
+# JSON export from the struct definitions in vulkan_core.h, so new fields show
+# up with a header update instead of a hand-edited list.
+#
+# usage: gen_device_fields.py path/to/vulkan_core.h -o bin/device_fields.hpp
+
+import re
+import sys
+
+# struct name -> table name
+STRUCTS = [
+    ('VkPhysicalDeviceLimits', 'g_DeviceLimitFields'),
+    ('VkPhysicalDeviceSparseProperties', 'g_DeviceSparseFields'),
+    ('VkPhysicalDeviceFeatures', 'g_DeviceFeatureFields'),
+]
+
+TYPES = {
+    'uint32_t': 'DEVICE_FIELD_U32',
+    'int32_t': 'DEVICE_FIELD_I32',
+    'VkDeviceSize': 'DEVICE_FIELD_U64',
+    'size_t': 'DEVICE_FIELD_SIZE',
+    'float': 'DEVICE_FIELD_FLOAT',
+    'VkBool32': 'DEVICE_FIELD_BOOL',
+    'VkSampleCountFlags': 'DEVICE_FIELD_SAMPLE_COUNTS',
+}
+
+def parse_struct(header, name):
+    match = re.search(r'typedef\s+struct\s+' + name + r'\s*\{(.*?)\}\s*' + name + r'\s*;', header, re.S)
+    if not match:
+        sys.exit(f'gen_device_fields: {name} not found')
+    body = re.sub(r'//[^\n]*|/\*.*?\*/', '', match.group(1), flags=re.S)
+
+    fields = []
+    for decl in body.split(';'):
+        decl = decl.strip()
+        if not decl:
+            continue
+        typ, _, declarators = decl.partition(' ')
+        if typ not in TYPES:
+            sys.exit(f'gen_device_fields: {name}: unsupported type {typ}')
+        for declarator in declarators.split(','):
+            m = re.fullmatch(r'\s*(\w+)\s*(?:\[\s*(\d+)\s*\])?\s*', declarator)
+            if not m:
+                sys.exit(f'gen_device_fields: {name}: can\'t parse "{declarator.strip()}"')
+            fields.append((m.group(1), TYPES[typ], int(m.group(2) or 1)))
+    return fields
+
+def main():
+    if len(sys.argv) != 4 or sys.argv[2] != '-o':
+        sys.exit('usage: gen_device_fields.py vulkan_core.h -o OUT')
+    with open(sys.argv[1]) as f:
+        header = f.read()
+
+    out = ['// Generated by tools/gen_device_fields.py from vulkan_core.h, do not edit.', '#pragma once', '']
+    for struct, table in STRUCTS:
+        out.append(f'static constexpr DeviceField {table}[] = {{')
+        for field, kind, count in parse_struct(header, struct):
+            out.append(f'    {{ "{field}", offsetof({struct}, {field}), {kind}, {count} }},')
+        out.append('};')
+        out.append('')
+
+    with open(sys.argv[3], 'w') as f:
+        f.write('\n'.join(out))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../src/shader_pack.hpp"
+
+// Bundles compiled SPIR-V into bin/shaders.pack (see src/shader_pack.hpp), or
+// with --embed into a header holding the same bytes as a constexpr array.
+//
+//   shader_pack [--embed] -o OUT bin/shaders/tri.vert.spv ...
+//
+// Module names are the file names without directory and ".spv". The output is
+// written to OUT.tmp and renamed, so a running app keeps its mapping of the
+// old pack intact.
+
+static void die(const char *fmt, const char *arg)
+{
+    fprintf(stderr, "shader_pack: ");
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+static uint64_t fnv1a64(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static std::vector<uint8_t> read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        die("can't open %s", path);
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    if (ferror(f))
+        die("can't read %s", path);
+    fclose(f);
+    if (data.empty() || data.size() % 4 != 0)
+        die("%s is not SPIR-V", path);
+    return data;
+}
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static std::vector<uint8_t> build_pack(int count, char **paths)
+{
+    size_t index_offset = align_up(sizeof(ShaderPackHeader), alignof(ShaderPackEntry));
+    size_t data_offset = align_up(index_offset + count * sizeof(ShaderPackEntry), SHADER_PACK_ALIGNMENT);
+
+    std::vector<ShaderPackEntry> entries(count);
+    std::vector<uint8_t> pack(data_offset, 0);
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = strrchr(paths[i], '/');
+        name = name ? name + 1 : paths[i];
+        size_t name_len = strlen(name);
+        if (name_len > 4 && strcmp(name + name_len - 4, ".spv") == 0)
+            name_len -= 4;
+        if (name_len >= SHADER_PACK_NAME_SIZE)
+            die("name of %s is too long", paths[i]);
+
+        std::vector<uint8_t> spirv = read_file(paths[i]);
+        pack.resize(align_up(pack.size(), SHADER_PACK_ALIGNMENT), 0);
+        ShaderPackEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, name, name_len);
+        entry.offset = (uint32_t)pack.size();
+        entry.size = (uint32_t)spirv.size();
+        entry.checksum = fnv1a64(spirv.data(), spirv.size());
+        pack.insert(pack.end(), spirv.begin(), spirv.end());
+    }
+
+    ShaderPackHeader header = {};
+    header.magic = SHADER_PACK_MAGIC;
+    header.version = SHADER_PACK_VERSION;
+    header.entry_count = (uint32_t)count;
+    header.index_offset = (uint32_t)index_offset;
+    header.total_size = pack.size();
+    memcpy(pack.data(), &header, sizeof(header));
+    if (count > 0)
+        memcpy(pack.data() + index_offset, entries.data(), count * sizeof(ShaderPackEntry));
+    return pack;
+}
+
+static void write_embedded(FILE *f, const std::vector<uint8_t>& pack)
+{
+    fprintf(f, "// Generated by tools/shader_pack --embed, do not edit.\n");
+    fprintf(f, "#pragma once\n\n#include <cstdint>\n\n");
+    fprintf(f, "alignas(%d) static constexpr uint8_t g_EmbeddedShaderPack[%zu] =\n{", SHADER_PACK_ALIGNMENT, pack.size());
+    for (size_t i = 0; i < pack.size(); i++)
+        fprintf(f, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", pack[i]);
+    fprintf(f, "\n};\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool embed = false;
+    const char *out_path = nullptr;
+    int first = 1;
+    for (; first < argc && argv[first][0] == '-'; first++)
+    {
+        if (strcmp(argv[first], "--embed") == 0)
+            embed = true;
+        else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc)
+            out_path = argv[++first];
+        else
+            die("unknown option %s", argv[first]);
+    }
+    if (!out_path)
+        die("%s", "usage: shader_pack [--embed] -o OUT FILE.spv...");
+
+    std::vector<uint8_t> pack = build_pack(argc - first, argv + first);
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    FILE *f = fopen(tmp_path, embed ? "w" : "wb");
+    if (!f)
+        die("can't create %s", tmp_path);
+    if (embed)
+        write_embedded(f, pack);
+    else
+        fwrite(pack.data(), 1, pack.size(), f);
+    if (ferror(f) || fclose(f) != 0)
+        die("can't write %s", tmp_path);
+    if (rename(tmp_path, out_path) != 0)
+        die("can't rename to %s", out_path);
+
+    printf("shader_pack: %d modules, %zu bytes -> %s\n", argc - first, pack.size(), out_path);
+    return 0;
+}